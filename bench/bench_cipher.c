@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "encrypt.h"
+#include "bench_cipher.h"
+
+static const char *const IMPLS[] = { "scalar", "sse2", "avx2", "portable" };
+static const size_t SIZES[] = { 64, 1024, 16 * 1024, 1024 * 1024 };
+
+#define IMPL_COUNT (int)(sizeof(IMPLS) / sizeof(IMPLS[0]))
+#define SIZE_COUNT (int)(sizeof(SIZES) / sizeof(SIZES[0]))
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * 한 구현 / 한 크기: seconds 동안 같은 버퍼를 반복해서 암호화 → GB/s
+ */
+static double run_one(uint8_t *buf, size_t size, double seconds) {
+    static const uint8_t key[CIPHER_KEY_LEN] = { 1, 2, 3 };
+    uint8_t nonce[CIPHER_NONCE_LEN] = { 0 };
+    uint64_t budget = (uint64_t)(seconds * 1e9);
+    uint64_t bytes = 0, t0 = bench_now_ns(), t;
+
+    do {
+        // 시간 측정 비용이 작은 버퍼를 가리지 않도록 묶어서 돌린다
+        for (int i = 0; i < 64; i++) {
+            nonce[0]++;
+            chacha20_xor(key, nonce, 1, buf, size);
+            bytes += size;
+        }
+        t = bench_now_ns();
+    } while (t - t0 < budget);
+
+    return (double)bytes / (double)(t - t0);      // 바이트/ns = GB/s
+}
+
+int cipher_bench(double seconds) {
+    const char *chosen = cipher_impl_name();
+    uint8_t *buf = malloc(SIZES[SIZE_COUNT - 1]);
+    if (!buf) return 1;
+    memset(buf, 0xa5, SIZES[SIZE_COUNT - 1]);
+
+    printf("[BENCH] chacha20, 1 thread, %.1f s per cell (runtime pick: %s)\n", seconds, chosen);
+    printf("%-10s", "impl");
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        char label[24];
+        if (SIZES[s] >= 1024 * 1024) snprintf(label, sizeof(label), "%zuMiB", SIZES[s] >> 20);
+        else if (SIZES[s] >= 1024)   snprintf(label, sizeof(label), "%zuKiB", SIZES[s] >> 10);
+        else                         snprintf(label, sizeof(label), "%zuB", SIZES[s]);
+        printf(" %10s", label);
+    }
+    printf("   (GB/s)\n");
+
+    for (int i = 0; i < IMPL_COUNT; i++) {
+        if (cipher_set_impl(IMPLS[i]) < 0) continue;
+        printf("%-10s", IMPLS[i]);
+        for (int s = 0; s < SIZE_COUNT; s++) {
+            printf(" %10.2f", run_one(buf, SIZES[s], seconds));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    cipher_set_impl(chosen);
+    free(buf);
+    return 0;
+}
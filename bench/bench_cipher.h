@@ -0,0 +1,11 @@
+#ifndef BENCH_CIPHER_H
+#define BENCH_CIPHER_H
+
+/*
+ * 암호화 마이크로벤치마크 (서버 없이 단일 스레드)
+ *  구현(scalar / sse2 / avx2) × 버퍼 크기별로 chacha20_xor 처리량(GB/s)을 출력한다.
+ */
+
+int cipher_bench(double seconds);
+
+#endif
@@ -0,0 +1,894 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "protocol.h"
+#include "frame.h"
+#include "bench_hdr.h"
+#include "bench_cipher.h"
+
+/*
+ * 부하 생성기 (헤드리스 클라이언트)
+ *  - 한 프로세스에서 수천 명의 사용자를 흉내 낸다: 로그인 → 일정 속도로 채팅/DM,
+ *    일부 사용자는 파일 업로드/다운로드를 반복.
+ *  - 채팅/DM 본문에 보낸 시각을 넣어, 받는 쪽에서 end-to-end 지연을 HDR 히스토그램에 기록한다.
+ *  - 사용자는 --threads 개의 epoll 워커 스레드에 나눠 배정된다.
+ *
+ *   ./bench_client --scenario=broadcast-storm
+ *   ./bench_client --users=500 --rate=2 --dm-ratio=0.3 --duration=30 --out=bench_results.tsv
+ *
+ * 서버 없이 암호화 처리량만 재기: ./bench_client --cipher-bench
+ *
+ * 측정 구간 앞뒤로 서버 metrics 포트를 읽어 sendmsg 호출 수 / 프레임 수도 같이 보고한다.
+ * (서버를 --tcp-nodelay=on|off 로 바꿔 가며 돌리면 지연과 묶어 보내기의 trade-off 가 보인다)
+ *
+ * 계정은 users.txt 에 있어야 한다: ./bench_client --print-users=2000 >> users.txt
+ * (서버가 users.txt 변경을 감지해서 바로 다시 읽는다)
+ */
+
+#define BENCH_TAG_CHAT   "~bc "      // 채팅 본문: "~bc <보낸 시각 ns>"
+#define BENCH_TAG_DM     "~bd "
+#define IN_BUF_SIZE      (64 * 1024)
+#define FILE_OUT_LIMIT   (256 * 1024) // 업로드 중 출력 버퍼에 쌓아 두는 최대 크기
+#define LOOP_TICK_MS     1
+#define CONNECT_BATCH    32           // 루프 한 번에 새로 접속하는 사용자 수
+
+typedef struct {
+    const char *name;
+    int    users;
+    double rate;          // 사용자 1명당 초당 메시지 수
+    double dm_ratio;      // 메시지 중 DM 비율
+    int    file_users;    // 파일 전송을 반복하는 사용자 수
+    long   file_size;
+    int    duration;      // 측정 시간 (초)
+    const char *desc;
+} Scenario;
+
+// 고정 시나리오 (결과를 시간에 따라 비교할 수 있도록 값을 바꾸지 않는다)
+static const Scenario scenarios[] = {
+    { "idle-fanin",      2000, 0.005, 0.0, 0, 0,                20,
+      "2000 mostly idle sessions, a trickle of chat fanned out to everyone" },
+    { "broadcast-storm",  200, 5.0,   0.0, 0, 0,                15,
+      "every user chats 5 msg/s, each message fans out to all 200" },
+    { "file-mix",         100, 1.0,   0.2, 4, 32 * 1024 * 1024, 20,
+      "chat + DM while 4 users loop 32 MiB upload/download" },
+};
+#define SCENARIO_COUNT ((int)(sizeof(scenarios) / sizeof(scenarios[0])))
+
+typedef struct {
+    Scenario    sc;
+    const char *host;
+    int         port;
+    int         threads;
+    int         warmup;
+    const char *prefix;
+    const char *password;
+    const char *out_path;     // 결과 누적 (TSV)
+    const char *hdr_path;     // 채팅 지연 분포 (.hgrm)
+    int         metrics_port; // 서버 metrics 포트 (0 이면 읽지 않음)
+} BenchConfig;
+
+static BenchConfig cfg = {
+    .sc       = { "custom", 100, 1.0, 0.0, 0, 8 * 1024 * 1024, 10, "command line" },
+    .host     = "127.0.0.1",
+    .port     = SERVER_PORT,
+    .threads  = 1,
+    .warmup   = 2,
+    .prefix   = "bench",
+    .password = "pw",
+    .metrics_port = 9001,
+};
+
+enum { ST_LOGIN = 0, ST_READY, ST_FAILED, ST_CLOSED };
+enum { FILE_IDLE = 0, FILE_WAIT_READY, FILE_SENDING, FILE_WAIT_DOWNLOAD, FILE_RECEIVING };
+
+typedef struct {
+    int   fd;
+    int   user;           // 사용자 번호 (이름 = prefix + user)
+    int   state;
+    int   file_role;
+    int   file_state;
+    long  file_off;
+    long  raw_left;       // bulk 다운로드 본문 남은 바이트
+    uint64_t login_ns;
+    uint64_t cycle_ns;    // 파일 업로드+다운로드 1회 시작 시각
+    char  name[MAX_NAME];
+    char  file_name[64];
+
+    unsigned char *in;
+    size_t in_len;
+    unsigned char *out;
+    size_t out_len, out_off, out_cap;
+    int   want_write;
+} BenchConn;
+
+typedef struct {
+    uint64_t chat_sent, dm_sent;
+    uint64_t chat_recv, dm_recv;
+    uint64_t chat_expected;       // 측정 구간에 보낸 채팅 × (받을 사람 수)
+    uint64_t up_bytes, down_bytes, file_cycles;
+    uint64_t errors;
+} Counters;
+
+// 서버 metrics 포트에서 읽은 누적 값
+typedef struct {
+    int      ok;
+    uint64_t send_calls;
+    uint64_t frames;
+} ServerSample;
+
+typedef struct {
+    int        id;
+    pthread_t  tid;
+    int        epfd;
+    BenchConn *conns;
+    int        count;
+    int        next_sender;
+    int        next_connect;
+    double     credit;
+    Hdr        chat_lat, dm_lat, login_lat, file_lat;
+    Counters   n;
+} Worker;
+
+static atomic_int      logged_in = 0;
+static atomic_int      login_failed = 0;
+static _Atomic uint64_t send_start_ns = UINT64_MAX;   // 이 시각부터 채팅 전송
+static _Atomic uint64_t measure_start_ns = UINT64_MAX;
+static _Atomic uint64_t measure_end_ns = UINT64_MAX;
+static atomic_int      stop = 0;
+static int chat_users = 0;    // 파일 사용자를 제외한 채팅 사용자 수
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int in_window(uint64_t t) {
+    return t >= atomic_load(&measure_start_ns) && t < atomic_load(&measure_end_ns);
+}
+
+/* ----------------------- 송신 ----------------------- */
+
+static int conn_flush(Worker *w, BenchConn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        c->out_off += n;
+    }
+    if (c->out_off == c->out_len) c->out_off = c->out_len = 0;
+
+    int want = c->out_len > 0;
+    if (want != c->want_write) {
+        struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.ptr = c };
+        epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want;
+    }
+    return 0;
+}
+
+static int conn_send(Worker *w, BenchConn *c, const Message *m) {
+    size_t len = frame_encoded_len(m);
+    if (c->out_len + len > c->out_cap) {
+        // 앞쪽 보낸 부분을 당기고, 그래도 모자라면 늘린다
+        if (c->out_off > 0) {
+            memmove(c->out, c->out + c->out_off, c->out_len - c->out_off);
+            c->out_len -= c->out_off;
+            c->out_off = 0;
+        }
+        if (c->out_len + len > c->out_cap) {
+            size_t cap = c->out_cap ? c->out_cap * 2 : 4096;
+            while (cap < c->out_len + len) cap *= 2;
+            unsigned char *p = realloc(c->out, cap);
+            if (!p) return -1;
+            c->out = p;
+            c->out_cap = cap;
+        }
+    }
+    c->out_len += frame_encode(m, FRAME_ID_NONE, FRAME_ID_NONE, c->out + c->out_len);
+    return conn_flush(w, c);
+}
+
+static void send_text(Worker *w, BenchConn *c, int type, const char *target, const char *data) {
+    Message m;
+    memset(&m, 0, sizeof(m));
+    m.type = type;
+    strcpy(m.sender, c->name);
+    if (target) snprintf(m.target, sizeof(m.target), "%s", target);
+    snprintf(m.data, sizeof(m.data), "%s", data);
+    if (conn_send(w, c, &m) < 0) {
+        w->n.errors++;
+        c->state = ST_CLOSED;
+    }
+}
+
+/* ----------------------- 파일 전송 사용자 ----------------------- */
+
+static void file_start(Worker *w, BenchConn *c) {
+    char data[MAX_BUF];
+    snprintf(data, sizeof(data), "%s %ld 60", c->file_name, cfg.sc.file_size);
+    c->cycle_ns = now_ns();
+    c->file_state = FILE_WAIT_READY;
+    send_text(w, c, MSG_FILE_UPLOAD, NULL, data);
+}
+
+static void file_pump(Worker *w, BenchConn *c) {
+    if (c->file_state != FILE_SENDING) return;
+
+    Message m;
+    memset(&m, 0, sizeof(m));
+    m.type = MSG_FILE_DATA;
+    strcpy(m.sender, c->name);
+    memset(m.data, 'x', sizeof(m.data));
+
+    while (c->out_len - c->out_off < FILE_OUT_LIMIT && c->file_off < cfg.sc.file_size) {
+        long left = cfg.sc.file_size - c->file_off;
+        m.data_len = left < MAX_BUF ? (int)left : MAX_BUF;
+        if (conn_send(w, c, &m) < 0) {
+            w->n.errors++;
+            c->state = ST_CLOSED;
+            return;
+        }
+        c->file_off += m.data_len;
+        w->n.up_bytes += m.data_len;
+    }
+
+    if (c->file_off >= cfg.sc.file_size) {
+        send_text(w, c, MSG_FILE_END, NULL, c->file_name);
+        char data[MAX_BUF];
+        snprintf(data, sizeof(data), "%s bulk", c->file_name);
+        send_text(w, c, MSG_FILE_DOWNLOAD, NULL, data);
+        c->file_state = FILE_WAIT_DOWNLOAD;
+    }
+}
+
+/* ----------------------- 수신 ----------------------- */
+
+static void handle_message(Worker *w, BenchConn *c, const Message *m) {
+    uint64_t now = now_ns();
+
+    switch (m->type) {
+    case MSG_LOGIN_OK:
+        if (c->state != ST_LOGIN) break;
+        c->state = ST_READY;
+        hdr_record(&w->login_lat, now - c->login_ns);
+        atomic_fetch_add(&logged_in, 1);
+        break;
+
+    case MSG_LOGIN_FAIL:
+        c->state = ST_FAILED;
+        atomic_fetch_add(&login_failed, 1);
+        break;
+
+    case MSG_CHAT:
+        if (strncmp(m->data, BENCH_TAG_CHAT, 4) == 0) {
+            uint64_t t = strtoull(m->data + 4, NULL, 10);
+            if (in_window(t)) {
+                w->n.chat_recv++;
+                hdr_record(&w->chat_lat, now - t);
+            }
+        }
+        break;
+
+    case MSG_DM:
+        // 서버는 보낸 사람에게도 DM 을 되돌려 준다 → 받는 사람 쪽만 센다
+        if (strcmp(m->sender, c->name) != 0 && strncmp(m->data, BENCH_TAG_DM, 4) == 0) {
+            uint64_t t = strtoull(m->data + 4, NULL, 10);
+            if (in_window(t)) {
+                w->n.dm_recv++;
+                hdr_record(&w->dm_lat, now - t);
+            }
+        }
+        break;
+
+    case MSG_FILE_READY:
+        if (c->file_state == FILE_WAIT_READY) {
+            char id[32];
+            long offset = 0;
+            sscanf(m->data, "%31s %ld", id, &offset);
+            c->file_off = offset;
+            c->file_state = FILE_SENDING;
+            file_pump(w, c);
+        }
+        break;
+
+    case MSG_FILE_BULK: {
+        char name[256];
+        long long size = 0, offset = 0;
+        if (sscanf(m->data, "%255s %lld %lld", name, &size, &offset) >= 2) {
+            c->raw_left = (long)(size - offset);
+            c->file_state = FILE_RECEIVING;
+        }
+        break;
+    }
+
+    case MSG_FILE_END:
+        if (c->file_state == FILE_RECEIVING) {
+            w->n.file_cycles++;
+            hdr_record(&w->file_lat, now - c->cycle_ns);
+            c->file_state = FILE_IDLE;
+        }
+        break;
+
+    case MSG_ERROR:
+    case MSG_DM_FAIL:
+        w->n.errors++;
+        if (c->file_role && c->file_state != FILE_IDLE) {
+            c->file_role = 0;       // 파일 경로가 실패하면 채팅만 계속
+            c->file_state = FILE_IDLE;
+        }
+        break;
+    }
+}
+
+/**
+ * 소켓에서 읽을 수 있는 만큼 읽고 완성된 프레임을 처리. 연결이 끊기면 -1
+ */
+static int conn_read(Worker *w, BenchConn *c) {
+    for (;;) {
+        ssize_t n = recv(c->fd, c->in + c->in_len, IN_BUF_SIZE - c->in_len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        if (n == 0) return -1;
+        c->in_len += n;
+
+        size_t off = 0;
+        for (;;) {
+            // bulk 다운로드 본문 (프레임이 아님)
+            if (c->raw_left > 0) {
+                size_t take = c->in_len - off;
+                if ((long)take > c->raw_left) take = (size_t)c->raw_left;
+                c->raw_left -= take;
+                w->n.down_bytes += take;
+                off += take;
+                if (c->raw_left > 0) break;
+                continue;
+            }
+
+            if (c->in_len - off < FRAME_HDR_LEN) break;
+            FrameHeader h;
+            if (frame_parse_header(c->in + off, &h) < 0) return -1;
+            if (c->in_len - off < FRAME_HDR_LEN + h.len) break;
+
+            Message m;
+            if (frame_decode(&h, c->in + off + FRAME_HDR_LEN, &m) < 0) return -1;
+            off += FRAME_HDR_LEN + h.len;
+            handle_message(w, c, &m);
+        }
+
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+    }
+}
+
+/* ----------------------- 워커 ----------------------- */
+
+static int connect_user(Worker *w, BenchConn *c) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg.port);
+    if (inet_pton(AF_INET, cfg.host, &addr.sin_addr) != 1) return -1;
+
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return -1;
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+
+    // 부하 생성기 쪽 Nagle 지연이 서버 지연으로 잡히지 않도록
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+
+    char data[MAX_BUF];
+    snprintf(data, sizeof(data), "%s %s", c->name, cfg.password);
+    c->login_ns = now_ns();
+    send_text(w, c, MSG_LOGIN, NULL, data);
+    return 0;
+}
+
+/**
+ * 이번 tick 에 보낼 몫만큼 채팅/DM 전송 (rate × 채팅 사용자 수를 스레드 간 나눔)
+ */
+static void send_due(Worker *w, double elapsed_s, uint64_t now) {
+    int senders = 0;
+    for (int i = 0; i < w->count; i++) {
+        if (!w->conns[i].file_role) senders++;
+    }
+    if (senders == 0) return;
+
+    w->credit += elapsed_s * cfg.sc.rate * senders;
+    if (w->credit > senders) w->credit = senders;    // 밀린 몫은 1초 분량까지만
+
+    while (w->credit >= 1.0) {
+        w->credit -= 1.0;
+
+        BenchConn *c = NULL;
+        for (int tries = 0; tries < w->count; tries++) {
+            BenchConn *cand = &w->conns[w->next_sender];
+            w->next_sender = (w->next_sender + 1) % w->count;
+            if (cand->state == ST_READY && !cand->file_role) {
+                c = cand;
+                break;
+            }
+        }
+        if (!c) return;
+
+        char data[MAX_BUF];
+        int window = in_window(now);
+        if (cfg.sc.dm_ratio > 0 && chat_users > 1 && drand48() < cfg.sc.dm_ratio) {
+            int target = (int)(drand48() * cfg.sc.users);
+            if (target == c->user) target = (target + 1) % cfg.sc.users;
+            char tname[MAX_NAME];
+            snprintf(tname, sizeof(tname), "%s%d", cfg.prefix, target);
+            snprintf(data, sizeof(data), BENCH_TAG_DM "%llu", (unsigned long long)now);
+            send_text(w, c, MSG_DM, tname, data);
+            if (window) w->n.dm_sent++;
+        } else {
+            snprintf(data, sizeof(data), BENCH_TAG_CHAT "%llu", (unsigned long long)now);
+            send_text(w, c, MSG_CHAT, NULL, data);
+            if (window) {
+                w->n.chat_sent++;
+                w->n.chat_expected += atomic_load(&logged_in) - 1;
+            }
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    struct epoll_event evs[256];
+
+    uint64_t last = now_ns();
+    while (!atomic_load(&stop)) {
+        // 접속은 조금씩 나눠서 (로그인 응답을 바로바로 읽어야 로그인 지연이 제대로 잡힌다)
+        for (int k = 0; k < CONNECT_BATCH && w->next_connect < w->count; k++) {
+            BenchConn *c = &w->conns[w->next_connect++];
+            if (connect_user(w, c) < 0) {
+                c->state = ST_FAILED;
+                atomic_fetch_add(&login_failed, 1);
+            }
+        }
+
+        int timeout = w->next_connect < w->count ? 0 : LOOP_TICK_MS;
+        int n = epoll_wait(w->epfd, evs, 256, timeout);
+        for (int e = 0; e < n; e++) {
+            BenchConn *c = evs[e].data.ptr;
+            if (c->state == ST_CLOSED || c->state == ST_FAILED) continue;
+
+            if ((evs[e].events & EPOLLOUT) && conn_flush(w, c) < 0) c->state = ST_CLOSED;
+            if ((evs[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && conn_read(w, c) < 0) {
+                if (c->state == ST_LOGIN) atomic_fetch_add(&login_failed, 1);
+                c->state = ST_CLOSED;
+                w->n.errors++;
+            }
+            if (c->state == ST_CLOSED) {
+                epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+
+        uint64_t now = now_ns();
+        double elapsed = (double)(now - last) / 1e9;
+        last = now;
+
+        if (now < atomic_load(&send_start_ns) || now >= atomic_load(&measure_end_ns)) continue;
+
+        send_due(w, elapsed, now);
+        for (int i = 0; i < w->count; i++) {
+            BenchConn *c = &w->conns[i];
+            if (!c->file_role || c->state != ST_READY) continue;
+            if (c->file_state == FILE_IDLE) file_start(w, c);
+            else file_pump(w, c);
+        }
+    }
+
+    for (int i = 0; i < w->count; i++) {
+        if (w->conns[i].fd >= 0) close(w->conns[i].fd);
+    }
+    return NULL;
+}
+
+/* ----------------------- 서버 지표 ----------------------- */
+
+static uint64_t metric_value(const char *text, const char *name) {
+    size_t n = strlen(name);
+    for (const char *p = text; (p = strstr(p, name)) != NULL; p += n) {
+        if ((p == text || p[-1] == '\n') && p[n] == ' ') return strtoull(p + n + 1, NULL, 10);
+    }
+    return 0;
+}
+
+/**
+ * 서버 metrics 포트에서 출력 큐 전송 카운터를 읽는다. 실패하면 s->ok = 0
+ */
+static void server_sample(ServerSample *s) {
+    memset(s, 0, sizeof(*s));
+    if (cfg.metrics_port <= 0) return;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg.metrics_port);
+    if (inet_pton(AF_INET, cfg.host, &addr.sin_addr) != 1) return;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return;
+    }
+
+    static const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    size_t cap = 256 * 1024, len = 0;
+    char *buf = malloc(cap);
+    if (buf && send(fd, req, sizeof(req) - 1, MSG_NOSIGNAL) == (ssize_t)(sizeof(req) - 1)) {
+        ssize_t n;
+        while (len < cap - 1 && (n = recv(fd, buf + len, cap - 1 - len, 0)) > 0) len += n;
+        buf[len] = '\0';
+        s->send_calls = metric_value(buf, "chat_send_calls_total");
+        s->frames = metric_value(buf, "chat_frames_sent_total");
+        s->ok = s->send_calls > 0;
+    }
+    free(buf);
+    close(fd);
+}
+
+/* ----------------------- 보고 ----------------------- */
+
+static void print_lat(const char *label, const Hdr *h) {
+    if (h->total == 0) {
+        printf("  %-6s %10s\n", label, "-");
+        return;
+    }
+    printf("  %-6s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", label,
+           (unsigned long long)h->total,
+           hdr_percentile(h, 50.0) / 1e3, hdr_percentile(h, 99.0) / 1e3,
+           hdr_percentile(h, 99.9) / 1e3, h->max / 1e3, hdr_mean(h) / 1e3);
+}
+
+static void append_result(const Counters *t, const Hdr *chat, const Hdr *dm, const Hdr *login,
+                          const ServerSample *srv, double secs) {
+    struct stat st;
+    int fresh = stat(cfg.out_path, &st) < 0 || st.st_size == 0;
+
+    FILE *fp = fopen(cfg.out_path, "a");
+    if (!fp) {
+        perror(cfg.out_path);
+        return;
+    }
+    if (fresh) {
+        fprintf(fp, "time\tscenario\tusers\trate\tdm_ratio\tfile_users\tduration\t"
+                    "chat_sent_per_s\tchat_deliv_per_s\tdeliv_ratio\t"
+                    "chat_p50_us\tchat_p99_us\tchat_p999_us\tchat_max_us\t"
+                    "dm_p50_us\tdm_p99_us\tlogin_p99_us\tfile_MBps\terrors\t"
+                    "srv_sends_per_s\tsrv_frames_per_send\n");
+    }
+
+    char ts[32];
+    time_t now = time(NULL);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(fp, "%s\t%s\t%d\t%g\t%g\t%d\t%d\t%.1f\t%.1f\t%.4f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%llu\t%.1f\t%.2f\n",
+            ts, cfg.sc.name, cfg.sc.users, cfg.sc.rate, cfg.sc.dm_ratio, cfg.sc.file_users,
+            cfg.sc.duration,
+            t->chat_sent / secs, t->chat_recv / secs,
+            t->chat_expected ? (double)t->chat_recv / t->chat_expected : 0.0,
+            hdr_percentile(chat, 50) / 1e3, hdr_percentile(chat, 99) / 1e3,
+            hdr_percentile(chat, 99.9) / 1e3, chat->max / 1e3,
+            hdr_percentile(dm, 50) / 1e3, hdr_percentile(dm, 99) / 1e3,
+            hdr_percentile(login, 99) / 1e3,
+            (t->up_bytes + t->down_bytes) / secs / 1e6,
+            (unsigned long long)t->errors,
+            srv->send_calls / secs,
+            srv->send_calls ? (double)srv->frames / srv->send_calls : 0.0);
+    fclose(fp);
+}
+
+/* ----------------------- 설정 ----------------------- */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --scenario=NAME     fixed scenario (options after it override its values)\n"
+            "  --users=N           simulated users (default %d)\n"
+            "  --rate=R            messages per second per user (default %g)\n"
+            "  --dm-ratio=F        fraction of messages sent as DM (default %g)\n"
+            "  --file-users=N      users looping upload+download instead of chatting (default %d)\n"
+            "  --file-size=BYTES   file size for file users (default %ld)\n"
+            "  --duration=SEC      measured seconds (default %d)\n"
+            "  --warmup=SEC        seconds after login before measuring (default %d)\n"
+            "  --threads=N         load generator threads (default %d)\n"
+            "  --host=IP --port=N  server address (default %s:%d)\n"
+            "  --prefix=NAME       account name prefix, users are NAME0..NAME{N-1} (default %s)\n"
+            "  --password=PW       account password (default %s)\n"
+            "  --out=FILE          append one TSV result row (for tracking over time)\n"
+            "  --hdr=FILE          write chat latency distribution (.hgrm, microseconds)\n"
+            "  --metrics-port=N    server metrics port to sample send counters, 0 = skip (default %d)\n"
+            "  --print-users=N     print N users.txt lines and exit\n"
+            "  --cipher-bench[=S]  measure DM cipher throughput per kernel (S s per cell, default 0.5), no server\n"
+            "  --list              list fixed scenarios\n",
+            prog, cfg.sc.users, cfg.sc.rate, cfg.sc.dm_ratio, cfg.sc.file_users,
+            cfg.sc.file_size, cfg.sc.duration, cfg.warmup, cfg.threads, cfg.host, cfg.port,
+            cfg.prefix, cfg.password, cfg.metrics_port);
+}
+
+static int parse_args(int argc, char **argv) {
+    enum { O_SCENARIO = 1000, O_USERS, O_RATE, O_DM, O_FUSERS, O_FSIZE, O_DURATION, O_WARMUP,
+           O_THREADS, O_HOST, O_PORT, O_PREFIX, O_PASSWORD, O_OUT, O_HDR, O_PRINT, O_LIST, O_CIPHER,
+           O_METRICS };
+
+    static const struct option opts[] = {
+        { "scenario",    required_argument, NULL, O_SCENARIO },
+        { "users",       required_argument, NULL, O_USERS },
+        { "rate",        required_argument, NULL, O_RATE },
+        { "dm-ratio",    required_argument, NULL, O_DM },
+        { "file-users",  required_argument, NULL, O_FUSERS },
+        { "file-size",   required_argument, NULL, O_FSIZE },
+        { "duration",    required_argument, NULL, O_DURATION },
+        { "warmup",      required_argument, NULL, O_WARMUP },
+        { "threads",     required_argument, NULL, O_THREADS },
+        { "host",        required_argument, NULL, O_HOST },
+        { "port",        required_argument, NULL, O_PORT },
+        { "prefix",      required_argument, NULL, O_PREFIX },
+        { "password",    required_argument, NULL, O_PASSWORD },
+        { "out",         required_argument, NULL, O_OUT },
+        { "hdr",         required_argument, NULL, O_HDR },
+        { "metrics-port", required_argument, NULL, O_METRICS },
+        { "print-users", required_argument, NULL, O_PRINT },
+        { "list",        no_argument,       NULL, O_LIST },
+        { "cipher-bench", optional_argument, NULL, O_CIPHER },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (ch) {
+        case O_SCENARIO: {
+            int found = 0;
+            for (int i = 0; i < SCENARIO_COUNT; i++) {
+                if (strcmp(optarg, scenarios[i].name) == 0) {
+                    cfg.sc = scenarios[i];
+                    found = 1;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "unknown scenario: %s (see --list)\n", optarg);
+                return -1;
+            }
+            break;
+        }
+        case O_USERS:    cfg.sc.users = atoi(optarg); break;
+        case O_RATE:     cfg.sc.rate = atof(optarg); break;
+        case O_DM:       cfg.sc.dm_ratio = atof(optarg); break;
+        case O_FUSERS:   cfg.sc.file_users = atoi(optarg); break;
+        case O_FSIZE:    cfg.sc.file_size = atol(optarg); break;
+        case O_DURATION: cfg.sc.duration = atoi(optarg); break;
+        case O_WARMUP:   cfg.warmup = atoi(optarg); break;
+        case O_THREADS:  cfg.threads = atoi(optarg); break;
+        case O_HOST:     cfg.host = optarg; break;
+        case O_PORT:     cfg.port = atoi(optarg); break;
+        case O_PREFIX:   cfg.prefix = optarg; break;
+        case O_PASSWORD: cfg.password = optarg; break;
+        case O_OUT:      cfg.out_path = optarg; break;
+        case O_HDR:      cfg.hdr_path = optarg; break;
+        case O_METRICS:  cfg.metrics_port = atoi(optarg); break;
+        case O_PRINT: {
+            int n = atoi(optarg);
+            for (int i = 0; i < n; i++) printf("%s%d %s\n", cfg.prefix, i, cfg.password);
+            exit(0);
+        }
+        case O_CIPHER:
+            exit(cipher_bench(optarg ? atof(optarg) : 0.5));
+        case O_LIST:
+            for (int i = 0; i < SCENARIO_COUNT; i++)
+                printf("%-16s %s\n", scenarios[i].name, scenarios[i].desc);
+            exit(0);
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (cfg.sc.users < 1 || cfg.threads < 1 || cfg.sc.duration < 1 ||
+        cfg.sc.file_users < 0 || cfg.sc.file_users > cfg.sc.users ||
+        (cfg.sc.file_users > 0 && cfg.sc.file_size < 1)) {
+        fprintf(stderr, "invalid users/threads/duration/file-users/file-size\n");
+        return -1;
+    }
+    if (cfg.threads > cfg.sc.users) cfg.threads = cfg.sc.users;
+    return 0;
+}
+
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void sleep_until(uint64_t t) {
+    uint64_t now;
+    while ((now = now_ns()) < t) {
+        uint64_t d = t - now;
+        struct timespec ts = { (time_t)(d / 1000000000ull), (long)(d % 1000000000ull) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) < 0) return 1;
+
+    raise_fd_limit();
+    srand48((long)now_ns());
+    chat_users = cfg.sc.users - cfg.sc.file_users;
+
+    printf("[BENCH] scenario %s: %d users (%d file), %g msg/s/user, dm %.0f%%, %d s, %d threads\n",
+           cfg.sc.name, cfg.sc.users, cfg.sc.file_users, cfg.sc.rate, cfg.sc.dm_ratio * 100,
+           cfg.sc.duration, cfg.threads);
+
+    BenchConn *conns = calloc(cfg.sc.users, sizeof(BenchConn));
+    Worker *workers = calloc(cfg.threads, sizeof(Worker));
+    if (!conns || !workers) return 1;
+
+    for (int i = 0; i < cfg.sc.users; i++) {
+        BenchConn *c = &conns[i];
+        c->fd = -1;
+        c->user = i;
+        c->file_role = i < cfg.sc.file_users;
+        snprintf(c->name, sizeof(c->name), "%s%d", cfg.prefix, i);
+        snprintf(c->file_name, sizeof(c->file_name), "bench_%d_%d.bin", (int)getpid(), i);
+        c->in = malloc(IN_BUF_SIZE);
+        if (!c->in) return 1;
+    }
+
+    // 사용자를 스레드에 연속 구간으로 나눔
+    int base = 0;
+    for (int t = 0; t < cfg.threads; t++) {
+        Worker *w = &workers[t];
+        w->id = t;
+        w->count = cfg.sc.users / cfg.threads + (t < cfg.sc.users % cfg.threads);
+        w->conns = &conns[base];
+        base += w->count;
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        hdr_init(&w->chat_lat);
+        hdr_init(&w->dm_lat);
+        hdr_init(&w->login_lat);
+        hdr_init(&w->file_lat);
+        pthread_create(&w->tid, NULL, worker_main, w);
+    }
+
+    // 1) 모두 로그인할 때까지 대기 (최대 60초)
+    uint64_t t0 = now_ns();
+    while (atomic_load(&logged_in) + atomic_load(&login_failed) < cfg.sc.users &&
+           now_ns() - t0 < 60ull * 1000000000ull) {
+        sleep_until(now_ns() + 10 * 1000000ull);
+    }
+    double login_s = (double)(now_ns() - t0) / 1e9;
+    int ok = atomic_load(&logged_in);
+    printf("[BENCH] %d/%d logged in (%.2f s)\n", ok, cfg.sc.users, login_s);
+    if (ok < cfg.sc.users) {
+        fprintf(stderr, "[BENCH] %d logins failed. Accounts missing? "
+                        "./bench_client --print-users=%d >> users.txt\n",
+                cfg.sc.users - ok, cfg.sc.users);
+        if (ok == 0) return 1;
+    }
+
+    // 2) warmup → 측정 → 전송 중지 후 남은 메시지 수신
+    uint64_t start = now_ns();
+    atomic_store(&measure_start_ns, start + (uint64_t)cfg.warmup * 1000000000ull);
+    atomic_store(&measure_end_ns, atomic_load(&measure_start_ns) + (uint64_t)cfg.sc.duration * 1000000000ull);
+    atomic_store(&send_start_ns, start);
+
+    // 측정 구간 동안의 서버 전송 카운터 차이
+    ServerSample s0, s1, srv;
+    sleep_until(atomic_load(&measure_start_ns));
+    server_sample(&s0);
+    sleep_until(atomic_load(&measure_end_ns));
+    server_sample(&s1);
+    memset(&srv, 0, sizeof(srv));
+    if (s0.ok && s1.ok) {
+        srv.ok = 1;
+        srv.send_calls = s1.send_calls - s0.send_calls;
+        srv.frames = s1.frames - s0.frames;
+    }
+
+    sleep_until(atomic_load(&measure_end_ns) + 1000000000ull);
+    atomic_store(&stop, 1);
+
+    Counters total;
+    memset(&total, 0, sizeof(total));
+    Hdr *chat = malloc(sizeof(Hdr)), *dm = malloc(sizeof(Hdr));
+    Hdr *login = malloc(sizeof(Hdr)), *file = malloc(sizeof(Hdr));
+    hdr_init(chat);
+    hdr_init(dm);
+    hdr_init(login);
+    hdr_init(file);
+
+    for (int t = 0; t < cfg.threads; t++) {
+        Worker *w = &workers[t];
+        pthread_join(w->tid, NULL);
+        hdr_merge(chat, &w->chat_lat);
+        hdr_merge(dm, &w->dm_lat);
+        hdr_merge(login, &w->login_lat);
+        hdr_merge(file, &w->file_lat);
+        total.chat_sent += w->n.chat_sent;
+        total.dm_sent += w->n.dm_sent;
+        total.chat_recv += w->n.chat_recv;
+        total.dm_recv += w->n.dm_recv;
+        total.chat_expected += w->n.chat_expected;
+        total.up_bytes += w->n.up_bytes;
+        total.down_bytes += w->n.down_bytes;
+        total.file_cycles += w->n.file_cycles;
+        total.errors += w->n.errors;
+    }
+
+    double secs = cfg.sc.duration;
+    printf("[BENCH] chat  sent %.1f msg/s, delivered %.1f msg/s (%.2f%% of expected)\n",
+           total.chat_sent / secs, total.chat_recv / secs,
+           total.chat_expected ? 100.0 * total.chat_recv / total.chat_expected : 0.0);
+    printf("[BENCH] dm    sent %.1f msg/s, delivered %.1f msg/s\n",
+           total.dm_sent / secs, total.dm_recv / secs);
+    if (cfg.sc.file_users > 0) {
+        printf("[BENCH] file  up %.1f MB/s, down %.1f MB/s, %llu cycles\n",
+               total.up_bytes / secs / 1e6, total.down_bytes / secs / 1e6,
+               (unsigned long long)total.file_cycles);
+    }
+    if (srv.ok) {
+        uint64_t delivered = total.chat_recv + total.dm_recv;
+        printf("[BENCH] server %.0f sendmsg/s, %.2f frames/send, %.3f sendmsg/delivered msg\n",
+               srv.send_calls / secs,
+               srv.send_calls ? (double)srv.frames / srv.send_calls : 0.0,
+               delivered ? (double)srv.send_calls / delivered : 0.0);
+    }
+    printf("[BENCH] errors %llu\n", (unsigned long long)total.errors);
+    printf("[BENCH] latency (us)  %10s %10s %10s %10s %10s %10s\n",
+           "count", "p50", "p99", "p99.9", "max", "mean");
+    print_lat("chat", chat);
+    print_lat("dm", dm);
+    print_lat("login", login);
+    print_lat("file", file);
+
+    if (cfg.out_path) append_result(&total, chat, dm, login, &srv, secs);
+    if (cfg.hdr_path) {
+        FILE *fp = fopen(cfg.hdr_path, "w");
+        if (fp) {
+            hdr_write_hgrm(chat, fp, 1000.0);
+            fclose(fp);
+        } else {
+            perror(cfg.hdr_path);
+        }
+    }
+    return 0;
+}
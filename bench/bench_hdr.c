@@ -0,0 +1,115 @@
+#include <string.h>
+#include <math.h>
+#include "bench_hdr.h"
+
+void hdr_init(Hdr *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static int hdr_index(uint64_t v) {
+    if (v < 2 * HDR_SUB_BUCKETS) return (int)v;
+
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HDR_SUB_BITS;
+    // v >> shift 는 [SUB, 2*SUB) 범위
+    return (shift + 1) * HDR_SUB_BUCKETS + (int)((v >> shift) - HDR_SUB_BUCKETS);
+}
+
+// 칸에 들어가는 가장 큰 값 (HdrHistogram 의 highestEquivalentValue)
+static uint64_t hdr_value_at(int idx) {
+    if (idx < 2 * HDR_SUB_BUCKETS) return (uint64_t)idx;
+
+    int shift = idx / HDR_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(idx % HDR_SUB_BUCKETS + HDR_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void hdr_record(Hdr *h, uint64_t value) {
+    h->counts[hdr_index(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void hdr_merge(Hdr *dst, const Hdr *src) {
+    for (int i = 0; i < HDR_COUNTS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+/**
+ * percentile(0~100) 에 해당하는 값. 기록이 없으면 0
+ */
+uint64_t hdr_percentile(const Hdr *h, double percentile) {
+    if (h->total == 0) return 0;
+
+    uint64_t want = (uint64_t)ceil(percentile / 100.0 * (double)h->total);
+    if (want == 0) want = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HDR_COUNTS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = hdr_value_at(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+double hdr_mean(const Hdr *h) {
+    return h->total ? h->sum / (double)h->total : 0.0;
+}
+
+/**
+ * 백분위 분포를 .hgrm 형식으로 출력 (절반 거리마다 5 칸씩, HdrHistogram 과 같은 간격)
+ * unit_ratio: 기록 단위 → 출력 단위 (ns 로 기록하고 us 로 보려면 1000)
+ */
+void hdr_write_hgrm(const Hdr *h, FILE *fp, double unit_ratio) {
+    fprintf(fp, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    if (h->total == 0) return;
+
+    const int ticks_per_half = 5;
+    double percentile = 0.0;
+    int half = 0;
+
+    for (;;) {
+        uint64_t v = hdr_percentile(h, percentile);
+
+        // v 이하로 기록된 개수
+        uint64_t count = 0;
+        for (int i = 0; i < HDR_COUNTS && hdr_value_at(i) <= v; i++) count += h->counts[i];
+
+        double frac = percentile / 100.0;
+        if (count >= h->total) {
+            fprintf(fp, "%12.3f %14.12f %10llu\n", (double)h->max / unit_ratio, 1.0,
+                    (unsigned long long)h->total);
+            break;
+        }
+        fprintf(fp, "%12.3f %14.12f %10llu %14.2f\n", (double)v / unit_ratio, frac,
+                (unsigned long long)count, 1.0 / (1.0 - frac));
+
+        // [100 - 100/2^half, 100 - 100/2^(half+1)) 을 5 칸으로
+        double step = 100.0 / pow(2.0, half + 1) / ticks_per_half;
+        percentile += step;
+        if (percentile >= 100.0 - 100.0 / pow(2.0, half + 1) - 1e-12) half++;
+        if (half > 40) break;
+    }
+
+    double mean = hdr_mean(h);
+    double var = 0.0;
+    for (int i = 0; i < HDR_COUNTS; i++) {
+        if (!h->counts[i]) continue;
+        double d = (double)hdr_value_at(i) - mean;
+        var += d * d * (double)h->counts[i];
+    }
+    fprintf(fp, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n",
+            mean / unit_ratio, sqrt(var / (double)h->total) / unit_ratio);
+    fprintf(fp, "#[Max     = %12.3f, Total count    = %12llu]\n",
+            (double)h->max / unit_ratio, (unsigned long long)h->total);
+    fprintf(fp, "#[Buckets = %12d, SubBuckets     = %12d]\n", 64, HDR_SUB_BUCKETS);
+}
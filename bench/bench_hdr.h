@@ -0,0 +1,34 @@
+#ifndef BENCH_HDR_H
+#define BENCH_HDR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * HDR(High Dynamic Range) 히스토그램
+ *  값(ns)을 2의 거듭제곱 구간마다 HDR_SUB_BUCKETS 칸으로 나눠 센다.
+ *  → 1ns ~ 수백 초까지 상대 오차 1% 미만, 기록은 O(1), 메모리 고정.
+ */
+
+#define HDR_SUB_BITS     7
+#define HDR_SUB_BUCKETS  (1 << HDR_SUB_BITS)
+#define HDR_COUNTS       (64 * HDR_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HDR_COUNTS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double   sum;
+} Hdr;
+
+void     hdr_init(Hdr *h);
+void     hdr_record(Hdr *h, uint64_t value);
+void     hdr_merge(Hdr *dst, const Hdr *src);
+uint64_t hdr_percentile(const Hdr *h, double percentile);
+double   hdr_mean(const Hdr *h);
+
+// HdrHistogram 의 .hgrm 형식 (Value / Percentile / TotalCount / 1/(1-Percentile))
+void     hdr_write_hgrm(const Hdr *h, FILE *fp, double unit_ratio);
+
+#endif
@@ -6,6 +6,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "../common/protocol.h"
+#include "../common/frame.h"
+#include "../common/encrypt.h"
 
 extern WINDOW *win_chat;
 extern int  sock;
@@ -13,6 +15,10 @@ extern char username[MAX_NAME];
 
 #define MAX_HISTORY 1000
 
+// 로그인 직후 서버에서 받아 오는 지난 채팅 (페이지 단위)
+#define BACKLOG_PAGE  50
+#define BACKLOG_MAX   200
+
 typedef struct {
     char text[1024];
     int  right_align;   // 0=왼쪽, 1=오른쪽
@@ -24,6 +30,13 @@ static int      chat_history_count = 0;
 
 static int chat_cur_line = 1;
 
+// 받는 중인 지난 채팅: 페이지는 최신 → 과거 순서로 오므로 앞에 붙여 나간다
+static ChatLine backlog[BACKLOG_MAX];
+static int      backlog_count = 0;
+static ChatLine backlog_page[BACKLOG_PAGE];
+static int      backlog_page_count = 0;
+static int      backlog_mark = -1;     // 지난 채팅을 끼워 넣을 chat_history 위치 (-1: 받는 중 아님)
+
 /* ----------------------------- */
 /*  히스토리에 저장              */
 /* ----------------------------- */
@@ -48,11 +61,10 @@ static void push_history(const char *text, int right_align, int color_pair)
 }
 
 /* ----------------------------- */
-/*  실제 화면 출력               */
+/*  화면에 그리기 (refresh 없음)  */
 /* ----------------------------- */
-static void add_chat_line(const char *text, int right_align, int color_pair)
+static void draw_chat_line(const char *text, int right_align, int color_pair)
 {
-    if (!win_chat) return;
 
     int maxy, maxx;
     getmaxyx(win_chat, maxy, maxx);
@@ -91,7 +103,16 @@ static void add_chat_line(const char *text, int right_align, int color_pair)
         chat_cur_line++;
         p += len;   // 다음 조각으로 이동
     }
+}
+
+/* ----------------------------- */
+/*  실제 화면 출력               */
+/* ----------------------------- */
+static void add_chat_line(const char *text, int right_align, int color_pair)
+{
+    if (!win_chat) return;
 
+    draw_chat_line(text, right_align, color_pair);
     box(win_chat, 0, 0);
     wrefresh(win_chat);
 }
@@ -149,11 +170,125 @@ void redraw_chat_window(void)
     if (chat_history_count > available)
         start = chat_history_count - available;
 
+    // 줄마다 refresh 하지 않고 다 그린 뒤 한 번만
     for (int i = start; i < chat_history_count; i++) {
-        add_chat_line(chat_history[i].text,
-                      chat_history[i].right_align,
-                      chat_history[i].color_pair);
+        draw_chat_line(chat_history[i].text,
+                       chat_history[i].right_align,
+                       chat_history[i].color_pair);
+    }
+    box(win_chat, 0, 0);
+    wrefresh(win_chat);
+}
+
+/* ----------------------------- */
+/*  지난 채팅 받기 (로그인 직후)  */
+/* ----------------------------- */
+static void request_backlog_page(unsigned long long before)
+{
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.type = MSG_HISTORY_REQUEST;
+    strcpy(msg.sender, username);
+    snprintf(msg.data, sizeof(msg.data), "%llu %d", before, BACKLOG_PAGE);
+
+    msg_send(sock, &msg);
+}
+
+void backlog_begin(void)
+{
+    backlog_count = 0;
+    backlog_page_count = 0;
+    backlog_mark = chat_history_count;   // 이 뒤로 오는 실시간 채팅보다 앞에 끼워 넣는다
+
+    request_backlog_page(0);
+}
+
+static void fill_line(ChatLine *l, const char *text, int right_align, int color_pair)
+{
+    snprintf(l->text, sizeof(l->text), "%s", text);
+    l->right_align = right_align;
+    l->color_pair  = color_pair;
+}
+
+/* MSG_HISTORY: 페이지에 모으기만 하고 화면은 건드리지 않음 */
+void backlog_add(const Message *msg)
+{
+    if (backlog_mark < 0 || backlog_page_count >= BACKLOG_PAGE) return;
+
+    char line[1024];
+    int body_max = (int)(sizeof(line) - strlen(msg->sender) - 4);
+    snprintf(line, sizeof(line), "[%s] %.*s", msg->sender, body_max, msg->data);
+
+    // 제어 문자 제거 (DM 출력과 같은 규칙)
+    for (int i = 0; line[i]; i++) {
+        unsigned char c = (unsigned char)line[i];
+        if (c < 32 || c == 127) line[i] = ' ';
+    }
+
+    fill_line(&backlog_page[backlog_page_count++], line,
+              strcmp(msg->sender, username) == 0, 0);
+}
+
+/*
+ * 받은 지난 채팅을 chat_history 의 backlog_mark 위치에 끼워 넣고 한 번에 다시 그린다
+ */
+static void backlog_commit(void)
+{
+    int n = backlog_count;
+    if (n > 0) {
+        n++;                                    // 구분선
+        if (chat_history_count + n > MAX_HISTORY) {
+            // 넘치는 만큼 가장 오래된 줄부터 버림
+            int drop = chat_history_count + n - MAX_HISTORY;
+            if (drop > backlog_mark) drop = backlog_mark;
+            memmove(&chat_history[0], &chat_history[drop],
+                    sizeof(ChatLine) * (chat_history_count - drop));
+            chat_history_count -= drop;
+            backlog_mark -= drop;
+            if (chat_history_count + n > MAX_HISTORY) n = MAX_HISTORY - chat_history_count;
+        }
+    }
+
+    if (n >= 2) {
+        memmove(&chat_history[backlog_mark + n], &chat_history[backlog_mark],
+                sizeof(ChatLine) * (chat_history_count - backlog_mark));
+
+        char sep[64];
+        snprintf(sep, sizeof(sep), "---- recent chat (%d) ----", n - 1);
+        fill_line(&chat_history[backlog_mark], sep, 0, 0);
+        memcpy(&chat_history[backlog_mark + 1], &backlog[backlog_count - (n - 1)],
+               sizeof(ChatLine) * (n - 1));
+        chat_history_count += n;
+
+        redraw_chat_window();
+    }
+
+    backlog_mark = -1;
+}
+
+/* MSG_HISTORY_END "first_seq more": 다음 페이지를 요청하거나 화면에 반영 */
+void backlog_page_end(const Message *msg)
+{
+    unsigned long long first = 0;
+    int more = 0;
+
+    if (backlog_mark < 0) return;
+    sscanf(msg->data, "%llu %d", &first, &more);
+
+    // 이번 페이지가 지금까지 받은 것보다 과거 → 앞에 붙임 (넘치면 이 페이지의 오래된 쪽을 버림)
+    int take = backlog_page_count;
+    if (take > BACKLOG_MAX - backlog_count) take = BACKLOG_MAX - backlog_count;
+    memmove(&backlog[take], &backlog[0], sizeof(ChatLine) * backlog_count);
+    memcpy(&backlog[0], &backlog_page[backlog_page_count - take], sizeof(ChatLine) * take);
+    backlog_count += take;
+    backlog_page_count = 0;
+
+    if (more && take > 0 && backlog_count < BACKLOG_MAX) {
+        request_backlog_page(first);
+        return;
     }
+    backlog_commit();
 }
 
 /* ----------------------------- */
@@ -168,7 +303,7 @@ void send_chat_message(const char *msg_text)
     strcpy(msg.sender, username);
     strcpy(msg.data, msg_text);
 
-    send(sock, &msg, sizeof(msg), 0);
+    msg_send(sock, &msg);
 }
 
 /* ----------------------------- */
@@ -179,11 +314,13 @@ void handle_chat_message(Message *msg)
     /* ---------------- DM 메시지 ---------------- */
     if (msg->type == MSG_DM) {
 
-        char decrypted[MAX_BUF];
-        decrypt(msg->data, decrypted);
+        char decrypted[MAX_BUF + 1];
+        int n = decrypt(msg->data, msg->data_len, decrypted);
+        if (n < 0) n = 0;
+        decrypted[n] = '\0';
 
-        // decrypt 후 줄바꿈 제거
-        for (int i = 0; decrypted[i]; i++) {
+        // decrypt 후 줄바꿈/제어 문자 제거 (본문에 NUL 이 섞여 있어도 길이만큼)
+        for (int i = 0; i < n; i++) {
             unsigned char c = (unsigned char)decrypted[i];
             if (c < 32 || c == 127) {   // 보이는 문자(스페이스~틸드)만 남김
                 decrypted[i] = ' ';
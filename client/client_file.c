@@ -2,10 +2,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/stat.h>
 #include "protocol.h"
+#include "frame.h"
+#include "blake3.h"
 #include <ncurses.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
 
 
 // 외부 함수/변수
@@ -19,8 +28,65 @@ extern FILE *g_download_fp;
 extern char g_download_name[256];
 extern long g_download_total;
 
-ssize_t w;
-ssize_t r;
+// 업로드 요청에 대한 서버 응답(OFFSET/READY/ERROR) 대기용
+// 소켓은 recv_thread 만 읽고, 응답이 오면 여기로 넘겨준다
+static pthread_mutex_t upload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  upload_cond = PTHREAD_COND_INITIALIZER;
+static int upload_waiting = 0;
+static int upload_reply = 0;
+static char upload_reply_data[MAX_BUF];
+
+#define UPLOAD_REPLY_TIMEOUT 10   // seconds
+
+// 병렬 업로드 기본값 (/upload 의 인자로 바꿀 수 있음)
+#define PUT_DEFAULT_STREAMS 4
+#define PUT_DEFAULT_RANGE   (4 * 1024 * 1024)
+#define PUT_MIN_FILE_SIZE   (8 * 1024 * 1024)    // 이보다 작으면 연결 하나로 보냄
+#define PUT_MAX_STREAMS     16
+#define DEDUP_MIN_FILE_SIZE (1024 * 1024)        // 이 이상이면 청크 해시를 먼저 보내 중복 제거
+
+/**
+ * recv_thread 에서 호출: 업로드 응답을 기다리는 중이면 넘겨주고 1 반환
+ */
+int handle_upload_reply(Message *msg) {
+    pthread_mutex_lock(&upload_lock);
+    if (!upload_waiting) {
+        pthread_mutex_unlock(&upload_lock);
+        return 0;
+    }
+    upload_reply = msg->type;
+    memcpy(upload_reply_data, msg->data, sizeof(upload_reply_data));
+    upload_waiting = 0;
+    pthread_cond_signal(&upload_cond);
+    pthread_mutex_unlock(&upload_lock);
+    return 1;
+}
+
+// 요청을 보내고 응답 타입을 반환 (응답 data 는 reply_data 로 복사, 시간 초과/오류면 0)
+static int upload_request(int sock, Message *req, char *reply_data) {
+    pthread_mutex_lock(&upload_lock);
+    upload_waiting = 1;
+    pthread_mutex_unlock(&upload_lock);
+
+    if (msg_send(sock, req) < 0) {
+        perror("write");
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += UPLOAD_REPLY_TIMEOUT;
+
+    pthread_mutex_lock(&upload_lock);
+    while (upload_waiting) {
+        if (pthread_cond_timedwait(&upload_cond, &upload_lock, &deadline) != 0)
+            break;
+    }
+    int reply = upload_waiting ? 0 : upload_reply;
+    if (reply) memcpy(reply_data, upload_reply_data, MAX_BUF);
+    upload_waiting = 0;
+    pthread_mutex_unlock(&upload_lock);
+    return reply;
+}
 
 
 void handle_file_data(Message *msg) {
@@ -35,6 +101,45 @@ void handle_file_data(Message *msg) {
     }
 }
 
+/**
+ * bulk 다운로드 본문 수신 (recv_thread 에서 호출)
+ * MSG_FILE_BULK 의 data = "filename size offset", 바로 뒤에 파일 본문 (size - offset) 바이트가 온다.
+ * 반환: 0 = 성공, -1 = 연결 종료
+ */
+int handle_file_bulk(int sock, Message *msg) {
+    char name[256];
+    long long size = 0;
+    long long offset = 0;
+    char buffer[64 * 1024];
+
+    if (sscanf(msg->data, "%255s %lld %lld", name, &size, &offset) < 2 ||
+        size < 0 || offset < 0 || offset > size) {
+        return -1;
+    }
+
+    // 서버가 정한 시작 위치에 맞춰 받아 둔 부분을 자른다 (처음부터면 0)
+    if (g_download_fp) {
+        fflush(g_download_fp);
+        if (ftruncate(fileno(g_download_fp), offset) < 0) {
+            perror("ftruncate");
+        }
+    }
+    size -= offset;
+
+    while (size > 0) {
+        size_t want = size > (long long)sizeof(buffer) ? sizeof(buffer) : (size_t)size;
+        ssize_t n = recv(sock, buffer, want, 0);
+        if (n <= 0) return -1;
+
+        if (g_download_fp) {
+            fwrite(buffer, 1, n, g_download_fp);
+        }
+        g_download_total += n;
+        size -= n;
+    }
+    return 0;
+}
+
 void handle_file_end(Message *msg) {
     if (!g_downloading || g_download_fp == NULL) {
         return;
@@ -48,101 +153,337 @@ void handle_file_end(Message *msg) {
     g_download_total = 0;
 }
 
+/* ---------------------- 병렬 업로드 ---------------------- */
+
+typedef struct {
+    int   fd;               // 올릴 파일
+    long  filesize;
+    long  range_size;
+    int   nranges;
+    char  xfer_id[32];
+    char  token[32];
+    int   cas;              // 중복 제거 모드 (서버가 READY 에 "cas" 로 알려줌)
+
+    pthread_mutex_t lock;
+    int   next;             // 다음에 보낼 구간 번호
+    int   failed;
+    int   committed;        // 서버가 "done" 으로 응답함
+    long  sent;
+    long  reused;           // 서버에 이미 있어서 보내지 않은 바이트
+} PutJob;
+
+// 서버에 구간 전송용 연결을 하나 더 연다 (로그인 없이 xfer_id/token 으로 세션에 붙음)
+static int open_stream(void) {
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(SERVER_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(s);
+        return -1;
+    }
+
+    // 중복 제거 모드는 구간마다 헤더 → 응답 → 본문을 주고받으므로 작은 헤더가 Nagle 에 묶이지 않게 한다
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return s;
+}
+
+// 구간 본문 전송 (cas 모드는 해시를 구하려고 읽어 둔 버퍼, 아니면 파일에서 바로 sendfile)
+static int send_range_body(int s, PutJob *job, const char *buf, off_t off, long len) {
+    long left = len;
+    while (left > 0) {
+        ssize_t n = buf ? send(s, buf + (len - left), left, 0)
+                        : sendfile(s, job->fd, &off, left);
+        if (n <= 0) return -1;
+        left -= n;
+    }
+    return 0;
+}
+
+static int recv_range_ack(int s, int index, char state[16]) {
+    Message ack;
+    int ack_index = -1;
+    if (msg_recv(s, &ack) < 0 || ack.type != MSG_FILE_RANGE_ACK ||
+        sscanf(ack.data, "%d %15s", &ack_index, state) != 2 || ack_index != index)
+        return -1;
+    return 0;
+}
+
+/**
+ * 구간 전송 스레드: 남은 구간을 하나씩 가져가서 MSG_FILE_RANGE 헤더 + 본문(sendfile) 을 보내고 ACK 를 기다린다
+ * cas 모드는 헤더에 구간 해시를 붙이고, 서버가 "need" 라고 할 때만 본문을 보낸다.
+ */
+static void *put_stream_main(void *arg) {
+    PutJob *job = arg;
+    int s = open_stream();
+    char *buf = job->cas ? malloc(job->range_size) : NULL;
+    int ok = (s >= 0) && (!job->cas || buf);
+
+    while (ok) {
+        pthread_mutex_lock(&job->lock);
+        int index = job->failed ? job->nranges : job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (index >= job->nranges) break;
+
+        off_t off = (off_t)index * job->range_size;
+        long len = job->filesize - off;
+        if (len > job->range_size) len = job->range_size;
+
+        Message hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.type = MSG_FILE_RANGE;
+        if (job->cas) {
+            uint8_t hash[BLAKE3_OUT_LEN];
+            char hex[2 * BLAKE3_OUT_LEN + 1];
+            if (pread(job->fd, buf, len, off) != len) {
+                ok = 0;
+                break;
+            }
+            blake3_hash(buf, len, hash);
+            blake3_to_hex(hash, hex);
+            snprintf(hdr.data, sizeof(hdr.data), "%s %s %d %s", job->xfer_id, job->token, index, hex);
+        } else {
+            snprintf(hdr.data, sizeof(hdr.data), "%s %s %d", job->xfer_id, job->token, index);
+        }
+        if (msg_send(s, &hdr) < 0) {
+            ok = 0;
+            break;
+        }
+
+        char state[16] = "";
+        int sent_body = 1;
+        if (job->cas) {
+            if (recv_range_ack(s, index, state) < 0) {
+                ok = 0;
+                break;
+            }
+            sent_body = strcmp(state, "need") == 0;
+        }
+        if (sent_body && (send_range_body(s, job, buf, off, len) < 0 ||
+                          recv_range_ack(s, index, state) < 0)) {
+            ok = 0;
+            break;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        job->sent += len;
+        if (!sent_body) job->reused += len;
+        if (strcmp(state, "done") == 0) job->committed = 1;
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    if (!ok) {
+        // 다른 스레드도 더 이상 새 구간을 가져가지 않도록
+        pthread_mutex_lock(&job->lock);
+        job->failed = 1;
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    free(buf);
+    if (s >= 0) close(s);
+    return NULL;
+}
+
+/**
+ * 병렬 업로드: 파일을 range_size 구간으로 나눠 streams 개의 연결로 동시에 보낸다
+ * dedup 이면 서버 청크 저장소에 이미 있는 구간은 해시만 보내고 건너뛴다.
+ * 반환: 0 = 완료, -1 = 실패
+ */
+static int upload_file_parallel(int sock, int fd, const char *name, long filesize,
+                                const char *username, int ttl_seconds,
+                                int streams, long range_size, int dedup) {
+    Message msg;
+    char reply[MAX_BUF];
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_FILE_PUT_OPEN;
+    strcpy(msg.sender, username);
+    snprintf(msg.data, sizeof(msg.data), "%s %ld %d %ld%s", name, filesize, ttl_seconds, range_size,
+             dedup ? " cas" : "");
+
+    PutJob job;
+    char mode[8] = "";
+    memset(&job, 0, sizeof(job));
+    if (upload_request(sock, &msg, reply) != MSG_FILE_PUT_READY ||
+        sscanf(reply, "%31s %31s %ld %d %7s", job.xfer_id, job.token,
+               &job.range_size, &job.nranges, mode) < 4 || job.range_size <= 0) {
+        print_chat("Server rejecte Upload reqeust.");
+        return -1;
+    }
+    job.cas = strcmp(mode, "cas") == 0;
+    job.fd = fd;
+    job.filesize = filesize;
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (streams > job.nranges) streams = job.nranges;
+    print_chat("Upload starts: %s (%ld bytes, %d streams x %ld KB ranges%s)",
+               name, filesize, streams, job.range_size / 1024, job.cas ? ", dedup" : "");
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    pthread_t tids[PUT_MAX_STREAMS];
+    int started = 0;
+    for (int i = 0; i < streams; i++) {
+        if (pthread_create(&tids[started], NULL, put_stream_main, &job) == 0) started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    if (!job.committed) {
+        print_chat("Upload failed: %s (%ld/%ld bytes)", name, job.sent, filesize);
+        return -1;
+    }
+    if (job.cas) {
+        print_chat("Upload Success: %s (%ld bytes, %ld bytes already on server, %.1f MB/s)",
+                   name, filesize, job.reused, sec > 0 ? filesize / sec / (1024 * 1024) : 0.0);
+    } else {
+        print_chat("Upload Success: %s (%ld bytes, %.1f MB/s)",
+                   name, filesize, sec > 0 ? filesize / sec / (1024 * 1024) : 0.0);
+    }
+    return 0;
+}
+
 /**
  * 파일 업로드 함수
+ * 큰 파일은 여러 연결로 나눠 보내고 (streams > 1), 1MB 이상이면 서버에 이미 있는 청크를 건너뛴다.
+ * 나머지는
+ * 1) MSG_FILE_QUERY 로 서버에 이미 올라간 위치를 묻고
+ * 2) 그 위치부터 이어서 보낸다. (연결이 끊겼던 업로드는 /upload 를 다시 하면 이어진다)
+ * streams / range_size 가 0 이면 기본값을 쓴다.
  */
-void upload_file(int sock, const char *filename, const char *username, int ttl_seconds) {
+void upload_file(int sock, const char *filename, const char *username, int ttl_seconds,
+                 int streams, long range_size) {
 
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) { 
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
         print_chat("Cannot open file: %s", filename);
+        if (fd >= 0) close(fd);
         return;
     }
+    long filesize = (long)st.st_size;
+
+    // 서버에는 경로를 뺀 파일 이름만 보낸다
+    char pathbuf[512];
+    snprintf(pathbuf, sizeof(pathbuf), "%s", filename);
+    const char *name = basename(pathbuf);
+
+    if (streams <= 0) streams = filesize >= PUT_MIN_FILE_SIZE ? PUT_DEFAULT_STREAMS : 1;
+    if (streams > PUT_MAX_STREAMS) streams = PUT_MAX_STREAMS;
+    if (range_size <= 0) range_size = PUT_DEFAULT_RANGE;
 
-    // 파일 크기 구하기
-    fseek(fp, 0, SEEK_END);
-    long filesize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    if (filesize > 0 && (streams > 1 || filesize >= DEDUP_MIN_FILE_SIZE)) {
+        upload_file_parallel(sock, fd, name, filesize, username, ttl_seconds, streams, range_size,
+                             filesize >= DEDUP_MIN_FILE_SIZE);
+        close(fd);
+        return;
+    }
 
-    // 1) 업로드 요청 메시지 전송
     Message msg;
+    char reply[MAX_BUF];
+    char xfer_id[32] = "";
+    long offset = 0;
+
+    // 1) 이어받기 위치 조회
     memset(&msg, 0, sizeof(msg));
-    msg.type = MSG_FILE_UPLOAD;
+    msg.type = MSG_FILE_QUERY;
     strcpy(msg.sender, username);
+    snprintf(msg.data, sizeof(msg.data), "%s %ld", name, filesize);
 
-    // 🔥 서버가 기대하는 형식: "filename filesize ttl_seconds"
-    snprintf(msg.data, sizeof(msg.data), "%s %ld %d", filename, filesize, ttl_seconds);
-
-    w = write(sock, &msg, sizeof(msg));
-    if (w < 0) {
-        perror("write");
+    if (upload_request(sock, &msg, reply) == MSG_FILE_OFFSET) {
+        sscanf(reply, "%31s %ld", xfer_id, &offset);
     }
 
-    // 2) READY 메시지 대기
-    Message reply;
-    r = read(sock, &reply, sizeof(reply));
+    // 2) 업로드 요청 메시지 전송
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_FILE_UPLOAD;
+    strcpy(msg.sender, username);
+
+    // 🔥 서버가 기대하는 형식: "filename filesize ttl_seconds resume_offset"
+    snprintf(msg.data, sizeof(msg.data), "%s %ld %d %ld", name, filesize, ttl_seconds, offset);
 
-    if(r < 0){
-        perror("read");
-    }
-    if (reply.type != MSG_FILE_READY) {
+    // 3) READY 메시지 대기 (data = "xfer_id offset", 실제 시작 위치는 서버가 정한다)
+    if (upload_request(sock, &msg, reply) != MSG_FILE_READY) {
         print_chat("Server rejecte Upload reqeust.");
-        fclose(fp);
+        close(fd);
         return;
     }
+    offset = 0;
+    sscanf(reply, "%31s %ld", xfer_id, &offset);
+    if (offset < 0 || offset > filesize) offset = 0;
+
+    if (offset > 0) {
+        print_chat("Upload resumes: %s at %ld/%ld bytes", name, offset, filesize);
+    } else {
+        print_chat("Upload starts: %s (%ld bytes)", name, filesize);
+    }
 
-    print_chat("Upload starts: %s (%ld bytes)", filename, filesize);
-
-    // 3) 파일 전송 (청크 기반)
-    char buffer[MAX_BUF];
+    // 4) 파일 전송 (청크 기반, offset 부터 pread)
     long total = 0;
-    int n;
-
-    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        Message chunk;
-        chunk.type = MSG_FILE_DATA;
-        strcpy(chunk.sender, username);
-        memcpy(chunk.data, buffer, n);
-        chunk.data_len = n;
-
-        w = write(sock, &chunk, sizeof(chunk));
-        
-        if(w < 0){
+    ssize_t n;
+
+    Message chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.type = MSG_FILE_DATA;
+    strcpy(chunk.sender, username);
+
+    while ((n = pread(fd, chunk.data, sizeof(chunk.data), offset)) > 0) {
+        chunk.data_len = (int)n;
+
+        if (msg_send(sock, &chunk) < 0) {
             perror("wirte");
+            break;
         }
+        offset += n;
         total += n;
     }
 
-    fclose(fp);
+    close(fd);
 
-    // 4) 전송 종료 메시지
+    // 5) 전송 종료 메시지
     Message end;
+    memset(&end, 0, sizeof(end));
     end.type = MSG_FILE_END;
     strcpy(end.sender, username);
-    strcpy(end.data, filename);
+    strcpy(end.data, name);
     end.data_len = 0;
-    w = write(sock, &end, sizeof(end));
 
-    if(w < 0){
+    if (msg_send(sock, &end) < 0) {
         perror("write");
     }
-    print_chat("Upload Success: %s (%ld bytes)", filename, total);
+    print_chat("Upload Success: %s (%ld bytes)", name, total);
 }
 
 
 /**
  * 파일 다운로드 함수
+ * 받는 중인 파일은 ./client/<file>.part 에 쓰고, 끝나면 ./client/<file> 로 옮긴다.
+ * .part 가 남아 있으면 (이전 다운로드가 끊긴 경우) 그 크기부터 이어받는다.
  */
 void download_file(int sock, const char *filename) {
 
-    // 1) 로컬 저장 파일 열기
-    char savepath[512];
-    sprintf(savepath, "./client/%s", filename);
-    FILE *fp = fopen(savepath, "wb");
+    // 1) 로컬 임시 파일 열기 (이어쓰기)
+    char partpath[512];
+    snprintf(partpath, sizeof(partpath), "./client/%s.part", filename);
+    FILE *fp = fopen(partpath, "ab");
     if (!fp) {
         print_chat("Download file create failed: %s", filename);
         return;
     }
+    long long offset = ftell(fp);
+    if (offset < 0) offset = 0;
 
     // 2) 다운로드 상태 설정
     g_downloading = 1;
@@ -155,10 +496,11 @@ void download_file(int sock, const char *filename) {
     memset(&req, 0, sizeof(req));
     req.type = MSG_FILE_DOWNLOAD;
     strcpy(req.sender, username);
-    strcpy(req.data, filename);
+    // "bulk": 서버가 지원하면 청크 대신 파일 본문을 한 번에 보낸다 (sendfile)
+    // offset: 이미 받아 둔 바이트 수
+    snprintf(req.data, sizeof(req.data), "%s bulk %lld", filename, offset);
 
-    ssize_t w = write(sock, &req, sizeof(req));
-    if (w < 0) {
+    if (msg_send(sock, &req) < 0) {
         perror("write");
         fclose(fp);
         g_downloading = 0;
@@ -166,5 +508,23 @@ void download_file(int sock, const char *filename) {
         return;
     }
 
-    print_chat("Download Starts: %s", filename);
+    if (offset > 0) {
+        print_chat("Download resumes: %s at %lld bytes", filename, offset);
+    } else {
+        print_chat("Download Starts: %s", filename);
+    }
+}
+
+/**
+ * 다운로드 완료: 임시 파일을 제자리로 옮긴다
+ */
+void download_commit(const char *filename) {
+    char partpath[512];
+    char savepath[512];
+    snprintf(partpath, sizeof(partpath), "./client/%s.part", filename);
+    snprintf(savepath, sizeof(savepath), "./client/%s", filename);
+
+    if (rename(partpath, savepath) < 0) {
+        perror("rename");
+    }
 }
@@ -1,5 +1,6 @@
 #include "../common/protocol.h"
 #include "../common/encrypt.h"
+#include "../common/frame.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,17 +14,23 @@
 
 #define MAX_DATA 1024
 
-void upload_file(int sock, const char *filename, const char *username, int ttl_seconds);
+void upload_file(int sock, const char *filename, const char *username, int ttl_seconds,
+                 int streams, long range_size);
 void download_file(int sock, const char *filename);
+void download_commit(const char *filename);
 void client_log(const char *fmt, ...);
 extern void print_chat(const char *format, ...);
 extern void print_chat_msg(const char *sender, const char *text);
 extern void handle_chat_message(Message *msg);
 extern void redraw_chat_window(void);
+extern void backlog_begin(void);
+extern void backlog_add(const Message *msg);
+extern void backlog_page_end(const Message *msg);
+extern int handle_upload_reply(Message *msg);
+extern int handle_file_bulk(int sock, Message *msg);
 
 int sock;
 char username[MAX_NAME];
-int ra;
 
 // download state
 volatile int g_downloading = 0;
@@ -111,21 +118,6 @@ void handle_resize(int sig) {
     g_need_resize = 1; // real work is done in main loop
 }
 
-/* ----------------------- utility ----------------------- */
-
-ssize_t recv_all(int sock, void *buf, size_t size) {
-    size_t total = 0;
-
-    while (total < size) {
-        ssize_t len = recv(sock, (char*)buf + total, size - total, 0);
-        if (len <= 0) {
-            return len;
-        }
-        total += len;
-    }
-    return total;
-}
-
 /* ----------------------- recv_thread ----------------------- */
 
 void *recv_thread(void *arg) {
@@ -133,8 +125,7 @@ void *recv_thread(void *arg) {
     Message msg;
 
     while (1) {
-        ssize_t len = recv_all(sock, &msg, sizeof(Message));
-        if (len <= 0) {
+        if (msg_recv(sock, &msg) < 0) {
             // server disconnected
             pthread_mutex_lock(&g_ui_lock);
             print_chat("Server disconnected");
@@ -143,8 +134,24 @@ void *recv_thread(void *arg) {
             exit(0);
         }
 
+        // upload_file() 이 기다리는 응답
+        if ((msg.type == MSG_FILE_OFFSET || msg.type == MSG_FILE_READY ||
+             msg.type == MSG_FILE_PUT_READY || msg.type == MSG_ERROR) &&
+            handle_upload_reply(&msg)) {
+            continue;
+        }
+
         // file download handling
-        if (g_downloading && (msg.type == MSG_FILE_DATA || msg.type == MSG_FILE_END)) {
+        if (g_downloading && (msg.type == MSG_FILE_DATA || msg.type == MSG_FILE_END ||
+                              msg.type == MSG_FILE_BULK)) {
+
+            if (msg.type == MSG_FILE_BULK && handle_file_bulk(sock, &msg) < 0) {
+                pthread_mutex_lock(&g_ui_lock);
+                print_chat("Server disconnected");
+                endwin();
+                pthread_mutex_unlock(&g_ui_lock);
+                exit(0);
+            }
 
             if (msg.type == MSG_FILE_DATA && g_download_fp) {
                 fwrite(msg.data, 1, msg.data_len, g_download_fp);
@@ -153,6 +160,7 @@ void *recv_thread(void *arg) {
 
             if (msg.type == MSG_FILE_END) {
                 if (g_download_fp) fclose(g_download_fp);
+                download_commit(g_download_name);
 
                 pthread_mutex_lock(&g_ui_lock);
                 print_chat("Download Success: %s (%ld bytes)",
@@ -179,6 +187,23 @@ void *recv_thread(void *arg) {
             print_chat("[NOTICE] %s", msg.data);
             pthread_mutex_unlock(&g_ui_lock);
         }
+        else if (msg.type == MSG_HISTORY) {
+            pthread_mutex_lock(&g_ui_lock);
+            backlog_add(&msg);
+            pthread_mutex_unlock(&g_ui_lock);
+        }
+        else if (msg.type == MSG_HISTORY_END) {
+            pthread_mutex_lock(&g_ui_lock);
+            backlog_page_end(&msg);
+            pthread_mutex_unlock(&g_ui_lock);
+        }
+        else if (msg.type == MSG_ROOM) {
+            // moved to another room: show its recent chat below the notice
+            pthread_mutex_lock(&g_ui_lock);
+            print_chat("Now chatting in #%s", msg.data);
+            backlog_begin();
+            pthread_mutex_unlock(&g_ui_lock);
+        }
         else if (msg.type == MSG_LOGIN_OK) {
             pthread_mutex_lock(&g_ui_lock);
             print_chat("Server: Login Success");
@@ -332,11 +357,11 @@ int main() {
     pthread_mutex_unlock(&g_ui_lock);
 
     // send login request
+    memset(&msg, 0, sizeof(msg));
     msg.type = MSG_LOGIN;
-    sprintf(msg.data, "%s %s", id, pw);
-    send(sock, &msg, sizeof(msg), 0);
-    ra = read(sock, &msg, sizeof(msg));
-    if (ra < 0) perror("read");
+    snprintf(msg.data, sizeof(msg.data), "%s %s", id, pw);
+    msg_send(sock, &msg);
+    if (msg_recv(sock, &msg) < 0) perror("read");
 
     if (strcmp(msg.data, "LOGIN_FAIL") == 0) {
         pthread_mutex_lock(&g_ui_lock);
@@ -367,6 +392,9 @@ int main() {
     }
     pthread_mutex_unlock(&g_ui_lock);
 
+    // 지난 채팅 요청 (응답은 recv_thread 가 페이지 단위로 받아 한 번에 그림)
+    backlog_begin();
+
     // start receiver thread
     pthread_create(&recv_tid, NULL, recv_thread, NULL);
 
@@ -425,19 +453,21 @@ int main() {
         if (strncmp(buf, "/upload ", 8) == 0) {
             char filename[256];
             int ttl_minutes = 0;
+            int streams = 0;        // 0: 파일 크기에 따라 자동
+            long range_kb = 0;      // 0: 기본 구간 크기
             int count;
 
-            count = sscanf(buf + 8, "%255s %d", filename, &ttl_minutes);
+            count = sscanf(buf + 8, "%255s %d %d %ld", filename, &ttl_minutes, &streams, &range_kb);
             if (count < 1) {
                 pthread_mutex_lock(&g_ui_lock);
-                print_chat("Usage: /upload <filename> [ttl_minutes]");
+                print_chat("Usage: /upload <filename> [ttl_minutes] [streams] [range_kb]");
                 pthread_mutex_unlock(&g_ui_lock);
                 continue;
             }
             if (count == 1) ttl_minutes = 0;
 
             int ttl_seconds = ttl_minutes * 60;
-            upload_file(sock, filename, username, ttl_seconds);
+            upload_file(sock, filename, username, ttl_seconds, streams, range_kb * 1024);
 
             if (ttl_minutes > 0) {
                 pthread_mutex_lock(&g_ui_lock);
@@ -471,14 +501,15 @@ int main() {
             memset(&req, 0, sizeof(req));
             req.type = MSG_LIST_REQEUST;
             strcpy(req.sender, username);
-            send(sock, &req, sizeof(req), 0);
+            msg_send(sock, &req);
         }
 
         /* ---------- Exit ---------- */
         else if (strcmp(buf, "/exit") == 0) {
             msg.type = MSG_EXIT;
             strcpy(msg.sender, username);
-            send(sock, &msg, sizeof(msg), 0);
+            msg.data[0] = '\0';
+            msg_send(sock, &msg);
 
             pthread_mutex_lock(&g_ui_lock);
             print_chat("Client exit");
@@ -503,14 +534,17 @@ int main() {
             pthread_mutex_lock(&g_ui_lock);
 
             print_chat("---------- COMMAND MANUAL ----------");
-            print_chat("/upload <file> [ttl_min]");
+            print_chat("/upload <file> [ttl_min] [streams] [range_kb]");
             print_chat("  - Upload a file. If ttl_min is given, the file is auto-deleted after that many minutes");
+            print_chat("  - Large files are sent over several connections (streams, range size in KB)");
             print_chat("/download <file>");
             print_chat("  - Download a file stored on the server");
             print_chat("/list");
             print_chat("  - Show current online user list");
             print_chat("/dm <username> <message>");
             print_chat("  - Send a direct message to the target user");
+            print_chat("/join <room>, /leave, /rooms");
+            print_chat("  - Move to a chat room (chat goes only to its members), back to the lobby, list rooms");
             print_chat("/refresh");
             print_chat("  - Rebuild the screen layout (useful after resize glitches)");
             print_chat("/exit");
@@ -521,6 +555,8 @@ int main() {
             print_chat("  - Kick the target user from the server");
             print_chat("/root <username>");
             print_chat("  - Transfer ROOT permission to the target user");
+            print_chat("/stats");
+            print_chat("  - Show server statistics (connections, messages, latency)");
             print_chat("------------------------------------");
 
             pthread_mutex_unlock(&g_ui_lock);
@@ -543,11 +579,13 @@ int main() {
                 strcpy(msg.sender, username);
                 strcpy(msg.target, target);
 
-                // encrypt DM body
-                encrypt(body, msg.data);
+                // encrypt DM body (nonce || ciphertext, binary → carried by data_len)
+                size_t blen = strlen(body);
+                if (blen > MAX_BUF - CIPHER_OVERHEAD) blen = MAX_BUF - CIPHER_OVERHEAD;
+                msg.data_len = (int)encrypt(body, blen, msg.data);
 
                 // send to server
-                send(sock, &msg, sizeof(msg), 0);
+                msg_send(sock, &msg);
 
                 client_log("DM to %s: %s", target, body);
             }
@@ -565,7 +603,7 @@ int main() {
             msg.type = MSG_CHAT;
             strcpy(msg.sender, username);
             strcpy(msg.data, buf);
-            send(sock, &msg, sizeof(msg), 0);
+            msg_send(sock, &msg);
             client_log("Chat: %s", buf);
 
             // also show my own message immediately
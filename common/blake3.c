@@ -0,0 +1,333 @@
+#include <string.h>
+#include "blake3.h"
+
+/*
+ * 트리 구조
+ *  - 입력을 1KB 청크로 나눠 각 청크의 chaining value(CV) 를 구하고,
+ *    CV 두 개씩 부모 노드로 합쳐 올라간다. 마지막 노드에 ROOT 플래그.
+ *  - 마지막 청크를 뺀 나머지는 모두 꽉 찬 청크라 서로 독립적이다
+ *    → hash_many 가 8개씩 묶어 레인마다 청크 하나를 동시에 압축한다.
+ */
+
+#define CHUNK_LEN   1024
+#define BLOCK_LEN   64
+#define LANES       8
+
+#define CHUNK_START 1
+#define CHUNK_END   2
+#define PARENT      4
+#define ROOT        8
+
+static const uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// 라운드마다 메시지 워드 순서 (순열을 미리 7번 적용해 둔 표)
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t load32(const uint8_t *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static inline void store32(uint8_t *p, uint32_t w) {
+    p[0] = (uint8_t)w;
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+}
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// G 함수. 스칼라/벡터 모두 같은 식을 쓴다.
+#define G(v, a, b, c, d, mx, my) do {          \
+    v[a] = v[a] + v[b] + (mx);                  \
+    v[d] = ROTR(v[d] ^ v[a], 16);               \
+    v[c] = v[c] + v[d];                         \
+    v[b] = ROTR(v[b] ^ v[c], 12);               \
+    v[a] = v[a] + v[b] + (my);                  \
+    v[d] = ROTR(v[d] ^ v[a], 8);                \
+    v[c] = v[c] + v[d];                         \
+    v[b] = ROTR(v[b] ^ v[c], 7);                \
+} while (0)
+
+#define ROUND(v, m, r) do {                                         \
+    const uint8_t *s = MSG_SCHEDULE[r];                             \
+    G(v, 0, 4,  8, 12, m[s[0]],  m[s[1]]);                          \
+    G(v, 1, 5,  9, 13, m[s[2]],  m[s[3]]);                          \
+    G(v, 2, 6, 10, 14, m[s[4]],  m[s[5]]);                          \
+    G(v, 3, 7, 11, 15, m[s[6]],  m[s[7]]);                          \
+    G(v, 0, 5, 10, 15, m[s[8]],  m[s[9]]);                          \
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);                         \
+    G(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);                         \
+    G(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);                         \
+} while (0)
+
+/**
+ * 압축 함수 (스칼라). out 에 16워드 전부를 남긴다 (앞 8워드가 새 CV).
+ */
+static void compress(const uint32_t cv[8], const uint8_t block[BLOCK_LEN],
+                     uint64_t counter, uint32_t block_len, uint32_t flags,
+                     uint32_t out[16]) {
+    uint32_t m[16], v[16];
+
+    for (int i = 0; i < 16; i++) m[i] = load32(block + 4 * i);
+    for (int i = 0; i < 8; i++) v[i] = cv[i];
+    v[8] = IV[0]; v[9] = IV[1]; v[10] = IV[2]; v[11] = IV[3];
+    v[12] = (uint32_t)counter;
+    v[13] = (uint32_t)(counter >> 32);
+    v[14] = block_len;
+    v[15] = flags;
+
+    for (int r = 0; r < 7; r++) ROUND(v, m, r);
+
+    for (int i = 0; i < 8; i++) {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+/*
+ * 아직 압축하지 않은 마지막 노드. ROOT 여부는 부모 쪽에서 정해지므로
+ * CV 가 필요하면 그냥, 최종 출력이면 ROOT 를 붙여 압축한다.
+ */
+typedef struct {
+    uint32_t cv[8];
+    uint8_t  block[BLOCK_LEN];
+    uint64_t counter;
+    uint32_t block_len;
+    uint32_t flags;
+} Output;
+
+static void output_cv(const Output *o, uint32_t cv[8]) {
+    uint32_t w[16];
+    compress(o->cv, o->block, o->counter, o->block_len, o->flags, w);
+    memcpy(cv, w, 8 * sizeof(uint32_t));
+}
+
+/**
+ * 청크 하나 (1 ~ 1024 바이트, 빈 입력이면 0) 를 마지막 블록 직전까지 압축
+ */
+static void chunk_output(const uint8_t *in, size_t len, uint64_t counter, Output *o) {
+    uint32_t cv[8], w[16];
+    uint32_t flags = CHUNK_START;
+
+    memcpy(cv, IV, sizeof(cv));
+    while (len > BLOCK_LEN) {
+        compress(cv, in, counter, BLOCK_LEN, flags, w);
+        memcpy(cv, w, sizeof(cv));
+        in += BLOCK_LEN;
+        len -= BLOCK_LEN;
+        flags = 0;
+    }
+
+    memcpy(o->cv, cv, sizeof(cv));
+    memset(o->block, 0, BLOCK_LEN);
+    memcpy(o->block, in, len);
+    o->counter = counter;
+    o->block_len = (uint32_t)len;
+    o->flags = flags | CHUNK_END;
+}
+
+static void parent_output(const uint32_t left[8], const uint32_t right[8], Output *o) {
+    memcpy(o->cv, IV, sizeof(o->cv));
+    for (int i = 0; i < 8; i++) {
+        store32(o->block + 4 * i, left[i]);
+        store32(o->block + 32 + 4 * i, right[i]);
+    }
+    o->counter = 0;
+    o->block_len = BLOCK_LEN;
+    o->flags = PARENT;
+}
+
+/* ---------- 여러 청크 동시 압축 (GCC 벡터 확장, 레인 = 청크) ---------- */
+
+typedef uint32_t v8u __attribute__((vector_size(4 * LANES)));
+
+/**
+ * 꽉 찬 청크 LANES 개를 한 번에 압축해 CV 를 구한다.
+ * 같은 본문을 대상 ISA 별로 두 번 컴파일하므로 항상 인라인.
+ */
+static inline __attribute__((always_inline))
+void hash_many_body(const uint8_t *in, uint64_t counter, uint32_t out[LANES][8]) {
+    v8u h[8], m[16], v[16], ctr_lo, ctr_hi;
+
+    for (int i = 0; i < 8; i++) h[i] = (v8u){0} + IV[i];
+    for (int k = 0; k < LANES; k++) {
+        ctr_lo[k] = (uint32_t)(counter + k);
+        ctr_hi[k] = (uint32_t)((counter + k) >> 32);
+    }
+
+    for (int b = 0; b < CHUNK_LEN / BLOCK_LEN; b++) {
+        uint32_t flags = (b == 0 ? CHUNK_START : 0) |
+                         (b == CHUNK_LEN / BLOCK_LEN - 1 ? CHUNK_END : 0);
+
+        // 레인 k 의 워드 j = k 번째 청크의 b 번째 블록의 j 번째 워드
+        for (int j = 0; j < 16; j++)
+            for (int k = 0; k < LANES; k++)
+                m[j][k] = load32(in + (size_t)k * CHUNK_LEN + (size_t)b * BLOCK_LEN + 4 * j);
+
+        for (int i = 0; i < 8; i++) v[i] = h[i];
+        for (int i = 0; i < 4; i++) v[8 + i] = (v8u){0} + IV[i];
+        v[12] = ctr_lo;
+        v[13] = ctr_hi;
+        v[14] = (v8u){0} + BLOCK_LEN;
+        v[15] = (v8u){0} + flags;
+
+        for (int r = 0; r < 7; r++) ROUND(v, m, r);
+
+        for (int i = 0; i < 8; i++) h[i] = v[i] ^ v[i + 8];
+    }
+
+    for (int k = 0; k < LANES; k++)
+        for (int i = 0; i < 8; i++)
+            out[k][i] = h[i][k];
+}
+
+static void hash_many_portable(const uint8_t *in, uint64_t counter, uint32_t out[LANES][8]) {
+    hash_many_body(in, counter, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void hash_many_avx2(const uint8_t *in, uint64_t counter, uint32_t out[LANES][8]) {
+    hash_many_body(in, counter, out);
+}
+#endif
+
+typedef void (*hash_many_fn)(const uint8_t *, uint64_t, uint32_t [LANES][8]);
+
+static hash_many_fn hash_many_impl;
+static const char  *impl_name;
+
+static void select_impl(void) {
+    hash_many_fn fn = hash_many_portable;
+    const char *name = "portable";
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = hash_many_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        name = "sse2";          // 기본 빌드가 SSE2 로 벡터를 둘로 나눠 처리
+    }
+#endif
+    // 여러 스레드가 동시에 골라도 결과가 같으므로 그냥 덮어쓴다
+    impl_name = name;
+    __atomic_store_n(&hash_many_impl, fn, __ATOMIC_RELEASE);
+}
+
+const char *blake3_impl_name(void) {
+    if (!__atomic_load_n(&hash_many_impl, __ATOMIC_ACQUIRE)) select_impl();
+    return impl_name;
+}
+
+/* ---------- 트리 ---------- */
+
+#define MAX_DEPTH 54            // 2^54 청크 = 2^64 바이트
+
+typedef struct {
+    uint32_t cv[MAX_DEPTH][8];
+    int      len;
+} CvStack;
+
+/**
+ * 청크 CV 를 쌓는다. 지금까지 청크 수(total) 의 하위 0비트 수만큼
+ * 완성된 서브트리가 생기므로 그만큼 부모로 합친다.
+ */
+static void push_chunk_cv(CvStack *st, uint32_t cv[8], uint64_t total) {
+    Output o;
+    while ((total & 1) == 0) {
+        st->len--;
+        parent_output(st->cv[st->len], cv, &o);
+        output_cv(&o, cv);
+        total >>= 1;
+    }
+    memcpy(st->cv[st->len++], cv, 8 * sizeof(uint32_t));
+}
+
+void blake3_hash(const void *data, size_t len, uint8_t out[BLAKE3_OUT_LEN]) {
+    const uint8_t *in = data;
+    hash_many_fn many = __atomic_load_n(&hash_many_impl, __ATOMIC_ACQUIRE);
+    CvStack st;
+    Output o;
+    uint32_t cv[8];
+    uint64_t chunk = 0;
+
+    if (!many) {
+        select_impl();
+        many = hash_many_impl;
+    }
+    st.len = 0;
+
+    // 마지막 청크 (꽉 찼어도) 는 ROOT 가 될 수 있으므로 남겨 둔다
+    size_t full = len > 0 ? (len - 1) / CHUNK_LEN : 0;
+
+    while (full - chunk >= LANES) {
+        uint32_t cvs[LANES][8];
+        many(in + chunk * CHUNK_LEN, chunk, cvs);
+        for (int k = 0; k < LANES; k++) {
+            chunk++;
+            push_chunk_cv(&st, cvs[k], chunk);
+        }
+    }
+    while (chunk < full) {
+        chunk_output(in + chunk * CHUNK_LEN, CHUNK_LEN, chunk, &o);
+        output_cv(&o, cv);
+        chunk++;
+        push_chunk_cv(&st, cv, chunk);
+    }
+
+    chunk_output(in + chunk * CHUNK_LEN, len - chunk * CHUNK_LEN, chunk, &o);
+    while (st.len > 0) {
+        output_cv(&o, cv);
+        st.len--;
+        parent_output(st.cv[st.len], cv, &o);
+    }
+
+    uint32_t w[16];
+    compress(o.cv, o.block, o.counter, o.block_len, o.flags | ROOT, w);
+    for (int i = 0; i < 8; i++) store32(out + 4 * i, w[i]);
+}
+
+void blake3_to_hex(const uint8_t hash[BLAKE3_OUT_LEN], char out[2 * BLAKE3_OUT_LEN + 1]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < BLAKE3_OUT_LEN; i++) {
+        out[2 * i] = digits[hash[i] >> 4];
+        out[2 * i + 1] = digits[hash[i] & 15];
+    }
+    out[2 * BLAKE3_OUT_LEN] = '\0';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int blake3_from_hex(const char *hex, uint8_t hash[BLAKE3_OUT_LEN]) {
+    for (int i = 0; i < BLAKE3_OUT_LEN; i++) {
+        int hi = hex_value(hex[2 * i]);
+        int lo = hi < 0 ? -1 : hex_value(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return -1;
+        hash[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return hex[2 * BLAKE3_OUT_LEN] == '\0' ? 0 : -1;
+}
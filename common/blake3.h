@@ -0,0 +1,21 @@
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * BLAKE3 해시 (한 번에 전부 해시하는 용도만, 키/파생 모드 없음)
+ *  - 1KB 청크 여러 개를 SIMD 레인에 하나씩 올려 동시에 압축한다.
+ *  - x86_64 에서는 실행 중인 CPU 를 보고 AVX2(8레인) / SSE2 구현을 고른다.
+ */
+
+#define BLAKE3_OUT_LEN 32
+
+void        blake3_hash(const void *data, size_t len, uint8_t out[BLAKE3_OUT_LEN]);
+const char *blake3_impl_name(void);         // 선택된 구현 ("avx2", "sse2", "portable")
+
+void        blake3_to_hex(const uint8_t hash[BLAKE3_OUT_LEN], char out[2 * BLAKE3_OUT_LEN + 1]);
+int         blake3_from_hex(const char *hex, uint8_t hash[BLAKE3_OUT_LEN]);   // 0: 성공
+
+#endif
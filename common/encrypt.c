@@ -1,15 +1,337 @@
-#include "./protocol.h"
 #include <string.h>
+#include <time.h>
+#include <sys/random.h>
+#include "encrypt.h"
 
-void encrypt(const char *in, char *out) {
-    unsigned char key = 0x5A;  // 원하는 XOR 키
-    int i;
-    for (i = 0; in[i]; i++) {
-        out[i] = in[i] ^ key;
+/*
+ * 상태 16워드 = 상수 4 | 키 8 | 블록 카운터 1 | nonce 3
+ *  - 블록마다 카운터만 다르므로 서로 독립적이다
+ *    → xor_many 가 8블록씩 묶어 레인마다 블록 하나의 키스트림을 만든다.
+ */
+
+#define BLOCK_LEN   64
+#define LANES       8
+
+// DM 공유 키 (이전 XOR 키처럼 클라이언트에 고정, 서버는 본문을 그대로 중계만 한다)
+static const uint8_t DM_KEY[CIPHER_KEY_LEN] = {
+    0x3c, 0x91, 0x5e, 0x07, 0xa8, 0x2d, 0xf4, 0x66, 0x1b, 0xc2, 0x79, 0x8e, 0x50, 0x13, 0xd7, 0xaa,
+    0x45, 0xe9, 0x0f, 0x72, 0xb6, 0x38, 0xcd, 0x84, 0x29, 0x5a, 0xf1, 0x9c, 0x63, 0x0e, 0xb5, 0x47,
+};
+
+static inline uint32_t load32(const uint8_t *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+#else
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#endif
+}
+
+static inline void store32(uint8_t *p, uint32_t w) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(p, &w, sizeof(w));
+#else
+    p[0] = (uint8_t)w;
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+#endif
+}
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// quarter round. 스칼라/벡터 모두 같은 식을 쓴다.
+#define QR(x, a, b, c, d) do {                  \
+    x[a] += x[b]; x[d] = ROTL(x[d] ^ x[a], 16); \
+    x[c] += x[d]; x[b] = ROTL(x[b] ^ x[c], 12); \
+    x[a] += x[b]; x[d] = ROTL(x[d] ^ x[a], 8);  \
+    x[c] += x[d]; x[b] = ROTL(x[b] ^ x[c], 7);  \
+} while (0)
+
+// column round + diagonal round
+#define DOUBLE_ROUND(x) do {                    \
+    QR(x, 0, 4,  8, 12);                        \
+    QR(x, 1, 5,  9, 13);                        \
+    QR(x, 2, 6, 10, 14);                        \
+    QR(x, 3, 7, 11, 15);                        \
+    QR(x, 0, 5, 10, 15);                        \
+    QR(x, 1, 6, 11, 12);                        \
+    QR(x, 2, 7,  8, 13);                        \
+    QR(x, 3, 4,  9, 14);                        \
+} while (0)
+
+static void state_init(uint32_t st[16], const uint8_t key[CIPHER_KEY_LEN],
+                       const uint8_t nonce[CIPHER_NONCE_LEN], uint32_t counter) {
+    st[0] = 0x61707865;         // "expand 32-byte k"
+    st[1] = 0x3320646e;
+    st[2] = 0x79622d32;
+    st[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) st[4 + i] = load32(key + 4 * i);
+    st[12] = counter;
+    for (int i = 0; i < 3; i++) st[13 + i] = load32(nonce + 4 * i);
+}
+
+/**
+ * 블록 하나의 키스트림 (스칼라). 꼬리 블록과 scalar 구현에서 사용.
+ */
+static void chacha_block(const uint32_t st[16], uint8_t out[BLOCK_LEN]) {
+    uint32_t x[16];
+
+    memcpy(x, st, sizeof(x));
+    for (int r = 0; r < 10; r++) DOUBLE_ROUND(x);
+    for (int i = 0; i < 16; i++) store32(out + 4 * i, x[i] + st[i]);
+}
+
+static void xor_block(const uint32_t st[16], uint8_t *buf, size_t len) {
+    uint8_t ks[BLOCK_LEN];
+
+    chacha_block(st, ks);
+    for (size_t i = 0; i < len; i++) buf[i] ^= ks[i];
+}
+
+/* ---------- 여러 블록 동시 처리 (GCC 벡터 확장, 레인 = 블록) ---------- */
+
+typedef uint32_t v8u __attribute__((vector_size(4 * LANES)));
+
+/**
+ * 8x8 전치: 입력 r[i] 의 레인 k = 블록 k 의 워드 i  →  출력 r[k] = 블록 k 의 워드 0..7
+ * (32비트 → 64비트 → 128비트 단위 interleave, AVX2 에서는 unpck/perm2i128 로 풀린다)
+ */
+static inline __attribute__((always_inline))
+void transpose8(v8u r[8]) {
+    const v8u lo32 = { 0, 8, 1, 9, 4, 12, 5, 13 }, hi32 = { 2, 10, 3, 11, 6, 14, 7, 15 };
+    const v8u lo64 = { 0, 1, 8, 9, 4, 5, 12, 13 }, hi64 = { 2, 3, 10, 11, 6, 7, 14, 15 };
+    const v8u lo128 = { 0, 1, 2, 3, 8, 9, 10, 11 }, hi128 = { 4, 5, 6, 7, 12, 13, 14, 15 };
+    v8u t[8], u[8];
+
+    for (int i = 0; i < 8; i += 2) {
+        t[i]     = __builtin_shuffle(r[i], r[i + 1], lo32);
+        t[i + 1] = __builtin_shuffle(r[i], r[i + 1], hi32);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i]     = __builtin_shuffle(t[i],     t[i + 2], lo64);   // 워드 0, 4
+        u[i + 1] = __builtin_shuffle(t[i],     t[i + 2], hi64);   // 워드 1, 5
+        u[i + 2] = __builtin_shuffle(t[i + 1], t[i + 3], lo64);   // 워드 2, 6
+        u[i + 3] = __builtin_shuffle(t[i + 1], t[i + 3], hi64);   // 워드 3, 7
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i]     = __builtin_shuffle(u[i], u[i + 4], lo128);
+        r[i + 4] = __builtin_shuffle(u[i], u[i + 4], hi128);
     }
-    out[i] = '\0';
 }
 
-void decrypt(const char *in, char *out) {
-    encrypt(in, out); // XOR은 양방향 동일
-}
\ No newline at end of file
+typedef uint8_t v32b __attribute__((vector_size(4 * LANES)));
+
+/*
+ * 16/8비트 회전은 바이트 단위 이동이라 pshufb 한 번으로 끝난다 (AVX2 빌드).
+ * SSE2 에는 바이트 셔플이 없으므로 shift + or 그대로 둔다.
+ */
+#define BYTE_ROT_MASK(a, b, c, d) \
+    { a, b, c, d, a + 4, b + 4, c + 4, d + 4, a + 8, b + 8, c + 8, d + 8,             \
+      a + 12, b + 12, c + 12, d + 12, a + 16, b + 16, c + 16, d + 16,                 \
+      a + 20, b + 20, c + 20, d + 20, a + 24, b + 24, c + 24, d + 24,                 \
+      a + 28, b + 28, c + 28, d + 28 }
+
+#define ROTL16_BYTES(v) ((v8u)__builtin_shuffle((v32b)(v), (v32b)BYTE_ROT_MASK(2, 3, 0, 1)))
+#define ROTL8_BYTES(v)  ((v8u)__builtin_shuffle((v32b)(v), (v32b)BYTE_ROT_MASK(3, 0, 1, 2)))
+
+#define QRV(x, a, b, c, d, bytes) do {                                          \
+    x[a] += x[b]; x[d] ^= x[a];                                                 \
+    x[d] = (bytes) ? ROTL16_BYTES(x[d]) : ROTL(x[d], 16);                       \
+    x[c] += x[d]; x[b] = ROTL(x[b] ^ x[c], 12);                                 \
+    x[a] += x[b]; x[d] ^= x[a];                                                 \
+    x[d] = (bytes) ? ROTL8_BYTES(x[d]) : ROTL(x[d], 8);                         \
+    x[c] += x[d]; x[b] = ROTL(x[b] ^ x[c], 7);                                  \
+} while (0)
+
+/**
+ * 블록 LANES 개 (카운터 st[12] .. st[12] + LANES - 1) 의 키스트림을 buf 에 XOR.
+ * 같은 본문을 대상 ISA 별로 두 번 컴파일하므로 항상 인라인 (bytes 는 상수로 접힌다).
+ */
+static inline __attribute__((always_inline))
+void xor_many_body(const uint32_t st[16], uint8_t *buf, int bytes) {
+    v8u s[16], x[16];
+
+    for (int i = 0; i < 16; i++) s[i] = (v8u){0} + st[i];
+    for (int k = 0; k < LANES; k++) s[12][k] = st[12] + (uint32_t)k;
+
+    for (int i = 0; i < 16; i++) x[i] = s[i];
+    for (int r = 0; r < 10; r++) {
+        QRV(x, 0, 4,  8, 12, bytes);
+        QRV(x, 1, 5,  9, 13, bytes);
+        QRV(x, 2, 6, 10, 14, bytes);
+        QRV(x, 3, 7, 11, 15, bytes);
+        QRV(x, 0, 5, 10, 15, bytes);
+        QRV(x, 1, 6, 11, 12, bytes);
+        QRV(x, 2, 7,  8, 13, bytes);
+        QRV(x, 3, 4,  9, 14, bytes);
+    }
+    for (int i = 0; i < 16; i++) x[i] += s[i];
+
+    // 레인 k 의 워드 j = k 번째 블록의 j 번째 키스트림 워드 → 블록별 32바이트 두 벡터로
+    transpose8(x);
+    transpose8(x + 8);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (int k = 0; k < LANES; k++) {
+        for (int h = 0; h < 2; h++) {
+            uint8_t *p = buf + (size_t)k * BLOCK_LEN + 32 * h;
+            v8u v;
+            memcpy(&v, p, sizeof(v));
+            v ^= x[8 * h + k];
+            memcpy(p, &v, sizeof(v));
+        }
+    }
+#else
+    for (int k = 0; k < LANES; k++)
+        for (int j = 0; j < 16; j++) {
+            uint8_t *p = buf + (size_t)k * BLOCK_LEN + 4 * j;
+            store32(p, load32(p) ^ x[8 * (j / 8) + k][j % 8]);
+        }
+#endif
+}
+
+static void xor_many_portable(const uint32_t st[16], uint8_t *buf) {
+    xor_many_body(st, buf, 0);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void xor_many_avx2(const uint32_t st[16], uint8_t *buf) {
+    xor_many_body(st, buf, 1);
+}
+#endif
+
+// 벡터 없이 블록 하나씩 (비교 기준)
+static void xor_many_scalar(const uint32_t st[16], uint8_t *buf) {
+    uint32_t s[16];
+
+    memcpy(s, st, sizeof(s));
+    for (int k = 0; k < LANES; k++, s[12]++)
+        xor_block(s, buf + (size_t)k * BLOCK_LEN, BLOCK_LEN);
+}
+
+typedef void (*xor_many_fn)(const uint32_t [16], uint8_t *);
+
+static xor_many_fn xor_many_impl;
+static const char *impl_name;
+
+static void select_impl(void) {
+    xor_many_fn fn = xor_many_portable;
+    const char *name = "portable";
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = xor_many_avx2;
+        name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        name = "sse2";          // 기본 빌드가 SSE2 로 벡터를 둘로 나눠 처리
+    }
+#endif
+    // 여러 스레드가 동시에 골라도 결과가 같으므로 그냥 덮어쓴다
+    impl_name = name;
+    __atomic_store_n(&xor_many_impl, fn, __ATOMIC_RELEASE);
+}
+
+const char *cipher_impl_name(void) {
+    if (!__atomic_load_n(&xor_many_impl, __ATOMIC_ACQUIRE)) select_impl();
+    return impl_name;
+}
+
+int cipher_set_impl(const char *name) {
+    xor_many_fn fn = NULL;
+
+    if (strcmp(name, "scalar") == 0) {
+        fn = xor_many_scalar;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    else if (strcmp(name, "sse2") == 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2")) fn = xor_many_portable;
+    } else if (strcmp(name, "avx2") == 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) fn = xor_many_avx2;
+    }
+#else
+    else if (strcmp(name, "portable") == 0) {
+        fn = xor_many_portable;
+    }
+#endif
+    if (!fn) return -1;
+
+    impl_name = fn == xor_many_scalar ? "scalar" : name;
+    __atomic_store_n(&xor_many_impl, fn, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void chacha20_xor(const uint8_t key[CIPHER_KEY_LEN], const uint8_t nonce[CIPHER_NONCE_LEN],
+                  uint32_t counter, void *buf, size_t len) {
+    uint8_t *p = buf;
+    xor_many_fn many = __atomic_load_n(&xor_many_impl, __ATOMIC_ACQUIRE);
+    uint32_t st[16];
+
+    if (!many) {
+        select_impl();
+        many = xor_many_impl;
+    }
+    state_init(st, key, nonce, counter);
+
+    while (len >= LANES * BLOCK_LEN) {
+        many(st, p);
+        st[12] += LANES;
+        p += LANES * BLOCK_LEN;
+        len -= LANES * BLOCK_LEN;
+    }
+    while (len > 0) {
+        size_t n = len < BLOCK_LEN ? len : BLOCK_LEN;
+        xor_block(st, p, n);
+        st[12]++;
+        p += n;
+        len -= n;
+    }
+}
+
+/* ---------- DM 본문 ---------- */
+
+/**
+ * 메시지마다 새 nonce. 같은 키로 nonce 가 겹치면 키스트림이 재사용되므로
+ * 커널 난수를 쓰고, 실패하면 시간 + 프로세스 내 카운터로 대신한다.
+ */
+static void make_nonce(uint8_t nonce[CIPHER_NONCE_LEN]) {
+    static uint32_t seq;
+    struct timespec ts;
+
+    if (getrandom(nonce, CIPHER_NONCE_LEN, 0) == CIPHER_NONCE_LEN) return;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint32_t w[3] = {
+        (uint32_t)ts.tv_sec,
+        (uint32_t)ts.tv_nsec,
+        __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED),
+    };
+    memcpy(nonce, w, CIPHER_NONCE_LEN);
+}
+
+size_t encrypt(const void *in, size_t len, void *out) {
+    uint8_t *o = out;
+
+    memmove(o + CIPHER_NONCE_LEN, in, len);
+    make_nonce(o);
+    chacha20_xor(DM_KEY, o, 1, o + CIPHER_NONCE_LEN, len);
+    return len + CIPHER_NONCE_LEN;
+}
+
+int decrypt(const void *in, size_t len, void *out) {
+    uint8_t nonce[CIPHER_NONCE_LEN];
+
+    if (len < CIPHER_NONCE_LEN) return -1;
+    memcpy(nonce, in, CIPHER_NONCE_LEN);
+
+    len -= CIPHER_NONCE_LEN;
+    memmove(out, (const uint8_t *)in + CIPHER_NONCE_LEN, len);
+    chacha20_xor(DM_KEY, nonce, 1, out, len);
+    return (int)len;
+}
@@ -1,7 +1,32 @@
 #ifndef ENCRYPT_H
 #define ENCRYPT_H
 
-void encrypt(const char *in, char *out);
-void decrypt(const char *in, char *out);
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * ChaCha20 (RFC 8439) 스트림 암호
+ *  - 길이 기반: NUL 바이트가 섞인 임의의 버퍼를 제자리에서 암/복호화한다.
+ *  - 64바이트 블록 여러 개를 SIMD 레인에 하나씩 올려 키스트림을 동시에 만든다.
+ *  - x86_64 에서는 실행 중인 CPU 를 보고 AVX2(8블록) / SSE2 구현을 고른다.
+ */
+
+#define CIPHER_KEY_LEN    32
+#define CIPHER_NONCE_LEN  12
+#define CIPHER_OVERHEAD   CIPHER_NONCE_LEN      // encrypt() 가 앞에 붙이는 nonce
+
+void        chacha20_xor(const uint8_t key[CIPHER_KEY_LEN], const uint8_t nonce[CIPHER_NONCE_LEN],
+                         uint32_t counter, void *buf, size_t len);
+const char *cipher_impl_name(void);         // 선택된 구현 ("avx2", "sse2", "portable", "scalar")
+int         cipher_set_impl(const char *name);  // 구현 강제 (벤치마크용), 0: 성공 / -1: 지원 안 함
+
+/*
+ * DM 본문 암호화 (공유 키 + 메시지마다 새 nonce)
+ *  - encrypt: out = nonce || 암호문, 반환값 len + CIPHER_OVERHEAD
+ *  - decrypt: 반환값 평문 길이, 너무 짧으면 -1
+ *  - 둘 다 in == out (제자리) 호출 가능 (encrypt 는 out 에 CIPHER_OVERHEAD 만큼 여유 필요)
+ */
+size_t encrypt(const void *in, size_t len, void *out);
+int    decrypt(const void *in, size_t len, void *out);
 
 #endif
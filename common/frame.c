@@ -0,0 +1,193 @@
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "frame.h"
+
+/**
+ * 본문 길이: 파일 청크와 암호화된 DM 은 data_len, 나머지는 문자열 길이
+ *  (data_len 이 0 인 DM 은 예전 클라이언트의 문자열 본문으로 본다)
+ */
+size_t message_body_len(const Message *m) {
+    if (m->type == MSG_FILE_DATA || (m->type == MSG_DM && m->data_len > 0)) {
+        if (m->data_len < 0) return 0;
+        return m->data_len > MAX_BUF ? MAX_BUF : (size_t)m->data_len;
+    }
+    return strnlen(m->data, MAX_BUF);
+}
+
+/**
+ * frame_encode() 결과 길이 (미리 정확한 크기의 버퍼를 잡을 때 사용)
+ */
+size_t frame_encoded_len(const Message *m) {
+    size_t slen = strnlen(m->sender, MAX_NAME - 1);
+    size_t tlen = strnlen(m->target, MAX_NAME - 1);
+    size_t names = (slen || tlen) ? 2 + slen + tlen : 0;
+    return FRAME_HDR_LEN + names + message_body_len(m);
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    v = htonl(v);
+    memcpy(p, &v, 4);
+}
+
+static uint32_t get32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+/**
+ * Message → v2 프레임. out 은 FRAME_MAX_LEN 이상이어야 한다.
+ * 반환: 프레임 전체 길이
+ */
+size_t frame_encode(const Message *m, uint32_t sender_id, uint32_t target_id,
+                    unsigned char *out) {
+    size_t slen = strnlen(m->sender, MAX_NAME - 1);
+    size_t tlen = strnlen(m->target, MAX_NAME - 1);
+    size_t blen = message_body_len(m);
+    uint16_t flags = 0;
+
+    unsigned char *p = out + FRAME_HDR_LEN;
+    if (slen || tlen) {
+        flags |= FRAME_F_NAMES;
+        *p++ = (unsigned char)slen;
+        memcpy(p, m->sender, slen);
+        p += slen;
+        *p++ = (unsigned char)tlen;
+        memcpy(p, m->target, tlen);
+        p += tlen;
+    }
+    memcpy(p, m->data, blen);
+    p += blen;
+
+    uint32_t len = (uint32_t)(p - out - FRAME_HDR_LEN);
+
+    out[0] = FRAME_MAGIC;
+    out[1] = (unsigned char)m->type;
+    out[2] = (unsigned char)(flags >> 8);
+    out[3] = (unsigned char)flags;
+    put32(out + 4, sender_id);
+    put32(out + 8, target_id);
+    put32(out + 12, len);
+
+    return FRAME_HDR_LEN + len;
+}
+
+/**
+ * 헤더 파싱. magic 이 다르거나 길이가 비정상이면 -1
+ */
+int frame_parse_header(const unsigned char *buf, FrameHeader *h) {
+    if (buf[0] != FRAME_MAGIC) return -1;
+
+    h->type = buf[1];
+    h->flags = (uint16_t)((buf[2] << 8) | buf[3]);
+    h->sender_id = get32(buf + 4);
+    h->target_id = get32(buf + 8);
+    h->len = get32(buf + 12);
+
+    if (h->len > FRAME_MAX_PAYLOAD) return -1;
+    return 0;
+}
+
+/**
+ * payload → Message. 사용한 부분만 채우고 문자열은 NUL 로 끝낸다.
+ */
+int frame_decode(const FrameHeader *h, const unsigned char *payload, Message *m) {
+    const unsigned char *p = payload;
+    const unsigned char *end = payload + h->len;
+
+    m->type = h->type;
+    m->sender[0] = '\0';
+    m->target[0] = '\0';
+
+    if (h->flags & FRAME_F_NAMES) {
+        size_t slen, tlen;
+
+        if (p >= end) return -1;
+        slen = *p++;
+        if (slen >= MAX_NAME || p + slen > end) return -1;
+        memcpy(m->sender, p, slen);
+        m->sender[slen] = '\0';
+        p += slen;
+
+        if (p >= end) return -1;
+        tlen = *p++;
+        if (tlen >= MAX_NAME || p + tlen > end) return -1;
+        memcpy(m->target, p, tlen);
+        m->target[tlen] = '\0';
+        p += tlen;
+    }
+
+    size_t blen = (size_t)(end - p);
+    if (blen > MAX_BUF) return -1;
+
+    memcpy(m->data, p, blen);
+    if (blen < MAX_BUF) m->data[blen] = '\0';
+    m->data_len = (m->type == MSG_FILE_DATA || m->type == MSG_DM) ? (int)blen : 0;
+    return 0;
+}
+
+/**
+ * v1 클라이언트로 보낼 Message 구성 (쓰지 않은 영역은 0으로 채움)
+ */
+void message_to_v1(const Message *m, Message *out) {
+    memset(out, 0, sizeof(*out));
+    out->type = m->type;
+    memcpy(out->sender, m->sender, strnlen(m->sender, MAX_NAME - 1));
+    memcpy(out->target, m->target, strnlen(m->target, MAX_NAME - 1));
+    memcpy(out->data, m->data, message_body_len(m));
+    out->data_len = m->data_len;
+}
+
+/* ----------------------- 블로킹 소켓 송수신 ----------------------- */
+
+static int send_full(int sock, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_full(int sock, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * Message 1개를 v2 프레임으로 전송. 실패 시 -1
+ */
+int msg_send(int sock, const Message *m) {
+    unsigned char frame[FRAME_MAX_LEN];
+    size_t len = frame_encode(m, FRAME_ID_NONE, FRAME_ID_NONE, frame);
+    return send_full(sock, frame, len);
+}
+
+/**
+ * v2 프레임 1개를 받아 Message 로 변환. 연결 종료/오류 시 -1
+ */
+int msg_recv(int sock, Message *m) {
+    unsigned char hdr[FRAME_HDR_LEN];
+    unsigned char payload[FRAME_MAX_PAYLOAD];
+    FrameHeader h;
+
+    if (recv_full(sock, hdr, sizeof(hdr)) < 0) return -1;
+    if (frame_parse_header(hdr, &h) < 0) return -1;
+    if (recv_full(sock, payload, h.len) < 0) return -1;
+    return frame_decode(&h, payload, m);
+}
@@ -0,0 +1,54 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "protocol.h"
+
+/*
+ * 프로토콜 v2: 가변 길이 프레임
+ *
+ *  0      1      2             4              8              12             16
+ *  +------+------+-------------+--------------+--------------+--------------+----------
+ *  |magic | type |   flags     |  sender_id   |  target_id   | payload_len  | payload
+ *  +------+------+-------------+--------------+--------------+--------------+----------
+ *  (모든 정수는 network byte order)
+ *
+ *  payload = [FRAME_F_NAMES 이면] u8 sender_len, sender, u8 target_len, target
+ *            + 본문 (Message.data 중 실제 사용한 바이트만)
+ *
+ * v1 (Message 구조체를 그대로 전송)의 첫 바이트는 메시지 타입의 하위 바이트이므로
+ * FRAME_MAGIC 과 겹치지 않는다 → 서버는 첫 바이트로 v1/v2 를 구분한다.
+ */
+
+#define FRAME_MAGIC        0xB2
+#define FRAME_HDR_LEN      16
+#define FRAME_ID_NONE      0xFFFFFFFFu   // 서버가 보낸 메시지 / 대상 없음
+
+// flags
+#define FRAME_F_NAMES      0x0001        // payload 앞에 sender/target 이름 포함
+
+#define FRAME_MAX_PAYLOAD  (2 + 2 * MAX_NAME + MAX_BUF)
+#define FRAME_MAX_LEN      (FRAME_HDR_LEN + FRAME_MAX_PAYLOAD)
+
+typedef struct {
+    uint8_t  type;
+    uint16_t flags;
+    uint32_t sender_id;
+    uint32_t target_id;
+    uint32_t len;                 // payload 길이
+} FrameHeader;
+
+size_t message_body_len(const Message *m);
+size_t frame_encoded_len(const Message *m);
+size_t frame_encode(const Message *m, uint32_t sender_id, uint32_t target_id,
+                    unsigned char *out);
+int    frame_parse_header(const unsigned char *buf, FrameHeader *h);
+int    frame_decode(const FrameHeader *h, const unsigned char *payload, Message *m);
+void   message_to_v1(const Message *m, Message *out);
+
+// 블로킹 소켓용 송수신 (클라이언트)
+int msg_send(int sock, const Message *m);
+int msg_recv(int sock, Message *m);
+
+#endif
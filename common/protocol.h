@@ -4,7 +4,6 @@
 // 공통 상수
 #define MAX_BUF     1024
 #define MAX_NAME    20
-#define MAX_CLIENTS 10
 #define SERVER_PORT 9000
 
 // 메시지 타입 정의
@@ -21,6 +20,16 @@
 #define MSG_FILE_READY      7      // 서버: 업로드 준비 완료
 #define MSG_FILE_DATA       8      // 파일 데이터 청크
 #define MSG_FILE_END        9      // 파일 전송 종료
+#define MSG_FILE_BULK       14     // 서버: bulk 다운로드 시작 (data = "filename size offset"),
+                                   //       이어서 파일 본문 (size - offset) 바이트가 그대로 온다
+#define MSG_FILE_QUERY      15     // 클라이언트: 업로드 이어받기 위치 조회 (data = "filename size")
+#define MSG_FILE_OFFSET     16     // 서버: 조회 결과 (data = "xfer_id offset")
+#define MSG_FILE_PUT_OPEN   17     // 클라이언트: 병렬 업로드 시작 (data = "filename size ttl range_size [cas]")
+#define MSG_FILE_PUT_READY  18     // 서버: data = "xfer_id token range_size nranges [cas]"
+#define MSG_FILE_RANGE      19     // 구간 연결: data = "xfer_id token index [hash]", 이어서 구간 본문이 그대로 온다
+                                   //   (cas: 서버가 "need" 라고 답한 뒤에만)
+#define MSG_FILE_RANGE_ACK  22     // 서버: 구간 확정 (data = "index ok|done", done = 파일 완성)
+                                   //   cas: "index have|need" (청크가 이미 있음 / 본문 필요)
 
 // 종료 및 기타
 #define MSG_EXIT            10
@@ -28,11 +37,19 @@
 
 
 //귓속말 전송
-#define MSG_DM 12
+#define MSG_DM 12                  // data = nonce(12) + ChaCha20 암호문, 길이는 data_len
 #define MSG_DM_FAIL         13 //귓속말 대상 없음 에러
 #define MSG_LIST_REQEUST 20
 #define MSG_LIST_RESPONSE 21
 
+// 채팅 기록 (로그인 직후 페이지 단위로 받아 감)
+#define MSG_HISTORY_REQUEST 23     // 클라이언트: data = "before count" (before = 0 이면 로그인 시점 이전 최신부터)
+#define MSG_HISTORY         24     // 서버: 기록 1개 (sender = 보낸 사람, data = 본문)
+#define MSG_HISTORY_END     25     // 서버: 페이지 끝 (data = "first_seq more"), 다음 요청의 before = first_seq
+
+// 채팅방 (/join, /leave 성공 시)
+#define MSG_ROOM            26     // 서버: 지금 들어가 있는 방 (data = 방 이름), 기록 조회도 이 방 기준
+
 //사용자 강퇴 후 전송 메시지
 #define MSG_KICK_NOTICE 99
 
@@ -2,73 +2,68 @@
 #include <string.h>
 #include <stdbool.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "protocol.h"
+#include "server_conn.h"
+#include "server_proto.h"
+#include "server_cred.h"
 
-
-extern int client_sockets[];
 #include <sys/socket.h>   // send() 사용용
 #include <unistd.h>       
 
-// 최대 10명 사용자 이름 저장
-char usernames[MAX_CLIENTS][MAX_NAME] = {0};
+extern void server_log(const char *fmt, ...);
+
+// root 사용자 위치 (conn 이 NULL 이면 없음). 모든 shard 가 공유하므로 root_lock 으로 보호
+static ConnRef root = { NULL, 0, -1, -1 };
+static pthread_mutex_t root_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// root 사용자 socket_fd 저장 (-1이면 없음)
-static int root_fd = -1;
+static bool is_root_conn(const Conn *c) {
+    return c && root.conn == c && root.gen == c->gen;
+}
 
 
 /**
- * users.txt 에서 ID/PW 인증
+ * users.txt 에서 ID/PW 인증 (시작 시 읽어 둔 메모리 인덱스 조회, server_cred.c)
  */
 bool check_login(const char *id, const char *pw) {
-
-    FILE *fp = fopen("./users.txt", "r");  // 실행 경로 무관하게
-    if (!fp) {
-        perror("users.txt open failed");
-        return false;
-    }
-
-    char fid[32], fpw[32];
-
-    while (fscanf(fp, "%s %s", fid, fpw) == 2) {
-        if (strcmp(fid, id) == 0 && strcmp(fpw, pw) == 0) {
-            fclose(fp);
-            return true;
-        }
-    }
-
-    fclose(fp);
-    return false;
+    return cred_check(id, pw);
 }
 /**
  * 로그인 성공한 유저 → socket_fd 에 username 저장
  */
 void register_user(int socket_fd, const char *username) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] == socket_fd) {
-            strncpy(usernames[i], username, MAX_NAME - 1);
-            break;
-        }
-    }
+    Conn *c = conn_by_fd(socket_fd);
+    if (!c) return;
+
+    conn_set_username(c, username);
 }
 /**
  * 서버에서 현재 유저의 username 얻기
  */
 const char* get_username(int socket_fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] == socket_fd) {
-            return usernames[i];
-        }
-    }
-    return NULL;
+    Conn *c = conn_by_fd(socket_fd);
+    return c ? c->username : NULL;
 }
 
 /**
  * root 권한 배정 (가장 먼저 로그인한 사용자)
  */
 void assign_root_if_first(int socket_fd) {
-    if (root_fd == -1) {
-        root_fd = socket_fd;
+    Conn *c = conn_by_fd(socket_fd);
+    if (!c) return;
+
+    bool assigned = false;
+    pthread_mutex_lock(&root_lock);
+    if (!root.conn) {
+        root.conn = c;
+        root.gen = c->gen;
+        root.shard = c->shard;
+        root.fd = c->fd;
+        assigned = true;
+    }
+    pthread_mutex_unlock(&root_lock);
 
+    if (assigned) {
         // root된 사용자에게만 공지 보내기
         Message msg;
         memset(&msg, 0, sizeof(msg));
@@ -77,7 +72,7 @@ void assign_root_if_first(int socket_fd) {
         strcpy(msg.sender, "SERVER");
         strcpy(msg.data, "You are now ROOT user. You can use /kick and /root.");
 
-        send(socket_fd, &msg, sizeof(msg), 0);
+        conn_send_msg_fd(socket_fd, &msg, 0);
     }
 }
 
@@ -86,7 +81,12 @@ void assign_root_if_first(int socket_fd) {
  * root 여부 확인
  */
 bool is_root(int socket_fd) {
-    return socket_fd == root_fd;
+    Conn *c = conn_by_fd(socket_fd);
+
+    pthread_mutex_lock(&root_lock);
+    bool r = is_root_conn(c);
+    pthread_mutex_unlock(&root_lock);
+    return r;
 }
 
 
@@ -95,15 +95,36 @@ bool is_root(int socket_fd) {
  * "/root user2" 같은 커맨드 처리용 (원하면 server_chat에서 연동)
  */
 bool transfer_root(const char *target_username) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (strcmp(usernames[i], target_username) == 0) {
-            root_fd = client_sockets[i];
-            printf("[SERVER] 🔑 Root permission transferred to %s\n", target_username);
-            return true;
-        }
+    // 로그인한 (username 인덱스에 있는) 연결만 대상. 다른 shard 의 사용자일 수 있다.
+    // 조회와 교체를 root_lock 안에서 하므로, 대상이 그 사이 나가더라도
+    // 그 연결의 auth_on_disconnect 가 뒤이어 root 를 비운다.
+    pthread_mutex_lock(&root_lock);
+    ConnRef ref;
+    bool found = conn_lookup(target_username, &ref);
+    if (found) root = ref;
+    pthread_mutex_unlock(&root_lock);
+    if (!found) return false;
+
+    printf("[SERVER] 🔑 Root permission transferred to %s\n", target_username);
+    return true;
+}
+/**
+ * 연결 종료 시 호출: root 가 나가면 root 를 비운다
+ * (fd 번호가 재사용되어 새 연결이 root 를 물려받는 일이 없도록. 다음 로그인 사용자가 root 가 됨)
+ */
+void auth_on_disconnect(int socket_fd) {
+    Conn *c = conn_by_fd(socket_fd);
+
+    pthread_mutex_lock(&root_lock);
+    bool was_root = is_root_conn(c);
+    if (was_root) root.conn = NULL;
+    pthread_mutex_unlock(&root_lock);
+
+    if (was_root) {
+        server_log("root user left (socket %d), next login becomes root", socket_fd);
     }
-    return false;
 }
+
 bool can_kick(int requester_fd) {
     // 지금 구조에서는 root만 kick 가능하게
     return is_root(requester_fd);
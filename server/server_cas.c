@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "server_file.h"
+#include "server_cas.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 디스크 배치
+ *   .chunks/<해시 앞 2자리>/<해시 64자리>   청크 본문
+ *   .manifests/<파일명>                     "size N\nchunk N\n" + 청크 해시 한 줄에 하나
+ * 청크/매니페스트 모두 임시 파일에 쓴 뒤 rename() 으로 들여놓는다.
+ *
+ * 참조 규칙
+ *  - 매니페스트가 가진 청크마다 +1, 업로드 세션이 확인/저장한 청크마다 +1 (commit 때 매니페스트로 넘어감)
+ *  - 매니페스트가 놓아서 0 이 되면 바로 지운다.
+ *  - 세션이 취소되어 0 이 된 청크는 남겨 둔다. 같은 파일을 다시 올리면 그대로 재사용되고
+ *    (이어받기), 끝내 아무도 안 쓰면 다음 시작 때 정리된다.
+ */
+
+#define NAME_BUCKETS 1024
+
+typedef struct ChunkEntry {
+    struct ChunkEntry *next;
+    CasHash hash;
+    long    refs;
+} ChunkEntry;
+
+typedef struct NameEntry {
+    struct NameEntry *next;
+    uint64_t     hash;
+    CasManifest *m;
+} NameEntry;
+
+static ChunkEntry    **chunks = NULL;
+static size_t          chunk_buckets = 0;
+static size_t          chunk_count = 0;
+static NameEntry      *names[NAME_BUCKETS];
+static pthread_mutex_t cas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t name_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;     // FNV-1a 64bit
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// 청크 해시는 이미 고르게 퍼져 있으므로 앞 8바이트를 그대로 버킷 번호로 쓴다
+static size_t chunk_bucket(const CasHash hash, size_t nbuckets) {
+    uint64_t k;
+    memcpy(&k, hash, sizeof(k));
+    return (size_t)(k & (nbuckets - 1));
+}
+
+static void chunk_path(const CasHash hash, char *out, size_t size) {
+    char hex[2 * BLAKE3_OUT_LEN + 1];
+    blake3_to_hex(hash, hex);
+    snprintf(out, size, "%s%.2s/%s", CAS_CHUNK_DIR, hex, hex);
+}
+
+/* ---------- 청크 목록 (cas_lock 안에서) ---------- */
+
+static ChunkEntry **chunk_find(const CasHash hash) {
+    if (chunk_buckets == 0) return NULL;
+    ChunkEntry **pp = &chunks[chunk_bucket(hash, chunk_buckets)];
+    while (*pp && memcmp((*pp)->hash, hash, sizeof(CasHash)) != 0) pp = &(*pp)->next;
+    return pp;
+}
+
+static int chunk_table_grow(void) {
+    size_t n = chunk_buckets ? chunk_buckets * 2 : 4096;
+    ChunkEntry **t = calloc(n, sizeof(ChunkEntry *));
+    if (!t) return -1;
+
+    for (size_t b = 0; b < chunk_buckets; b++) {
+        ChunkEntry *e = chunks[b];
+        while (e) {
+            ChunkEntry *next = e->next;
+            size_t nb = chunk_bucket(e->hash, n);
+            e->next = t[nb];
+            t[nb] = e;
+            e = next;
+        }
+    }
+    free(chunks);
+    chunks = t;
+    chunk_buckets = n;
+    return 0;
+}
+
+// 참조 +1 (없으면 만든다)
+static int chunk_ref(const CasHash hash) {
+    ChunkEntry **pp = chunk_find(hash);
+    if (pp && *pp) {
+        (*pp)->refs++;
+        return 0;
+    }
+
+    if (chunk_count >= chunk_buckets && chunk_table_grow() < 0) return -1;
+    ChunkEntry *e = malloc(sizeof(ChunkEntry));
+    if (!e) return -1;
+    memcpy(e->hash, hash, sizeof(CasHash));
+    e->refs = 1;
+
+    ChunkEntry **head = &chunks[chunk_bucket(hash, chunk_buckets)];
+    e->next = *head;
+    *head = e;
+    chunk_count++;
+    return 0;
+}
+
+// 참조 -1. drop 이면 0 이 될 때 파일까지 지운다.
+static void chunk_unref(const CasHash hash, int drop) {
+    ChunkEntry **pp = chunk_find(hash);
+    if (!pp || !*pp) return;
+
+    ChunkEntry *e = *pp;
+    if (e->refs > 0) e->refs--;
+    if (e->refs > 0 || !drop) return;
+
+    char path[512];
+    chunk_path(hash, path, sizeof(path));
+    if (unlink(path) < 0 && errno != ENOENT)
+        server_log("CAS: unlink(%s) failed (errno=%d)", path, errno);
+
+    *pp = e->next;
+    free(e);
+    chunk_count--;
+}
+
+/* ---------- 매니페스트 ---------- */
+
+static NameEntry **name_find(const char *name, uint64_t h) {
+    NameEntry **pp = &names[h & (NAME_BUCKETS - 1)];
+    while (*pp && ((*pp)->hash != h || strcmp((*pp)->m->name, name) != 0))
+        pp = &(*pp)->next;
+    return pp;
+}
+
+static void manifest_free(CasManifest *m) {
+    free(m->hashes);
+    free(m);
+}
+
+// 참조 -1, 마지막이면 청크 참조도 놓는다 (cas_lock 안에서)
+static void manifest_put(CasManifest *m) {
+    if (--m->refs > 0) return;
+    for (int i = 0; i < m->nchunks; i++) chunk_unref(m->hashes[i], 1);
+    manifest_free(m);
+}
+
+static CasManifest *manifest_new(const char *name, long size, long chunk_size, int nchunks) {
+    CasManifest *m = calloc(1, sizeof(CasManifest));
+    if (!m) return NULL;
+    m->hashes = malloc(sizeof(CasHash) * (size_t)nchunks);
+    if (!m->hashes) {
+        free(m);
+        return NULL;
+    }
+    m->refs = 1;
+    m->size = size;
+    m->chunk_size = chunk_size;
+    m->nchunks = nchunks;
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    return m;
+}
+
+long cas_chunk_len(const CasManifest *m, int idx) {
+    if (idx < m->nchunks - 1) return m->chunk_size;
+    return m->size - (long)(m->nchunks - 1) * m->chunk_size;
+}
+
+static CasManifest *manifest_load(const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", CAS_MANIFEST_DIR, name);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+
+    long size, chunk_size;
+    CasManifest *m = NULL;
+    if (fscanf(fp, "size %ld chunk %ld", &size, &chunk_size) == 2 &&
+        size > 0 && chunk_size > 0) {
+        m = manifest_new(name, size, chunk_size, (int)((size + chunk_size - 1) / chunk_size));
+    }
+
+    char hex[2 * BLAKE3_OUT_LEN + 2];
+    for (int i = 0; m && i < m->nchunks; i++) {
+        if (fscanf(fp, "%65s", hex) != 1 || blake3_from_hex(hex, m->hashes[i]) < 0) {
+            manifest_free(m);
+            m = NULL;
+        }
+    }
+    if (m && fscanf(fp, "%65s", hex) == 1) {    // 뒤에 남는 줄이 있으면 깨진 것
+        manifest_free(m);
+        m = NULL;
+    }
+    fclose(fp);
+    return m;
+}
+
+// 청크 파일이 모두 제 크기로 있는지 (rename 은 됐는데 내용이 디스크에 안 남은 경우 등)
+static int manifest_intact(const CasManifest *m) {
+    for (int i = 0; i < m->nchunks; i++) {
+        char path[512];
+        struct stat st;
+        chunk_path(m->hashes[i], path, sizeof(path));
+        if (stat(path, &st) < 0 || st.st_size != cas_chunk_len(m, i)) return 0;
+    }
+    return 1;
+}
+
+static void name_insert(CasManifest *m) {
+    NameEntry *n = malloc(sizeof(NameEntry));
+    if (!n) {
+        manifest_put(m);
+        return;
+    }
+    n->hash = name_hash(m->name);
+    n->m = m;
+    NameEntry **head = &names[n->hash & (NAME_BUCKETS - 1)];
+    n->next = *head;
+    *head = n;
+}
+
+/* ---------- 시작 시 복원 ---------- */
+
+static int is_tmp_name(const char *name) {
+    return strncmp(name, ".tmp.", 5) == 0;
+}
+
+static int load_manifests(void) {
+    DIR *dir = opendir(CAS_MANIFEST_DIR);
+    if (!dir) return -1;
+
+    int loaded = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        char path[512];
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s%s", CAS_MANIFEST_DIR, de->d_name);
+        if (is_tmp_name(de->d_name)) {
+            unlink(path);                           // 쓰다 만 매니페스트
+            continue;
+        }
+
+        CasManifest *m = manifest_load(de->d_name);
+        if (!m || !manifest_intact(m)) {
+            server_log("CAS: dropping broken manifest %s", de->d_name);
+            if (m) manifest_free(m);
+            unlink(path);
+            continue;
+        }
+        for (int i = 0; i < m->nchunks; i++) chunk_ref(m->hashes[i]);
+        name_insert(m);
+        loaded++;
+    }
+    closedir(dir);
+    return loaded;
+}
+
+// 어떤 매니페스트도 참조하지 않는 청크 파일 삭제
+static long sweep_chunks(void) {
+    DIR *top = opendir(CAS_CHUNK_DIR);
+    if (!top) return 0;
+
+    long removed = 0;
+    struct dirent *de;
+    while ((de = readdir(top)) != NULL) {
+        char sub[512];
+        snprintf(sub, sizeof(sub), "%s%s", CAS_CHUNK_DIR, de->d_name);
+        if (is_tmp_name(de->d_name)) {
+            unlink(sub);
+            continue;
+        }
+        if (de->d_name[0] == '.' || strlen(de->d_name) != 2) continue;
+
+        DIR *dir = opendir(sub);
+        if (!dir) continue;
+        struct dirent *ce;
+        while ((ce = readdir(dir)) != NULL) {
+            if (ce->d_name[0] == '.') continue;
+
+            CasHash hash;
+            ChunkEntry **pp = NULL;
+            if (blake3_from_hex(ce->d_name, hash) == 0) pp = chunk_find(hash);
+            if (pp && *pp) continue;
+
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", sub, ce->d_name);
+            if (unlink(path) == 0) removed++;
+        }
+        closedir(dir);
+    }
+    closedir(top);
+    return removed;
+}
+
+/**
+ * 매니페스트를 읽어 이름/청크 목록을 만들고, 참조 없는 청크를 지운다 (스레드 시작 전)
+ */
+int cas_init(void) {
+    if ((mkdir(CAS_CHUNK_DIR, 0755) < 0 && errno != EEXIST) ||
+        (mkdir(CAS_MANIFEST_DIR, 0755) < 0 && errno != EEXIST)) {
+        perror("cas storage");
+        return -1;
+    }
+    if (chunk_table_grow() < 0) return -1;
+
+    int files = load_manifests();
+    if (files < 0) {
+        perror("cas manifests");
+        return -1;
+    }
+    long removed = sweep_chunks();
+
+    server_log("CAS: %d files, %zu chunks (%ld unreferenced removed, blake3=%s)",
+               files, chunk_count, removed, blake3_impl_name());
+    return 0;
+}
+
+/* ---------- 업로드 ---------- */
+
+/**
+ * 이미 있는 청크면 참조를 잡고 1 (본문을 받을 필요 없음)
+ */
+int cas_chunk_pin(const CasHash hash) {
+    pthread_mutex_lock(&cas_lock);
+    ChunkEntry **pp = chunk_find(hash);
+    int have = pp && *pp;
+    if (have) (*pp)->refs++;
+    pthread_mutex_unlock(&cas_lock);
+    return have;
+}
+
+void cas_chunk_unpin(const CasHash hash) {
+    pthread_mutex_lock(&cas_lock);
+    chunk_unref(hash, 0);
+    pthread_mutex_unlock(&cas_lock);
+}
+
+/**
+ * 해시가 확인된 청크 본문을 저장하고 참조를 잡는다
+ * 같은 청크를 두 연결이 동시에 올려도 내용이 같으므로 나중 rename 이 덮어쓸 뿐이다.
+ */
+int cas_chunk_store(const CasHash hash, const void *buf, size_t len) {
+    char path[512], tmp[512];
+    chunk_path(hash, path, sizeof(path));
+
+    // 해시 앞 2자리 디렉토리
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        server_log("CAS: mkdir(%s) failed (errno=%d)", path, errno);
+        return -1;
+    }
+    *slash = '/';
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp.XXXXXX", CAS_CHUNK_DIR);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        server_log("CAS: mkstemp failed (errno=%d)", errno);
+        return -1;
+    }
+
+    const char *p = buf;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            server_log("CAS: write(%s) failed (errno=%d)", tmp, errno);
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        p += w;
+        left -= (size_t)w;
+    }
+    close(fd);
+
+    pthread_mutex_lock(&cas_lock);
+    int rc = rename(tmp, path);
+    if (rc == 0) rc = chunk_ref(hash);
+    pthread_mutex_unlock(&cas_lock);
+
+    if (rc < 0) {
+        server_log("CAS: storing chunk %s failed (errno=%d)", path, errno);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int manifest_write(const CasManifest *m, char *tmp, size_t size) {
+    snprintf(tmp, size, "%s.tmp.XXXXXX", CAS_MANIFEST_DIR);
+    int fd = mkstemp(tmp);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp);
+        }
+        return -1;
+    }
+
+    fprintf(fp, "size %ld\nchunk %ld\n", m->size, m->chunk_size);
+    for (int i = 0; i < m->nchunks; i++) {
+        char hex[2 * BLAKE3_OUT_LEN + 1];
+        blake3_to_hex(m->hashes[i], hex);
+        fprintf(fp, "%s\n", hex);
+    }
+    if (fclose(fp) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 업로드가 끝난 파일의 매니페스트를 기록하고 이름을 새 내용으로 바꾼다
+ * hashes 의 청크 참조는 (성공/실패 모두) 이 함수가 넘겨받는다.
+ * 같은 이름의 이전 내용(매니페스트 또는 일반 파일)은 지운다.
+ */
+int cas_commit(const char *name, long size, long chunk_size, int nchunks,
+               const CasHash *hashes) {
+    char tmp[512], path[512];
+    CasManifest *m = manifest_new(name, size, chunk_size, nchunks);
+    if (m) memcpy(m->hashes, hashes, sizeof(CasHash) * (size_t)nchunks);
+
+    if (!m || manifest_write(m, tmp, sizeof(tmp)) < 0) {
+        server_log("CAS: writing manifest for %s failed (errno=%d)", name, errno);
+        pthread_mutex_lock(&cas_lock);
+        for (int i = 0; i < nchunks; i++) chunk_unref(hashes[i], 0);
+        pthread_mutex_unlock(&cas_lock);
+        if (m) manifest_free(m);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s%s", CAS_MANIFEST_DIR, name);
+
+    pthread_mutex_lock(&cas_lock);
+    if (rename(tmp, path) < 0) {
+        server_log("CAS: rename(%s -> %s) failed (errno=%d)", tmp, path, errno);
+        for (int i = 0; i < nchunks; i++) chunk_unref(hashes[i], 0);
+        pthread_mutex_unlock(&cas_lock);
+        unlink(tmp);
+        manifest_free(m);
+        return -1;
+    }
+
+    NameEntry **pp = name_find(name, name_hash(name));
+    if (*pp) {
+        CasManifest *old = (*pp)->m;
+        (*pp)->m = m;
+        manifest_put(old);          // 내려받는 중이면 끝날 때 해제
+    } else {
+        name_insert(m);
+    }
+    pthread_mutex_unlock(&cas_lock);
+
+    // 예전에 일반 업로드로 올라간 같은 이름의 파일
+    snprintf(path, sizeof(path), "%s%s", STORAGE_DIR, name);
+    unlink(path);
+    return 0;
+}
+
+int cas_remove(const char *name) {
+    pthread_mutex_lock(&cas_lock);
+    NameEntry **pp = name_find(name, name_hash(name));
+    NameEntry *n = *pp;
+    if (n) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s%s", CAS_MANIFEST_DIR, name);
+        unlink(path);
+
+        *pp = n->next;
+        manifest_put(n->m);
+        free(n);
+    }
+    pthread_mutex_unlock(&cas_lock);
+    return n != NULL;
+}
+
+/* ---------- 다운로드 ---------- */
+
+CasManifest *cas_lookup(const char *name) {
+    pthread_mutex_lock(&cas_lock);
+    NameEntry *n = *name_find(name, name_hash(name));
+    CasManifest *m = n ? n->m : NULL;
+    if (m) m->refs++;
+    pthread_mutex_unlock(&cas_lock);
+    return m;
+}
+
+void cas_release(CasManifest *m) {
+    pthread_mutex_lock(&cas_lock);
+    manifest_put(m);
+    pthread_mutex_unlock(&cas_lock);
+}
+
+int cas_open_chunk(const CasManifest *m, int idx) {
+    char path[512];
+    chunk_path(m->hashes[idx], path, sizeof(path));
+    return open(path, O_RDONLY);
+}
@@ -0,0 +1,47 @@
+#ifndef SERVER_CAS_H
+#define SERVER_CAS_H
+
+#include <stdint.h>
+#include "blake3.h"
+
+/*
+ * 내용 주소 청크 저장소 (중복 제거)
+ *  - 파일을 CAS_CHUNK_SIZE 단위로 잘라 BLAKE3 해시를 이름으로 한 번만 저장한다.
+ *  - 파일 이름 → 매니페스트(크기 + 청크 해시 목록). 청크는 매니페스트가 참조하는 수만큼 refcount.
+ *  - 같은 내용을 다시 올리면 해시만 주고받고 본문은 보내지 않는다.
+ */
+
+#define CAS_CHUNK_SIZE (1024 * 1024)
+#define CAS_CHUNK_DIR    STORAGE_DIR ".chunks/"
+#define CAS_MANIFEST_DIR STORAGE_DIR ".manifests/"
+
+typedef uint8_t CasHash[BLAKE3_OUT_LEN];
+
+typedef struct CasManifest {
+    int      refs;              // 이름 목록 1 + 내려받는 중인 연결 수 (cas_lock)
+    long     size;
+    long     chunk_size;
+    int      nchunks;
+    CasHash *hashes;
+    char     name[256];
+} CasManifest;
+
+int  cas_init(void);            // 매니페스트 읽기 + 참조 없는 청크 정리 (스레드 시작 전)
+
+// 청크 (업로드 세션이 잡는 참조)
+int  cas_chunk_pin(const CasHash hash);                         // 있으면 참조 +1 하고 1
+int  cas_chunk_store(const CasHash hash, const void *buf, size_t len);   // 기록 + 참조 +1
+void cas_chunk_unpin(const CasHash hash);                       // 세션 취소: 청크 파일은 남김
+
+// 이름
+int  cas_commit(const char *name, long size, long chunk_size, int nchunks,
+                const CasHash *hashes);     // 세션의 청크 참조를 매니페스트가 넘겨받는다
+int  cas_remove(const char *name);          // 1: 지움 (일반 파일로 다시 올림 / TTL 만료)
+
+// 다운로드
+CasManifest *cas_lookup(const char *name);  // 참조 +1, 없으면 NULL
+void cas_release(CasManifest *m);
+int  cas_open_chunk(const CasManifest *m, int idx);
+long cas_chunk_len(const CasManifest *m, int idx);
+
+#endif
@@ -8,13 +8,17 @@
 #include "../common/protocol.h"
 #include "server_auth.h"   // is_root, can_kick, transfer_root, get_username 등
 #include "server_user_list.h"  // disconnect_client 등
+#include "server_conn.h"
+#include "server_proto.h"
+#include "server_shard.h"
+#include "server_metrics.h"
+#include "server_history.h"
+#include "server_msglog.h"
+#include "server_room.h"
+#include "server_spool.h"
+#include "server_cred.h"
 
-extern int client_sockets[];
-extern char usernames[][MAX_NAME];
 extern void server_log(const char *fmt, ...);
-extern void disconnect_client(int idx);   // server_main / user_list 쪽에서 구현됨
-
-#define MAX_CLIENTS 10
 
 
 /**
@@ -32,73 +36,328 @@ void send_text(int client_fd, const char *sender, const char *text) {
     strncpy(msg.data, text, sizeof(msg.data) - 1);
     msg.data[sizeof(msg.data) - 1] = '\0';
 
-    send(client_fd, &msg, sizeof(msg), 0);
+    conn_send_msg_fd(client_fd, &msg, 0);
 }
 
 
 /**
- *  전체 사용자에게 메시지 전송 (sender 제외)
+ *  list 의 로그인한 연결들에게 전송 (exclude_fd 제외)
+ *  room 의 기록 링에 hist_seq 보다 늦게 들어온 연결은 이 메시지를 기록 조회로 받으므로 건너뛴다.
+ *  (다른 shard 에서 온 메시지가 메일박스에 있는 사이 로그인하거나 방에 들어온 경우)
+ *  반환: 큐에 넣은 수신자 수
  */
-void broadcast(int sender_fd, Message *msg, int max_clients) {
-    for (int i = 0; i < max_clients; i++) {
-        int sd = client_sockets[i];
-
-        if (sd > 0 && sd != sender_fd) {
-            int sent = send(sd, msg, sizeof(Message), 0);
-
-            if (sent < 0) {
-                server_log("Fail Send: socket %d", sd);
-                close(sd);
-                client_sockets[i] = 0;
-            }
-        }
+static int fanout(Conn **list, int count, const Message *msg, int room, uint64_t hist_seq,
+                  uint32_t sender_id, int exclude_fd, int flags) {
+    // 프레임은 한 번만 인코딩하고 모든 수신자 큐가 같은 버퍼를 참조한다
+    OutMessage om;
+    outmsg_init(&om, msg, sender_id, FRAME_ID_NONE);
+    uint64_t start = metrics_now_ns();
+    int recipients = 0;
+
+    // 전송 실패 시 배열에서 제거되므로 뒤에서부터 순회
+    for (int i = count - 1; i >= 0; i--) {
+        Conn *c = list[i];
+
+        if (!c->authed || c->fd == exclude_fd) continue;
+        if (c->room == room && c->hist_seq > hist_seq) continue;
+
+        conn_send_outmsg(c, &om, flags);
+        recipients++;
     }
+
+    outmsg_release(&om);
+
+    metric_add(M_BROADCASTS, 1);
+    metric_add(M_BROADCAST_RECIPIENTS, recipients);
+    metric_observe(H_BROADCAST_FANOUT, metrics_now_ns() - start);
+    return recipients;
 }
 
+/**
+ *  전체 사용자에게 메시지 전송 (sender 제외): 강퇴 / root 이전 같은 서버 공지
+ *  로그인 전 연결은 프로토콜 버전도 모르고 로그인 응답을 기다리는 중이므로 제외
+ *  다른 shard 의 사용자는 그 shard 의 메일박스를 거쳐 전달된다.
+ *  나중에 접속한 사용자가 볼 수 있도록 로비 채팅 기록에도 남긴다.
+ *  (영구 로그는 링에 복사만 하고 디스크 기록은 writer 스레드가 한다)
+ */
+void broadcast(int sender_fd, Message *msg) {
+    uint32_t sender_id = conn_wire_id(conn_by_fd(sender_fd));
+    uint64_t seq = history_append(&history_lobby, msg);
+    msglog_append(msg);
+
+    // 느린 클라이언트 때문에 다른 사용자가 기다리지 않도록 큐에만 넣음
+    fanout(conn_active, conn_active_count, msg, ROOM_LOBBY, seq, sender_id, sender_fd, OUTQ_DROPPABLE);
+    shard_broadcast_remote(msg, seq, sender_id, OUTQ_DROPPABLE);
+}
 
-/* ===================== root 권한 명령 ===================== */
+/**
+ *  채팅을 보낸 사람이 들어가 있는 방의 멤버에게만 전송
+ *  이 shard 멤버는 바로, 다른 shard 는 그 방 멤버가 있는 shard 에만 메일을 보낸다.
+ *  로비가 아닌 방의 채팅은 target 에 방 이름을 담는다. (영구 로그에서 방 구분)
+ */
+void room_chat(Conn *c, Message *msg) {
+    int room = c->room >= 0 ? c->room : ROOM_LOBBY;
+    Room *r = &rooms[room];
+
+    if (room != ROOM_LOBBY) memcpy(msg->target, r->name, MAX_NAME);
+    uint64_t seq = history_append(r->hist, msg);
+    msglog_append(msg);
+
+    uint32_t sender_id = conn_wire_id(c);
+    RoomMembers *m = room_local(room);
+    int recipients = fanout(m->conns, m->count, msg, room, seq, sender_id, c->fd, OUTQ_DROPPABLE);
+
+    atomic_fetch_add_explicit(&r->msgs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&r->recipients, recipients, memory_order_relaxed);
+
+    Mail tmpl = { .type = MAIL_ROOM, .room = room, .target_gen = r->gen,
+                  .sender_id = sender_id, .flags = OUTQ_DROPPABLE };
+    shard_multicast(atomic_load(&r->shard_mask), &tmpl, msg, seq);
+}
+
+static void send_history_entry(uint64_t seq, int type, const char *sender,
+                               const char *body, size_t len, void *arg) {
+    Conn *c = arg;
+    Message m;
+    memset(&m, 0, sizeof(m));
+    (void)seq;
+    (void)type;
+
+    m.type = MSG_HISTORY;
+    memcpy(m.sender, sender, strnlen(sender, MAX_NAME - 1));
+    memcpy(m.data, body, len);
+    conn_send_msg(c, &m, 0);
+}
+
+/**
+ *  채팅 기록 페이지 요청 (data = "before count")
+ *  기록마다 MSG_HISTORY 하나, 끝에 MSG_HISTORY_END "first_seq more".
+ *  지금 들어가 있는 방의 기록. before 가 0 이면 방에 들어온 시점 이전부터
+ *  (그 뒤 메시지는 실시간으로 이미 받고 있다)
+ */
+void handle_history_request(Conn *c, Message *msg) {
+    unsigned long long before = 0;
+    int count = HISTORY_PAGE_MAX;
+
+    if (!c->authed || c->room < 0) return;
+    sscanf(msg->data, "%llu %d", &before, &count);
+    if (before == 0 || before > c->hist_seq) before = c->hist_seq;
+
+    uint64_t first;
+    int more;
+    history_page(rooms[c->room].hist, before, count, send_history_entry, c, &first, &more);
+
+    Message end;
+    memset(&end, 0, sizeof(end));
+    end.type = MSG_HISTORY_END;
+    strcpy(end.sender, "SERVER");
+    snprintf(end.data, sizeof(end.data), "%llu %d", (unsigned long long)first, more);
+    conn_send_msg(c, &end, 0);
+}
+
+/**
+ *  보관하지 못한 DM 에 대한 MSG_DM_FAIL (바로 보낼 때와 배달 중에 끊겼을 때 같은 문구)
+ */
+void dm_fail_init(Message *err, const char *target, SpoolResult sr) {
+    memset(err, 0, sizeof(*err));
+    err->type = MSG_DM_FAIL;
+    strcpy(err->sender, "SERVER");
+    if (sr == SPOOL_FULL)       strcpy(err->data, "User's mailbox is full.");
+    else if (sr == SPOOL_ERROR) strcpy(err->data, "Could not keep the message. Try again later.");
+    else if (cred_exists(target)) strcpy(err->data, "User is offline.");
+    else                        strcpy(err->data, "User not found.");
+}
+
+/**
+ *  배달 중에 끊긴 DM 을 보관하지도 못했으면 보낸 사람에게 알린다 (보낸 사람의 shard 에서 전달)
+ */
+static void dm_notify_fail(const Message *dm, SpoolResult sr) {
+    ConnRef ref;
+    if (!conn_lookup(dm->sender, &ref)) return;     // 보낸 사람도 나갔으면 알릴 곳이 없다
+
+    Message err;
+    dm_fail_init(&err, dm->target, sr);
+
+    SharedMsg *sm = shared_msg_new(&err, 1);
+    Mail *mail = sm ? mail_new(MAIL_DM, sm) : NULL;
+    if (!mail) {
+        shared_msg_unref(sm);
+        return;
+    }
+    mail->target = ref.conn;
+    mail->target_gen = ref.gen;
+    mail->sender_id = FRAME_ID_NONE;
+    mail->target_id = conn_ref_wire_id(&ref);
+    shard_post(ref.shard, mail);
+}
+
+/**
+ *  배달 중에 받는 사람이 끊긴 DM: 보관함에 넣고, 그 사이 다시 접속했으면 새 위치로 보낸다
+ */
+static void dm_redeliver(Mail *m) {
+    ConnRef ref;
+    SpoolResult sr = spool_put(&m->msg->msg, &ref);
+    if (sr == SPOOL_STORED) return;
+    if (sr != SPOOL_ONLINE) {
+        dm_notify_fail(&m->msg->msg, sr);
+        return;
+    }
+
+    SharedMsg *sm = shared_msg_new(&m->msg->msg, 1);
+    Mail *mail = sm ? mail_new(MAIL_DM, sm) : NULL;
+    if (!mail) {
+        shared_msg_unref(sm);
+        dm_notify_fail(&m->msg->msg, SPOOL_ERROR);
+        return;
+    }
+    mail->target = ref.conn;
+    mail->target_gen = ref.gen;
+    mail->sender_id = m->sender_id;
+    mail->target_id = conn_ref_wire_id(&ref);
+    shard_post(ref.shard, mail);
+}
 
 /**
- * username → client_sockets[] 인덱스 찾기
+ *  다른 shard 에서 온 작업 처리 (shard_drain 에서 호출)
+ *  대상 연결은 보낸 뒤에 끊기거나 슬롯이 재사용됐을 수 있으므로 gen 으로 확인한다.
  */
-static int find_client_index_by_username(const char *name) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0 &&
-            strcmp(usernames[i], name) == 0) {
-            return i;
+void mail_deliver(Mail *m) {
+    Conn *t = m->target;
+
+    switch (m->type) {
+    case MAIL_BROADCAST:
+        fanout(conn_active, conn_active_count, &m->msg->msg, ROOM_LOBBY, m->msg->hist_seq,
+               m->sender_id, -1, m->flags);
+        break;
+
+    case MAIL_ROOM: {
+        // 보낸 뒤 방이 정리되어 다른 방이 됐으면 버린다
+        Room *r = &rooms[m->room];
+        if (r->gen != m->target_gen) break;
+        RoomMembers *rm = room_local(m->room);
+        int n = fanout(rm->conns, rm->count, &m->msg->msg, m->room, m->msg->hist_seq,
+                       m->sender_id, -1, m->flags);
+        atomic_fetch_add_explicit(&r->recipients, n, memory_order_relaxed);
+        break;
+    }
+
+    case MAIL_DM:
+        if (t && t->fd >= 0 && t->gen == m->target_gen && t->authed) {
+            OutMessage om;
+            outmsg_init(&om, &m->msg->msg, m->sender_id, m->target_id);
+            conn_send_outmsg(t, &om, m->flags);
+            outmsg_release(&om);
+        } else if (m->msg->msg.type == MSG_DM) {
+            dm_redeliver(m);                // 실패 알림(MSG_DM_FAIL)은 받을 사람이 없으면 버린다
+        }
+        break;
+
+    case MAIL_KICK:
+        if (t && t->fd >= 0 && t->gen == m->target_gen) {
+            send_text(t->fd, "SERVER", "You have been kicked by root.");
+            disconnect_client(t);
         }
+        break;
     }
-    return -1;
 }
 
 
+/* ===================== root 권한 명령 ===================== */
+
 /**
  * root가 특정 유저 강퇴
  */
 static bool kick_user_by_name(const char *target_username) {
-    int idx = find_client_index_by_username(target_username);
-    if (idx < 0) {
+    ConnRef ref;
+    if (!conn_lookup(target_username, &ref)) {
         return false;
     }
 
-    int fd = client_sockets[idx];
+    if (ref.shard == shard_id) {
+        Conn *c = ref.conn;
+        if (c->gen != ref.gen) return false;
 
-    send_text(fd, "SERVER", "You have been kicked by root.");
-
-    disconnect_client(idx);
+        send_text(c->fd, "SERVER", "You have been kicked by root.");
+        disconnect_client(c);
+    } else {
+        // 다른 shard 의 사용자: 그 shard 가 직접 끊는다
+        Mail *mail = mail_new(MAIL_KICK, NULL);
+        if (!mail) return false;
+        mail->target = ref.conn;
+        mail->target_gen = ref.gen;
+        shard_post(ref.shard, mail);
+    }
 
     server_log("[SERVER] %s has been kicked.", target_username);
     return true;
 }
 
 
+/* ===================== 채팅방 명령 ===================== */
+
+/**
+ * 방을 옮긴 뒤 클라이언트에게 알림 (클라이언트는 이걸 받고 그 방 기록을 조회한다)
+ */
+static void send_room(Conn *c) {
+    Message m;
+    memset(&m, 0, sizeof(m));
+    m.type = MSG_ROOM;
+    strcpy(m.sender, "SERVER");
+    memcpy(m.data, rooms[c->room].name, MAX_NAME);
+    conn_send_msg(c, &m, 0);
+}
+
+/**
+ * /join <방> /leave /rooms. 처리했으면 true (root 가 아니어도 쓸 수 있다)
+ */
+static bool handle_room_command(Conn *c, const char *text) {
+    char buf[MAX_BUF / 2];
+
+    if (strncmp(text, "/join ", 6) == 0) {
+        int room = room_join(c, text + 6);
+        if (room == -1) {
+            send_text(c->fd, "SERVER", "Room names use letters, digits, '_' and '-' (up to 19 chars).");
+        } else if (room < 0) {
+            send_text(c->fd, "SERVER", "Too many rooms. Try again later.");
+        } else {
+            server_log("채팅방 입장: %s → %s", c->username, rooms[room].name);
+            send_room(c);
+        }
+        return true;
+    }
+    if (strcmp(text, "/leave") == 0) {
+        if (c->room == ROOM_LOBBY) {
+            send_text(c->fd, "SERVER", "You are already in the lobby.");
+        } else if (room_enter(c, ROOM_LOBBY) >= 0) {
+            send_room(c);
+        }
+        return true;
+    }
+    if (strcmp(text, "/rooms") == 0) {
+        RoomStat list[MAX_ROOMS];
+        int n = room_list(list, MAX_ROOMS);
+        size_t len = snprintf(buf, sizeof(buf), "Rooms (%d):", n);
+        for (int i = 0; i < n && len < sizeof(buf); i++) {
+            len += snprintf(buf + len, sizeof(buf) - len, "\n  %s%s (%d)",
+                            list[i].name, strcmp(list[i].name, rooms[c->room].name) == 0 ? " *" : "",
+                            list[i].members);
+        }
+        send_text(c->fd, "SERVER", buf);
+        return true;
+    }
+    return false;
+}
+
+
 /**
- * 슬래시(/) 명령 처리: /kick /root 등
+ * 슬래시(/) 명령 처리: /kick /root /stats 등
  */
 static void handle_command(int sender_fd,
                            const char *sender_name,
-                           const char *text,
-                           int max_clients) {
+                           const char *text) {
+
+    Conn *c = conn_by_fd(sender_fd);
+    if (c && c->authed && handle_room_command(c, text)) return;
 
     if (!can_kick(sender_fd)) {
         send_text(sender_fd, "SERVER",
@@ -121,12 +380,18 @@ static void handle_command(int sender_fd,
             strncpy(msg.sender, "SERVER", sizeof(msg.sender) - 1);
             strncpy(msg.data, buf, sizeof(msg.data) - 1);
 
-            broadcast(sender_fd, &msg, max_clients);
+            broadcast(sender_fd, &msg);
 
         } else {
             send_text(sender_fd, "SERVER", "No such user.");
         }
     }
+    else if (strcmp(text, "/stats") == 0) {
+        // 모든 reactor 스레드의 지표를 합산한 요약
+        char buf[MAX_BUF / 2];
+        metrics_format_summary(buf, sizeof(buf));
+        send_text(sender_fd, "SERVER", buf);
+    }
     else if (strncmp(text, "/root ", 6) == 0) {
         const char *target = text + 6;
 
@@ -142,7 +407,7 @@ static void handle_command(int sender_fd,
             strncpy(msg.sender, "SERVER", sizeof(msg.sender) - 1);
             strncpy(msg.data, buf, sizeof(msg.data) - 1);
 
-            broadcast(sender_fd, &msg, max_clients);
+            broadcast(sender_fd, &msg);
         }
         else {
             send_text(sender_fd, "SERVER",
@@ -158,15 +423,17 @@ static void handle_command(int sender_fd,
 /**
  * Chat 메시지 처리:
  * - "/" 로 시작하면 명령
- * - 아니면 일반 채팅
+ * - 아니면 일반 채팅 (들어가 있는 방에만)
  */
-void handle_chat_message(int sender_fd, Message *msg, int max_clients) {
+void handle_chat_message(int sender_fd, Message *msg) {
     const char *sender_name = get_username(sender_fd);
     if (!sender_name) sender_name = "UNKNOWN";
 
+    Conn *c = conn_by_fd(sender_fd);
+
     if (msg->type == MSG_CHAT && msg->data[0] == '/') {
-        handle_command(sender_fd, sender_name, msg->data, max_clients);
-    } else {
-        broadcast(sender_fd, msg, max_clients);
+        handle_command(sender_fd, sender_name, msg->data);
+    } else if (c) {
+        room_chat(c, msg);
     }
 }
@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "server_config.h"
+#include "server_shard.h"
+
+/*
+ * 서버 설정 (기본값 + 명령행 옵션)
+ *   ./server_app --outq-high=1048576 --outq-low=262144 --slow-policy=coalesce --log-overflow=block
+ *   ./server_app --threads=4 --metrics-port=9001 --idle-timeout=600
+ *   ./server_app --history-kb=1024 --history-msgs=10000 --room-history-kb=128
+ *   ./server_app --msglog-segment-mb=64 --msglog-retain-hours=720 --msglog-commit-ms=2
+ *   ./server_app --tcp-nodelay=off --tcp-cork=off
+ *   ./server_app --rate-msgs=20 --rate-bytes=10485760 --accept-rate=200 --max-handshakes=256
+ *   ./server_app --spool-msgs=500 --spool-kb=1024 --spool-ttl-hours=168
+ */
+
+ServerConfig g_config = {
+    .outq_high_wm = 1024 * 1024,
+    .outq_low_wm  = 256 * 1024,
+    .slow_policy  = SLOW_POLICY_DROP,
+    .log_overflow = LOG_OVERFLOW_DROP,
+    .threads      = 0,          // 0: CPU 코어 수
+    .metrics_port = 9001,
+    .idle_timeout = 0,
+    .history_kb   = 256,
+    .history_msgs = 4096,
+    .room_history_kb     = 64,
+    .msglog_segment_mb   = 16,
+    .msglog_retain_mb    = 1024,
+    .msglog_retain_hours = 0,
+    .msglog_commit_ms    = 5,
+    .tcp_nodelay  = 1,
+    .tcp_cork     = 1,
+    .rate_msgs       = 100,
+    .rate_msg_burst  = 200,
+    .rate_bytes      = 0,
+    .rate_byte_burst = 1024 * 1024,
+    .accept_rate     = 1000,
+    .max_handshakes  = 1024,
+    .spool_msgs      = 256,
+    .spool_kb        = 256,
+    .spool_ttl_hours = 72,
+};
+
+static const char *policy_names[] = { "drop", "coalesce", "disconnect" };
+
+const char *slow_policy_name(SlowPolicy p) {
+    return policy_names[p];
+}
+
+static const char *log_overflow_names[] = { "drop", "block" };
+
+const char *log_overflow_name(LogOverflow p) {
+    return log_overflow_names[p];
+}
+
+static int parse_log_overflow(const char *s, LogOverflow *out) {
+    for (int i = 0; i < 2; i++) {
+        if (strcmp(s, log_overflow_names[i]) == 0) {
+            *out = (LogOverflow)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_policy(const char *s, SlowPolicy *out) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(s, policy_names[i]) == 0) {
+            *out = (SlowPolicy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_onoff(const char *s, int *out) {
+    if (strcmp(s, "on") == 0) *out = 1;
+    else if (strcmp(s, "off") == 0) *out = 0;
+    else return -1;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --outq-high=BYTES      output queue high watermark (default %zu)\n"
+            "  --outq-low=BYTES       output queue low watermark (default %zu)\n"
+            "  --slow-policy=POLICY   drop | coalesce | disconnect (default %s)\n"
+            "  --log-overflow=POLICY  drop | block, when the log ring is full (default %s)\n"
+            "  --threads=N            reactor threads, 1..%d (default: number of CPUs)\n"
+            "  --metrics-port=PORT    metrics listener on 127.0.0.1, 0 disables (default %d)\n"
+            "  --idle-timeout=SEC     close connections idle for SEC seconds, 0 disables (default %d)\n"
+            "  --history-kb=KB        chat history buffer size, 0 disables history (default %d)\n"
+            "  --history-msgs=N       max messages kept in chat history (default %d)\n"
+            "  --room-history-kb=KB   chat history buffer per room, 0 disables (default %d)\n"
+            "  --msglog-segment-mb=MB persistent message log segment size, 0 disables the log (default %d)\n"
+            "  --msglog-retain-mb=MB  total message log size kept, 0 = unlimited (default %d)\n"
+            "  --msglog-retain-hours=H drop logged messages older than H hours, 0 = keep (default %d)\n"
+            "  --msglog-commit-ms=MS  group commit window for fdatasync (default %d)\n"
+            "  --tcp-nodelay=on|off   disable Nagle on client sockets (default %s)\n"
+            "  --tcp-cork=on|off      cork client sockets during file downloads (default %s)\n"
+            "  --rate-msgs=N          messages per second per connection, 0 = unlimited (default %d)\n"
+            "  --rate-msg-burst=N     messages a connection may send at once (default %d)\n"
+            "  --rate-bytes=BYTES     bytes per second per connection incl. files, 0 = unlimited (default %ld)\n"
+            "  --rate-byte-burst=BYTES bytes a connection may send at once (default %ld)\n"
+            "  --accept-rate=N        new connections accepted per second, 0 = unlimited (default %d)\n"
+            "  --max-handshakes=N     connections not yet logged in, 0 = unlimited (default %d)\n"
+            "  --spool-msgs=N         DMs kept per offline user, 0 disables offline delivery (default %d)\n"
+            "  --spool-kb=KB          DM bytes kept per offline user (default %d)\n"
+            "  --spool-ttl-hours=H    drop undelivered DMs older than H hours, 0 = keep (default %d)\n",
+            prog, g_config.outq_high_wm, g_config.outq_low_wm,
+            slow_policy_name(g_config.slow_policy),
+            log_overflow_name(g_config.log_overflow), MAX_SHARDS,
+            g_config.metrics_port, g_config.idle_timeout,
+            g_config.history_kb, g_config.history_msgs, g_config.room_history_kb,
+            g_config.msglog_segment_mb, g_config.msglog_retain_mb,
+            g_config.msglog_retain_hours, g_config.msglog_commit_ms,
+            g_config.tcp_nodelay ? "on" : "off", g_config.tcp_cork ? "on" : "off",
+            g_config.rate_msgs, g_config.rate_msg_burst, g_config.rate_bytes,
+            g_config.rate_byte_burst, g_config.accept_rate, g_config.max_handshakes,
+            g_config.spool_msgs, g_config.spool_kb, g_config.spool_ttl_hours);
+}
+
+/**
+ * 명령행 옵션 파싱. 잘못된 옵션이면 -1
+ */
+int config_load(int argc, char **argv) {
+    enum { OPT_OUTQ_HIGH = 1000, OPT_OUTQ_LOW, OPT_SLOW_POLICY, OPT_LOG_OVERFLOW, OPT_THREADS,
+           OPT_METRICS_PORT, OPT_IDLE_TIMEOUT, OPT_HISTORY_KB, OPT_HISTORY_MSGS, OPT_ROOM_HISTORY_KB,
+           OPT_MSGLOG_SEGMENT, OPT_MSGLOG_RETAIN_MB, OPT_MSGLOG_RETAIN_HOURS, OPT_MSGLOG_COMMIT,
+           OPT_TCP_NODELAY, OPT_TCP_CORK, OPT_RATE_MSGS, OPT_RATE_MSG_BURST, OPT_RATE_BYTES,
+           OPT_RATE_BYTE_BURST, OPT_ACCEPT_RATE, OPT_MAX_HANDSHAKES,
+           OPT_SPOOL_MSGS, OPT_SPOOL_KB, OPT_SPOOL_TTL };
+
+    static const struct option opts[] = {
+        { "outq-high",   required_argument, NULL, OPT_OUTQ_HIGH },
+        { "outq-low",    required_argument, NULL, OPT_OUTQ_LOW },
+        { "slow-policy", required_argument, NULL, OPT_SLOW_POLICY },
+        { "log-overflow", required_argument, NULL, OPT_LOG_OVERFLOW },
+        { "threads",     required_argument, NULL, OPT_THREADS },
+        { "metrics-port", required_argument, NULL, OPT_METRICS_PORT },
+        { "idle-timeout", required_argument, NULL, OPT_IDLE_TIMEOUT },
+        { "history-kb",  required_argument, NULL, OPT_HISTORY_KB },
+        { "history-msgs", required_argument, NULL, OPT_HISTORY_MSGS },
+        { "room-history-kb", required_argument, NULL, OPT_ROOM_HISTORY_KB },
+        { "msglog-segment-mb", required_argument, NULL, OPT_MSGLOG_SEGMENT },
+        { "msglog-retain-mb", required_argument, NULL, OPT_MSGLOG_RETAIN_MB },
+        { "msglog-retain-hours", required_argument, NULL, OPT_MSGLOG_RETAIN_HOURS },
+        { "msglog-commit-ms", required_argument, NULL, OPT_MSGLOG_COMMIT },
+        { "tcp-nodelay", required_argument, NULL, OPT_TCP_NODELAY },
+        { "tcp-cork",    required_argument, NULL, OPT_TCP_CORK },
+        { "rate-msgs",   required_argument, NULL, OPT_RATE_MSGS },
+        { "rate-msg-burst", required_argument, NULL, OPT_RATE_MSG_BURST },
+        { "rate-bytes",  required_argument, NULL, OPT_RATE_BYTES },
+        { "rate-byte-burst", required_argument, NULL, OPT_RATE_BYTE_BURST },
+        { "accept-rate", required_argument, NULL, OPT_ACCEPT_RATE },
+        { "max-handshakes", required_argument, NULL, OPT_MAX_HANDSHAKES },
+        { "spool-msgs",  required_argument, NULL, OPT_SPOOL_MSGS },
+        { "spool-kb",    required_argument, NULL, OPT_SPOOL_KB },
+        { "spool-ttl-hours", required_argument, NULL, OPT_SPOOL_TTL },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (ch) {
+            case OPT_OUTQ_HIGH:
+                g_config.outq_high_wm = strtoul(optarg, NULL, 10);
+                break;
+            case OPT_OUTQ_LOW:
+                g_config.outq_low_wm = strtoul(optarg, NULL, 10);
+                break;
+            case OPT_SLOW_POLICY:
+                if (parse_policy(optarg, &g_config.slow_policy) < 0) {
+                    fprintf(stderr, "unknown slow policy: %s\n", optarg);
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case OPT_LOG_OVERFLOW:
+                if (parse_log_overflow(optarg, &g_config.log_overflow) < 0) {
+                    fprintf(stderr, "unknown log overflow policy: %s\n", optarg);
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case OPT_THREADS:
+                g_config.threads = atoi(optarg);
+                if (g_config.threads < 1 || g_config.threads > MAX_SHARDS) {
+                    fprintf(stderr, "threads must be between 1 and %d\n", MAX_SHARDS);
+                    return -1;
+                }
+                break;
+            case OPT_METRICS_PORT:
+                g_config.metrics_port = atoi(optarg);
+                if (g_config.metrics_port < 0 || g_config.metrics_port > 65535) {
+                    fprintf(stderr, "metrics-port must be between 0 and 65535\n");
+                    return -1;
+                }
+                break;
+            case OPT_IDLE_TIMEOUT:
+                g_config.idle_timeout = atoi(optarg);
+                if (g_config.idle_timeout < 0) {
+                    fprintf(stderr, "idle-timeout must not be negative\n");
+                    return -1;
+                }
+                break;
+            case OPT_HISTORY_KB:
+                g_config.history_kb = atoi(optarg);
+                if (g_config.history_kb < 0 || g_config.history_kb > 1024 * 1024) {
+                    fprintf(stderr, "history-kb must be between 0 and %d\n", 1024 * 1024);
+                    return -1;
+                }
+                break;
+            case OPT_HISTORY_MSGS:
+                g_config.history_msgs = atoi(optarg);
+                if (g_config.history_msgs < 1) {
+                    fprintf(stderr, "history-msgs must be positive\n");
+                    return -1;
+                }
+                break;
+            case OPT_ROOM_HISTORY_KB:
+                g_config.room_history_kb = atoi(optarg);
+                if (g_config.room_history_kb < 0 || g_config.room_history_kb > 64 * 1024) {
+                    fprintf(stderr, "room-history-kb must be between 0 and %d\n", 64 * 1024);
+                    return -1;
+                }
+                break;
+            case OPT_MSGLOG_SEGMENT:
+                g_config.msglog_segment_mb = atoi(optarg);
+                if (g_config.msglog_segment_mb < 0 || g_config.msglog_segment_mb > 4096) {
+                    fprintf(stderr, "msglog-segment-mb must be between 0 and 4096\n");
+                    return -1;
+                }
+                break;
+            case OPT_MSGLOG_RETAIN_MB:
+                g_config.msglog_retain_mb = atoi(optarg);
+                if (g_config.msglog_retain_mb < 0) {
+                    fprintf(stderr, "msglog-retain-mb must not be negative\n");
+                    return -1;
+                }
+                break;
+            case OPT_MSGLOG_RETAIN_HOURS:
+                g_config.msglog_retain_hours = atoi(optarg);
+                if (g_config.msglog_retain_hours < 0) {
+                    fprintf(stderr, "msglog-retain-hours must not be negative\n");
+                    return -1;
+                }
+                break;
+            case OPT_MSGLOG_COMMIT:
+                g_config.msglog_commit_ms = atoi(optarg);
+                if (g_config.msglog_commit_ms < 0 || g_config.msglog_commit_ms > 1000) {
+                    fprintf(stderr, "msglog-commit-ms must be between 0 and 1000\n");
+                    return -1;
+                }
+                break;
+            case OPT_TCP_NODELAY:
+                if (parse_onoff(optarg, &g_config.tcp_nodelay) < 0) {
+                    fprintf(stderr, "tcp-nodelay must be on or off\n");
+                    return -1;
+                }
+                break;
+            case OPT_TCP_CORK:
+                if (parse_onoff(optarg, &g_config.tcp_cork) < 0) {
+                    fprintf(stderr, "tcp-cork must be on or off\n");
+                    return -1;
+                }
+                break;
+            case OPT_RATE_MSGS:
+                g_config.rate_msgs = atoi(optarg);
+                if (g_config.rate_msgs < 0) {
+                    fprintf(stderr, "rate-msgs must be 0 or more\n");
+                    return -1;
+                }
+                break;
+            case OPT_RATE_MSG_BURST:
+                g_config.rate_msg_burst = atoi(optarg);
+                if (g_config.rate_msg_burst < 1) {
+                    fprintf(stderr, "rate-msg-burst must be at least 1\n");
+                    return -1;
+                }
+                break;
+            case OPT_RATE_BYTES:
+                g_config.rate_bytes = atol(optarg);
+                if (g_config.rate_bytes < 0) {
+                    fprintf(stderr, "rate-bytes must be 0 or more\n");
+                    return -1;
+                }
+                break;
+            case OPT_RATE_BYTE_BURST:
+                g_config.rate_byte_burst = atol(optarg);
+                if (g_config.rate_byte_burst < 1) {
+                    fprintf(stderr, "rate-byte-burst must be at least 1\n");
+                    return -1;
+                }
+                break;
+            case OPT_ACCEPT_RATE:
+                g_config.accept_rate = atoi(optarg);
+                if (g_config.accept_rate < 0) {
+                    fprintf(stderr, "accept-rate must be 0 or more\n");
+                    return -1;
+                }
+                break;
+            case OPT_MAX_HANDSHAKES:
+                g_config.max_handshakes = atoi(optarg);
+                if (g_config.max_handshakes < 0) {
+                    fprintf(stderr, "max-handshakes must be 0 or more\n");
+                    return -1;
+                }
+                break;
+            case OPT_SPOOL_MSGS:
+                g_config.spool_msgs = atoi(optarg);
+                if (g_config.spool_msgs < 0 || g_config.spool_msgs > 100000) {
+                    fprintf(stderr, "spool-msgs must be between 0 and 100000\n");
+                    return -1;
+                }
+                break;
+            case OPT_SPOOL_KB:
+                g_config.spool_kb = atoi(optarg);
+                if (g_config.spool_kb < 1 || g_config.spool_kb > 1024 * 1024) {
+                    fprintf(stderr, "spool-kb must be between 1 and 1048576\n");
+                    return -1;
+                }
+                break;
+            case OPT_SPOOL_TTL:
+                g_config.spool_ttl_hours = atoi(optarg);
+                if (g_config.spool_ttl_hours < 0) {
+                    fprintf(stderr, "spool-ttl-hours must not be negative\n");
+                    return -1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (g_config.outq_high_wm == 0 ||
+        g_config.outq_low_wm >= g_config.outq_high_wm) {
+        fprintf(stderr, "outq-low must be smaller than outq-high\n");
+        return -1;
+    }
+
+    if (g_config.threads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        g_config.threads = ncpu < 1 ? 1 : ncpu > MAX_SHARDS ? MAX_SHARDS : (int)ncpu;
+    }
+    return 0;
+}
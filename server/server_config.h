@@ -0,0 +1,53 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <stddef.h>
+
+// 느린 클라이언트(출력 큐가 high watermark 초과) 처리 정책
+typedef enum {
+    SLOW_POLICY_DROP = 0,     // low watermark 까지 비워질 때까지 새 채팅 버림
+    SLOW_POLICY_COALESCE,     // 아직 안 보낸 오래된 채팅을 버려서 low 까지 줄임
+    SLOW_POLICY_DISCONNECT    // 연결 종료
+} SlowPolicy;
+
+// 로그 링 버퍼가 가득 찼을 때 처리 정책
+typedef enum {
+    LOG_OVERFLOW_DROP = 0,    // 버리고 개수만 센다 (이벤트 루프를 막지 않음)
+    LOG_OVERFLOW_BLOCK        // writer 가 자리를 비울 때까지 기다린다 (로그 유실 없음)
+} LogOverflow;
+
+typedef struct {
+    size_t      outq_high_wm;  // 출력 큐 high watermark (bytes)
+    size_t      outq_low_wm;   // 출력 큐 low watermark (bytes)
+    SlowPolicy  slow_policy;
+    LogOverflow log_overflow;
+    int         threads;       // reactor 스레드(shard) 수
+    int         metrics_port;  // 지표 조회 포트 (127.0.0.1, 0 이면 끔)
+    int         idle_timeout;  // 이 시간(초) 동안 아무것도 보내지 않은 연결 종료 (0 이면 끔)
+    int         history_kb;    // 채팅 기록 arena 크기 (KB, 0 이면 기록 안 함)
+    int         history_msgs;  // 채팅 기록 최대 메시지 수
+    int         room_history_kb;     // 채팅방마다의 기록 arena 크기 (KB, 0 이면 방 기록 안 함)
+    int         msglog_segment_mb;   // 영구 메시지 로그 세그먼트 크기 (MB, 0 이면 로그 끔)
+    int         msglog_retain_mb;    // 로그 전체 최대 크기 (MB, 0 이면 제한 없음)
+    int         msglog_retain_hours; // 이보다 오래된 레코드 정리 (시간, 0 이면 제한 없음)
+    int         msglog_commit_ms;    // group commit 으로 모으는 시간 (ms)
+    int         tcp_nodelay;   // 클라이언트 소켓 TCP_NODELAY (Nagle 끔)
+    int         tcp_cork;      // 파일 다운로드 동안 TCP_CORK
+    int         rate_msgs;       // 연결별 초당 메시지 수 (0 이면 제한 없음)
+    int         rate_msg_burst;  // 한꺼번에 보낼 수 있는 메시지 수
+    long        rate_bytes;      // 연결별 초당 바이트 (파일 전송 포함, 0 이면 제한 없음)
+    long        rate_byte_burst;
+    int         accept_rate;     // 서버 전체 초당 accept 수 (0 이면 제한 없음)
+    int         max_handshakes;  // 로그인 전 연결 최대 수 (0 이면 제한 없음)
+    int         spool_msgs;      // 오프라인 사용자별 보관 귓속말 최대 수 (0 이면 보관 안 함)
+    int         spool_kb;        // 오프라인 사용자별 보관 크기 (KB)
+    int         spool_ttl_hours; // 이보다 오래 보관된 귓속말은 버림 (시간, 0 이면 제한 없음)
+} ServerConfig;
+
+extern ServerConfig g_config;
+
+int config_load(int argc, char **argv);
+const char *slow_policy_name(SlowPolicy p);
+const char *log_overflow_name(LogOverflow p);
+
+#endif
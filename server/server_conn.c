@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "server_conn.h"
+#include "server_metrics.h"
+
+/*
+ * 연결 테이블
+ *  - Conn 슬롯은 CONN_SLAB_SIZE 개씩 슬랩 단위로 할당하고, 슬랩 포인터 배열을
+ *    필요할 때 두 배로 늘린다. (슬롯 주소가 바뀌지 않으므로 Conn* 를 들고 있어도 안전)
+ *  - 해제된 슬롯은 free list 로 재사용
+ *  - 접속 중인 연결은 conn_active[] dense array 로 관리 → broadcast 등은
+ *    빈 슬롯 없이 접속자만 순회
+ *  - fd → Conn 은 fd 를 인덱스로 쓰는 배열, username → Conn 은 해시 테이블로 찾는다.
+ *    (DM/kick/로그인이 접속자 수와 상관없이 O(1))
+ *  - 연결 테이블은 reactor 스레드(shard)마다 따로 갖고 (__thread), username 인덱스만 공용이다.
+ */
+
+__thread Conn **conn_active = NULL;
+__thread int    conn_active_count = 0;
+static __thread int conn_active_cap = 0;
+
+static __thread Conn **slabs = NULL;
+static __thread int    slab_count = 0;
+static __thread int    slab_cap = 0;
+
+static __thread int free_head = -1;
+
+// fd → Conn (fd 번호를 그대로 인덱스로 사용)
+static __thread Conn **fd_map = NULL;
+static __thread int    fd_map_cap = 0;
+
+// username → 연결 위치 (모든 shard 공용, open addressing, linear probing)
+typedef struct {
+    unsigned int hash;
+    ConnRef      ref;       // ref.conn == NULL 이면 빈 칸
+    char         name[MAX_NAME];
+} NameSlot;
+
+static NameSlot *name_slots = NULL;
+static size_t    name_cap = 0;      // 2의 거듭제곱
+static size_t    name_count = 0;
+static pthread_rwlock_t name_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * 이 스레드(shard)의 연결 테이블 초기화
+ */
+void conn_table_init(void) {
+    conn_active = NULL;
+    conn_active_count = 0;
+    conn_active_cap = 0;
+    slabs = NULL;
+    slab_count = 0;
+    slab_cap = 0;
+    free_head = -1;
+    free(fd_map);
+    fd_map = NULL;
+    fd_map_cap = 0;
+}
+
+/* ---------------------- fd 인덱스 ---------------------- */
+
+static int fd_map_set(int fd, Conn *c) {
+    if (fd < 0) return -1;
+    if (fd >= fd_map_cap) {
+        int new_cap = fd_map_cap ? fd_map_cap : 1024;
+        while (new_cap <= fd) new_cap *= 2;
+        Conn **p = realloc(fd_map, sizeof(Conn *) * new_cap);
+        if (!p) return -1;
+        memset(p + fd_map_cap, 0, sizeof(Conn *) * (new_cap - fd_map_cap));
+        fd_map = p;
+        fd_map_cap = new_cap;
+    }
+    fd_map[fd] = c;
+    return 0;
+}
+
+Conn *conn_by_fd(int fd) {
+    if (fd < 0 || fd >= fd_map_cap) return NULL;
+    return fd_map[fd];
+}
+
+/* ---------------------- username 인덱스 ---------------------- */
+/*
+ * 사용자 목록/DM/kick/root 위임이 shard 와 상관없이 같은 결과를 보도록 하나만 둔다.
+ * 다른 shard 의 Conn 필드는 읽지 않도록 이름과 위치(shard, gen, fd)를 칸에 복사해 둔다.
+ */
+
+static unsigned int name_hash(const char *s) {
+    unsigned int h = 2166136261u;       // FNV-1a 32bit
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void name_insert_slot(const NameSlot *src) {
+    size_t mask = name_cap - 1;
+    size_t i = src->hash & mask;
+    while (name_slots[i].ref.conn) i = (i + 1) & mask;
+    name_slots[i] = *src;
+    name_count++;
+}
+
+static int name_grow(void) {
+    size_t old_cap = name_cap;
+    NameSlot *old = name_slots;
+
+    size_t new_cap = old_cap ? old_cap * 2 : 256;
+    NameSlot *p = calloc(new_cap, sizeof(NameSlot));
+    if (!p) return -1;
+
+    name_slots = p;
+    name_cap = new_cap;
+    name_count = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].ref.conn) name_insert_slot(&old[i]);
+    }
+    free(old);
+    return 0;
+}
+
+static long name_find(const char *name, unsigned int h) {
+    if (name_cap == 0) return -1;
+    size_t mask = name_cap - 1;
+    for (size_t i = h & mask; name_slots[i].ref.conn; i = (i + 1) & mask) {
+        if (name_slots[i].hash == h && strcmp(name_slots[i].name, name) == 0)
+            return (long)i;
+    }
+    return -1;
+}
+
+// 칸 하나를 비우고 뒤따르는 칸들을 당겨서 탐색 경로를 유지 (tombstone 없음)
+static void name_remove_at(size_t i) {
+    size_t mask = name_cap - 1;
+    name_slots[i].ref.conn = NULL;
+    name_count--;
+
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!name_slots[j].ref.conn) break;
+
+        size_t home = name_slots[j].hash & mask;
+        // home 이 (i, j] 밖에 있으면 i 로 옮겨도 찾을 수 있다
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            name_slots[i] = name_slots[j];
+            name_slots[j].ref.conn = NULL;
+            i = j;
+        }
+    }
+}
+
+/**
+ * 이름으로 접속 위치 찾기 (어느 shard 든). 없으면 0
+ */
+int conn_lookup(const char *name, ConnRef *out) {
+    pthread_rwlock_rdlock(&name_lock);
+    long i = name_find(name, name_hash(name));
+    if (i >= 0 && out) *out = name_slots[i].ref;
+    pthread_rwlock_unlock(&name_lock);
+    return i >= 0;
+}
+
+/**
+ * 이름으로 연결 찾기 (이 shard 에 있는 연결만, 다른 shard 면 NULL)
+ */
+Conn *conn_by_username(const char *name) {
+    ConnRef ref;
+    if (!conn_lookup(name, &ref) || ref.shard != shard_id) return NULL;
+    return ref.conn->gen == ref.gen ? ref.conn : NULL;
+}
+
+/**
+ * 로그인한 사용자 전체 순회 (모든 shard, 읽기 락을 잡은 채로 fn 호출)
+ */
+void conn_foreach_user(void (*fn)(const char *name, const ConnRef *ref, void *arg), void *arg) {
+    pthread_rwlock_rdlock(&name_lock);
+    for (size_t i = 0; i < name_cap; i++) {
+        if (name_slots[i].ref.conn) fn(name_slots[i].name, &name_slots[i].ref, arg);
+    }
+    pthread_rwlock_unlock(&name_lock);
+}
+
+/**
+ * 로그인 성공: 이름을 기록하고 username 인덱스에 등록
+ * 같은 이름으로 이미 접속한 연결이 있으면 새 연결이 그 이름을 가져간다.
+ */
+int conn_set_username(Conn *c, const char *name) {
+    if (c->authed) conn_clear_username(c);
+
+    strncpy(c->username, name, MAX_NAME - 1);
+    c->username[MAX_NAME - 1] = '\0';
+
+    NameSlot slot;
+    slot.hash = name_hash(c->username);
+    slot.ref.conn = c;
+    slot.ref.gen = c->gen;
+    slot.ref.shard = c->shard;
+    slot.ref.fd = c->fd;
+    memcpy(slot.name, c->username, MAX_NAME);
+
+    pthread_rwlock_wrlock(&name_lock);
+    long i = name_find(c->username, slot.hash);
+    if (i >= 0) {
+        name_slots[i] = slot;
+    } else {
+        if ((name_count + 1) * 2 > name_cap && name_grow() < 0) {
+            pthread_rwlock_unlock(&name_lock);
+            return -1;
+        }
+        name_insert_slot(&slot);
+    }
+    pthread_rwlock_unlock(&name_lock);
+
+    c->authed = 1;
+    return 0;
+}
+
+void conn_clear_username(Conn *c) {
+    if (c->authed) {
+        pthread_rwlock_wrlock(&name_lock);
+        long i = name_find(c->username, name_hash(c->username));
+        // 같은 이름의 다른(나중) 연결이 차지하고 있으면 그대로 둔다
+        if (i >= 0 && name_slots[i].ref.conn == c && name_slots[i].ref.gen == c->gen)
+            name_remove_at((size_t)i);
+        pthread_rwlock_unlock(&name_lock);
+    }
+    c->authed = 0;
+    c->username[0] = '\0';
+}
+
+Conn *conn_by_id(int id) {
+    if (id < 0 || (id >> CONN_SLAB_SHIFT) >= slab_count) return NULL;
+    return &slabs[id >> CONN_SLAB_SHIFT][id & (CONN_SLAB_SIZE - 1)];
+}
+
+/**
+ * 새 슬랩을 할당해서 free list 에 연결
+ */
+static int grow_slabs(void) {
+    if (slab_count == slab_cap) {
+        int new_cap = slab_cap ? slab_cap * 2 : 4;
+        Conn **p = realloc(slabs, sizeof(Conn *) * new_cap);
+        if (!p) return -1;
+        slabs = p;
+        slab_cap = new_cap;
+    }
+
+    Conn *slab = calloc(CONN_SLAB_SIZE, sizeof(Conn));
+    if (!slab) return -1;
+
+    int base = slab_count << CONN_SLAB_SHIFT;
+    slabs[slab_count++] = slab;
+
+    // 낮은 id 부터 쓰이도록 역순으로 push
+    for (int i = CONN_SLAB_SIZE - 1; i >= 0; i--) {
+        slab[i].fd = -1;
+        slab[i].id = base + i;
+        slab[i].next_free = free_head;
+        free_head = base + i;
+    }
+    return 0;
+}
+
+/**
+ * 새 연결 슬롯 할당 (메모리가 없을 때만 NULL)
+ */
+Conn *conn_alloc(int fd) {
+    if (free_head < 0 && grow_slabs() < 0) return NULL;
+
+    if (conn_active_count == conn_active_cap) {
+        int new_cap = conn_active_cap ? conn_active_cap * 2 : 64;
+        Conn **p = realloc(conn_active, sizeof(Conn *) * new_cap);
+        if (!p) return NULL;
+        conn_active = p;
+        conn_active_cap = new_cap;
+    }
+
+    if (fd_map_set(fd, NULL) < 0) return NULL;
+
+    Conn *c = conn_by_id(free_head);
+    free_head = c->next_free;
+    fd_map[fd] = c;
+
+    c->fd = fd;
+    c->shard = shard_id;
+    c->gen++;
+    c->authed = 0;
+    c->proto = 0;
+    c->rx_head = c->rx_tail = 0;
+    c->handshake = 0;
+    c->spool_unacked = 0;
+    c->username[0] = '\0';
+    c->next_free = -1;
+    memset(&c->outq, 0, sizeof(c->outq));
+    c->upload = NULL;
+    c->download = NULL;
+    c->put = NULL;
+    c->range = NULL;
+    c->accepted_ns = metrics_now_ns();
+    c->last_active = timer_ticks();
+    c->hist_seq = 0;
+    c->room = -1;
+
+    c->active_idx = conn_active_count;
+    conn_active[conn_active_count++] = c;
+
+    metric_add(M_ACCEPTED, 1);
+    metric_gauge_add(G_CONNECTIONS, 1);
+    return c;
+}
+
+/**
+ * 연결 슬롯 반납 (fd close 는 호출자가 담당)
+ * active 배열에서는 마지막 원소와 자리를 바꿔 제거한다.
+ */
+void conn_release(Conn *c) {
+    if (!c || c->fd < 0) return;
+
+    int idx = c->active_idx;
+    Conn *last = conn_active[--conn_active_count];
+    conn_active[idx] = last;
+    last->active_idx = idx;
+
+    outq_clear(&c->outq);
+    timer_del(&c->idle_timer);
+    timer_del(&c->rate_timer);
+    admit_handshake_end(c);
+    conn_clear_username(c);
+    fd_map[c->fd] = NULL;
+
+    c->fd = -1;
+    c->active_idx = -1;
+    c->next_free = free_head;
+    free_head = c->id;
+
+    metric_add(M_DISCONNECTED, 1);
+    metric_gauge_add(G_CONNECTIONS, -1);
+}
+
@@ -0,0 +1,78 @@
+#ifndef SERVER_CONN_H
+#define SERVER_CONN_H
+
+#include "protocol.h"
+#include "frame.h"
+#include "server_outq.h"
+#include "server_shard.h"
+#include "server_timer.h"
+#include "server_ratelimit.h"
+
+// 슬랩 하나에 들어가는 연결 슬롯 수 (2의 거듭제곱)
+#define CONN_SLAB_SHIFT 10
+#define CONN_SLAB_SIZE  (1 << CONN_SLAB_SHIFT)
+
+// 연결별 입력 버퍼 크기: recv 한 번에 작은 프레임 여러 개를 받는다 (최대 프레임보다 커야 함)
+#define CONN_RX_BUF     (8 * 1024)
+
+/*
+ * 연결(세션) 1개의 상태
+ * 자주 접근하는 필드(fd, 인증 상태, active 인덱스)를 앞에 모으고
+ * 큰 버퍼는 뒤에 둔다.
+ */
+typedef struct Conn {
+    int  fd;                  // -1 이면 빈 슬롯
+    int  id;                  // 세션 id (슬랩 인덱스, 재사용됨)
+    int  shard;               // 이 연결을 맡은 reactor 스레드
+    unsigned gen;             // 슬롯을 새로 쓸 때마다 증가 (다른 shard 가 든 참조 확인용)
+    int  authed;              // 로그인 완료 여부
+    int  proto;               // PROTO_* (server_proto.h)
+    int  active_idx;          // conn_active[] 안의 위치
+    int  next_free;           // free list 다음 슬롯 id (-1: 끝)
+    char username[MAX_NAME];  // 로그인 전에는 빈 문자열
+    uint64_t accepted_ns;     // accept 시각 (로그인 지연 지표용)
+    uint64_t last_active;     // 마지막으로 읽기 이벤트를 처리한 tick (server_timer.h)
+    uint64_t hist_seq;        // 지금 방에 들어온 시점의 채팅 기록 seq (이전은 기록 조회로, 이후는 실시간으로 받음)
+    int  room;                // 들어가 있는 채팅방 (server_room.h, -1: 로그인 전)
+    int  room_idx;            // 그 방의 이 shard 멤버 배열 안의 위치
+    Timer    idle_timer;      // 유휴 연결 종료 (--idle-timeout)
+    Timer    rate_timer;      // 속도 제한으로 멈춘 읽기를 다시 시작
+    RateLimit rate;           // 연결별 메시지/바이트 버킷 (server_ratelimit.h)
+    int  handshake;           // 로그인 전 연결 수에 포함되어 있음
+    int  spool_unacked;       // 보관된 귓속말을 출력 큐에 넣었고 아직 다 보내지 않음 (server_spool.c)
+    unsigned rx_head;         // rxbuf 안에서 아직 처리하지 않은 바이트 [rx_head, rx_tail)
+    unsigned rx_tail;
+
+    OutQueue outq;            // 전송 대기 큐
+    struct UploadState   *upload;     // 진행 중인 업로드 (server_file.c)
+    struct DownloadState *download;   // 진행 중인 다운로드
+    struct PutSession    *put;        // 이 연결이 연 병렬 업로드 세션
+    struct RangeRecv     *range;      // 받는 중인 병렬 업로드 구간 본문
+    Message rx;               // 꺼낸 메시지
+    unsigned char rxbuf[CONN_RX_BUF];       // 소켓에서 읽어 둔 바이트 (프레임 단위로 꺼냄)
+} Conn;
+
+// 다른 shard 에서도 쓸 수 있는 연결 위치 (conn 은 shard 스레드만 역참조)
+typedef struct {
+    Conn    *conn;
+    unsigned gen;
+    int      shard;
+    int      fd;
+} ConnRef;
+
+// 이 shard 에 접속 중인 연결들 (dense array, 순서는 보장하지 않음)
+extern __thread Conn **conn_active;
+extern __thread int    conn_active_count;
+
+void  conn_table_init(void);
+Conn *conn_alloc(int fd);
+void  conn_release(Conn *c);
+Conn *conn_by_id(int id);
+Conn *conn_by_fd(int fd);
+Conn *conn_by_username(const char *name);
+int   conn_lookup(const char *name, ConnRef *out);
+void  conn_foreach_user(void (*fn)(const char *name, const ConnRef *ref, void *arg), void *arg);
+int   conn_set_username(Conn *c, const char *name);
+void  conn_clear_username(Conn *c);
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include "server_cred.h"
+#include "server_shard.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 계정 정보 (users.txt) 메모리 인덱스
+ *  - 시작할 때 한 번 읽어서 open addressing 해시 테이블로 만든다.
+ *    로그인 처리(check_login)는 이 테이블만 보고 디스크는 건드리지 않는다.
+ *  - users.txt 가 바뀌면 (inotify) 백그라운드 스레드가 새 테이블을 만들어 포인터만 바꾼다.
+ *    읽는 쪽은 shard 마다 따로 둔 cred_readers[] 칸에 표시하고, 옛 테이블은 모든 shard 가
+ *    조회 밖(quiescent)을 한 번씩 지난 뒤 해제한다. (RCU 방식)
+ */
+
+#define CRED_PATH     "./users.txt"
+#define CRED_DIR      "."
+#define CRED_FILENAME "users.txt"
+#define CRED_FIELD_MAX 64
+
+typedef struct {
+    uint64_t    hash;       // 0 이면 빈 칸
+    const char *id;
+    const char *pw;
+} CredEntry;
+
+typedef struct {
+    CredEntry *slots;
+    size_t     mask;        // 칸 수 - 1 (칸 수는 2의 거듭제곱)
+    size_t     count;
+    char      *arena;       // id/pw 문자열 저장소
+} CredTable;
+
+/*
+ * shard 별 읽기 표시: 조회를 시작할 때 1 올려서 홀수, 끝나면 또 1 올려서 짝수.
+ * 칸마다 캐시 라인 하나를 써서 로그인이 몰려도 shard 끼리 같은 라인을 두고 다투지 않고,
+ * 칸에 쓰는 것은 그 shard 스레드 하나뿐이라 lock 명령 없이 store 로 충분하다.
+ */
+typedef struct {
+    atomic_uint seq;
+    char        pad[64 - sizeof(atomic_uint)];
+} __attribute__((aligned(64))) CredReader;
+
+static _Atomic(CredTable *) cred_current = NULL;
+static CredReader cred_readers[MAX_SHARDS];
+
+static uint64_t cred_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;     // FNV-1a 64bit
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;       // 0 은 빈 칸 표시
+}
+
+static void cred_table_free(CredTable *t) {
+    if (!t) return;
+    free(t->slots);
+    free(t->arena);
+    free(t);
+}
+
+static void cred_table_insert(CredTable *t, const char *id, const char *pw) {
+    uint64_t h = cred_hash(id);
+    size_t i = h & t->mask;
+
+    while (t->slots[i].hash) {
+        // 같은 ID 가 또 나오면 나중 줄이 이긴다
+        if (t->slots[i].hash == h && strcmp(t->slots[i].id, id) == 0) {
+            t->slots[i].pw = pw;
+            return;
+        }
+        i = (i + 1) & t->mask;
+    }
+    t->slots[i].hash = h;
+    t->slots[i].id = id;
+    t->slots[i].pw = pw;
+    t->count++;
+}
+
+/**
+ * users.txt 를 읽어 새 테이블 생성 (파일을 못 열면 NULL)
+ */
+static CredTable *cred_table_load(void) {
+    FILE *fp = fopen(CRED_PATH, "r");
+    if (!fp) return NULL;
+
+    // 파일 전체를 arena 로 읽고, 줄마다 "id pw" 를 잘라서 NUL 로 끝낸다
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) size = 0;
+
+    CredTable *t = calloc(1, sizeof(CredTable));
+    char *arena = malloc(size + 1);
+    if (!t || !arena || fread(arena, 1, size, fp) != (size_t)size) {
+        fclose(fp);
+        free(arena);
+        free(t);
+        return NULL;
+    }
+    fclose(fp);
+    arena[size] = '\0';
+    t->arena = arena;
+
+    size_t lines = 1;
+    for (long i = 0; i < size; i++) {
+        if (arena[i] == '\n') lines++;
+    }
+
+    size_t cap = 16;
+    while (cap < lines * 2) cap <<= 1;      // load factor 0.5 이하
+    t->slots = calloc(cap, sizeof(CredEntry));
+    if (!t->slots) {
+        cred_table_free(t);
+        return NULL;
+    }
+    t->mask = cap - 1;
+
+    char *save = NULL;
+    for (char *line = strtok_r(arena, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *fsave = NULL;
+        char *id = strtok_r(line, " \t\r", &fsave);
+        char *pw = id ? strtok_r(NULL, " \t\r", &fsave) : NULL;
+        if (!id || !pw) continue;
+        if (strlen(id) >= CRED_FIELD_MAX || strlen(pw) >= CRED_FIELD_MAX) continue;
+        cred_table_insert(t, id, pw);
+    }
+    return t;
+}
+
+/**
+ * 새 테이블로 교체하고, 옛 테이블을 읽는 쪽이 없어지면 해제
+ */
+static void cred_publish(CredTable *t) {
+    CredTable *old = atomic_exchange(&cred_current, t);
+
+    // 교체 시점에 조회 중이던 shard 만, 그 조회가 끝날 때까지 기다린다.
+    // 다음 조회는 새 테이블을 보므로 로그인이 계속 들어와도 한 번 바뀌면 끝난다.
+    for (int i = 0; i < MAX_SHARDS; i++) {
+        unsigned seq = atomic_load(&cred_readers[i].seq);
+        if (!(seq & 1)) continue;
+        while (atomic_load(&cred_readers[i].seq) == seq) {
+            sched_yield();
+        }
+    }
+    cred_table_free(old);
+}
+
+// 조회 시작/끝 표시 (reactor 스레드에서만 부른다)
+static inline void cred_read_begin(void) {
+    CredReader *r = &cred_readers[shard_id];
+    atomic_store(&r->seq, atomic_load_explicit(&r->seq, memory_order_relaxed) + 1);
+}
+
+static inline void cred_read_end(void) {
+    CredReader *r = &cred_readers[shard_id];
+    atomic_store_explicit(&r->seq, atomic_load_explicit(&r->seq, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+// id 칸 찾기 (cred_read_begin() 한 상태에서)
+static const CredEntry *cred_find(const CredTable *t, const char *id) {
+    if (!t) return NULL;
+
+    uint64_t h = cred_hash(id);
+    for (size_t i = h & t->mask; t->slots[i].hash; i = (i + 1) & t->mask) {
+        if (t->slots[i].hash == h && strcmp(t->slots[i].id, id) == 0) return &t->slots[i];
+    }
+    return NULL;
+}
+
+/**
+ * ID/PW 확인. 메모리 테이블만 조회한다.
+ */
+bool cred_check(const char *id, const char *pw) {
+    cred_read_begin();
+    const CredEntry *e = cred_find(atomic_load(&cred_current), id);
+    bool ok = e && strcmp(e->pw, pw) == 0;
+    cred_read_end();
+    return ok;
+}
+
+/**
+ * 계정이 있는지만 확인 (오프라인 귓속말 보관 대상 판단)
+ */
+bool cred_exists(const char *id) {
+    cred_read_begin();
+    bool ok = cred_find(atomic_load(&cred_current), id) != NULL;
+    cred_read_end();
+    return ok;
+}
+
+/**
+ * users.txt 다시 읽기 (실패하면 기존 테이블 유지)
+ */
+static void cred_reload(void) {
+    CredTable *t = cred_table_load();
+    if (!t) {
+        server_log("users.txt reload failed (errno=%d), keeping previous accounts", errno);
+        return;
+    }
+    size_t count = t->count;
+    cred_publish(t);
+    server_log("users.txt loaded: %zu accounts", count);
+}
+
+// 디렉토리를 감시해서 users.txt 가 저장(닫힘)되거나 교체(rename)되면 다시 읽는다
+static void *cred_watch_main(void *arg) {
+    int ifd = *(int *)arg;
+    free(arg);
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t n = read(ifd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            server_log("inotify read failed (errno=%d), users.txt hot reload disabled", errno);
+            break;
+        }
+
+        int changed = 0;
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->len > 0 && strcmp(ev->name, CRED_FILENAME) == 0) changed = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        if (changed) cred_reload();
+    }
+
+    close(ifd);
+    return NULL;
+}
+
+/**
+ * 시작 시 계정 로드 + 변경 감시 스레드 시작
+ */
+int cred_start(void) {
+    CredTable *t = cred_table_load();
+    if (!t) {
+        perror("users.txt open failed");
+        // 빈 테이블로 시작 (파일이 생기면 감시 스레드가 읽어 들임)
+        t = calloc(1, sizeof(CredTable));
+        if (t) t->slots = calloc(16, sizeof(CredEntry));
+        if (!t || !t->slots) {
+            cred_table_free(t);
+            return -1;
+        }
+        t->mask = 15;
+    }
+    server_log("users.txt loaded: %zu accounts", t->count);
+    atomic_store(&cred_current, t);
+
+    int *ifd = malloc(sizeof(int));
+    if (!ifd) return 0;
+    *ifd = inotify_init1(IN_CLOEXEC);
+    if (*ifd < 0 ||
+        inotify_add_watch(*ifd, CRED_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        server_log("inotify unavailable (errno=%d), users.txt hot reload disabled", errno);
+        if (*ifd >= 0) close(*ifd);
+        free(ifd);
+        return 0;
+    }
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, cred_watch_main, ifd) != 0) {
+        close(*ifd);
+        free(ifd);
+        return 0;
+    }
+    pthread_detach(tid);
+    return 0;
+}
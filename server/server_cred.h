@@ -0,0 +1,11 @@
+#ifndef SERVER_CRED_H
+#define SERVER_CRED_H
+
+#include <stdbool.h>
+
+// users.txt 메모리 인덱스 (로그인 시 디스크 접근 없음, 파일이 바뀌면 자동 다시 읽기)
+int  cred_start(void);
+bool cred_check(const char *id, const char *pw);
+bool cred_exists(const char *id);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "server_event.h"
+
+/*
+ * I/O 이벤트 엔진
+ *  - 기본: epoll (edge-triggered). fd는 accept 시 한 번만 등록하고,
+ *    event_wait()는 준비된 fd만 돌려준다. → 깨어날 때 비용은 접속자 수가 아니라
+ *    활성 fd 수에 비례.
+ *  - make EVENT_BACKEND=select : 기존 select() 방식 (비교/디버깅용)
+ *
+ * edge-triggered 이므로 호출자는 EV_READ를 받으면 더 읽을 데이터가 없을 때까지
+ * 처리해야 한다.
+ * 상태는 __thread 라서 reactor 스레드(shard)마다 자기 이벤트 인스턴스를 갖는다.
+ */
+
+#ifndef USE_SELECT
+
+#include <sys/epoll.h>
+
+static __thread int epoll_fd = -1;
+
+static unsigned int to_epoll(int events) {
+    unsigned int ev = EPOLLET | EPOLLRDHUP;
+    if (events & EV_READ)  ev |= EPOLLIN;
+    if (events & EV_WRITE) ev |= EPOLLOUT;
+    return ev;
+}
+
+int event_init(void) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    return 0;
+}
+
+int event_add(int fd, int events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = to_epoll(events);
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int event_mod(int fd, int events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = to_epoll(events);
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void event_del(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int event_wait(IoEvent *out, int max_events, int timeout_ms) {
+    struct epoll_event evs[EV_MAX_EVENTS];
+    if (max_events > EV_MAX_EVENTS) max_events = EV_MAX_EVENTS;
+
+    int n = epoll_wait(epoll_fd, evs, max_events, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        out[i].fd = evs[i].data.fd;
+        out[i].events = 0;
+        if (evs[i].events & EPOLLIN)  out[i].events |= EV_READ;
+        if (evs[i].events & EPOLLOUT) out[i].events |= EV_WRITE;
+        if (evs[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+            out[i].events |= EV_HUP;
+    }
+    return n;
+}
+
+const char *event_backend_name(void) {
+    return "epoll";
+}
+
+#else /* USE_SELECT */
+
+#include <sys/select.h>
+
+// 등록된 fd별 관심 이벤트 (0이면 미등록)
+static __thread unsigned char interest[FD_SETSIZE];
+static __thread int max_fd = -1;
+
+int event_init(void) {
+    memset(interest, 0, sizeof(interest));
+    max_fd = -1;
+    return 0;
+}
+
+int event_add(int fd, int events) {
+    if (fd < 0 || fd >= FD_SETSIZE) {
+        errno = EMFILE;     // select()는 FD_SETSIZE 이상을 감시할 수 없음
+        return -1;
+    }
+    interest[fd] = (unsigned char)events;
+    if (fd > max_fd) max_fd = fd;
+    return 0;
+}
+
+int event_mod(int fd, int events) {
+    return event_add(fd, events);
+}
+
+void event_del(int fd) {
+    if (fd < 0 || fd >= FD_SETSIZE) return;
+    interest[fd] = 0;
+    while (max_fd >= 0 && interest[max_fd] == 0) max_fd--;
+}
+
+int event_wait(IoEvent *out, int max_events, int timeout_ms) {
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+
+    // 매번 전체 등록 목록을 다시 구성 (select 방식의 고정 비용)
+    for (int fd = 0; fd <= max_fd; fd++) {
+        if (interest[fd] & EV_READ)  FD_SET(fd, &rfds);
+        if (interest[fd] & EV_WRITE) FD_SET(fd, &wfds);
+    }
+
+    struct timeval tv, *tvp = NULL;
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        tvp = &tv;
+    }
+
+    int n = select(max_fd + 1, &rfds, &wfds, NULL, tvp);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        return -1;
+    }
+
+    int count = 0;
+    for (int fd = 0; fd <= max_fd && count < max_events; fd++) {
+        int ev = 0;
+        if (FD_ISSET(fd, &rfds)) ev |= EV_READ;
+        if (FD_ISSET(fd, &wfds)) ev |= EV_WRITE;
+        if (ev) {
+            out[count].fd = fd;
+            out[count].events = ev;
+            count++;
+        }
+    }
+    return count;
+}
+
+const char *event_backend_name(void) {
+    return "select";
+}
+
+#endif /* USE_SELECT */
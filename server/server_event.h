@@ -0,0 +1,23 @@
+#ifndef SERVER_EVENT_H
+#define SERVER_EVENT_H
+
+// 이벤트 종류 (backend 공통)
+#define EV_READ   0x01
+#define EV_WRITE  0x02
+#define EV_HUP    0x04     // 상대방 종료/에러
+
+#define EV_MAX_EVENTS 256  // event_wait() 한 번에 돌려받는 최대 이벤트 수
+
+typedef struct {
+    int fd;
+    int events;            // EV_* 조합
+} IoEvent;
+
+int  event_init(void);
+int  event_add(int fd, int events);
+int  event_mod(int fd, int events);
+void event_del(int fd);
+int  event_wait(IoEvent *out, int max_events, int timeout_ms);
+const char *event_backend_name(void);
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "server_file.h"
+#include "server_timer.h"
+#include "server_metrics.h"
+#include "server_expiry.h"
+#include "server_cas.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 저널 형식 (한 줄에 하나, 뒤에 나온 줄이 이긴다)
+ *   A <만료 시각(epoch 초)> <파일명>     만료 예정 추가/변경
+ *   D <파일명>                          삭제 완료 또는 취소
+ * 시작할 때 읽어서 살아있는 항목만 다시 쓰고, 실행 중에는 끝에 덧붙이기만 한다.
+ * 덧붙인 줄이 살아있는 항목보다 훨씬 많아지면 그때 다시 정리한다.
+ */
+
+#define EXPIRY_JOURNAL   STORAGE_DIR ".expiry.journal"
+#define EXPIRY_BUCKETS   1024
+#define EXPIRY_COMPACT_MIN 1024
+
+typedef struct ExpiryEntry {
+    struct ExpiryEntry *next;       // 해시 체인
+    uint64_t hash;
+    time_t   expires;
+    int      armed;                 // 타이머 등록됨 (해제는 타이머 콜백이 한다)
+    int      cancelled;             // 목록에서 빠짐 → 타이머가 울리면 해제만
+    Timer    timer;
+    char     filename[256];
+} ExpiryEntry;
+
+static ExpiryEntry    *buckets[EXPIRY_BUCKETS];
+static pthread_mutex_t expiry_lock = PTHREAD_MUTEX_INITIALIZER;
+static int             journal_fd = -1;
+static long            live_count = 0;
+static long            journal_lines = 0;
+
+static uint64_t expiry_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;     // FNV-1a 64bit
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static ExpiryEntry **entry_find(const char *filename, uint64_t h) {
+    ExpiryEntry **pp = &buckets[h & (EXPIRY_BUCKETS - 1)];
+    while (*pp && ((*pp)->hash != h || strcmp((*pp)->filename, filename) != 0))
+        pp = &(*pp)->next;
+    return pp;
+}
+
+static ExpiryEntry *entry_new(const char *filename, uint64_t h, time_t expires) {
+    ExpiryEntry *e = calloc(1, sizeof(ExpiryEntry));
+    if (!e) return NULL;
+    e->hash = h;
+    e->expires = expires;
+    snprintf(e->filename, sizeof(e->filename), "%s", filename);
+
+    ExpiryEntry **head = &buckets[h & (EXPIRY_BUCKETS - 1)];
+    e->next = *head;
+    *head = e;
+    live_count++;
+    return e;
+}
+
+// 목록에서 뺀다. 타이머가 걸려 있으면 해제는 콜백에 맡긴다.
+static void entry_remove(ExpiryEntry **pp) {
+    ExpiryEntry *e = *pp;
+    *pp = e->next;
+    live_count--;
+    if (e->armed) e->cancelled = 1;
+    else free(e);
+}
+
+static void journal_append(const char *line, size_t len) {
+    if (journal_fd < 0) return;
+    if (write(journal_fd, line, len) != (ssize_t)len) {
+        server_log("expiry journal write failed (errno=%d)", errno);
+    }
+    journal_lines++;
+}
+
+/**
+ * 살아있는 항목만 새 파일에 써서 저널을 교체 (expiry_lock 안에서 호출)
+ */
+static int journal_rewrite(void) {
+    const char *tmp = EXPIRY_JOURNAL ".tmp";
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return -1;
+
+    for (int b = 0; b < EXPIRY_BUCKETS; b++) {
+        for (ExpiryEntry *e = buckets[b]; e; e = e->next)
+            fprintf(fp, "A %lld %s\n", (long long)e->expires, e->filename);
+    }
+    if (fflush(fp) != 0 || fdatasync(fileno(fp)) < 0) {
+        fclose(fp);
+        unlink(tmp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (rename(tmp, EXPIRY_JOURNAL) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    if (journal_fd >= 0) close(journal_fd);
+    journal_fd = open(EXPIRY_JOURNAL, O_WRONLY | O_APPEND | O_CLOEXEC);
+    journal_lines = live_count;
+    return journal_fd < 0 ? -1 : 0;
+}
+
+static void journal_maybe_compact(void) {
+    if (journal_lines > EXPIRY_COMPACT_MIN && journal_lines > 4 * live_count) {
+        if (journal_rewrite() < 0)
+            server_log("expiry journal compaction failed (errno=%d)", errno);
+    }
+}
+
+/**
+ * 시작 시 저널을 읽어 만료 예정 목록을 복원하고, 정리된 저널로 다시 쓴다
+ */
+int expiry_init(void) {
+    FILE *fp = fopen(EXPIRY_JOURNAL, "r");
+    if (fp) {
+        char line[512], name[256];
+        long long expires;
+
+        while (fgets(line, sizeof(line), fp)) {
+            size_t n = strlen(line);
+            if (n == 0 || line[n - 1] != '\n') continue;     // 쓰다 만 마지막 줄
+            if (sscanf(line, "A %lld %255s", &expires, name) == 2) {
+                uint64_t h = expiry_hash(name);
+                ExpiryEntry **pp = entry_find(name, h);
+                if (*pp) (*pp)->expires = (time_t)expires;
+                else entry_new(name, h, (time_t)expires);
+            } else if (sscanf(line, "D %255s", name) == 1) {
+                ExpiryEntry **pp = entry_find(name, expiry_hash(name));
+                if (*pp) entry_remove(pp);
+            }
+        }
+        fclose(fp);
+    }
+
+    pthread_mutex_lock(&expiry_lock);
+    int r = journal_rewrite();
+    pthread_mutex_unlock(&expiry_lock);
+
+    if (r < 0) {
+        perror("expiry journal");
+        return -1;
+    }
+    if (live_count > 0)
+        server_log("파일 자동 삭제 예정 %ld개 복원", live_count);
+    return 0;
+}
+
+static void expiry_fire(Timer *t) {
+    ExpiryEntry *e = t->arg;
+
+    pthread_mutex_lock(&expiry_lock);
+    if (e->cancelled) {
+        // 다시 올려져서 예정이 바뀐 파일
+        pthread_mutex_unlock(&expiry_lock);
+        free(e);
+        return;
+    }
+
+    time_t now = time(NULL);
+    if (e->expires > now) {
+        // 벽시계가 뒤로 간 경우 등: 남은 만큼 다시 기다린다
+        timer_add_ms(&e->timer, (uint64_t)(e->expires - now) * 1000);
+        pthread_mutex_unlock(&expiry_lock);
+        return;
+    }
+
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", STORAGE_DIR, e->filename);
+    if (unlink(filepath) == 0 || cas_remove(e->filename)) {
+        server_log("Timed-delete: removed file %s", filepath);
+        metric_add(M_FILES_EXPIRED, 1);
+    } else if (errno != ENOENT) {
+        server_log("Timed-delete: unlink(%s) failed (errno=%d)", filepath, errno);
+    }
+
+    char line[300];
+    int len = snprintf(line, sizeof(line), "D %s\n", e->filename);
+    journal_append(line, (size_t)len);
+
+    e->armed = 0;
+    entry_remove(entry_find(e->filename, e->hash));     // 등록 해제 상태라 여기서 해제됨
+    journal_maybe_compact();
+    pthread_mutex_unlock(&expiry_lock);
+}
+
+static void entry_arm(ExpiryEntry *e) {
+    time_t now = time(NULL);
+    uint64_t delay_ms = e->expires > now ? (uint64_t)(e->expires - now) * 1000 : 0;
+
+    timer_setup(&e->timer, expiry_fire, e);
+    timer_add_ms(&e->timer, delay_ms);
+    e->armed = 1;
+}
+
+/**
+ * 저널에서 복원한 항목을 호출한 reactor 스레드의 타이머 휠에 등록 (shard 0 에서 한 번)
+ * 이미 지난 항목은 첫 tick 에 삭제된다.
+ */
+void expiry_arm_restored(void) {
+    pthread_mutex_lock(&expiry_lock);
+    for (int b = 0; b < EXPIRY_BUCKETS; b++) {
+        for (ExpiryEntry *e = buckets[b]; e; e = e->next)
+            if (!e->armed) entry_arm(e);
+    }
+    pthread_mutex_unlock(&expiry_lock);
+}
+
+/**
+ * 업로드가 확정된 파일의 만료 예정 등록 (reactor 스레드에서 호출)
+ * 같은 이름의 이전 예정은 취소된다. ttl_seconds 가 0 이면 취소만 한다.
+ */
+void expiry_schedule(const char *filename, int ttl_seconds) {
+    uint64_t h = expiry_hash(filename);
+    char line[300];
+    int len;
+
+    pthread_mutex_lock(&expiry_lock);
+    ExpiryEntry **pp = entry_find(filename, h);
+    int existed = (*pp != NULL);
+    if (existed) entry_remove(pp);
+
+    if (ttl_seconds > 0) {
+        ExpiryEntry *e = entry_new(filename, h, time(NULL) + ttl_seconds);
+        if (e) {
+            len = snprintf(line, sizeof(line), "A %lld %s\n", (long long)e->expires, filename);
+            journal_append(line, (size_t)len);
+            entry_arm(e);
+            server_log("Timed-delete scheduled for %s (ttl=%d sec)", filename, ttl_seconds);
+        } else {
+            server_log("malloc failed for expiry entry (%s)", filename);
+        }
+    } else if (existed) {
+        len = snprintf(line, sizeof(line), "D %s\n", filename);
+        journal_append(line, (size_t)len);
+    }
+
+    journal_maybe_compact();
+    pthread_mutex_unlock(&expiry_lock);
+}
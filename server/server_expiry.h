@@ -0,0 +1,14 @@
+#ifndef SERVER_EXPIRY_H
+#define SERVER_EXPIRY_H
+
+/*
+ * 업로드 파일 TTL 자동 삭제
+ *  - 만료 예정은 STORAGE_DIR 의 저널에 기록해서 서버를 다시 켜도 이어진다.
+ *  - 삭제는 reactor 스레드의 타이머 휠이 처리한다. (파일마다 스레드를 만들지 않음)
+ */
+
+int  expiry_init(void);                     // 저널 읽기 + 정리 (스레드 시작 전)
+void expiry_arm_restored(void);             // 복원한 항목을 이 스레드 타이머에 등록
+void expiry_schedule(const char *filename, int ttl_seconds);   // 0 이면 기존 예정 취소
+
+#endif
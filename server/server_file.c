@@ -1,221 +1,1153 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/random.h>
 #include "protocol.h"
+#include "server_conn.h"
+#include "server_config.h"
+#include "server_proto.h"
+#include "server_user_list.h"
+#include "server_file.h"
+#include "server_metrics.h"
+#include "server_expiry.h"
+#include "server_cas.h"
 
 extern void server_log(const char *fmt, ...);
 
-// 서버 파일 저장 디렉토리
-#define STORAGE_DIR "./server/server_storage/"
+/*
+ * 파일 전송은 연결별 상태 머신으로 처리한다. (이벤트 루프를 막지 않음)
+ *  - 업로드: MSG_FILE_UPLOAD 로 상태를 만들고, 이후 MSG_FILE_DATA / MSG_FILE_END 가
+ *    다른 메시지와 똑같이 이벤트 루프에서 하나씩 처리된다.
+ *  - 다운로드: 소켓에 보낼 수 있는 만큼(최대 XFER_BUDGET) 보내고 돌아온다.
+ *    소켓 버퍼가 가득 차면 EV_WRITE 이벤트를, 예산을 다 쓰면 다음 tick 을 기다린다.
+ *    → 큰 파일을 주고받는 동안에도 다른 사용자의 채팅/DM 이 바로 처리된다.
+ */
 
-// 삭제 타이머 스레드에 넘길 인자 구조체
-typedef struct {
-    char filepath[512];
-    int ttl_seconds;
-} DeleteTaskArgs;
+typedef struct UploadState {
+    int   fd;                 // 임시 파일 (PARTIAL_DIR/<id>.part)
+    char  filename[256];
+    char  partpath[512];
+    char  xfer_id[XFER_ID_LEN];
+    long  filesize;
+    long  offset;             // 임시 파일에 기록된 바이트 수 = 다음 청크 위치
+    int   ttl_seconds;
+} UploadState;
 
-// 일정 시간 후 파일 삭제하는 스레드 함수
-static void* delete_file_after_delay(void *arg) {
-    DeleteTaskArgs *task = (DeleteTaskArgs *)arg;
+typedef struct DownloadState {
+    int   file_fd;         // 일반 파일, 또는 지금 보내는 청크 파일 (-1: 아직 안 엶)
+    CasManifest *man;      // 청크 저장소에 있는 파일이면 매니페스트
+    int   chunk_idx;       // file_fd 가 가리키는 청크 번호
+    off_t off;
+    off_t size;
+    int   bulk;            // sendfile 모드
+    int   body_started;    // bulk 본문 전송 시작 (출력 큐 보류 중)
+    int   ready;           // EV_WRITE 없이 바로 더 보낼 수 있음
+    int   active_idx;      // downloads[] 안의 위치
+    char  filename[256];
+} DownloadState;
 
-    server_log("Timer started for file %s (ttl=%d sec)",
-               task->filepath, task->ttl_seconds);
+/*
+ * 병렬 업로드 세션 (여러 연결이 파일의 서로 다른 구간을 동시에 보낸다)
+ * 세션을 연 연결(owner) 과 구간을 받는 중인 연결 수(refs) 가 모두 없어지면 해제된다.
+ * 구간 연결은 다른 reactor 스레드(shard)에 붙을 수 있으므로 세션 목록/상태는 put_lock 으로 보호한다.
+ * owner 의 c->put 은 owner 의 shard 만 바꾼다.
+ * cas 세션은 임시 파일 없이 구간(= 청크)마다 해시를 받아 청크 저장소에 넣는다.
+ */
+typedef struct PutSession {
+    char   xfer_id[XFER_ID_LEN];
+    unsigned long long token;   // 구간 연결이 세션에 붙을 때 확인하는 비밀 값
+    int    fd;                  // fallocate 로 미리 잡아 둔 임시 파일 (cas 세션은 -1)
+    int    cas;                 // 중복 제거 업로드
+    int    committed;           // 완료됨 (목록에서 빠짐)
+    int    opening;             // 등록은 했고 임시 파일을 만드는 중 (구간을 받지 않음)
+    CasHash *hashes;            // cas: 구간별 청크 해시 (RANGE_DONE 이면 참조를 잡고 있음)
+    char   filename[256];
+    char   partpath[512];
+    long   filesize;
+    long   range_size;
+    int    nranges;
+    int    acked;               // 확정된 구간 수
+    unsigned char *state;       // 구간별 RANGE_*
+    int    refs;                // 구간 본문을 받는 중인 연결 수
+    int    ttl_seconds;
+    Conn  *owner;
+    struct PutSession *next;
+} PutSession;
 
-    sleep(task->ttl_seconds);
+enum { RANGE_EMPTY = 0, RANGE_RECEIVING, RANGE_DONE };
 
-    int ret = unlink(task->filepath);
-    if (ret == 0) {
-        server_log("Timed-delete: removed file %s", task->filepath);
-    } else {
-        server_log("Timed-delete: unlink(%s) failed (errno=%d)",
-                   task->filepath, errno);
+// 구간 연결 1개의 수신 상태 (MSG_FILE_RANGE 헤더 뒤 본문)
+typedef struct RangeRecv {
+    PutSession *s;
+    int   index;
+    off_t off;
+    long  left;
+    char *buf;                  // cas: 해시를 확인할 때까지 청크 본문을 모아 둔다
+    long  len;
+} RangeRecv;
+
+static PutSession *put_sessions = NULL;
+static pthread_mutex_t put_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 진행 중인 다운로드가 있는 연결들
+static __thread Conn **downloads = NULL;
+static __thread int    download_count = 0;
+static __thread int    download_cap = 0;
+
+static void send_error(Conn *c, const char *text) {
+    Message err;
+    memset(&err, 0, sizeof(err));
+    err.type = MSG_ERROR;
+    strcpy(err.sender, "SERVER");
+    strncpy(err.data, text, sizeof(err.data) - 1);
+    conn_send_msg(c, &err, 0);
+}
+
+/* ======================== 업로드 ======================== */
+
+/*
+ * 이어받기(resume) 가능한 업로드
+ *  - 업로드는 전송 ID 로 구분한다. ID 는 (사용자, 파일명, 크기) 의 해시라서
+ *    같은 사용자가 같은 파일을 다시 올리면 같은 ID 가 나온다. (클라이언트가 따로 저장할 필요 없음)
+ *  - 데이터는 PARTIAL_DIR/<id>.part 에 pwrite 로 기록하고, MSG_FILE_END 에서 크기가 맞으면
+ *    rename() 으로 한 번에 STORAGE_DIR/<filename> 으로 옮긴다.
+ *    → 다른 사용자가 반쯤 올라간 파일을 내려받는 일이 없다.
+ *  - 연결이 끊겨도 임시 파일은 남는다. 기록된 크기가 곧 확정된 offset 이다.
+ */
+
+/**
+ * 사용자가 주는 파일명 검사 (업로드/이어받기 조회/병렬 업로드/다운로드 공통)
+ * '.' 으로 시작하는 이름은 서버 내부 파일(.expiry.journal, .partial/, .chunks/, .manifests/, .tmp.*)
+ * 자리라서 받지 않는다. ".", ".." 도 여기에 걸린다.
+ */
+static int is_safe_filename(const char *name) {
+    return name[0] != '\0' && name[0] != '.' && strchr(name, '/') == NULL;
+}
+
+static const char *upload_owner(Conn *c, Message *msg) {
+    if (c->authed) return c->username;
+    return msg->sender[0] ? msg->sender : "-";
+}
+
+// 전송 ID: FNV-1a 64bit ("owner\0filename\0filesize")
+static void make_xfer_id(const char *owner, const char *filename, long filesize,
+                         char out[XFER_ID_LEN]) {
+    char key[MAX_NAME + 256 + 32];
+    int len = snprintf(key, sizeof(key), "%s%c%s%c%ld", owner, 0, filename, 0, filesize);
+    if (len > (int)sizeof(key)) len = sizeof(key);
+
+    unsigned long long h = 1469598103934665603ULL;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
     }
+    snprintf(out, XFER_ID_LEN, "%016llx", h);
+}
 
-    free(task);
-    return NULL;
+static void partial_path(const char *xfer_id, char *out, size_t size) {
+    snprintf(out, size, "%s%s.part", PARTIAL_DIR, xfer_id);
 }
 
-ssize_t w;
+// 임시 파일에 이미 기록된 바이트 수 (없거나 크기가 이상하면 0)
+static long committed_offset(const char *partpath, long filesize) {
+    struct stat st;
+    if (stat(partpath, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+    if (st.st_size > filesize) return 0;
+    return (long)st.st_size;
+}
+
+/**
+ * 업로드 이어받기 위치 조회
+ * MSG_FILE_QUERY ("filename filesize") → MSG_FILE_OFFSET ("xfer_id offset")
+ */
+void handle_file_query(Conn *c, Message *msg) {
+    char filename[256];
+    long filesize;
+
+    if (sscanf(msg->data, "%255s %ld", filename, &filesize) != 2 ||
+        filesize < 0 || !is_safe_filename(filename)) {
+        send_error(c, "BAD_FILE_QUERY_FORMAT");
+        return;
+    }
+
+    char xfer_id[XFER_ID_LEN];
+    char partpath[512];
+    make_xfer_id(upload_owner(c, msg), filename, filesize, xfer_id);
+    partial_path(xfer_id, partpath, sizeof(partpath));
+
+    Message reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.type = MSG_FILE_OFFSET;
+    strcpy(reply.sender, "SERVER");
+    snprintf(reply.data, sizeof(reply.data), "%s %ld",
+             xfer_id, committed_offset(partpath, filesize));
+
+    conn_send_msg(c, &reply, 0);
+}
 
 /**
- * 파일 업로드 처리
- * MSG_FILE_UPLOAD → MSG_FILE_READY → MSG_FILE_DATA 반복 → MSG_FILE_END
+ * 파일 업로드 시작
+ * MSG_FILE_UPLOAD → MSG_FILE_READY ("xfer_id offset") → MSG_FILE_DATA 반복 → MSG_FILE_END
+ * data = "filename filesize ttl [resume_offset]"
+ *  - resume_offset 이 없으면 처음부터 새로 받는다.
+ *  - 있으면 서버에 기록된 위치부터 이어받는다. 실제 시작 위치는 READY 의 offset 이다.
  */
-void handle_file_upload(int client_fd, Message *msg) {
+void handle_file_upload(Conn *c, Message *msg) {
     char filename[256];
     long filesize;
     int ttl_seconds = 0;     // 0이면 자동 삭제 없음
+    long resume = -1;
 
-    // MSG_FILE_UPLOAD의 data = "filename filesize ttl"
-    int parsed = sscanf(msg->data, "%s %ld %d", filename, &filesize, &ttl_seconds);
-    if (parsed < 2) {
+    int parsed = sscanf(msg->data, "%255s %ld %d %ld", filename, &filesize, &ttl_seconds, &resume);
+    if (parsed < 2 || filesize < 0 || !is_safe_filename(filename)) {
         // 형식 잘못된 경우
-        Message err;
-        memset(&err, 0, sizeof(err));
-        err.type = MSG_ERROR;
-        strcpy(err.sender, "SERVER");
-        strcpy(err.data, "BAD_FILE_UPLOAD_FORMAT");
-        write(client_fd, &err, sizeof(err));
+        send_error(c, "BAD_FILE_UPLOAD_FORMAT");
         return;
     }
 
-    server_log("File upload request: %s (%ld bytes)", filename, filesize);
-
-    // 저장 경로 구성
-    char filepath[512];
-    sprintf(filepath, "%s%s", STORAGE_DIR, filename);
+    if (c->upload) {
+        send_error(c, "UPLOAD_IN_PROGRESS");
+        return;
+    }
 
-    FILE *fp = fopen(filepath, "wb");
-    if (!fp) {
-        server_log("Fail File creating: %s", filepath);
+    UploadState *u = calloc(1, sizeof(UploadState));
+    if (!u) {
+        send_error(c, "FILE_OPEN_FAIL");
+        return;
+    }
+    make_xfer_id(upload_owner(c, msg), filename, filesize, u->xfer_id);
+    partial_path(u->xfer_id, u->partpath, sizeof(u->partpath));
 
-        Message err;
-        memset(&err, 0, sizeof(err));
-        err.type = MSG_ERROR;
-        strcpy(err.sender, "SERVER");
-        strcpy(err.data, "FILE_OPEN_FAIL");
+    u->fd = open(u->partpath, O_WRONLY | O_CREAT, 0644);
+    if (u->fd < 0) {
+        server_log("Fail File creating: %s (errno=%d)", u->partpath, errno);
+        free(u);
+        send_error(c, "FILE_OPEN_FAIL");
+        return;
+    }
 
-        w = write(client_fd, &err, sizeof(err));
-        if (w < 0) perror("write");
+    // 이어받기: 확정된 위치부터 / 새 업로드: 처음부터
+    u->offset = (parsed >= 4 && resume >= 0) ? committed_offset(u->partpath, filesize) : 0;
+    if (ftruncate(u->fd, u->offset) < 0) {
+        server_log("ftruncate(%s) failed (errno=%d)", u->partpath, errno);
+        close(u->fd);
+        free(u);
+        send_error(c, "FILE_OPEN_FAIL");
         return;
     }
 
-    // 🔹 1) READY 전송
+    strcpy(u->filename, filename);
+    u->filesize = filesize;
+    u->ttl_seconds = ttl_seconds;
+    c->upload = u;
+    metric_gauge_add(G_UPLOADS, 1);
+
+    if (u->offset > 0) {
+        server_log("File upload resumed: %s (id=%s, %ld/%ld bytes)",
+                   filename, u->xfer_id, u->offset, filesize);
+    } else {
+        server_log("File upload request: %s (id=%s, %ld bytes)", filename, u->xfer_id, filesize);
+    }
+
+    // 🔹 1) READY 전송 (이후 청크는 이벤트 루프에서 하나씩 처리)
     Message ready;
     memset(&ready, 0, sizeof(ready));
     ready.type = MSG_FILE_READY;
     strcpy(ready.sender, "SERVER");
+    snprintf(ready.data, sizeof(ready.data), "%s %ld", u->xfer_id, u->offset);
 
-    w = write(client_fd, &ready, sizeof(ready));
-    if (w < 0) perror("write");
+    conn_send_msg(c, &ready, 0);
+}
 
-    long received = 0;
+static void upload_close(Conn *c) {
+    UploadState *u = c->upload;
+    close(u->fd);
+    free(u);
+    c->upload = NULL;
+    metric_gauge_add(G_UPLOADS, -1);
+}
 
-    // 🔹 2) 파일 청크 수신
-    while (1) {
-        Message chunk;
-        int len = read(client_fd, &chunk, sizeof(chunk));
-        if (len <= 0) break;
+/**
+ * 🔹 2) 파일 청크 수신
+ */
+void handle_file_data(Conn *c, Message *msg) {
+    UploadState *u = c->upload;
+    if (!u) {
+        server_log("예상치 못한 위치에서 파일 관련 메시지 수신(type=%d)", msg->type);
+        return;
+    }
 
-        if (chunk.type == MSG_FILE_END) {
-            server_log("Sending File Upload exit signal: %s", filename);
-            break;
-        }
+    if (msg->data_len <= 0) return;
 
-        if (chunk.type == MSG_FILE_DATA) {
-            fwrite(chunk.data, 1, chunk.data_len, fp);
-            received += chunk.data_len;
-        }
+    if (u->offset + msg->data_len > u->filesize) {
+        server_log("File upload overflow: %s (%ld + %d > %ld bytes)",
+                   u->filename, u->offset, msg->data_len, u->filesize);
+        upload_close(c);
+        send_error(c, "UPLOAD_TOO_LARGE");
+        return;
     }
 
-    fclose(fp);
+    ssize_t n = pwrite(u->fd, msg->data, msg->data_len, u->offset);
+    if (n != msg->data_len) {
+        server_log("pwrite(%s) failed (errno=%d)", u->partpath, errno);
+        upload_close(c);
+        send_error(c, "FILE_WRITE_FAIL");
+        return;
+    }
+    u->offset += n;
+    metric_add(M_FILE_BYTES_IN, (uint64_t)n);
+}
+
+/**
+ * 🔹 3) 업로드 종료: 크기가 맞으면 임시 파일을 제자리로 옮긴다
+ */
+void handle_file_end(Conn *c, Message *msg) {
+    UploadState *u = c->upload;
+    if (!u) {
+        server_log("예상치 못한 위치에서 파일 관련 메시지 수신(type=%d)", msg->type);
+        return;
+    }
+
+    server_log("Sending File Upload exit signal: %s", u->filename);
+
+    if (u->offset != u->filesize) {
+        // 임시 파일은 남겨 두고 다음 업로드에서 이어받는다
+        server_log("File upload incomplete: %s (%ld/%ld bytes)",
+                   u->filename, u->offset, u->filesize);
+        upload_close(c);
+        send_error(c, "UPLOAD_INCOMPLETE");
+        return;
+    }
 
-    server_log("File Upload success %s (%ld bytes send)", filename, received);
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", STORAGE_DIR, u->filename);
 
-    // 🔥 TTL 자동 삭제 스레드
-    if (ttl_seconds > 0) {
-        DeleteTaskArgs *task = malloc(sizeof(DeleteTaskArgs));
-        if (task) {
-            memset(task, 0, sizeof(*task));
-            snprintf(task->filepath, sizeof(task->filepath),
-                     "%s%s", STORAGE_DIR, filename);
-            task->ttl_seconds = ttl_seconds;
+    if (rename(u->partpath, filepath) < 0) {
+        server_log("rename(%s -> %s) failed (errno=%d)", u->partpath, filepath, errno);
+        upload_close(c);
+        send_error(c, "FILE_WRITE_FAIL");
+        return;
+    }
 
-            pthread_t tid;
-            pthread_attr_t attr;
+    server_log("File Upload success %s (%ld bytes send)", u->filename, u->offset);
+    cas_remove(u->filename);        // 같은 이름이 청크 저장소에 있었으면 새 내용으로 대체
 
-            pthread_attr_init(&attr);
-            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // 🔥 TTL 자동 삭제 (같은 이름의 이전 예정은 취소)
+    expiry_schedule(u->filename, u->ttl_seconds);
+    upload_close(c);
+}
 
-            int rc = pthread_create(&tid, &attr, delete_file_after_delay, task);
-            pthread_attr_destroy(&attr);
+/* ======================== 병렬 업로드 ======================== */
 
-            if (rc != 0) {
-                server_log("Failed to create delete timer thread for %s (rc=%d)", filename, rc);
-                free(task);
-            } else {
-                server_log("Delete timer thread created for %s", filename);
-            }
+/*
+ * 큰 파일은 여러 연결로 나눠서 올린다. (연결 하나로 1KB 청크만 보내면 빠른 링크를 다 못 씀)
+ *  1) 제어 연결: MSG_FILE_PUT_OPEN ("filename filesize ttl range_size")
+ *                → MSG_FILE_PUT_READY ("xfer_id token range_size nranges")
+ *  2) 구간 연결들(v2, 로그인 불필요): MSG_FILE_RANGE ("xfer_id token index") 뒤에
+ *     구간 본문(range_size, 마지막 구간은 나머지)을 그대로 보낸다 → MSG_FILE_RANGE_ACK ("index ok|done")
+ *  3) 모든 구간이 확정되면 서버가 임시 파일을 rename() 으로 제자리에 옮기고 "done" 으로 알린다.
+ * 구간은 pwrite 로 자기 위치에 바로 기록하므로 도착 순서는 상관없다.
+ *
+ * 중복 제거 업로드 (PUT_OPEN 끝에 "cas", READY 끝에도 "cas")
+ *  - 구간 크기는 CAS_CHUNK_SIZE 로 고정. 구간 헤더에 본문 대신 먼저 BLAKE3 해시를 보낸다:
+ *    MSG_FILE_RANGE ("xfer_id token index hash")
+ *  - 서버에 이미 있는 청크면 "index have" (본문 없음), 없으면 "index need" → 그때 본문을 보내고
+ *    서버가 해시를 확인해 저장한 뒤 "index ok" 로 답한다. 마지막 구간은 어느 쪽이든 "index done".
+ *  - 완료되면 파일 내용은 청크 목록(매니페스트)으로만 남는다. (server_cas.c)
+ */
 
+static PutSession *put_session_find(const char *xfer_id) {
+    for (PutSession *s = put_sessions; s; s = s->next) {
+        if (strcmp(s->xfer_id, xfer_id) == 0) return s;
+    }
+    return NULL;
+}
+
+static void put_session_unlink(PutSession *s) {
+    PutSession **pp = &put_sessions;
+    while (*pp && *pp != s) pp = &(*pp)->next;
+    if (*pp) *pp = s->next;
+}
+
+static void put_session_free(PutSession *s) {
+    put_session_unlink(s);
+
+    if (!s->committed) {
+        if (s->cas) {
+            // 받아 둔 청크는 저장소에 남아서 다시 올릴 때 그대로 쓰인다
+            for (int i = 0; i < s->nranges; i++)
+                if (s->state[i] == RANGE_DONE) cas_chunk_unpin(s->hashes[i]);
         } else {
-            server_log("malloc failed for DeleteTaskArgs");
+            // 완료되지 않은 세션의 임시 파일은 지운다 (구간 상태가 메모리에만 있으므로 이어받을 수 없음)
+            close(s->fd);
+            unlink(s->partpath);
         }
+        server_log("Parallel upload dropped: %s (%d/%d ranges)",
+                   s->filename, s->acked, s->nranges);
     }
+    free(s->hashes);
+    free(s->state);
+    free(s);
+}
+
+// 더 이상 붙어 있는 연결이 없으면 해제
+static void put_session_release(PutSession *s) {
+    if (s->refs == 0 && s->owner == NULL) put_session_free(s);
 }
 
+static unsigned long long put_token(void) {
+    unsigned long long t;
+    if (getrandom(&t, sizeof(t), 0) != (ssize_t)sizeof(t)) {
+        t = ((unsigned long long)time(NULL) << 32) ^ (unsigned long long)getpid() ^
+            (unsigned long long)(uintptr_t)&t;
+    }
+    return t;
+}
+
+/**
+ * 구간을 모을 임시 파일을 만들고 전체 크기만큼 공간을 잡는다 (cas 가 아닌 세션)
+ */
+static int put_partial_open(PutSession *s, long filesize) {
+    snprintf(s->partpath, sizeof(s->partpath), "%s%s.ranges", PARTIAL_DIR, s->xfer_id);
+    s->fd = open(s->partpath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (s->fd < 0) {
+        server_log("Fail File creating: %s (errno=%d)", s->partpath, errno);
+        return -1;
+    }
+
+    // 디스크 공간을 미리 잡아 두면 구간들이 흩어져 써져도 단편화/공간 부족이 시작 시점에 드러난다
+    int rc = posix_fallocate(s->fd, 0, filesize);
+    if (rc != 0) {
+        if (rc != EOPNOTSUPP && rc != EINVAL) {
+            server_log("fallocate(%s, %ld) failed (errno=%d)", s->partpath, filesize, rc);
+            close(s->fd);
+            unlink(s->partpath);
+            s->fd = -1;
+            return -1;
+        }
+        if (ftruncate(s->fd, filesize) < 0) {
+            server_log("ftruncate(%s) failed (errno=%d)", s->partpath, errno);
+        }
+    }
+    return 0;
+}
 
 /**
- * 파일 다운로드 처리
- * MSG_FILE_DOWNLOAD → MSG_FILE_READY → MSG_FILE_DATA 반복 → MSG_FILE_END
+ * 병렬 업로드 세션 열기
  */
-void handle_file_download(int client_fd, Message *msg) {
+void handle_file_put_open(Conn *c, Message *msg) {
     char filename[256];
-    strcpy(filename, msg->data);
+    long filesize;
+    int ttl_seconds = 0;
+    long range_size = PUT_RANGE_DEFAULT;
+    char mode[8] = "";
 
-    server_log("File Download Request: %s", filename);
+    int parsed = sscanf(msg->data, "%255s %ld %d %ld %7s",
+                        filename, &filesize, &ttl_seconds, &range_size, mode);
+    if (parsed < 2 || filesize <= 0 || !is_safe_filename(filename)) {
+        send_error(c, "BAD_FILE_UPLOAD_FORMAT");
+        return;
+    }
 
-    char filepath[512];
-    sprintf(filepath, "%s%s", STORAGE_DIR, filename);
+    if (c->upload) {
+        send_error(c, "UPLOAD_IN_PROGRESS");
+        return;
+    }
+    if (c->put) {
+        // 이전 세션이 (다른 shard 에서) 이미 완료됐으면 여기서 떼어 낸다
+        pthread_mutex_lock(&put_lock);
+        PutSession *old = c->put;
+        int finished = old->committed;
+        if (finished) {
+            old->owner = NULL;
+            c->put = NULL;
+            put_session_release(old);
+        }
+        pthread_mutex_unlock(&put_lock);
+
+        if (!finished) {
+            send_error(c, "UPLOAD_IN_PROGRESS");
+            return;
+        }
+    }
 
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp) {
-        server_log("There are no file in directory: %s", filename);
+    int cas = strcmp(mode, "cas") == 0;
+    if (cas) range_size = CAS_CHUNK_SIZE;       // 구간 = 저장소 청크
+    if (range_size < PUT_RANGE_MIN) range_size = PUT_RANGE_MIN;
+    if (range_size > PUT_RANGE_MAX) range_size = PUT_RANGE_MAX;
 
-        Message err;
-        memset(&err, 0, sizeof(err));
-        err.type = MSG_ERROR;
-        strcpy(err.sender, "SERVER");
-        strcpy(err.data, "NOFILE");
+    PutSession *s = calloc(1, sizeof(PutSession));
+    if (!s) {
+        send_error(c, "FILE_OPEN_FAIL");
+        return;
+    }
+    make_xfer_id(upload_owner(c, msg), filename, filesize, s->xfer_id);
 
-        w = write(client_fd, &err, sizeof(err));
-        if (w < 0) perror("write");
+    s->nranges = (int)((filesize + range_size - 1) / range_size);
+    s->state = calloc(s->nranges, 1);
+    s->cas = cas;
+    s->fd = -1;
+    if (s->state && cas) s->hashes = calloc(s->nranges, sizeof(CasHash));
+    if (!s->state || (cas && !s->hashes)) {
+        free(s->hashes);
+        free(s->state);
+        free(s);
+        send_error(c, "FILE_OPEN_FAIL");
+        return;
+    }
+    strcpy(s->filename, filename);
+    s->filesize = filesize;
+    s->range_size = range_size;
+    s->ttl_seconds = ttl_seconds;
+    s->opening = 1;
 
+    // 같은 전송 ID 확인과 등록은 한 번에 한다 (같은 사용자가 동시에 열어도 하나만 통과)
+    pthread_mutex_lock(&put_lock);
+    int busy = put_session_find(s->xfer_id) != NULL;
+    if (!busy) {
+        s->next = put_sessions;
+        put_sessions = s;
+    }
+    pthread_mutex_unlock(&put_lock);
+    if (busy) {
+        free(s->hashes);
+        free(s->state);
+        free(s);
+        send_error(c, "UPLOAD_IN_PROGRESS");
         return;
     }
 
-    // 🔹 1) 파일 다운로드 준비됨 알림
+    // 임시 파일은 등록한 뒤 잠금 밖에서 만든다 (그동안 구간 연결은 opening 을 보고 거절됨)
+    int rc = cas ? 0 : put_partial_open(s, filesize);
+    unsigned long long token = put_token();
+
+    pthread_mutex_lock(&put_lock);
+    if (rc < 0) {
+        put_session_unlink(s);
+    } else {
+        s->token = token;
+        s->opening = 0;
+        s->owner = c;
+    }
+    pthread_mutex_unlock(&put_lock);
+
+    if (rc < 0) {
+        free(s->hashes);
+        free(s->state);
+        free(s);
+        send_error(c, "FILE_OPEN_FAIL");
+        return;
+    }
+    c->put = s;
+
+    server_log("Parallel upload request: %s (id=%s, %ld bytes, %d x %ld%s)",
+               filename, s->xfer_id, filesize, s->nranges, range_size, cas ? ", dedup" : "");
+
     Message ready;
     memset(&ready, 0, sizeof(ready));
-    ready.type = MSG_FILE_READY;
+    ready.type = MSG_FILE_PUT_READY;
     strcpy(ready.sender, "SERVER");
+    snprintf(ready.data, sizeof(ready.data), "%s %016llx %ld %d%s",
+             s->xfer_id, s->token, s->range_size, s->nranges, cas ? " cas" : "");
+
+    conn_send_msg(c, &ready, 0);
+}
+
+static void send_range_ack(Conn *c, int index, const char *state) {
+    Message ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.type = MSG_FILE_RANGE_ACK;
+    strcpy(ack.sender, "SERVER");
+    snprintf(ack.data, sizeof(ack.data), "%d %s", index, state);
+    conn_send_msg(c, &ack, 0);
+}
+
+/**
+ * 다 받은 세션을 제자리에 옮긴다 (put_lock 없이). 반환: 0 = 성공, -1 = 실패 (올린 내용은 버려짐)
+ */
+static int put_session_commit(PutSession *s) {
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", STORAGE_DIR, s->filename);
+
+    if (s->cas) {
+        // 청크 참조는 매니페스트로 넘어간다 (실패해도 cas_commit 이 참조를 정리한다)
+        if (cas_commit(s->filename, s->filesize, s->range_size, s->nranges,
+                       (const CasHash *)s->hashes) < 0) {
+            server_log("Dedup upload commit failed: %s", s->filename);
+            return -1;
+        }
+    } else {
+        close(s->fd);
+        s->fd = -1;
 
-    w = write(client_fd, &ready, sizeof(ready));
-    if (w < 0) perror("write");
+        if (rename(s->partpath, filepath) < 0) {
+            server_log("Parallel upload commit failed: rename(%s -> %s) (errno=%d)",
+                       s->partpath, filepath, errno);
+            unlink(s->partpath);
+            return -1;
+        }
+        cas_remove(s->filename);    // 같은 이름이 청크 저장소에 있었으면 새 내용으로 대체
+    }
+
+    server_log("File Upload success %s (%ld bytes, %d ranges)",
+               s->filename, s->filesize, s->nranges);
+
+    expiry_schedule(s->filename, s->ttl_seconds);
+    return 0;
+}
+
+/**
+ * 마지막 구간이 확정된 세션 완료 (put_lock 을 잡은 채로 부른다)
+ * 목록에서 먼저 빼서 같은 파일을 바로 다시 올릴 수 있게 하고, 디스크 작업(rename, 매니페스트,
+ * TTL 기록) 동안은 잠금을 풀어 다른 shard 의 구간 처리를 막지 않는다.
+ * 그 사이 세션이 해제되지 않도록 refs 를 하나 잡아 둔다.
+ */
+static int put_session_finish(PutSession *s) {
+    s->committed = 1;
+    put_session_unlink(s);
+    s->refs++;
+    pthread_mutex_unlock(&put_lock);
+
+    int rc = put_session_commit(s);
 
-    // 🔹 2) 파일 청크 전송
-    char buffer[MAX_BUF];
-    int n;
+    pthread_mutex_lock(&put_lock);
+    s->refs--;
+    return rc;
+}
+
+// 구간 index 의 길이 (마지막 구간은 나머지)
+static long range_len(const PutSession *s, int index) {
+    long left = s->filesize - (long)index * s->range_size;
+    return left > s->range_size ? s->range_size : left;
+}
 
-    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
-        server_log("SEND DATA: %d bytes", n);
+/**
+ * 구간 수신 시작 (MSG_FILE_RANGE 헤더). 잘못된 요청이면 본문과 동기가 안 맞으므로 연결을 끊는다.
+ * cas 세션이면 해시로 먼저 확인해서, 이미 있는 청크는 본문 없이 바로 확정한다.
+ */
+void handle_file_range(Conn *c, Message *msg) {
+    char xfer_id[XFER_ID_LEN];
+    char hex[2 * BLAKE3_OUT_LEN + 2] = "";
+    unsigned long long token;
+    int index;
+    CasHash hash;
 
-        Message chunk;
-        memset(&chunk, 0, sizeof(chunk));
-        chunk.type = MSG_FILE_DATA;
-        strcpy(chunk.sender, "SERVER");
+    int parsed = sscanf(msg->data, "%16s %llx %d %65s", xfer_id, &token, &index, hex);
 
-        memcpy(chunk.data, buffer, n);
-        chunk.data_len = n;
+    pthread_mutex_lock(&put_lock);
+    PutSession *s = parsed >= 3 ? put_session_find(xfer_id) : NULL;
 
-        w = write(client_fd, &chunk, sizeof(chunk));
-        if (w < 0) perror("write");
+    const char *err = NULL;
+    if (!s || s->opening || s->token != token) err = "NO_UPLOAD_SESSION";
+    else if (c->proto != PROTO_V2) err = "RANGE_NEEDS_V2";
+    else if (c->range || index < 0 || index >= s->nranges || s->state[index] != RANGE_EMPTY)
+        err = "BAD_RANGE";
+    else if (s->cas && blake3_from_hex(hex, hash) < 0)
+        err = "BAD_RANGE";
+
+    if (!err && s->cas && cas_chunk_pin(hash)) {
+        // 이미 있는 청크: 참조만 잡고 확정
+        long len = range_len(s, index);
+        memcpy(s->hashes[index], hash, sizeof(CasHash));
+        s->state[index] = RANGE_DONE;
+        s->acked++;
+
+        int done = (s->acked == s->nranges);
+        int rc = done ? put_session_finish(s) : 0;
+        put_session_release(s);     // owner 가 이미 떠났으면 여기서 해제
+        pthread_mutex_unlock(&put_lock);
+
+        metric_add(M_CAS_CHUNKS_REUSED, 1);
+        metric_add(M_CAS_BYTES_REUSED, (uint64_t)len);
+        if (rc < 0) send_error(c, "FILE_COMMIT_FAIL");
+        else send_range_ack(c, index, done ? "done" : "have");
+        return;
     }
 
-    fclose(fp);
+    RangeRecv *r = err ? NULL : calloc(1, sizeof(RangeRecv));
+    if (r && s->cas) {
+        r->len = range_len(s, index);
+        r->buf = malloc((size_t)r->len);
+        if (!r->buf) {
+            free(r);
+            r = NULL;
+        }
+    }
+    if (r) {
+        s->state[index] = RANGE_RECEIVING;
+        s->refs++;
+        if (s->cas) memcpy(s->hashes[index], hash, sizeof(CasHash));
+    }
+    pthread_mutex_unlock(&put_lock);
+
+    if (!r) {
+        server_log("Range rejected (socket %d): %s", c->fd, err ? err : "no memory");
+        send_error(c, err ? err : "FILE_OPEN_FAIL");
+        disconnect_client(c);
+        return;
+    }
+
+    r->s = s;
+    r->index = index;
+    r->off = (off_t)index * s->range_size;
+    r->left = range_len(s, index);
+    c->range = r;
+    metric_gauge_add(G_RANGES, 1);
+
+    if (s->cas) send_range_ack(c, index, "need");
+}
+
+int file_range_receiving(Conn *c) {
+    return c->range != NULL;
+}
+
+static void range_free(RangeRecv *r) {
+    free(r->buf);
+    free(r);
+}
+
+/**
+ * 받다 만 (또는 잘못 받은) 구간을 비워서 다른 연결이 다시 보낼 수 있게 한다
+ */
+static void range_abort(Conn *c) {
+    RangeRecv *r = c->range;
+    pthread_mutex_lock(&put_lock);
+    r->s->state[r->index] = RANGE_EMPTY;
+    r->s->refs--;
+    put_session_release(r->s);
+    pthread_mutex_unlock(&put_lock);
+    c->range = NULL;
+    metric_gauge_add(G_RANGES, -1);
+    range_free(r);
+}
+
+/**
+ * cas 구간 본문을 다 받았으면 해시를 확인하고 청크 저장소에 넣는다
+ */
+static int range_store_chunk(RangeRecv *r) {
+    CasHash got;
+    blake3_hash(r->buf, (size_t)r->len, got);
+    if (memcmp(got, r->s->hashes[r->index], sizeof(CasHash)) != 0) {
+        server_log("Range %d of %s: chunk hash mismatch", r->index, r->s->filename);
+        return -1;
+    }
+    if (cas_chunk_store(got, r->buf, (size_t)r->len) < 0) return -1;
+    metric_add(M_CAS_CHUNKS_STORED, 1);
+    return 0;
+}
+
+/**
+ * 구간 확정. 반환: 0 = 정상, -1 = 잘못된 본문 (연결 종료)
+ */
+static int range_complete(Conn *c) {
+    RangeRecv *r = c->range;
+    PutSession *s = r->s;
+
+    if (s->cas && range_store_chunk(r) < 0) {
+        send_error(c, "BAD_CHUNK");
+        range_abort(c);
+        return -1;
+    }
+
+    pthread_mutex_lock(&put_lock);
+    s->state[r->index] = RANGE_DONE;
+    s->acked++;
+    s->refs--;
+    c->range = NULL;
+    metric_gauge_add(G_RANGES, -1);
+
+    int done = (s->acked == s->nranges);
+    int rc = done ? put_session_finish(s) : 0;
+    put_session_release(s);     // owner 가 이미 떠났으면 여기서 해제
+    pthread_mutex_unlock(&put_lock);
+
+    if (rc < 0) send_error(c, "FILE_COMMIT_FAIL");
+    else send_range_ack(c, r->index, done ? "done" : "ok");
+    range_free(r);
+    return 0;
+}
+
+/**
+ * 구간 본문 수신: 소켓에서 읽은 만큼 바로 pwrite 한다. (최대 XFER_BUDGET)
+ * 헤더 프레임과 같이 입력 버퍼에 들어온 본문 앞부분을 먼저 쓴다.
+ * cas 구간은 해시를 확인할 때까지 메모리에 모은다.
+ * 반환: 1 = 진행함 (구간 완료 또는 예산 소진), 0 = 읽을 데이터 없음, -1 = 연결 종료/오류
+ */
+int file_range_recv(Conn *c) {
+    static __thread char buffer[64 * 1024];
+    RangeRecv *r = c->range;
+    size_t budget = rate_budget(c, XFER_BUDGET);
+
+    while (r->left > 0 && budget > 0) {
+        size_t want = r->left < (long)sizeof(buffer) ? (size_t)r->left : sizeof(buffer);
+        if (want > budget) want = budget;   // 짧게 읽은 뒤 남은 예산보다 더 읽지 않도록
+        char *dst = r->buf ? r->buf + (r->len - r->left) : buffer;
+        ssize_t n = (ssize_t)conn_rx_take(c, dst, want);
+        if (n == 0) {
+            n = recv(c->fd, dst, want, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+                return -1;
+            }
+            if (n == 0) return -1;
+            metric_add(M_BYTES_IN, (uint64_t)n);
+            rate_charge_bytes(c, (size_t)n);
+        }
+
+        for (ssize_t done = 0; !r->buf && done < n; ) {
+            ssize_t w = pwrite(r->s->fd, buffer + done, n - done, r->off + done);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                server_log("pwrite(%s) failed (errno=%d)", r->s->partpath, errno);
+                return -1;
+            }
+            done += w;
+        }
+        r->off += n;
+        r->left -= n;
+        budget -= n;
+        metric_add(M_FILE_BYTES_IN, (uint64_t)n);
+    }
+
+    if (r->left == 0 && range_complete(c) < 0) return -1;
+    return 1;
+}
+
+/* ======================== 다운로드 ======================== */
+
+static void download_finish(Conn *c, int ok) {
+    DownloadState *d = c->download;
+
+    // downloads[] 에서 제거 (마지막 원소와 자리 교환)
+    Conn *last = downloads[--download_count];
+    downloads[d->active_idx] = last;
+    last->download->active_idx = d->active_idx;
+
+    if (d->file_fd >= 0) close(d->file_fd);
+    if (d->man) cas_release(d->man);
+    c->download = NULL;
+    metric_gauge_add(G_DOWNLOADS, -1);
+    c->outq.hold = 0;
+
+    if (ok) {
+        // 🔹 3) 파일 전송 완료 메시지
+        Message end;
+        memset(&end, 0, sizeof(end));
+        end.type = MSG_FILE_END;
+        strcpy(end.sender, "SERVER");
+        strcpy(end.data, d->filename);
+        end.data_len = 0;
+
+        conn_send_msg(c, &end, 0);
+
+        // 본문 끝 조각과 END 프레임을 같이 내보내고 cork 를 푼다
+        if (conn_flush(c) == 0) conn_cork(c, 0);
+
+        server_log("Success File Download: %s (%lld bytes, %s)",
+                   d->filename, (long long)d->size, d->bulk ? "sendfile" : "chunk");
+    }
+    free(d);
+}
+
+/**
+ * d->off 를 담고 있는 파일과 그 안의 위치
+ * 청크 저장소의 파일이면 해당 청크 파일을 (바뀔 때만) 연다.
+ * 반환: 그 파일에서 이어서 보낼 수 있는 바이트 수, -1 = 청크를 열 수 없음
+ */
+static long download_source(DownloadState *d, off_t *pos) {
+    if (!d->man) {
+        *pos = d->off;
+        return (long)(d->size - d->off);
+    }
+    if (d->off >= d->size) return 0;
+
+    int idx = (int)(d->off / d->man->chunk_size);
+    if (idx != d->chunk_idx) {
+        if (d->file_fd >= 0) close(d->file_fd);
+        d->file_fd = cas_open_chunk(d->man, idx);
+        d->chunk_idx = idx;
+        if (d->file_fd < 0) {
+            server_log("CAS: chunk %d of %s is missing (errno=%d)", idx, d->filename, errno);
+            return -1;
+        }
+    }
+    *pos = d->off - (off_t)idx * d->man->chunk_size;
+    return cas_chunk_len(d->man, idx) - (long)*pos;
+}
+
+/**
+ * bulk 본문: 파일을 page cache 에서 소켓으로 바로 보낸다 (sendfile)
+ */
+static void pump_bulk(Conn *c, DownloadState *d) {
+    size_t budget = rate_budget(c, XFER_BUDGET);
+
+    if (!d->body_started) {
+        // 헤더 프레임 등 큐에 있던 것이 본문보다 먼저 나가야 한다
+        if (conn_flush(c) < 0) return;
+        if (c->outq.count > 0) return;      // EV_WRITE 대기
+
+        d->body_started = 1;
+        c->outq.hold = 1;                   // 본문이 끝날 때까지 다른 프레임은 큐에서 대기
+    }
+
+    while (d->off < d->size && budget > 0) {
+        off_t pos;
+        long avail = download_source(d, &pos);
+        if (avail < 0) {
+            disconnect_client(c);
+            return;
+        }
+        size_t want = (size_t)avail;
+        if (want > budget) want = budget;
+
+        ssize_t n = sendfile(c->fd, d->file_fd, &pos, want);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_want_write(c, 1);
+                return;
+            }
+            server_log("sendfile failed (socket %d, errno=%d)", c->fd, errno);
+            disconnect_client(c);
+            return;
+        }
+        if (n == 0) {
+            server_log("File shrank during download (socket %d)", c->fd);
+            disconnect_client(c);
+            return;
+        }
+        d->off += n;
+        budget -= n;
+        metric_add(M_BYTES_OUT, (uint64_t)n);
+        metric_add(M_FILE_BYTES_OUT, (uint64_t)n);
+        rate_charge_bytes(c, (size_t)n);
+    }
+
+    if (d->off < d->size) {
+        d->ready = 1;                       // 예산 소진 → 다음 tick
+        return;
+    }
+    download_finish(c, 1);
+}
 
-    // 🔹 3) 파일 전송 완료 메시지
-    Message end;
-    memset(&end, 0, sizeof(end));
-    end.type = MSG_FILE_END;
-    strcpy(end.sender, "SERVER");
-    strcpy(end.data, filename);
-    end.data_len = 0;
+/**
+ * 청크 본문: 출력 큐가 low watermark 아래로 내려갈 때마다 채운다
+ */
+static void pump_chunks(Conn *c, DownloadState *d) {
+    size_t budget = rate_budget(c, XFER_BUDGET);
+
+    Message chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.type = MSG_FILE_DATA;
+    strcpy(chunk.sender, "SERVER");
+
+    while (budget > 0) {
+        if (c->outq.bytes >= g_config.outq_low_wm) {
+            if (conn_flush(c) < 0) return;
+            if (c->outq.bytes >= g_config.outq_low_wm) return;   // EV_WRITE 대기
+        }
 
-    w = write(client_fd, &end, sizeof(end));
-    if (w < 0) perror("write");
+        off_t pos;
+        long avail = download_source(d, &pos);
+        if (avail < 0) {
+            disconnect_client(c);
+            return;
+        }
+        size_t want = avail < (long)sizeof(chunk.data) ? (size_t)avail : sizeof(chunk.data);
+        if (want > budget) want = budget;   // 바이트 잔액보다 큰 청크는 잘라서 보낸다
+
+        ssize_t n = want > 0 ? pread(d->file_fd, chunk.data, want, pos) : 0;
+        if (n <= 0) {
+            download_finish(c, 1);
+            return;
+        }
+        chunk.data_len = (int)n;
+        d->off += n;
+
+        metric_add(M_FILE_BYTES_OUT, (uint64_t)n);
+        rate_charge_bytes(c, (size_t)n);
+        if (conn_send_msg(c, &chunk, 0) < 0) return;
+        budget -= n;
+    }
+    d->ready = 1;
+}
+
+/**
+ * 다운로드 진행 (쓰기 가능 이벤트 / 다음 tick 에 호출)
+ */
+void file_download_pump(Conn *c) {
+    DownloadState *d = c->download;
+    if (!d) return;
 
-    server_log("Success File Download: %s", filename);
+    // 쓰기 가능 이벤트로 왔어도 버킷이 비었으면 미뤄 둔다 (찬 뒤 다음 tick 에 진행)
+    d->ready = 1;
+    if (rate_throttle(c, 0)) return;
+
+    d->ready = 0;
+    if (d->bulk) pump_bulk(c, d);
+    else pump_chunks(c, d);
+}
+
+/**
+ * EV_WRITE 를 기다리지 않고 바로 진행할 수 있는지
+ * (예산 소진으로 멈췄거나, tick 끝의 flush 로 큐가 비워져 쓰기 대기가 풀린 경우)
+ */
+static int download_can_progress(Conn *c) {
+    // 바이트 버킷이 비었으면 찰 때까지 쉰다 (rate_timer 가 이벤트 루프를 깨운다)
+    return (c->download->ready || !c->outq.write_armed) && !rate_throttle(c, 0);
+}
+
+/**
+ * 바로 진행할 수 있는 다운로드가 있는지 (있으면 이벤트 루프는 기다리지 않고 한 바퀴 더 돈다)
+ */
+int file_transfers_pending(void) {
+    for (int i = 0; i < download_count; i++) {
+        if (download_can_progress(downloads[i])) return 1;
+    }
+    return 0;
+}
+
+void file_transfers_run(void) {
+    // pump 중 다운로드가 끝나면 배열이 바뀌므로 뒤에서부터
+    for (int i = download_count - 1; i >= 0; i--) {
+        if (i >= download_count) continue;
+        Conn *c = downloads[i];
+        if (download_can_progress(c)) file_download_pump(c);
+    }
+}
+
+/**
+ * 파일 다운로드 요청 처리
+ * MSG_FILE_DOWNLOAD ("filename [bulk|chunk] [offset]")
+ *  - 청크 모드: MSG_FILE_READY ("filename size offset") → MSG_FILE_DATA 반복 → MSG_FILE_END
+ *  - bulk 모드: MSG_FILE_BULK ("filename size offset") → 파일 본문 (size - offset) 바이트 → MSG_FILE_END
+ *    (클라이언트가 "bulk" 를 요청하고 v2 프레임을 쓰는 경우만)
+ *  - offset: 이미 받아 둔 바이트 수. 그 위치부터 이어서 보낸다. (파일보다 크면 처음부터)
+ */
+void handle_file_download(Conn *c, Message *msg) {
+    char filename[256];
+    char mode[16] = "";
+    long long offset = 0;
+
+    if (sscanf(msg->data, "%255s %15s %lld", filename, mode, &offset) < 1) {
+        filename[0] = '\0';
+    }
+
+    server_log("File Download Request: %s", filename);
+
+    if (c->download) {
+        send_error(c, "DOWNLOAD_IN_PROGRESS");
+        return;
+    }
+
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", STORAGE_DIR, filename);
+
+    // 청크 저장소에 있는 파일이면 매니페스트를 잡고, 청크 파일은 보내면서 연다
+    CasManifest *man = is_safe_filename(filename) ? cas_lookup(filename) : NULL;
+    int file_fd = -1;
+    struct stat st;
+    if (man) {
+        st.st_size = man->size;
+    } else {
+        file_fd = is_safe_filename(filename) ? open(filepath, O_RDONLY) : -1;
+        if (file_fd < 0 || fstat(file_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            server_log("There are no file in directory: %s", filename);
+            if (file_fd >= 0) close(file_fd);
+            send_error(c, "NOFILE");
+            return;
+        }
+    }
+
+    if (download_count == download_cap) {
+        int new_cap = download_cap ? download_cap * 2 : 16;
+        Conn **p = realloc(downloads, sizeof(Conn *) * new_cap);
+        if (!p) {
+            if (file_fd >= 0) close(file_fd);
+            if (man) cas_release(man);
+            send_error(c, "NOFILE");
+            return;
+        }
+        downloads = p;
+        download_cap = new_cap;
+    }
+
+    DownloadState *d = calloc(1, sizeof(DownloadState));
+    if (!d) {
+        if (file_fd >= 0) close(file_fd);
+        if (man) cas_release(man);
+        send_error(c, "NOFILE");
+        return;
+    }
+    if (offset < 0 || offset > st.st_size) offset = 0;
+
+    d->file_fd = file_fd;
+    d->man = man;
+    d->chunk_idx = -1;
+    d->off = offset;
+    d->size = st.st_size;
+    d->bulk = (strcmp(mode, "bulk") == 0 && c->proto == PROTO_V2);
+    d->ready = 1;
+    d->active_idx = download_count;
+    strcpy(d->filename, filename);
+
+    downloads[download_count++] = c;
+    c->download = d;
+    metric_gauge_add(G_DOWNLOADS, 1);
+    conn_cork(c, 1);        // 헤더 + 본문을 MSS 단위로 채워 보낸다 (download_finish 에서 해제)
+
+    if (offset > 0) {
+        server_log("File download resumed: %s at %lld/%lld bytes",
+                   filename, offset, (long long)st.st_size);
+    }
+
+    // 🔹 1) 파일 다운로드 준비됨 알림 (크기와 시작 위치도 같이 알림)
+    Message ready;
+    memset(&ready, 0, sizeof(ready));
+    ready.type = d->bulk ? MSG_FILE_BULK : MSG_FILE_READY;
+    strcpy(ready.sender, "SERVER");
+    snprintf(ready.data, sizeof(ready.data), "%s %lld %lld",
+             filename, (long long)st.st_size, offset);
+
+    // 🔹 2) 본문은 file_transfers_run() 에서 조금씩 전송
+    conn_send_msg(c, &ready, 0);
+}
+
+/**
+ * 연결 종료 시 진행 중인 전송 정리
+ */
+void file_transfer_abort(Conn *c) {
+    if (c->upload) {
+        UploadState *u = c->upload;
+        server_log("File upload interrupted: %s (id=%s, %ld/%ld bytes kept for resume)",
+                   u->filename, u->xfer_id, u->offset, u->filesize);
+        upload_close(c);
+    }
+    if (c->range) {
+        // 받다 만 구간은 다른 연결이 다시 보낼 수 있도록 비워 둔다
+        range_abort(c);
+    }
+    if (c->put) {
+        PutSession *s = c->put;
+        pthread_mutex_lock(&put_lock);
+        s->owner = NULL;
+        put_session_release(s);
+        pthread_mutex_unlock(&put_lock);
+        c->put = NULL;
+    }
+    if (c->download) {
+        server_log("File download aborted: %s", c->download->filename);
+        download_finish(c, 0);
+    }
 }
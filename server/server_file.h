@@ -0,0 +1,40 @@
+#ifndef SERVER_FILE_H
+#define SERVER_FILE_H
+
+#include "protocol.h"
+#include "server_conn.h"
+
+// 서버 파일 저장 디렉토리
+#define STORAGE_DIR "./server/server_storage/"
+
+// 업로드 중인 파일 (이어받기용 임시 파일) 디렉토리
+#define PARTIAL_DIR STORAGE_DIR ".partial/"
+
+// 전송 ID 문자열 길이 (16진수 16자리 + NUL)
+#define XFER_ID_LEN 17
+
+// 병렬 업로드 구간 크기 범위 (클라이언트가 요청한 값을 이 안으로 맞춤)
+#define PUT_RANGE_MIN     (64 * 1024)
+#define PUT_RANGE_DEFAULT (4 * 1024 * 1024)
+#define PUT_RANGE_MAX     (64 * 1024 * 1024)
+
+// 한 번의 pump 에서 연결 하나가 보낼 수 있는 최대 바이트 (다른 연결과 번갈아 처리)
+#define XFER_BUDGET (256 * 1024)
+
+void handle_file_query(Conn *c, Message *msg);
+void handle_file_upload(Conn *c, Message *msg);
+void handle_file_data(Conn *c, Message *msg);
+void handle_file_end(Conn *c, Message *msg);
+void handle_file_download(Conn *c, Message *msg);
+void handle_file_put_open(Conn *c, Message *msg);
+void handle_file_range(Conn *c, Message *msg);
+
+int  file_range_receiving(Conn *c);
+int  file_range_recv(Conn *c);
+
+void file_download_pump(Conn *c);
+int  file_transfers_pending(void);
+void file_transfers_run(void);
+void file_transfer_abort(Conn *c);
+
+#endif
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "frame.h"
+#include "server_history.h"
+
+/*
+ * 레코드 = 헤더 + 보낸 사람 + 본문, 8바이트 단위로 맞춘다.
+ * arena 는 [head, tail) 가 사용 중인 원형 버퍼. 끝에 레코드가 안 들어가면 0 으로 돌아가
+ * 쓰고 (끝 부분은 버림), 자리가 날 때까지 가장 오래된 레코드를 버린다.
+ * 레코드 위치는 idx[seq % cap] 에 있으므로 head 는 따로 두지 않는다.
+ */
+
+typedef struct {
+    uint64_t seq;
+    uint16_t len;               // 본문 길이
+    uint8_t  type;
+    uint8_t  sender_len;
+} HistRec;
+
+#define REC_ALIGN(n) (((n) + 7u) & ~7u)
+
+HistoryRing history_lobby = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+int history_ring_init(HistoryRing *r, size_t arena_bytes, uint32_t max_msgs) {
+    if (arena_bytes == 0 || max_msgs == 0) return 0;       // 기록 끔
+
+    // 가장 큰 레코드 하나는 항상 들어가야 한다
+    size_t min = REC_ALIGN(sizeof(HistRec) + MAX_NAME + MAX_BUF);
+    if (arena_bytes < min) arena_bytes = min;
+
+    r->arena = malloc(arena_bytes);
+    r->idx = calloc(max_msgs, sizeof(uint32_t));
+    if (!r->arena || !r->idx) {
+        free(r->arena);
+        free(r->idx);
+        r->arena = NULL;
+        r->idx = NULL;
+        return -1;
+    }
+    r->size = (uint32_t)arena_bytes;
+    r->cap = max_msgs;
+    r->tail = 0;
+    r->first_seq = r->next_seq = 1;
+    return 0;
+}
+
+void history_ring_free(HistoryRing *r) {
+    free(r->arena);
+    free(r->idx);
+    r->arena = NULL;
+    r->idx = NULL;
+    r->size = r->cap = r->tail = 0;
+    r->first_seq = r->next_seq = 1;
+}
+
+/**
+ * need 바이트를 쓸 위치. 가장 오래된 레코드를 버리지 않고는 자리가 없으면 -1
+ */
+static int64_t ring_fit(const HistoryRing *r, uint32_t need) {
+    if (r->first_seq == r->next_seq) return 0;             // 비었음
+
+    uint32_t head = r->idx[r->first_seq % r->cap];
+    if (r->tail > head) {                                   // [head, tail) 사용 중
+        if (r->size - r->tail >= need) return r->tail;
+        if (head >= need) return 0;                         // 끝을 버리고 앞으로
+        return -1;
+    }
+    // [head, 끝) + [0, tail) 사용 중 (tail == head 면 꽉 참)
+    return head - r->tail >= need ? (int64_t)r->tail : -1;
+}
+
+uint64_t history_append(HistoryRing *r, const Message *m) {
+    if (!r->arena) return 0;
+
+    size_t slen = strnlen(m->sender, MAX_NAME - 1);
+    size_t blen = message_body_len(m);
+    uint32_t need = REC_ALIGN(sizeof(HistRec) + slen + blen);
+
+    pthread_mutex_lock(&r->lock);
+
+    int64_t at = 0;
+    while (r->next_seq - r->first_seq == r->cap || (at = ring_fit(r, need)) < 0)
+        r->first_seq++;
+
+    HistRec h = {
+        .seq = r->next_seq,
+        .len = (uint16_t)blen,
+        .type = (uint8_t)m->type,
+        .sender_len = (uint8_t)slen,
+    };
+    uint8_t *p = r->arena + at;
+    memcpy(p, &h, sizeof(h));
+    memcpy(p + sizeof(h), m->sender, slen);
+    memcpy(p + sizeof(h) + slen, m->data, blen);
+
+    uint64_t seq = r->next_seq++;
+    r->idx[seq % r->cap] = (uint32_t)at;
+    r->tail = (uint32_t)at + need;
+
+    pthread_mutex_unlock(&r->lock);
+    return seq;
+}
+
+uint64_t history_next_seq(HistoryRing *r) {
+    pthread_mutex_lock(&r->lock);
+    uint64_t seq = r->next_seq;
+    pthread_mutex_unlock(&r->lock);
+    return seq;
+}
+
+int history_page(HistoryRing *r, uint64_t before, int count,
+                 history_fn fn, void *arg, uint64_t *first, int *more) {
+    if (count > HISTORY_PAGE_MAX) count = HISTORY_PAGE_MAX;
+
+    pthread_mutex_lock(&r->lock);
+
+    uint64_t end = (before == 0 || before > r->next_seq) ? r->next_seq : before;
+    uint64_t start = end;
+    if (end > r->first_seq && count > 0)
+        start = end - r->first_seq > (uint64_t)count ? end - count : r->first_seq;
+
+    char sender[MAX_NAME];
+    for (uint64_t s = start; s < end; s++) {
+        const uint8_t *p = r->arena + r->idx[s % r->cap];
+        HistRec h;
+        memcpy(&h, p, sizeof(h));
+        memcpy(sender, p + sizeof(h), h.sender_len);
+        sender[h.sender_len] = '\0';
+        fn(s, h.type, sender, (const char *)p + sizeof(h) + h.sender_len, h.len, arg);
+    }
+
+    *first = start;
+    *more = start > r->first_seq;
+    pthread_mutex_unlock(&r->lock);
+    return (int)(end - start);
+}
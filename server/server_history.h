@@ -0,0 +1,45 @@
+#ifndef SERVER_HISTORY_H
+#define SERVER_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "protocol.h"
+
+/*
+ * 최근 채팅 기록 (방마다 링 하나)
+ *  - 메시지는 시작할 때 한 번 잡은 arena 에 가변 길이 레코드로 이어 쓴다. (메시지마다 malloc 없음)
+ *  - arena 가 모자라거나 레코드 수가 max_msgs 에 닿으면 가장 오래된 것부터 덮어쓴다.
+ *  - seq 는 링마다 1 부터 늘어나는 번호. 클라이언트는 "이 seq 이전 N 개" 단위로 페이지를 받아 간다.
+ */
+
+#define HISTORY_PAGE_MAX 64     // 요청 한 번에 돌려주는 최대 메시지 수
+
+typedef struct {
+    pthread_mutex_t lock;       // 여러 shard 가 기록 / 조회
+    uint8_t  *arena;            // NULL 이면 기록 안 함 (--history-kb=0)
+    uint32_t  size;
+    uint32_t *idx;              // seq % cap → arena 안 레코드 위치
+    uint32_t  cap;
+    uint32_t  tail;             // 다음 레코드를 쓸 위치
+    uint64_t  first_seq;        // 가장 오래된 레코드 (비었으면 next_seq)
+    uint64_t  next_seq;
+} HistoryRing;
+
+// 페이지 조회 콜백 (링 잠금을 잡은 채로 오래된 것부터 호출된다)
+typedef void (*history_fn)(uint64_t seq, int type, const char *sender,
+                           const char *body, size_t len, void *arg);
+
+extern HistoryRing history_lobby;   // 방이 없는 기본 채팅
+
+int      history_ring_init(HistoryRing *r, size_t arena_bytes, uint32_t max_msgs);
+void     history_ring_free(HistoryRing *r);     // 아무도 쓰지 않을 때만 (방 정리)
+uint64_t history_append(HistoryRing *r, const Message *m);   // 붙인 seq (기록 끔이면 0)
+uint64_t history_next_seq(HistoryRing *r);
+
+// seq < before 중 최신 count 개. before == 0 이면 가장 최신부터.
+// 반환: 보낸 개수, *first = 페이지의 가장 오래된 seq, *more = 그보다 오래된 기록이 남아 있으면 1
+int      history_page(HistoryRing *r, uint64_t before, int count,
+                      history_fn fn, void *arg, uint64_t *first, int *more);
+
+#endif
@@ -1,40 +1,245 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include "server_config.h"
+#include "server_log.h"
 
-pthread_mutex_t server_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * 비동기 로그
+ *  - server_log() 는 고정 크기 링 버퍼의 슬롯 하나를 잡아 거기에 바로 포맷하고 끝난다.
+ *    (락 없음, 시스템 콜 없음 → 채팅/파일 청크 처리 경로에서 로그 비용이 거의 안 보임)
+ *  - 백그라운드 writer 스레드가 슬롯들을 모아 큰 write() 한 번으로 파일에 쓴다.
+ *    파일은 한 번만 열어 두고, 시각 문자열은 초가 바뀔 때만 다시 만든다.
+ *  - 링이 가득 차면 --log-overflow 정책에 따라 버리거나(drop) 자리가 날 때까지 기다린다(block).
+ *
+ * 링은 슬롯마다 sequence 번호를 두는 bounded MPSC 큐:
+ *  seq == pos     : 비어 있음, pos 번째 생산자가 쓸 수 있음
+ *  seq == pos + 1 : 기록 완료, writer 가 읽을 수 있음
+ * (슬롯에는 seq - 슬롯 번호 를 저장해서, 0 으로 초기화된 링이 그대로 "모두 비어 있음" 이 된다)
+ */
+
+#define LOG_PATH        "./server/server_log.txt"
+#define LOG_RING_SLOTS  4096                    // 2의 거듭제곱
+#define LOG_TEXT_MAX    480                     // 한 줄 최대 길이 (넘으면 잘림)
+#define LOG_BATCH_SIZE  (64 * 1024)             // writer 가 한 번에 write() 하는 크기
+#define LOG_IDLE_SLEEP_NS (10 * 1000 * 1000)    // 링이 비었을 때 writer 대기 시간
+#define LOG_FINAL_WAIT_TRIES 100000            // 종료 시 쓰는 중인 슬롯을 기다리는 횟수
+
+typedef struct {
+    atomic_size_t seq;      // seq - 슬롯 번호
+    time_t   ts;
+    uint16_t len;
+    char     text[LOG_TEXT_MAX];
+} LogSlot;
+
+static LogSlot       ring[LOG_RING_SLOTS];
+static atomic_size_t ring_tail;                 // 생산자가 다음에 잡을 위치
+static size_t        ring_head;                 // writer 만 사용
+static atomic_ulong  log_dropped;
+static atomic_int    log_stop;
+
+static pthread_t writer_tid;
+static int       writer_running = 0;
+static int       log_fd = -1;
+
+#define SLOT_INDEX(pos) ((pos) & (LOG_RING_SLOTS - 1))
+
+static inline size_t slot_seq(size_t pos) {
+    return atomic_load_explicit(&ring[SLOT_INDEX(pos)].seq, memory_order_acquire) + SLOT_INDEX(pos);
+}
+
+static inline void slot_set_seq(size_t pos, size_t seq) {
+    atomic_store_explicit(&ring[SLOT_INDEX(pos)].seq, seq - SLOT_INDEX(pos), memory_order_release);
+}
 
 /**
  * 서버 로그 기록 (멀티클라이언트/멀티쓰레드 안전)
  */
 void server_log(const char *fmt, ...) {
-    // server 디렉토리 자동 생성
-    mkdir("./server", 0755);
+    size_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    LogSlot *slot;
 
-    pthread_mutex_lock(&server_log_mutex);
+    // 빈 슬롯 하나 잡기
+    for (;;) {
+        slot = &ring[SLOT_INDEX(pos)];
+        size_t seq = slot_seq(pos);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
 
-    FILE *fp = fopen("./server/server_log.txt", "a");
-    if (!fp) {
-        pthread_mutex_unlock(&server_log_mutex);
-        return;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            // 링이 가득 참
+            if (g_config.log_overflow == LOG_OVERFLOW_DROP || !writer_running) {
+                atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+                return;
+            }
+            sched_yield();
+            pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
     }
 
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-
-    fprintf(fp, "[%04d-%02d-%02d %02d:%02d:%02d] ",
-            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
-            t->tm_hour, t->tm_min, t->tm_sec);
+    slot->ts = time(NULL);
 
     va_list args;
     va_start(args, fmt);
-    vfprintf(fp, fmt, args);
+    int n = vsnprintf(slot->text, sizeof(slot->text), fmt, args);
     va_end(args);
 
-    fprintf(fp, "\n");
-    fclose(fp);
+    if (n < 0) n = 0;
+    if (n >= (int)sizeof(slot->text)) n = sizeof(slot->text) - 1;
+    slot->len = (uint16_t)n;
+
+    slot_set_seq(pos, pos + 1);
+}
+
+/* ----------------------- writer 스레드 ----------------------- */
+
+typedef struct {
+    char   buf[LOG_BATCH_SIZE];
+    size_t len;
+    time_t stamp_ts;        // stamp 를 만든 시각 (초 단위 캐시)
+    char   stamp[32];       // "[YYYY-MM-DD HH:MM:SS] "
+    size_t stamp_len;
+} LogBatch;
+
+static void batch_flush(LogBatch *b) {
+    size_t off = 0;
+    while (off < b->len) {
+        ssize_t n = write(log_fd, b->buf + off, b->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;      // 디스크 오류: 이번 배치는 버림
+        }
+        off += n;
+    }
+    b->len = 0;
+}
+
+static void batch_append(LogBatch *b, time_t ts, const char *text, size_t len) {
+    if (ts != b->stamp_ts || b->stamp_len == 0) {
+        struct tm t;
+        localtime_r(&ts, &t);
+        b->stamp_len = strftime(b->stamp, sizeof(b->stamp), "[%Y-%m-%d %H:%M:%S] ", &t);
+        b->stamp_ts = ts;
+    }
+
+    if (b->len + b->stamp_len + len + 1 > sizeof(b->buf)) batch_flush(b);
+
+    memcpy(b->buf + b->len, b->stamp, b->stamp_len);
+    b->len += b->stamp_len;
+    memcpy(b->buf + b->len, text, len);
+    b->len += len;
+    b->buf[b->len++] = '\n';
+}
+
+/**
+ * 링에 쌓인 기록을 모두 배치에 옮긴다. 반환: 옮긴 개수
+ */
+static int ring_drain(LogBatch *b) {
+    int count = 0;
+
+    for (;;) {
+        LogSlot *slot = &ring[SLOT_INDEX(ring_head)];
+        if (slot_seq(ring_head) != ring_head + 1) break;
+
+        batch_append(b, slot->ts, slot->text, slot->len);
+        slot_set_seq(ring_head, ring_head + LOG_RING_SLOTS);
+        ring_head++;
+        count++;
+    }
+
+    unsigned long dropped = atomic_exchange_explicit(&log_dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        char note[64];
+        int n = snprintf(note, sizeof(note), "(log) %lu messages dropped: ring full", dropped);
+        batch_append(b, time(NULL), note, n);
+    }
+    return count;
+}
+
+/**
+ * 종료 직전: 자리를 잡았지만 아직 다 쓰지 못한 슬롯이 있으면 잠깐 기다렸다가 마저 옮긴다
+ * (생산자는 포맷 한 번이면 끝나므로 오래 걸리지 않는다. 그래도 무한정 기다리지는 않음)
+ */
+static void ring_drain_final(LogBatch *b) {
+    for (int tries = 0; tries < LOG_FINAL_WAIT_TRIES; tries++) {
+        ring_drain(b);
+        if (ring_head == atomic_load_explicit(&ring_tail, memory_order_acquire)) return;
+        sched_yield();
+    }
+}
+
+static void *log_writer_main(void *arg) {
+    (void)arg;
+    static LogBatch batch;
+
+    for (;;) {
+        int stopping = atomic_load(&log_stop);
+        int count = 0;
+        if (stopping) ring_drain_final(&batch);
+        else count = ring_drain(&batch);
+        if (batch.len > 0) batch_flush(&batch);
+        if (stopping) break;
+
+        if (count == 0) {
+            struct timespec ts = { 0, LOG_IDLE_SLEEP_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 로그 파일을 열고 writer 스레드 시작 (그 전에 남긴 로그도 여기서 기록된다)
+ */
+int server_log_start(void) {
+    if (writer_running) return 0;
+
+    // server 디렉토리 자동 생성
+    mkdir("./server", 0755);
+
+    log_fd = open(LOG_PATH, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
+        perror("open server log");
+        return -1;
+    }
+
+    if (pthread_create(&writer_tid, NULL, log_writer_main, NULL) != 0) {
+        close(log_fd);
+        log_fd = -1;
+        return -1;
+    }
+    writer_running = 1;
+    return 0;
+}
+
+/**
+ * 남은 로그를 모두 기록하고 writer 종료
+ * 시그널 핸들러에서 부르면 안 된다: 다른 server_log() 가 잡은 슬롯을 기다리므로
+ * reactor 들이 멈춘 뒤 main 에서 호출한다.
+ */
+void server_log_shutdown(void) {
+    if (!writer_running) return;
+
+    atomic_store(&log_stop, 1);
+    pthread_join(writer_tid, NULL);
+    writer_running = 0;
 
-    pthread_mutex_unlock(&server_log_mutex);
+    close(log_fd);
+    log_fd = -1;
 }
@@ -0,0 +1,10 @@
+#ifndef SERVER_LOG_H
+#define SERVER_LOG_H
+
+// 서버 로그 (비동기: 링 버퍼에 넣고 writer 스레드가 파일에 기록)
+void server_log(const char *fmt, ...);
+
+int  server_log_start(void);
+void server_log_shutdown(void);
+
+#endif
@@ -1,73 +1,524 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <sys/select.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/resource.h>
 #include <signal.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include "../common/protocol.h"
 #include "server_user_list.h"
 #include "server_auth.h"
+#include "server_event.h"
+#include "server_conn.h"
+#include "server_config.h"
+#include "server_proto.h"
+#include "server_file.h"
+#include "server_log.h"
+#include "server_cred.h"
+#include "server_shard.h"
+#include "server_metrics.h"
+#include "server_timer.h"
+#include "server_expiry.h"
+#include "server_cas.h"
+#include "server_history.h"
+#include "server_msglog.h"
+#include "server_spool.h"
+#include "server_room.h"
+#include "server_ratelimit.h"
 
 // 외부 함수
 bool check_login(const char *id, const char *pw);
-void broadcast(int sender_fd, Message *msg, int max_clients);
-void handle_chat_message(int client_fd, Message *msg,int max_clients);
-void handle_file_upload(int client_fd, Message *msg);
-void handle_file_download(int client_fd, Message *msg);
-void server_log(const char *fmt, ...);
-int find_client_fd(const char *name);
-
-#define MAX_CLIENTS 10
-int client_sockets[MAX_CLIENTS] = {0};
-
-ssize_t wa;
-
-ssize_t recv_all(int sock, void *buf, size_t size){
-    size_t received = 0;
-    while(received < size){
-        ssize_t len = recv(sock, (char*)buf + received, size - received, 0);
-        if(len <= 0) return len;
-        received += len;
+void broadcast(int sender_fd, Message *msg);
+void handle_chat_message(int client_fd, Message *msg);
+void send_text(int client_fd, const char *sender, const char *text);
+void handle_history_request(Conn *c, Message *msg);
+void dm_fail_init(Message *err, const char *target, SpoolResult sr);
+void room_chat(Conn *c, Message *msg);
+
+/**
+ * 영구 로그의 레코드를 로비 채팅 기록 링에 다시 넣는다 (시작할 때)
+ */
+static void warm_history(const MsglogRecord *r, void *arg) {
+    (void)arg;
+    if (r->type == MSG_DM || r->target[0]) return;     // DM, 로비가 아닌 방의 채팅
+
+    Message m;
+    memset(&m, 0, sizeof(m));
+    m.type = r->type;
+    strcpy(m.sender, r->sender);
+    memcpy(m.data, r->body, r->len);
+    history_append(&history_lobby, &m);
+}
+
+// 한 번에 연결 하나에서 처리할 최대 메시지 수 (업로드 중인 연결이 루프를 독점하지 않도록)
+#define READ_BUDGET 64
+
+// 예산을 다 써서 다음 tick 에 이어 읽을 소켓들
+static __thread int *read_backlog = NULL;
+static __thread int  read_backlog_count = 0;
+static __thread int  read_backlog_cap = 0;
+
+/**
+ * 소켓에 아직 처리하지 않은 입력(데이터 또는 EOF/에러)이 있는지 확인 (블로킹 없음)
+ * edge-triggered 모드에서는 남은 데이터를 다 처리해야 다음 이벤트가 온다.
+ */
+static bool has_pending_input(int sock) {
+    char c;
+    ssize_t n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+    return true;   // 데이터, EOF(0), 에러 모두 다음 read 에서 처리
+}
+
+static void read_backlog_push(int sock) {
+    if (read_backlog_count == read_backlog_cap) {
+        int new_cap = read_backlog_cap ? read_backlog_cap * 2 : 64;
+        int *p = realloc(read_backlog, sizeof(int) * new_cap);
+        if (!p) return;
+        read_backlog = p;
+        read_backlog_cap = new_cap;
     }
+    read_backlog[read_backlog_count++] = sock;
+}
 
-    return received;
+/**
+ * 열 수 있는 fd 개수를 hard limit 까지 올린다 (대량 접속 대비)
+ */
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
 }
 
+// 종료 요청: 시그널 핸들러는 표시만 하고, 정리는 reactor 가 멈춘 뒤 main 에서 한다
+static volatile sig_atomic_t stop_signal = 0;
+static atomic_int reactors_stop;
+
 void cleanup(int signo) {
-    printf("\n[SERVER] 종료 중...\n");
-    server_log("서버 정상 종료됨.");
-    exit(0);
+    (void)signo;
+    stop_signal = 1;
+    shard_wake(0);              // shard 0 이 이벤트 대기 중이면 바로 깨운다
 }
 
-int main() {
-    signal(SIGINT, cleanup);
+/**
+ * shard 0 이 종료 시그널을 보면 모든 reactor 에 멈추라고 알린다
+ */
+static void check_stop_request(void) {
+    if (shard_id != 0 || !stop_signal || atomic_load(&reactors_stop)) return;
+
+    atomic_store(&reactors_stop, 1);
+    for (int i = 1; i < shard_count; i++) shard_wake(i);
+}
+
+/**
+ * 받는 사람이 접속해 있지 않은 DM 결과를 보낸 사람에게 알린다.
+ * 보관했으면 평소처럼 보낸 사람 창에 DM 을 보여 주고, 로그인하면 전달된다고 덧붙인다.
+ */
+static void handle_dm_offline(Conn *c, const Message *dm, SpoolResult sr) {
+    if (sr == SPOOL_STORED) {
+        msglog_append(dm);
+
+        OutMessage om;
+        outmsg_init(&om, dm, conn_wire_id(c), FRAME_ID_NONE);
+        conn_send_outmsg(c, &om, 0);
+        outmsg_release(&om);
+
+        char text[MAX_BUF];
+        snprintf(text, sizeof(text), "%s is offline. The message will be delivered when they log in.",
+                 dm->target);
+        send_text(c->fd, "SERVER", text);
+        return;
+    }
+
+    Message err;
+    dm_fail_init(&err, dm->target, sr);
+    conn_send_msg(c, &err, 0);
+}
+
+/**
+ * 클라이언트 메시지 1개 처리
+ * 반환값: 연결 유지 시 1, 연결을 닫았으면 0
+ */
+static int handle_client_message(Conn *c, Message *msg) {
+    int sd = c->fd;
+
+    metric_msg_in(msg->type);
+
+    switch (msg->type) {
+        case MSG_FILE_UPLOAD:
+            server_log("%s 파일 업로드 요청", msg->sender);
+            handle_file_upload(c, msg);
+            break;
+
+        case MSG_FILE_QUERY:
+            handle_file_query(c, msg);
+            break;
+
+        case MSG_FILE_PUT_OPEN:
+            server_log("%s 병렬 업로드 요청", msg->sender);
+            handle_file_put_open(c, msg);
+            break;
+
+        case MSG_FILE_RANGE:
+            handle_file_range(c, msg);
+            break;
+
+        case MSG_FILE_DOWNLOAD:
+            server_log("%s 파일 다운로드 요청", msg->sender);
+            handle_file_download(c, msg);
+            break;
+
+        case MSG_DM: {
+            // DM 전용 메시지 재구성
+            Message dm;
+            memset(&dm, 0, sizeof(dm));
+
+            dm.type = MSG_DM;
+            strcpy(dm.sender, msg->sender);   // 보낸 사람
+            strcpy(dm.target, msg->target);   // 받는 사람
+            dm.data_len = (int)message_body_len(msg);
+            memcpy(dm.data, msg->data, dm.data_len);    // 암호화된 본문 그대로 (바이너리)
+
+            // 받는 사람은 다른 shard 에 있을 수 있다 (공용 username 인덱스에서 위치 조회)
+            // 접속해 있지 않은 계정이면 보관함에 넣어 두고 로그인할 때 전달한다
+            ConnRef ref;
+            if (!conn_lookup(dm.target, &ref)) {
+                SpoolResult sr = cred_exists(dm.target) ? spool_put(&dm, &ref) : SPOOL_OFF;
+                if (sr != SPOOL_ONLINE) {
+                    handle_dm_offline(c, &dm, sr);
+                    break;
+                }
+            }
+            msglog_append(&dm);
+
+            // 한 번만 인코딩
+            OutMessage om;
+            outmsg_init(&om, &dm, conn_wire_id(c), conn_ref_wire_id(&ref));
+
+            // 1) 대상자에게 전송
+            if (ref.shard == shard_id) {
+                if (ref.conn->gen == ref.gen) conn_send_outmsg(ref.conn, &om, 0);
+            } else {
+                SharedMsg *sm = shared_msg_new(&dm, 1);
+                Mail *mail = sm ? mail_new(MAIL_DM, sm) : NULL;
+                if (mail) {
+                    mail->target = ref.conn;
+                    mail->target_gen = ref.gen;
+                    mail->sender_id = om.sender_id;
+                    mail->target_id = om.target_id;
+                    shard_post(ref.shard, mail);
+                } else {
+                    shared_msg_unref(sm);
+                }
+            }
+
+            // 2) 보낸 사람에게도 전송
+            conn_send_outmsg(c, &om, 0);
+
+            outmsg_release(&om);
+
+            break;
+        }
+        case MSG_CHAT:
+            if (strcmp(msg->data, "/users") == 0) {
+                send_user_list(sd);
+            }else if(msg->data[0] == '/' ){
+                handle_chat_message(sd, msg);
+            }
+            else {
+                printf("[%s]: %s\n", msg->sender, msg->data);
+                server_log("채팅: %s - %s", msg->sender, msg->data);
+                room_chat(c, msg);
+            }
+            break;
+
+
+        case MSG_EXIT:
+            printf("[SERVER] %s exited. (socket %d)\n", msg->sender, sd);
+            server_log("클라이언트 종료: %s (socket %d)", msg->sender, sd);
+            disconnect_client(c);
+            return 0;
+
+        case MSG_LOGIN:
+        {
+            char id[32], pw[32];
+            sscanf(msg->data, "%s %s", id, pw);
+
+            Message reply;
+            memset(&reply, 0, sizeof(reply));
+            strcpy(reply.sender, "SERVER");
+
+            if (check_login(id, pw)) {
+                reply.type = MSG_LOGIN_OK;
+                strcpy(reply.data, "LOGIN_OK");
+                conn_send_msg(c, &reply, 0);
+
+                room_enter(c, ROOM_LOBBY);       // 로비에서 시작 (이 뒤 채팅은 실시간으로 받음)
+                register_user(sd, id);           // username 기록
+                spool_drain(c);                  // 접속해 있지 않을 때 온 귓속말 (한 번에 큐에 넣음)
+                assign_root_if_first(sd);        // root 자동 배정
+
+                admit_handshake_end(c);          // 로그인 전 연결 수에서 뺌
+                metric_add(M_LOGIN_OK, 1);
+                metric_observe(H_LOGIN_LATENCY, metrics_now_ns() - c->accepted_ns);
+
+                printf("[SERVER] 로그인 성공: %s (socket %d)\n", id, sd);
+            }
+            else {
+                reply.type = MSG_LOGIN_FAIL;
+                strcpy(reply.data, "LOGIN_FAIL");
+                conn_send_msg(c, &reply, 0);
+                metric_add(M_LOGIN_FAIL, 1);
+
+                printf("[SERVER] 로그인 실패: %s\n", id);
+            }
+            break;
+        }
+
+
+        case MSG_HISTORY_REQUEST:
+            handle_history_request(c, msg);
+            break;
+
+        // 업로드 청크/종료: 진행 중인 업로드 상태에 기록
+        case MSG_FILE_DATA:
+            handle_file_data(c, msg);
+            break;
 
-    int server_fd, client_fd, max_fd, activity;
-    struct sockaddr_in server_addr, client_addr;
+        case MSG_FILE_END:
+            handle_file_end(c, msg);
+            break;
+
+        // 클라이언트가 보낼 일이 없는 메시지는 로그만 찍고 무시
+        case MSG_FILE_READY:
+        case MSG_LIST_REQEUST:
+            send_user_list(sd);
+        case MSG_ERROR:
+            server_log("예상치 못한 위치에서 파일 관련 메시지 수신(type=%d)", msg->type);
+            break;
+
+        default:
+            server_log("알 수 없는 메시지 타입 수신(type=%d)", msg->type);
+            break;
+    }
+
+    // 핸들러 안에서 kick 등으로 소켓이 닫혔을 수 있음
+    return c->fd == sd;
+}
+
+/**
+ * 읽기 가능 이벤트 처리: 입력 버퍼에서 완성된 메시지를 READ_BUDGET 개까지 처리한다.
+ * 버퍼에 완성된 프레임이 없을 때만 소켓에서 더 읽고, 소켓이 비면 (덜 온 조각은 버퍼에 둔 채) 돌아간다.
+ * 예산을 다 쓰면 backlog 에 넣어 다음 tick 에 이어서 처리한다.
+ */
+static void handle_client_readable(int sd) {
+    Conn *c = conn_by_fd(sd);
+    if (!c) return;
+
+    c->last_active = timer_ticks();
+
+    for (int budget = READ_BUDGET; budget > 0; ) {
+        // 버킷이 비었으면 읽기를 멈춘다 (남은 입력은 rate_timer 가 다시 불러 처리)
+        if (rate_throttle(c, 1)) return;
+
+        // 병렬 업로드 구간 본문: 프레임이 아니라 바이트 그대로 파일에 기록
+        if (file_range_receiving(c)) {
+            int r = file_range_recv(c);
+            if (r < 0) {
+                server_log("클라이언트 비정상 종료 (socket %d)", sd);
+                disconnect_client(c);
+                return;
+            }
+            if (r == 0) return;                 // 소켓 비었음
+            if (file_range_receiving(c)) break; // 예산 소진 → 다음 tick
+            budget--;
+            continue;
+        }
+
+        // v1/v2 프레임 하나를 Message 로 변환 (모자라면 소켓에서 더 읽어 옴)
+        int r = conn_next_message(c, &c->rx);
+        if (r == 0) {
+            r = conn_rx_fill(c);
+            if (r == 0) return;                 // 소켓 비었음
+            if (r > 0) continue;
+        }
+        // 연결 종료/오류 (잘못된 프레임 포함)
+        if (r < 0) {
+            server_log("클라이언트 비정상 종료 (socket %d)", sd);
+            disconnect_client(c);
+            return;
+        }
+
+        if (c->rx.type != MSG_FILE_DATA) rate_charge_msg(c);   // 업로드 청크는 바이트로만 센다
+        if (!handle_client_message(c, &c->rx)) return;
+        budget--;
+    }
+
+    read_backlog_push(sd);
+}
+
+/**
+ * 지난 tick 에 예산을 다 써서 남겨둔 소켓들 이어서 처리
+ */
+static void run_read_backlog(void) {
+    int count = read_backlog_count;
+    if (count == 0) return;
+
+    int *fds = malloc(sizeof(int) * count);
+    if (!fds) return;
+    memcpy(fds, read_backlog, sizeof(int) * count);
+    read_backlog_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        // 그 사이 닫혔거나 이미 다 읽은 소켓은 건너뜀
+        Conn *c = conn_by_fd(fds[i]);
+        if (c && (conn_rx_buffered(c) > 0 || has_pending_input(fds[i])))
+            handle_client_readable(fds[i]);
+    }
+    free(fds);
+}
+
+/**
+ * 속도 제한 타이머: 버킷이 찼으니 멈춰 두었던 입력을 이어서 처리한다.
+ * (다운로드는 이벤트 루프가 다음 tick 에 알아서 이어 간다)
+ */
+static void rate_timer_fire(Timer *t) {
+    Conn *c = t->arg;
+    if (c->fd >= 0) handle_client_readable(c->fd);
+}
+
+/**
+ * 유휴 연결 타이머: 마지막 입력 이후 --idle-timeout 초가 지났으면 연결을 끊는다.
+ * 입력이 있을 때마다 타이머를 옮기지 않고, 울렸을 때 남은 시간만큼 다시 건다.
+ */
+static void idle_timer_fire(Timer *t) {
+    Conn *c = t->arg;
+    uint64_t limit = timer_ms_to_ticks((uint64_t)g_config.idle_timeout * 1000);
+
+    if (timer_ticks() - c->last_active < limit) {
+        timer_add(t, c->last_active + limit);
+        return;
+    }
+    if (c->download) {
+        // 서버가 보내는 중인 연결은 클라이언트가 조용해도 유휴가 아니다
+        timer_add(t, timer_ticks() + limit);
+        return;
+    }
+
+    server_log("유휴 연결 종료 (socket %d, %d초)", c->fd, g_config.idle_timeout);
+    metric_add(M_IDLE_TIMEOUTS, 1);
+
+    char text[64];
+    snprintf(text, sizeof(text), "Disconnected: idle for %d seconds.", g_config.idle_timeout);
+    send_text(c->fd, "SERVER", text);
+    disconnect_client(c);
+}
+
+// accept 버킷이 비어 미뤄 둔 accept 를 다시 시도할 때 (shard 마다)
+static __thread Timer accept_timer;
+
+/**
+ * 신규 접속 처리: 대기 중인 연결을 모두 accept 한다. (listen 소켓은 non-blocking)
+ * accept 버킷이 비면 나머지는 커널 backlog 에 두고 accept_timer 로 다시 시도한다.
+ */
+static void accept_clients(int server_fd) {
+    struct sockaddr_in client_addr;
     socklen_t addrlen;
-    fd_set readfds;
-    Message msg;
 
-    // 업로드 파일 저장용 디렉토리
-    if(system("mkdir -p server/server_storage")){
-        perror("system");
+    while (1) {
+        int wait = admit_accept();
+        if (wait > 0) {
+            if (!timer_pending(&accept_timer)) {
+                timer_add_ms(&accept_timer, (uint64_t)wait);
+                metric_add(M_ACCEPT_DELAYED, 1);
+            }
+            return;
+        }
+
+        addrlen = sizeof(client_addr);
+        // 클라이언트 소켓도 non-blocking: 느린 수신자가 서버 전체를 막지 않도록
+        int client_fd = accept4(server_fd, (struct sockaddr *)&client_addr, &addrlen,
+                                SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            admit_accept_refund();
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept failed");
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        outq_sock_init(client_fd);
+
+        printf("[SERVER] 새 연결: socket %d (shard %d)\n", client_fd, shard_id);
+        server_log("클라이언트 연결 (socket %d, shard %d)", client_fd, shard_id);
+
+        Conn *c = conn_alloc(client_fd);
+        if (!c) {
+            server_log("연결 슬롯 할당 실패 (socket %d)", client_fd);
+            close(client_fd);
+            continue;
+        }
+
+        // 로그인하지 않은 연결이 너무 많으면 (붙잡고만 있는 클라이언트 등) 바로 닫는다
+        if (!admit_handshake_begin(c)) {
+            server_log("로그인 전 연결 한도 초과로 닫음 (socket %d)", client_fd);
+            metric_add(M_HANDSHAKE_REJECTED, 1);
+            conn_release(c);
+            close(client_fd);
+            continue;
+        }
+
+        if (event_add(client_fd, EV_READ) < 0) {
+            perror("event_add");
+            conn_release(c);
+            close(client_fd);
+            continue;
+        }
+
+        rate_init(c);
+        timer_setup(&c->rate_timer, rate_timer_fire, c);
+
+        if (g_config.idle_timeout > 0) {
+            timer_setup(&c->idle_timer, idle_timer_fire, c);
+            timer_add_ms(&c->idle_timer, (uint64_t)g_config.idle_timeout * 1000);
+        }
     }
+}
 
-    // 1. 소켓 생성(IPv4, TCP로 동작하는 소켓 생성)
+static void accept_timer_fire(Timer *t) {
+    accept_clients((int)(intptr_t)t->arg);
+}
 
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+/**
+ * shard 별 listen 소켓 생성. SO_REUSEPORT 로 같은 포트를 여러 소켓이 열고,
+ * 커널이 새 연결을 소켓들에 나눠 준다. (accept 경쟁/락 없음)
+ */
+static int open_listener(void) {
+    struct sockaddr_in server_addr;
+
+    // 1. 소켓 생성(IPv4, TCP로 동작하는 소켓 생성)
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         perror("socket failed");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    // SO_REUSEADDR 설정 (서버 재시작 시 TIME_WAIT 방지)
+    // SO_REUSEADDR 설정 (서버 재시작 시 TIME_WAIT 방지), SO_REUSEPORT (shard 마다 listen 소켓)
     int opt = 1;
     setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("SO_REUSEPORT");
+        close(server_fd);
+        return -1;
+    }
 
     // 2. 주소 지정
     memset(&server_addr, 0, sizeof(server_addr));
@@ -78,194 +529,212 @@ int main() {
     if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("bind failed");
         close(server_fd);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // 3. 클라이언트 요청 대기(서버가 문열고 기다리기)
-    if (listen(server_fd, 3) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen failed");
         close(server_fd);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
-    //printf("[DEBUG] SERVER sizeof(Message) = %ld\n", sizeof(Message));
-
+    // edge-triggered 에서 accept 루프가 블로킹되지 않도록 non-blocking
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK);
+    return server_fd;
+}
 
-    printf("[SERVER] Listening on port %d...\n", SERVER_PORT);
-    server_log("서버 시작 (포트 %d)", SERVER_PORT);
+typedef struct {
+    int shard;
+    int server_fd;
+} ReactorArgs;
+
+/**
+ * reactor 스레드 1개 (= shard 1개): 자기 listen 소켓, 이벤트 엔진, 연결 테이블로 동작한다.
+ * 다른 shard 에서 온 broadcast/DM/kick 은 메일박스 eventfd 로 깨어나 처리한다.
+ */
+static void *reactor_main(void *arg) {
+    ReactorArgs *ra = arg;
+    int server_fd = ra->server_fd;
+    shard_id = ra->shard;
+
+    IoEvent events[EV_MAX_EVENTS];
+
+    conn_table_init();
+    metrics_thread_init(shard_id);
+    timer_wheel_init();
+    timer_setup(&accept_timer, accept_timer_fire, (void *)(intptr_t)server_fd);
+    if (shard_id == 0) {
+        expiry_arm_restored();   // 재시작 전 TTL 예정
+        spool_arm_sweep();       // 오프라인 귓속말 보관 기간 정리
+    }
 
-    while (1) {
-        FD_ZERO(&readfds);
-        FD_SET(server_fd, &readfds);
-        max_fd = server_fd;
-
-        // 기존 클라이언트 소켓들을 감시 목록에 추가
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            int sd = client_sockets[i];
-            if (sd > 0) FD_SET(sd, &readfds);
-            if (sd > max_fd) max_fd = sd;
-        }
+    // 4. 이벤트 엔진 초기화 (listen 소켓, 메일박스는 한 번만 등록)
+    int mail_fd = shard_mailbox_fd();
+    if (event_init() < 0 || event_add(server_fd, EV_READ) < 0 ||
+        event_add(mail_fd, EV_READ) < 0) {
+        perror("event init failed");
+        exit(EXIT_FAILURE);
+    }
 
-        // 4. I/O 이벤트 감지(select(감시할 fd개수 + 1, 읽을 데이터 있는지 감시하는 파일 집합, 파일에 데이터 쓸 수 있는지 검사하기 위한 파일집합)..)
-        activity = select(max_fd + 1, &readfds, NULL, NULL, NULL);
-        if (activity < 0) {
-            perror("select error");
+    while (!atomic_load(&reactors_stop)) {
+        // 5. I/O 이벤트 대기: 준비된 fd만 돌려받는다
+        //    (이어서 처리할 입력/다운로드/메일이 남아있으면 기다리지 않음,
+        //     타이머가 있으면 가장 가까운 만료 칸까지만 기다림)
+        int timeout = (read_backlog_count > 0 || file_transfers_pending() ||
+                       shard_mail_pending()) ? 0 : timer_wait_ms();
+        int n = event_wait(events, EV_MAX_EVENTS, timeout);
+        check_stop_request();
+        if (n < 0) {
+            if (errno != EINTR) perror("event_wait error");
             continue;
         }
+        uint64_t tick_start = metrics_now_ns();
 
-        // 5. 신규 접속 처리
-        if (FD_ISSET(server_fd, &readfds)) {
-            addrlen = sizeof(client_addr);
-            client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addrlen);
-            if (client_fd < 0) {
-                perror("accept failed");
+        // 만료된 타이머 (파일 TTL, 유휴 연결)
+        timer_run();
+
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].fd;
+
+            // 6. 신규 접속 처리
+            if (fd == server_fd) {
+                accept_clients(server_fd);
                 continue;
             }
+            if (fd == mail_fd) continue;    // 아래 shard_drain 에서 처리
 
-            printf("[SERVER] 새 연결: socket %d\n", client_fd);
-            server_log("클라이언트 연결 (socket %d)", client_fd);
-
-            for (int i = 0; i < MAX_CLIENTS; i++) {
-                if (client_sockets[i] == 0) {
-                    client_sockets[i] = client_fd;
-                    break;
-                }
+            // 7. 기존 클라이언트 메시지 처리
+            if (events[e].events & EV_WRITE) {
+                Conn *c = conn_by_fd(fd);
+                if (c && c->download) file_download_pump(c);
+                else if (c && conn_flush(c) < 0) continue;
+            }
+            if (events[e].events & (EV_READ | EV_HUP)) {
+                handle_client_readable(fd);
             }
         }
 
-        // 6. 기존 클라이언트 메시지 처리
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            int sd = client_sockets[i];
-
-            if (sd > 0 && FD_ISSET(sd, &readfds)) {
-                //여기서 sizeof(Message)로 설정햇더라도 read로는 읽어오지 못한다.
-                //int valread = read(sd, &msg, sizeof(Message)); // 클라이언트 → 서버
-                int valread = recv_all(sd, &msg, sizeof(Message));
-                // 연결 종료/오류
-                if (valread <= 0) {
-                    printf("[SERVER] Client %d disconnected\n", sd);
-                    server_log("클라이언트 비정상 종료 (socket %d)", sd);
-                    close(sd);
-                    client_sockets[i] = 0;
-                    continue;
-                }
+        // 8. 다른 shard 에서 온 메시지, 이어서 처리할 입력, 진행 중인 다운로드를 조금씩 처리
+        shard_drain();
+        run_read_backlog();
+        file_transfers_run();
 
-                switch (msg.type) {
-                    case MSG_FILE_UPLOAD:
-                        server_log("%s 파일 업로드 요청", msg.sender);
-                        handle_file_upload(sd, &msg);
-                        break;
-
-                    case MSG_FILE_DOWNLOAD:
-                        server_log("%s 파일 다운로드 요청", msg.sender);
-                        handle_file_download(sd, &msg);
-                        break;
-
-                    case MSG_DM: {
-                        int recv_fd = find_client_fd(msg.target);
-
-                        if (recv_fd < 0) {
-                            Message err;
-                            memset(&err, 0, sizeof(err));
-
-                            err.type = MSG_DM_FAIL;
-                            strcpy(err.sender, "SERVER");
-                            strcpy(err.data, "User not found.");
-                            send(sd, &err, sizeof(err), 0);
-                            break;
-                        }
-
-                        // DM 전용 메시지 재구성
-                        Message dm;
-                        memset(&dm, 0, sizeof(dm));
-
-                        dm.type = MSG_DM;
-                        strcpy(dm.sender, msg.sender);   // 보낸 사람
-                        strcpy(dm.target, msg.target);   // 받는 사람
-                        strcpy(dm.data, msg.data);       // 암호화된 본문 그대로
-
-                        // 1) 대상자에게 전송
-                        send(recv_fd, &dm, sizeof(dm), 0);
-
-                        // 2) 보낸 사람에게도 전송
-                        send(sd, &dm, sizeof(dm), 0);
-
-                        break;
-                    }
-                    case MSG_CHAT:
-                        if (strcmp(msg.data, "/users") == 0) {
-                            send_user_list(sd);
-                        }else if(msg.data[0] == '/' ){
-                            handle_chat_message(sd, &msg, MAX_CLIENTS);
-                        }
-                        else {
-                            printf("[%s]: %s\n", msg.sender, msg.data);
-                            server_log("채팅: %s - %s", msg.sender, msg.data);
-                            broadcast(sd, &msg, MAX_CLIENTS);
-                        }
-                        break;
-
-
-                    case MSG_EXIT:
-                        printf("[SERVER] %s exited. (socket %d)\n", msg.sender, sd);
-                        server_log("클라이언트 종료: %s (socket %d)", msg.sender, sd);
-                        close(sd);
-                        client_sockets[i] = 0;
-                        break;
-
-                    case MSG_LOGIN:
-                    {
-                        char id[32], pw[32];
-                        sscanf(msg.data, "%s %s", id, pw);
-
-                        Message reply;
-                        memset(&reply, 0, sizeof(reply));
-                        strcpy(reply.sender, "SERVER");
-
-                        if (check_login(id, pw)) {
-                            reply.type = MSG_LOGIN_OK;
-                            strcpy(reply.data, "LOGIN_OK");
-                            wa = write(sd, &reply, sizeof(reply));
-                            if(wa < 0){
-                                perror("write");
-                            }
-
-                            register_user(sd, id);           // username 기록
-                            assign_root_if_first(sd);        // root 자동 배정
-
-                            printf("[SERVER] 로그인 성공: %s (socket %d)\n", id, sd);
-                        }
-                        else {
-                            reply.type = MSG_LOGIN_FAIL;
-                            strcpy(reply.data, "LOGIN_FAIL");
-                            wa = write(sd, &reply, sizeof(reply));
-
-                            if(wa < 0){
-                                perror("write");
-                            }
-
-                            printf("[SERVER] 로그인 실패: %s\n", id);
-                        }
-                        break;
-                    }
-
-
-                    // 파일 데이터/종료 메시지는 보통 handle_file_* 내부에서 처리하겠지만,
-                    // 혹시 여기로 들어오면 로그만 찍고 무시
-                    case MSG_FILE_DATA:
-                    case MSG_FILE_END:
-                    case MSG_FILE_READY:
-                    case MSG_LIST_REQEUST:
-                        send_user_list(sd);
-                    case MSG_ERROR:
-                        server_log("예상치 못한 위치에서 파일 관련 메시지 수신(type=%d)", msg.type);
-                        break;
-
-                    default:
-                        server_log("알 수 없는 메시지 타입 수신(type=%d)", msg.type);
-                        break;
-                }
-            }
+        // 9. 이번 tick 에 쌓인 출력을 연결마다 한 번에 전송
+        outq_flush_pending();
+
+        metric_gauge_set(G_READ_BACKLOG, read_backlog_count);
+        metric_observe(H_LOOP_ITERATION, metrics_now_ns() - tick_start);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (config_load(argc, argv) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (server_log_start() < 0 || cred_start() < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGINT, cleanup);
+    signal(SIGTERM, cleanup);
+    signal(SIGPIPE, SIG_IGN);    // 끊긴 소켓에 send 해도 서버가 죽지 않도록
+
+    raise_fd_limit();
+
+    // 업로드 파일 저장용 디렉토리
+    if(system("mkdir -p server/server_storage/.partial")){
+        perror("system");
+    }
+
+    // 재시작 전에 예약된 TTL 삭제 복원
+    if (expiry_init() < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 중복 제거 저장소 (매니페스트 읽기, 참조 없는 청크 정리)
+    if (cas_init() < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 최근 채팅 기록 (고정 크기)
+    if (history_ring_init(&history_lobby, (size_t)g_config.history_kb * 1024,
+                          (uint32_t)g_config.history_msgs) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 영구 메시지 로그 복구, 재시작 전 최근 채팅을 기록 링에 다시 채움
+    if (msglog_start() < 0) {
+        exit(EXIT_FAILURE);
+    }
+    uint64_t last = msglog_last_seq();
+    uint64_t warm = (uint64_t)g_config.history_msgs;
+    msglog_read_after(last > warm ? last - warm : 0, (int)warm, warm_history, NULL);
+
+    // 오프라인 귓속말 보관함 인덱스
+    if (spool_start() < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 채팅방 (로비는 위 기록 링을 쓴다)
+    room_init();
+
+    int nshards = g_config.threads;
+    if (shard_init(nshards) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // shard 마다 listen 소켓 (바인드 실패는 시작 단계에서 바로 알 수 있도록 미리 연다)
+    ReactorArgs *args = calloc(nshards, sizeof(ReactorArgs));
+    if (!args) exit(EXIT_FAILURE);
+    for (int i = 0; i < nshards; i++) {
+        args[i].shard = i;
+        args[i].server_fd = open_listener();
+        if (args[i].server_fd < 0) exit(EXIT_FAILURE);
+    }
+
+    //printf("[DEBUG] SERVER sizeof(Message) = %ld\n", sizeof(Message));
+
+
+    printf("[SERVER] Listening on port %d (%s, %d reactor threads)...\n",
+           SERVER_PORT, event_backend_name(), nshards);
+    printf("[SERVER] Output queue: high %zu / low %zu bytes, slow policy: %s\n",
+           g_config.outq_high_wm, g_config.outq_low_wm,
+           slow_policy_name(g_config.slow_policy));
+    server_log("서버 시작 (포트 %d, %s, reactor %d개)", SERVER_PORT, event_backend_name(), nshards);
+
+    // 종료 시그널은 main 스레드(shard 0)가 받도록 나머지 스레드에서는 막아 둔다
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+
+    metrics_start();
+    if (g_config.metrics_port > 0) {
+        printf("[SERVER] Metrics on 127.0.0.1:%d\n", g_config.metrics_port);
+    }
+
+    pthread_t *tids = calloc(nshards, sizeof(pthread_t));
+    if (!tids) exit(EXIT_FAILURE);
+    for (int i = 1; i < nshards; i++) {
+        if (pthread_create(&tids[i], NULL, reactor_main, &args[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
         }
     }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    reactor_main(&args[0]);
+
+    // 종료 시그널: 모든 reactor 가 루프를 빠져나온 뒤에 로그들을 닫는다
+    for (int i = 1; i < nshards; i++) pthread_join(tids[i], NULL);
+
+    printf("\n[SERVER] 종료 중...\n");
+    msglog_shutdown();          // 링에 남은 메시지까지 디스크에 확정
+    server_log("서버 정상 종료됨.");
+    server_log_shutdown();      // 링에 남은 로그까지 파일에 기록
+    return 0;
 }
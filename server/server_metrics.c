@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "protocol.h"
+#include "server_config.h"
+#include "server_shard.h"
+#include "server_metrics.h"
+#include "server_msglog.h"
+#include "server_room.h"
+#include "server_ratelimit.h"
+#include "server_spool.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 지표 조회
+ *  - root 전용 /stats 채팅 명령: 한 메시지 분량 요약
+ *  - metrics 포트 (127.0.0.1, --metrics-port): Prometheus text 형식 전체 덤프
+ *      curl -s localhost:9001/metrics
+ * 기록은 스레드마다 따로 하고 (server_metrics.h), 여기서 읽을 때만 합산한다.
+ */
+
+#define HIST_LE_FIRST 10        // 2^10 ns ≈ 1us 부터
+#define HIST_LE_LAST  35        // 2^35 ns ≈ 34s 까지
+
+static ThreadMetrics  metrics_discard;                  // reactor 가 아닌 스레드용
+static ThreadMetrics *metrics_blocks[MAX_SHARDS];
+__thread ThreadMetrics *metrics_local = &metrics_discard;
+
+static time_t metrics_started;
+
+typedef struct {
+    uint64_t msgs_in[METRIC_MSG_TYPES];
+    uint64_t msgs_out[METRIC_MSG_TYPES];
+    uint64_t counters[M_COUNTER_COUNT];
+    int64_t  gauges[M_GAUGE_COUNT];
+    uint64_t hist[M_HIST_COUNT][METRIC_HIST_BUCKETS];
+    uint64_t hist_sum[M_HIST_COUNT];
+} MetricsSnapshot;
+
+static const char *msg_type_names[METRIC_MSG_TYPES] = {
+    [MSG_LOGIN]          = "login",
+    [MSG_LOGIN_OK]       = "login_ok",
+    [MSG_LOGIN_FAIL]     = "login_fail",
+    [MSG_CHAT]           = "chat",
+    [MSG_FILE_UPLOAD]    = "file_upload",
+    [MSG_FILE_DOWNLOAD]  = "file_download",
+    [MSG_FILE_READY]     = "file_ready",
+    [MSG_FILE_DATA]      = "file_data",
+    [MSG_FILE_END]       = "file_end",
+    [MSG_EXIT]           = "exit",
+    [MSG_ERROR]          = "error",
+    [MSG_DM]             = "dm",
+    [MSG_DM_FAIL]        = "dm_fail",
+    [MSG_FILE_BULK]      = "file_bulk",
+    [MSG_FILE_QUERY]     = "file_query",
+    [MSG_FILE_OFFSET]    = "file_offset",
+    [MSG_FILE_PUT_OPEN]  = "file_put_open",
+    [MSG_FILE_PUT_READY] = "file_put_ready",
+    [MSG_FILE_RANGE]     = "file_range",
+    [MSG_LIST_REQEUST]   = "list_request",
+    [MSG_LIST_RESPONSE]  = "list_response",
+    [MSG_FILE_RANGE_ACK] = "file_range_ack",
+    [MSG_HISTORY_REQUEST] = "history_request",
+    [MSG_HISTORY]        = "history",
+    [MSG_HISTORY_END]    = "history_end",
+    [MSG_ROOM]           = "room",
+    [MSG_KICK_NOTICE]    = "kick_notice",
+    [METRIC_MSG_TYPES - 1] = "other",
+};
+
+static const char *hist_names[M_HIST_COUNT] = {
+    [H_BROADCAST_FANOUT] = "broadcast_fanout",
+    [H_LOGIN_LATENCY]    = "login_latency",
+    [H_LOOP_ITERATION]   = "loop_iteration",
+};
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * reactor 스레드 시작 시 호출: 이 스레드 전용 기록 블록 등록
+ */
+void metrics_thread_init(int shard) {
+    ThreadMetrics *m = calloc(1, sizeof(ThreadMetrics));
+    if (!m) return;         // 기록은 공용 블록으로 (지표에는 안 잡힘)
+    metrics_blocks[shard] = m;
+    metrics_local = m;
+}
+
+static void metrics_collect(MetricsSnapshot *s) {
+    memset(s, 0, sizeof(*s));
+
+    for (int t = 0; t < MAX_SHARDS; t++) {
+        ThreadMetrics *m = metrics_blocks[t];
+        if (!m) continue;
+
+        for (int i = 0; i < METRIC_MSG_TYPES; i++) {
+            s->msgs_in[i]  += atomic_load_explicit(&m->msgs_in[i], memory_order_relaxed);
+            s->msgs_out[i] += atomic_load_explicit(&m->msgs_out[i], memory_order_relaxed);
+        }
+        for (int i = 0; i < M_COUNTER_COUNT; i++)
+            s->counters[i] += atomic_load_explicit(&m->counters[i], memory_order_relaxed);
+        for (int i = 0; i < M_GAUGE_COUNT; i++)
+            s->gauges[i] += atomic_load_explicit(&m->gauges[i], memory_order_relaxed);
+        for (int h = 0; h < M_HIST_COUNT; h++) {
+            for (int b = 0; b < METRIC_HIST_BUCKETS; b++)
+                s->hist[h][b] += atomic_load_explicit(&m->hists[h].counts[b], memory_order_relaxed);
+            s->hist_sum[h] += atomic_load_explicit(&m->hists[h].sum_ns, memory_order_relaxed);
+        }
+    }
+}
+
+static uint64_t hist_total(const uint64_t *counts) {
+    uint64_t n = 0;
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) n += counts[b];
+    return n;
+}
+
+// 백분위 근사값 (해당 2^b 구간의 상한, ns)
+static uint64_t hist_quantile(const uint64_t *counts, double q) {
+    uint64_t total = hist_total(counts);
+    if (total == 0) return 0;
+
+    uint64_t want = (uint64_t)(q * (double)total);
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= want) return b >= 63 ? UINT64_MAX : (1ull << b);
+    }
+    return UINT64_MAX;
+}
+
+/* ----------------------- Prometheus text ----------------------- */
+
+static void write_counter(FILE *fp, const char *name, const char *help, uint64_t v) {
+    fprintf(fp, "# HELP chat_%s %s\n# TYPE chat_%s counter\nchat_%s %llu\n",
+            name, help, name, name, (unsigned long long)v);
+}
+
+static void write_gauge(FILE *fp, const char *name, const char *help, long long v) {
+    fprintf(fp, "# HELP chat_%s %s\n# TYPE chat_%s gauge\nchat_%s %lld\n",
+            name, help, name, name, v);
+}
+
+static void write_msg_types(FILE *fp, const char *name, const char *help, const uint64_t *v) {
+    fprintf(fp, "# HELP chat_%s %s\n# TYPE chat_%s counter\n", name, help, name);
+    for (int i = 0; i < METRIC_MSG_TYPES; i++) {
+        if (v[i] == 0) continue;
+        if (msg_type_names[i])
+            fprintf(fp, "chat_%s{type=\"%s\"} %llu\n", name, msg_type_names[i], (unsigned long long)v[i]);
+        else
+            fprintf(fp, "chat_%s{type=\"%d\"} %llu\n", name, i, (unsigned long long)v[i]);
+    }
+}
+
+static void write_hist(FILE *fp, const char *name, const char *help,
+                       const uint64_t *counts, uint64_t sum_ns) {
+    fprintf(fp, "# HELP chat_%s_seconds %s\n# TYPE chat_%s_seconds histogram\n", name, help, name);
+
+    uint64_t cum = 0;
+    for (int b = 0; b < METRIC_HIST_BUCKETS; b++) {
+        cum += counts[b];
+        if (b < HIST_LE_FIRST || b > HIST_LE_LAST) continue;
+        // 구간 b 는 [2^(b-1), 2^b) ns → 누적값은 "2^b ns 미만"
+        fprintf(fp, "chat_%s_seconds_bucket{le=\"%.9g\"} %llu\n",
+                name, (double)(1ull << b) / 1e9, (unsigned long long)cum);
+    }
+    fprintf(fp, "chat_%s_seconds_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cum);
+    fprintf(fp, "chat_%s_seconds_sum %.9f\n", name, (double)sum_ns / 1e9);
+    fprintf(fp, "chat_%s_seconds_count %llu\n", name, (unsigned long long)cum);
+}
+
+/**
+ * 방마다 label 을 붙인 값 (방 이름은 [A-Za-z0-9_-] 라 escape 가 필요 없다)
+ */
+static void write_rooms(FILE *fp) {
+    static const struct { const char *name, *type, *help; } fam[] = {
+        { "room_members", "gauge", "Members per chat room." },
+        { "room_messages_total", "counter", "Chat messages sent to each room." },
+        { "room_recipients_total", "counter", "Recipients queued by each room's chats." },
+    };
+    RoomStat *list = malloc(sizeof(RoomStat) * MAX_ROOMS);
+    if (!list) return;
+    int n = room_list(list, MAX_ROOMS);
+
+    for (int f = 0; f < 3; f++) {
+        fprintf(fp, "# HELP chat_%s %s\n# TYPE chat_%s %s\n", fam[f].name, fam[f].help, fam[f].name, fam[f].type);
+        for (int i = 0; i < n; i++) {
+            unsigned long long v = f == 0 ? (unsigned long long)list[i].members
+                                 : f == 1 ? list[i].msgs : list[i].recipients;
+            fprintf(fp, "chat_%s{room=\"%s\"} %llu\n", fam[f].name, list[i].name, v);
+        }
+    }
+    free(list);
+}
+
+void metrics_write_prometheus(FILE *fp) {
+    MetricsSnapshot *s = malloc(sizeof(MetricsSnapshot));
+    if (!s) return;
+    metrics_collect(s);
+
+    write_gauge(fp, "uptime_seconds", "Seconds since server start.",
+                (long long)(time(NULL) - metrics_started));
+    write_gauge(fp, "reactor_threads", "Reactor threads (shards).", shard_count);
+
+    write_msg_types(fp, "messages_in_total", "Messages received, by type.", s->msgs_in);
+    write_msg_types(fp, "messages_out_total", "Messages queued to clients, by type.", s->msgs_out);
+
+    write_counter(fp, "connections_accepted_total", "Accepted connections.", s->counters[M_ACCEPTED]);
+    write_counter(fp, "disconnects_total", "Closed connections.", s->counters[M_DISCONNECTED]);
+    write_counter(fp, "logins_ok_total", "Successful logins.", s->counters[M_LOGIN_OK]);
+    write_counter(fp, "logins_failed_total", "Failed logins.", s->counters[M_LOGIN_FAIL]);
+    write_counter(fp, "bytes_received_total", "Bytes read from client sockets.", s->counters[M_BYTES_IN]);
+    write_counter(fp, "bytes_sent_total", "Bytes written to client sockets.", s->counters[M_BYTES_OUT]);
+    write_counter(fp, "send_calls_total", "sendmsg calls made flushing output queues.",
+                  s->counters[M_SEND_CALLS]);
+    write_counter(fp, "frames_sent_total", "Frames fully written from output queues.",
+                  s->counters[M_FRAMES_OUT]);
+    write_counter(fp, "file_bytes_received_total", "Uploaded file bytes.", s->counters[M_FILE_BYTES_IN]);
+    write_counter(fp, "file_bytes_sent_total", "Downloaded file bytes.", s->counters[M_FILE_BYTES_OUT]);
+    write_counter(fp, "outq_dropped_total", "Messages dropped by the slow client policy.",
+                  s->counters[M_OUTQ_DROPPED]);
+    write_counter(fp, "broadcasts_total", "Broadcast fan-outs (per shard).", s->counters[M_BROADCASTS]);
+    write_counter(fp, "broadcast_recipients_total", "Recipients queued by broadcasts.",
+                  s->counters[M_BROADCAST_RECIPIENTS]);
+    write_counter(fp, "mailbox_messages_total", "Cross-shard mailbox items handled.", s->counters[M_MAIL_IN]);
+    write_counter(fp, "files_expired_total", "Uploaded files removed after their TTL.",
+                  s->counters[M_FILES_EXPIRED]);
+    write_counter(fp, "idle_timeouts_total", "Connections closed for being idle.", s->counters[M_IDLE_TIMEOUTS]);
+    write_counter(fp, "cas_chunks_stored_total", "New chunks written to the chunk store.",
+                  s->counters[M_CAS_CHUNKS_STORED]);
+    write_counter(fp, "cas_chunks_reused_total", "Uploaded chunks the store already had.",
+                  s->counters[M_CAS_CHUNKS_REUSED]);
+    write_counter(fp, "cas_bytes_reused_total", "Upload bytes skipped by deduplication.",
+                  s->counters[M_CAS_BYTES_REUSED]);
+    write_counter(fp, "msglog_appended_total", "Messages queued to the persistent log.",
+                  s->counters[M_MSGLOG_APPENDED]);
+    write_counter(fp, "msglog_dropped_total", "Messages not logged because the log ring was full.",
+                  s->counters[M_MSGLOG_DROPPED]);
+    write_counter(fp, "rate_limited_msgs_total", "Times a connection was paused by its message rate limit.",
+                  s->counters[M_RATE_LIMITED_MSGS]);
+    write_counter(fp, "rate_limited_bytes_total", "Times a connection was paused by its byte rate limit.",
+                  s->counters[M_RATE_LIMITED_BYTES]);
+    write_counter(fp, "accepts_delayed_total", "Times accepting was put off by the accept rate limit.",
+                  s->counters[M_ACCEPT_DELAYED]);
+    write_counter(fp, "handshakes_rejected_total", "Connections closed because too many were not logged in.",
+                  s->counters[M_HANDSHAKE_REJECTED]);
+    write_gauge(fp, "handshakes_pending", "Connections not logged in yet.", admit_handshakes());
+
+    SpoolStats sp;
+    spool_stats(&sp);
+    write_counter(fp, "spool_stored_total", "DMs kept for offline users.", s->counters[M_SPOOL_STORED]);
+    write_counter(fp, "spool_delivered_total", "Kept DMs delivered at login.", s->counters[M_SPOOL_DELIVERED]);
+    write_counter(fp, "spool_expired_total", "Kept DMs dropped after their TTL.", s->counters[M_SPOOL_EXPIRED]);
+    write_counter(fp, "spool_full_total", "DMs refused because the recipient's spool was full.",
+                  s->counters[M_SPOOL_FULL]);
+    write_gauge(fp, "spool_users", "Offline users with kept DMs.", (long long)sp.users);
+    write_gauge(fp, "spool_messages", "DMs waiting for offline users.", (long long)sp.msgs);
+    write_gauge(fp, "spool_bytes", "Spool bytes on disk.", (long long)sp.bytes);
+
+    // 영구 로그 writer 는 reactor 가 아니므로 자기 값을 따로 둔다
+    MsglogStats ml;
+    msglog_stats(&ml);
+    write_counter(fp, "msglog_records_total", "Records written to the persistent log.", ml.records);
+    write_counter(fp, "msglog_bytes_total", "Bytes written to the persistent log.", ml.bytes);
+    write_counter(fp, "msglog_commits_total", "Group commits (one fdatasync each).", ml.syncs);
+    fprintf(fp, "# HELP chat_msglog_commit_seconds_total Time spent in fdatasync.\n"
+                "# TYPE chat_msglog_commit_seconds_total counter\n"
+                "chat_msglog_commit_seconds_total %.9f\n", (double)ml.sync_ns / 1e9);
+    write_counter(fp, "msglog_segments_compacted_total", "Segments removed or rewritten by retention.",
+                  ml.compactions);
+    write_gauge(fp, "msglog_last_seq", "Last durable log sequence number.", (long long)ml.last_seq);
+    write_gauge(fp, "msglog_segments", "Log segments on disk.", (long long)ml.segments);
+    write_gauge(fp, "msglog_disk_bytes", "Log bytes on disk.", (long long)ml.disk_bytes);
+
+    write_rooms(fp);
+
+    write_gauge(fp, "connections", "Open connections.", s->gauges[G_CONNECTIONS]);
+    write_gauge(fp, "uploads_active", "Single-stream uploads in progress.", s->gauges[G_UPLOADS]);
+    write_gauge(fp, "downloads_active", "Downloads in progress.", s->gauges[G_DOWNLOADS]);
+    write_gauge(fp, "upload_ranges_active", "Parallel upload ranges being received.", s->gauges[G_RANGES]);
+    write_gauge(fp, "outq_bytes", "Bytes waiting in output queues.", s->gauges[G_OUTQ_BYTES]);
+    write_gauge(fp, "read_backlog", "Sockets deferred to the next loop iteration.", s->gauges[G_READ_BACKLOG]);
+
+    write_hist(fp, hist_names[H_BROADCAST_FANOUT], "Time to queue one broadcast on a shard.",
+               s->hist[H_BROADCAST_FANOUT], s->hist_sum[H_BROADCAST_FANOUT]);
+    write_hist(fp, hist_names[H_LOGIN_LATENCY], "Time from accept to LOGIN_OK.",
+               s->hist[H_LOGIN_LATENCY], s->hist_sum[H_LOGIN_LATENCY]);
+    write_hist(fp, hist_names[H_LOOP_ITERATION], "Event loop iteration time, excluding the wait.",
+               s->hist[H_LOOP_ITERATION], s->hist_sum[H_LOOP_ITERATION]);
+    free(s);
+}
+
+/* ----------------------- /stats 요약 ----------------------- */
+
+static void fmt_ns(char *out, size_t size, uint64_t ns) {
+    if (ns == UINT64_MAX)   snprintf(out, size, "inf");
+    else if (ns < 1000)     snprintf(out, size, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000)  snprintf(out, size, "%.0fus", ns / 1e3);
+    else if (ns < 1000000000ull) snprintf(out, size, "%.1fms", ns / 1e6);
+    else                    snprintf(out, size, "%.2fs", ns / 1e9);
+}
+
+static void fmt_bytes(char *out, size_t size, uint64_t b) {
+    if (b < 1024)                snprintf(out, size, "%lluB", (unsigned long long)b);
+    else if (b < 1024 * 1024)    snprintf(out, size, "%.1fK", b / 1024.0);
+    else if (b < 1024ull << 30)  snprintf(out, size, "%.1fM", b / 1048576.0);
+    else                         snprintf(out, size, "%.2fG", b / 1073741824.0);
+}
+
+/**
+ * 채팅 메시지 하나에 들어가는 요약 (root 의 /stats)
+ */
+void metrics_format_summary(char *buf, size_t size) {
+    MetricsSnapshot *s = malloc(sizeof(MetricsSnapshot));
+    if (!s) {
+        snprintf(buf, size, "stats unavailable");
+        return;
+    }
+    metrics_collect(s);
+
+    uint64_t in = 0, out = 0;
+    int top[3] = { -1, -1, -1 };
+    for (int i = 0; i < METRIC_MSG_TYPES; i++) {
+        in += s->msgs_in[i];
+        out += s->msgs_out[i];
+        // 받은 개수 상위 3개 타입
+        for (int k = 0; k < 3; k++) {
+            if (s->msgs_in[i] && (top[k] < 0 || s->msgs_in[i] > s->msgs_in[top[k]])) {
+                for (int j = 2; j > k; j--) top[j] = top[j - 1];
+                top[k] = i;
+                break;
+            }
+        }
+    }
+
+    char tops[128] = "";
+    for (int k = 0; k < 3 && top[k] >= 0; k++) {
+        char one[40];
+        snprintf(one, sizeof(one), "%s%s %llu", k ? ", " : "",
+                 msg_type_names[top[k]] ? msg_type_names[top[k]] : "?",
+                 (unsigned long long)s->msgs_in[top[k]]);
+        strncat(tops, one, sizeof(tops) - strlen(tops) - 1);
+    }
+
+    char bin[16], bout[16], fin[16], fout[16], oq[16];
+    fmt_bytes(bin, sizeof(bin), s->counters[M_BYTES_IN]);
+    fmt_bytes(bout, sizeof(bout), s->counters[M_BYTES_OUT]);
+    fmt_bytes(fin, sizeof(fin), s->counters[M_FILE_BYTES_IN]);
+    fmt_bytes(fout, sizeof(fout), s->counters[M_FILE_BYTES_OUT]);
+    fmt_bytes(oq, sizeof(oq), (uint64_t)(s->gauges[G_OUTQ_BYTES] > 0 ? s->gauges[G_OUTQ_BYTES] : 0));
+
+    char q[M_HIST_COUNT][2][16];
+    for (int h = 0; h < M_HIST_COUNT; h++) {
+        fmt_ns(q[h][0], sizeof(q[h][0]), hist_quantile(s->hist[h], 0.50));
+        fmt_ns(q[h][1], sizeof(q[h][1]), hist_quantile(s->hist[h], 0.99));
+    }
+
+    snprintf(buf, size,
+             "[stats] uptime %lds, %d reactor threads\n"
+             "conn %lld open / %llu accepted / %llu closed, login ok %llu fail %llu\n"
+             "msgs in %llu (%s), out %llu, dropped %llu\n"
+             "bytes in %s out %s, file in %s out %s, %.1f frames/send\n"
+             "transfers: up %lld down %lld ranges %lld, outq %s, backlog %lld\n"
+             "fanout p50 %s p99 %s | login p50 %s p99 %s | loop p50 %s p99 %s",
+             (long)(time(NULL) - metrics_started), shard_count,
+             (long long)s->gauges[G_CONNECTIONS],
+             (unsigned long long)s->counters[M_ACCEPTED],
+             (unsigned long long)s->counters[M_DISCONNECTED],
+             (unsigned long long)s->counters[M_LOGIN_OK],
+             (unsigned long long)s->counters[M_LOGIN_FAIL],
+             (unsigned long long)in, tops, (unsigned long long)out,
+             (unsigned long long)s->counters[M_OUTQ_DROPPED],
+             bin, bout, fin, fout,
+             s->counters[M_SEND_CALLS] ?
+                 (double)s->counters[M_FRAMES_OUT] / s->counters[M_SEND_CALLS] : 0.0,
+             (long long)s->gauges[G_UPLOADS], (long long)s->gauges[G_DOWNLOADS],
+             (long long)s->gauges[G_RANGES], oq, (long long)s->gauges[G_READ_BACKLOG],
+             q[H_BROADCAST_FANOUT][0], q[H_BROADCAST_FANOUT][1],
+             q[H_LOGIN_LATENCY][0], q[H_LOGIN_LATENCY][1],
+             q[H_LOOP_ITERATION][0], q[H_LOOP_ITERATION][1]);
+    free(s);
+}
+
+/* ----------------------- metrics 포트 ----------------------- */
+
+/**
+ * 요청 하나 처리: HTTP GET 이면 HTTP 응답으로, 아니면 (nc 등) 본문만 보낸다
+ */
+static void metrics_serve(int fd) {
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char req[1024];
+    ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+    int http = n >= 4 && memcmp(req, "GET ", 4) == 0;
+
+    char *body = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&body, &len);
+    if (!fp) return;
+    metrics_write_prometheus(fp);
+    fclose(fp);
+
+    char head[160];
+    int hlen = 0;
+    if (http) {
+        hlen = snprintf(head, sizeof(head),
+                        "HTTP/1.0 200 OK\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: %zu\r\n\r\n", len);
+    }
+
+    struct iovec iov[2] = { { head, (size_t)hlen }, { body, len } };
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 2;
+    if (sendmsg(fd, &mh, MSG_NOSIGNAL) < 0 && errno != EPIPE) {
+        server_log("metrics: send failed (errno=%d)", errno);
+    }
+    free(body);
+}
+
+static void *metrics_listener_main(void *arg) {
+    int lfd = *(int *)arg;
+    free(arg);
+
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            server_log("metrics: accept failed (errno=%d), listener stopped", errno);
+            break;
+        }
+        metrics_serve(fd);
+        close(fd);
+    }
+    close(lfd);
+    return NULL;
+}
+
+/**
+ * 시작 시각 기록 + (설정되어 있으면) 127.0.0.1:metrics_port 리스너 스레드 시작
+ * 포트를 못 열면 로그만 남기고 서버는 계속 동작한다.
+ */
+int metrics_start(void) {
+    metrics_started = time(NULL);
+    if (g_config.metrics_port <= 0) return 0;
+
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return -1;
+
+    int opt = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);      // 로컬에서만 조회
+    addr.sin_port = htons(g_config.metrics_port);
+
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0) {
+        server_log("metrics: cannot listen on 127.0.0.1:%d (errno=%d)", g_config.metrics_port, errno);
+        perror("metrics listen");
+        close(lfd);
+        return 0;
+    }
+
+    int *arg = malloc(sizeof(int));
+    pthread_t tid;
+    if (!arg) {
+        close(lfd);
+        return 0;
+    }
+    *arg = lfd;
+    if (pthread_create(&tid, NULL, metrics_listener_main, arg) != 0) {
+        free(arg);
+        close(lfd);
+        return 0;
+    }
+    pthread_detach(tid);
+    return 0;
+}
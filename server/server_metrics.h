@@ -0,0 +1,122 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*
+ * 서버 지표 (카운터 / 게이지 / 히스토그램)
+ *  - reactor 스레드마다 자기 블록에만 기록한다. (락/원자적 RMW 없음, 일반 load+store)
+ *  - 읽을 때(/stats, metrics 포트) 모든 스레드 블록을 합산한다.
+ */
+
+#define METRIC_MSG_TYPES   128      // 메시지 타입별 카운터 (그 이상은 127 로 묶음)
+#define METRIC_HIST_BUCKETS 64      // 2^k ns 구간
+
+typedef enum {
+    M_ACCEPTED = 0,         // accept 한 연결
+    M_DISCONNECTED,
+    M_LOGIN_OK,
+    M_LOGIN_FAIL,
+    M_BYTES_IN,             // 소켓에서 읽은 바이트 (프레임 + 구간 본문)
+    M_BYTES_OUT,            // 소켓으로 보낸 바이트 (프레임 + sendfile)
+    M_SEND_CALLS,           // 출력 큐 flush 의 sendmsg 호출 수
+    M_FRAMES_OUT,           // 출력 큐에서 다 보낸 프레임 수
+    M_FILE_BYTES_IN,        // 업로드 파일 데이터
+    M_FILE_BYTES_OUT,       // 다운로드 파일 데이터
+    M_OUTQ_DROPPED,         // 느린 클라이언트 정책으로 버린 메시지
+    M_BROADCASTS,           // broadcast 호출 (shard 별 전달 포함)
+    M_BROADCAST_RECIPIENTS, // broadcast 로 큐에 넣은 수신자 수
+    M_MAIL_IN,              // 다른 shard 에서 받은 작업
+    M_FILES_EXPIRED,        // TTL 이 지나 삭제한 파일
+    M_IDLE_TIMEOUTS,        // 유휴 시간 초과로 끊은 연결
+    M_CAS_CHUNKS_STORED,    // 새로 저장한 청크
+    M_CAS_CHUNKS_REUSED,    // 이미 있어서 본문을 받지 않은 청크
+    M_CAS_BYTES_REUSED,     // 중복 제거로 받지 않은 바이트
+    M_MSGLOG_APPENDED,      // 영구 로그 링에 넣은 메시지
+    M_MSGLOG_DROPPED,       // 로그 링이 가득 차서 기록하지 못한 메시지
+    M_RATE_LIMITED_MSGS,    // 메시지 버킷이 비어 연결을 멈춘 횟수
+    M_RATE_LIMITED_BYTES,   // 바이트 버킷이 비어 연결을 멈춘 횟수
+    M_ACCEPT_DELAYED,       // accept 버킷이 비어 accept 를 미룬 횟수
+    M_HANDSHAKE_REJECTED,   // 로그인 전 연결이 가득 차서 바로 닫은 연결
+    M_SPOOL_STORED,         // 오프라인 사용자 보관함에 넣은 귓속말
+    M_SPOOL_DELIVERED,      // 로그인할 때 꺼내 보낸 귓속말
+    M_SPOOL_EXPIRED,        // 보관 기간이 지나 버린 귓속말
+    M_SPOOL_FULL,           // 보관함이 가득 차서 거절한 귓속말
+    M_COUNTER_COUNT
+} MetricCounter;
+
+typedef enum {
+    G_CONNECTIONS = 0,      // 접속 중인 연결
+    G_UPLOADS,              // 진행 중인 단일 업로드
+    G_DOWNLOADS,            // 진행 중인 다운로드
+    G_RANGES,               // 받는 중인 병렬 업로드 구간
+    G_OUTQ_BYTES,           // 출력 큐에 쌓인 바이트 합
+    G_READ_BACKLOG,         // 다음 tick 으로 미룬 읽기
+    M_GAUGE_COUNT
+} MetricGauge;
+
+typedef enum {
+    H_BROADCAST_FANOUT = 0, // broadcast 1회를 이 shard 수신자 큐에 넣는 시간
+    H_LOGIN_LATENCY,        // accept → LOGIN_OK
+    H_LOOP_ITERATION,       // 이벤트 루프 1회 처리 시간 (대기 제외)
+    M_HIST_COUNT
+} MetricHist;
+
+typedef struct {
+    _Atomic uint64_t counts[METRIC_HIST_BUCKETS];
+    _Atomic uint64_t sum_ns;
+} HistBlock;
+
+typedef struct {
+    _Atomic uint64_t msgs_in[METRIC_MSG_TYPES];
+    _Atomic uint64_t msgs_out[METRIC_MSG_TYPES];
+    _Atomic uint64_t counters[M_COUNTER_COUNT];
+    _Atomic int64_t  gauges[M_GAUGE_COUNT];
+    HistBlock        hists[M_HIST_COUNT];
+} ThreadMetrics;
+
+// 이 스레드의 기록 블록 (reactor 스레드가 아니면 버려지는 공용 블록)
+extern __thread ThreadMetrics *metrics_local;
+
+// 스레드 소유 값이므로 RMW 대신 relaxed load + store
+#define METRIC_BUMP(field, n) \
+    atomic_store_explicit(&(field), atomic_load_explicit(&(field), memory_order_relaxed) + (n), \
+                          memory_order_relaxed)
+
+static inline void metric_add(MetricCounter c, uint64_t n) {
+    METRIC_BUMP(metrics_local->counters[c], n);
+}
+
+static inline void metric_gauge_add(MetricGauge g, int64_t d) {
+    METRIC_BUMP(metrics_local->gauges[g], d);
+}
+
+static inline void metric_gauge_set(MetricGauge g, int64_t v) {
+    atomic_store_explicit(&metrics_local->gauges[g], v, memory_order_relaxed);
+}
+
+static inline void metric_msg_in(int type) {
+    METRIC_BUMP(metrics_local->msgs_in[(unsigned)type < METRIC_MSG_TYPES ? type : METRIC_MSG_TYPES - 1], 1);
+}
+
+static inline void metric_msg_out(int type) {
+    METRIC_BUMP(metrics_local->msgs_out[(unsigned)type < METRIC_MSG_TYPES ? type : METRIC_MSG_TYPES - 1], 1);
+}
+
+static inline void metric_observe(MetricHist h, uint64_t ns) {
+    int b = ns ? 64 - __builtin_clzll(ns) : 0;     // ns < 2^b
+    if (b >= METRIC_HIST_BUCKETS) b = METRIC_HIST_BUCKETS - 1;
+    METRIC_BUMP(metrics_local->hists[h].counts[b], 1);
+    METRIC_BUMP(metrics_local->hists[h].sum_ns, ns);
+}
+
+uint64_t metrics_now_ns(void);
+void     metrics_thread_init(int shard);
+int      metrics_start(void);
+void     metrics_write_prometheus(FILE *fp);
+void     metrics_format_summary(char *buf, size_t size);
+
+#endif
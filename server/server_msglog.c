@@ -0,0 +1,869 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "frame.h"
+#include "server_config.h"
+#include "server_log.h"
+#include "server_metrics.h"
+#include "server_msglog.h"
+
+/*
+ * 파일 배치
+ *   <첫 seq 20자리>.log : 레코드를 이어 쓴 세그먼트
+ *   <첫 seq 20자리>.idx : 희소 인덱스 {seq, 위치} 배열. 크기를 미리 잡아 mmap 해 두고,
+ *                         seq == 0 인 항목이 끝 표시. 로그 MSGLOG_INDEX_EVERY 바이트마다 1개.
+ * 레코드 = RecHdr + 보낸 사람 + 받는 사람 + 본문. sum 이 안 맞거나 seq 가 이어지지 않는 곳부터는
+ * 쓰다 만 꼬리로 보고 시작할 때 잘라낸다.
+ *
+ * 생산자 → writer 는 server_log.c 와 같은 bounded MPSC 링이다.
+ * 링 pos 번째 슬롯의 레코드가 seq_base + pos 가 되므로 seq 는 슬롯을 잡을 때 정해지고
+ * 빈 번호 없이 이어진다. (링이 가득 차서 버린 메시지는 슬롯을 잡지 않으므로 번호도 쓰지 않는다)
+ *
+ * 잠금
+ *  - seg_lock: 세그먼트 목록과 각 세그먼트의 size/last/nidx. 조회는 잡은 채로 읽는다.
+ *  - 활성 세그먼트 파일은 writer 만 쓰고, 정리 스레드는 봉인된 세그먼트만 지우거나 다시 쓴다.
+ */
+
+#define MSGLOG_RING_SLOTS   4096                // 2의 거듭제곱
+#define MSGLOG_BATCH_SIZE   (256 * 1024)        // writer 가 한 번에 write() 하는 크기
+#define MSGLOG_INDEX_EVERY  4096                // 인덱스 항목 간격 (bytes)
+#define MSGLOG_COMPACT_SEC  10                  // 정리 스레드 주기
+
+typedef struct {
+    uint32_t len;           // 헤더 뒤 바이트 수
+    uint32_t sum;           // seq 부터 레코드 끝까지 FNV-1a
+    uint64_t seq;
+    int64_t  ts_ms;
+    uint8_t  type;
+    uint8_t  sender_len;
+    uint8_t  target_len;
+    uint8_t  pad[5];
+} RecHdr;
+
+#define REC_MAX (sizeof(RecHdr) + 2 * MAX_NAME + MAX_BUF)
+
+typedef struct {
+    uint64_t seq;
+    uint64_t off;
+} IdxEntry;
+
+typedef struct {
+    uint64_t  base;         // 첫 seq (파일 이름)
+    uint64_t  last;         // 마지막 seq (비었으면 base - 1)
+    int64_t   first_ts;     // 첫/마지막 레코드 시각 (보존 기간 판단)
+    int64_t   last_ts;
+    uint64_t  size;         // 기록된 바이트 (조회는 여기까지만)
+    int       fd;
+    IdxEntry *idx;          // mmap
+    uint32_t  nidx;
+    uint32_t  idx_cap;
+} Segment;
+
+typedef struct {
+    atomic_size_t turn;     // server_log.c 의 slot seq 와 같은 규칙
+    int64_t  ts_ms;
+    uint16_t len;
+    uint8_t  type;
+    uint8_t  sender_len;
+    uint8_t  target_len;
+    char     data[2 * MAX_NAME + MAX_BUF];     // 보낸 사람 + 받는 사람 + 본문
+} MsgSlot;
+
+static MsgSlot       ring[MSGLOG_RING_SLOTS];
+static atomic_size_t ring_tail;
+static size_t        ring_head;                 // writer 만 사용
+static uint64_t      seq_base;                  // 링 pos 0 의 seq
+static atomic_int    msglog_stop;
+static int           running = 0;
+
+static pthread_t writer_tid, compact_tid;
+
+static pthread_mutex_t seg_lock = PTHREAD_MUTEX_INITIALIZER;
+static Segment **segs;
+static int       nsegs, segs_cap;
+static Segment  *active;                        // 쓰는 중인 마지막 세그먼트 (writer 소유)
+
+static pthread_mutex_t compact_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  compact_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t segment_bytes, retain_bytes;
+static int64_t  retain_ms;
+
+static _Atomic uint64_t st_last, st_records, st_bytes, st_syncs, st_sync_ns, st_compactions;
+
+#define SLOT_INDEX(pos) ((pos) & (MSGLOG_RING_SLOTS - 1))
+
+static inline size_t slot_turn(size_t pos) {
+    return atomic_load_explicit(&ring[SLOT_INDEX(pos)].turn, memory_order_acquire) + SLOT_INDEX(pos);
+}
+
+static inline void slot_set_turn(size_t pos, size_t turn) {
+    atomic_store_explicit(&ring[SLOT_INDEX(pos)].turn, turn - SLOT_INDEX(pos), memory_order_release);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t fnv1a(uint32_t h, const void *p, size_t n) {
+    const uint8_t *b = p;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t rec_sum(const RecHdr *h, const void *payload) {
+    uint32_t s = fnv1a(2166136261u, &h->seq, sizeof(*h) - offsetof(RecHdr, seq));
+    return fnv1a(s, payload, h->len);
+}
+
+/* ----------------------- 생산자 ----------------------- */
+
+/**
+ * 메시지 한 건을 로그 링에 넣는다. (reactor 스레드, 락/시스템 콜 없음)
+ * 디스크 기록은 writer 스레드가 모아서 한다.
+ */
+uint64_t msglog_append(const Message *m) {
+    if (!running) return 0;
+
+    size_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    MsgSlot *slot;
+
+    for (;;) {
+        slot = &ring[SLOT_INDEX(pos)];
+        intptr_t dif = (intptr_t)slot_turn(pos) - (intptr_t)pos;
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            // 링이 가득 참: 방송 경로를 막지 않고 버린다
+            metric_add(M_MSGLOG_DROPPED, 1);
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
+    }
+
+    size_t slen = strnlen(m->sender, MAX_NAME - 1);
+    size_t tlen = strnlen(m->target, MAX_NAME - 1);
+    size_t blen = message_body_len(m);
+
+    slot->ts_ms = now_ms();
+    slot->type = (uint8_t)m->type;
+    slot->sender_len = (uint8_t)slen;
+    slot->target_len = (uint8_t)tlen;
+    slot->len = (uint16_t)blen;
+    memcpy(slot->data, m->sender, slen);
+    memcpy(slot->data + slen, m->target, tlen);
+    memcpy(slot->data + slen + tlen, m->data, blen);
+
+    slot_set_turn(pos, pos + 1);
+    metric_add(M_MSGLOG_APPENDED, 1);
+    return seq_base + pos;
+}
+
+/* ----------------------- 세그먼트 파일 ----------------------- */
+
+static void seg_path(char *out, size_t size, uint64_t base, const char *ext) {
+    snprintf(out, size, MSGLOG_DIR "%020llu.%s", (unsigned long long)base, ext);
+}
+
+static void sync_dir(void) {
+    int fd = open(MSGLOG_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int pread_full(int fd, void *buf, size_t len, uint64_t off) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, (char *)buf + done, len - done, (off_t)(off + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const void *buf, size_t len, uint64_t off) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(fd, (const char *)buf + done, len - done, (off_t)(off + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * 인덱스 파일을 최소 cap 항목 크기로 열어 mmap. 이미 있는 항목은 유효한 것만 남긴다.
+ */
+static int idx_open(Segment *s, uint32_t cap) {
+    char path[256];
+    seg_path(path, sizeof(path), s->base, "idx");
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((uint64_t)st.st_size / sizeof(IdxEntry) > cap)
+        cap = (uint32_t)(st.st_size / sizeof(IdxEntry));
+    if ((uint64_t)st.st_size < (uint64_t)cap * sizeof(IdxEntry) &&
+        ftruncate(fd, (off_t)cap * sizeof(IdxEntry)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *p = mmap(NULL, (size_t)cap * sizeof(IdxEntry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+
+    s->idx = p;
+    s->idx_cap = cap;
+
+    // 끝 표시(seq 0) 전까지, 위치가 파일 안에 있고 seq/위치가 늘어나는 항목만 믿는다
+    uint32_t n = 0;
+    while (n < cap && s->idx[n].seq != 0 && s->idx[n].seq >= s->base && s->idx[n].off < s->size &&
+           (n == 0 || (s->idx[n].seq > s->idx[n - 1].seq && s->idx[n].off > s->idx[n - 1].off)))
+        n++;
+    s->nidx = n;
+    return 0;
+}
+
+static void idx_add(Segment *s, uint64_t seq, uint64_t off) {
+    if (s->nidx > 0 && off - s->idx[s->nidx - 1].off < MSGLOG_INDEX_EVERY) return;
+    if (s->nidx + 1 >= s->idx_cap) return;     // 끝 표시 자리는 남긴다 (뒤쪽은 순차로 찾음)
+    s->idx[s->nidx].off = off;
+    s->idx[s->nidx].seq = seq;
+    s->nidx++;
+}
+
+static void seg_destroy(Segment *s, int remove) {
+    if (s->idx) munmap(s->idx, (size_t)s->idx_cap * sizeof(IdxEntry));
+    if (s->fd >= 0) close(s->fd);
+    if (remove) {
+        char path[256];
+        seg_path(path, sizeof(path), s->base, "log");
+        unlink(path);
+        seg_path(path, sizeof(path), s->base, "idx");
+        unlink(path);
+    }
+    free(s);
+}
+
+/**
+ * off 부터 레코드를 확인하며 last/last_ts/인덱스를 채운다.
+ * 깨진 레코드를 만나면 거기서 파일을 잘라낸다. 반환: 확인한 끝 위치
+ */
+static uint64_t seg_scan(Segment *s, uint64_t off, uint64_t expect, uint64_t file_size) {
+    char buf[REC_MAX];
+
+    while (off + sizeof(RecHdr) <= file_size) {
+        RecHdr h;
+        if (pread_full(s->fd, &h, sizeof(h), off) < 0) break;
+        if (h.len > REC_MAX - sizeof(RecHdr) || h.sender_len + h.target_len > h.len ||
+            off + sizeof(h) + h.len > file_size)
+            break;
+        if (h.seq != expect) break;
+        if (pread_full(s->fd, buf, h.len, off + sizeof(h)) < 0 || rec_sum(&h, buf) != h.sum) break;
+
+        if (off == 0) s->first_ts = h.ts_ms;
+        idx_add(s, h.seq, off);
+        s->last = h.seq;
+        s->last_ts = h.ts_ms;
+        expect = h.seq + 1;
+        off += sizeof(h) + h.len;
+    }
+
+    if (off < file_size) {
+        server_log("(msglog) %020llu.log: %llu bytes of torn tail truncated",
+                   (unsigned long long)s->base, (unsigned long long)(file_size - off));
+        if (ftruncate(s->fd, (off_t)off) == 0) fdatasync(s->fd);
+    }
+    return off;
+}
+
+/**
+ * 세그먼트 하나를 열고 확인한다.
+ * 인덱스를 믿을 수 있으면 마지막 인덱스 항목부터만, 아니면 처음부터 훑어 인덱스를 다시 만든다.
+ */
+static Segment *seg_load(uint64_t base, int rebuild) {
+    char path[256];
+    seg_path(path, sizeof(path), base, "log");
+
+    Segment *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->base = base;
+    s->last = base - 1;
+    s->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (s->fd < 0) {
+        free(s);
+        return NULL;
+    }
+
+    struct stat st;
+    fstat(s->fd, &st);
+    s->size = (uint64_t)st.st_size;
+
+    uint64_t need = (s->size > segment_bytes ? s->size : segment_bytes) / MSGLOG_INDEX_EVERY + 2;
+    if (idx_open(s, (uint32_t)need) < 0) {
+        seg_destroy(s, 0);
+        return NULL;
+    }
+
+    uint64_t from = 0, expect = base;
+    if (rebuild || s->nidx == 0) {
+        memset(s->idx, 0, (size_t)s->idx_cap * sizeof(IdxEntry));
+        s->nidx = 0;
+    } else {
+        RecHdr h;
+        if (pread_full(s->fd, &h, sizeof(h), 0) == 0) s->first_ts = h.ts_ms;
+        s->nidx--;                              // 마지막 항목은 다시 확인하며 넣는다
+        from = s->idx[s->nidx].off;
+        expect = s->idx[s->nidx].seq;
+    }
+
+    uint64_t nidx_before = s->nidx;
+    s->size = seg_scan(s, from, expect, s->size);
+    memset(s->idx + s->nidx, 0, (size_t)(s->idx_cap - s->nidx) * sizeof(IdxEntry));
+    if (s->nidx != nidx_before || rebuild) msync(s->idx, (size_t)s->idx_cap * sizeof(IdxEntry), MS_SYNC);
+    return s;
+}
+
+static Segment *seg_create(uint64_t base) {
+    char path[256];
+    seg_path(path, sizeof(path), base, "log");
+
+    // 같은 이름의 빈 찌꺼기가 있을 수 있으므로 새로 만든다
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
+    close(fd);
+    seg_path(path, sizeof(path), base, "idx");
+    unlink(path);
+
+    Segment *s = seg_load(base, 1);
+    if (s) sync_dir();
+    return s;
+}
+
+static int seg_list_push(Segment *s) {
+    if (nsegs == segs_cap) {
+        int cap = segs_cap ? segs_cap * 2 : 16;
+        Segment **p = realloc(segs, cap * sizeof(*p));
+        if (!p) return -1;
+        segs = p;
+        segs_cap = cap;
+    }
+    segs[nsegs++] = s;
+    return 0;
+}
+
+static void seg_list_remove_first(void) {
+    memmove(segs, segs + 1, (nsegs - 1) * sizeof(*segs));
+    nsegs--;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * 디렉토리의 세그먼트를 모두 불러오고 정리 도중 죽어서 남은 중복/찌꺼기를 지운다.
+ */
+static int segs_recover(void) {
+    DIR *d = opendir(MSGLOG_DIR);
+    if (!d) return -1;
+
+    uint64_t *bases = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned long long base;
+        char ext[8];
+        if (sscanf(e->d_name, "%20llu.%7s", &base, ext) != 2 || base == 0) continue;
+
+        if (strcmp(ext, "tmp") == 0) {         // 다시 쓰다 만 세그먼트
+            char path[300];
+            snprintf(path, sizeof(path), MSGLOG_DIR "%s", e->d_name);
+            unlink(path);
+            continue;
+        }
+        if (strcmp(ext, "log") != 0) continue;
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            uint64_t *p = realloc(bases, cap * sizeof(*p));
+            if (!p) break;
+            bases = p;
+        }
+        bases[n++] = base;
+    }
+    closedir(d);
+    qsort(bases, n, sizeof(*bases), cmp_u64);
+
+    for (size_t i = 0; i < n; i++) {
+        Segment *s = seg_load(bases[i], 0);
+        if (!s) continue;
+
+        // 다시 쓴 세그먼트로 바꾸는 중이었다면 앞의 (오래된) 쪽이 뒤와 겹친다
+        while (nsegs > 0 && segs[nsegs - 1]->last >= s->base) {
+            seg_destroy(segs[--nsegs], 1);
+        }
+        // 빈 세그먼트는 마지막이 아니면 필요 없다
+        if (nsegs > 0 && segs[nsegs - 1]->last < segs[nsegs - 1]->base) {
+            seg_destroy(segs[--nsegs], 1);
+        }
+        seg_list_push(s);
+    }
+    free(bases);
+    return 0;
+}
+
+/* ----------------------- writer 스레드 ----------------------- */
+
+typedef struct {
+    char     buf[MSGLOG_BATCH_SIZE];
+    size_t   len;
+    uint64_t first_seq;         // 배치의 첫 레코드
+    uint64_t last_seq;
+    int64_t  last_ts;
+    IdxEntry idx[MSGLOG_BATCH_SIZE / MSGLOG_INDEX_EVERY + 2];   // 쓰고 나서 인덱스에 넣을 항목
+    int      nidx;
+    uint64_t idx_last_off;
+} MsgBatch;
+
+/**
+ * 배치를 활성 세그먼트 끝에 쓰고, 인덱스와 크기를 조회 쪽에 공개한다. (fdatasync 는 따로)
+ */
+static void batch_write(MsgBatch *b) {
+    if (b->len == 0) return;
+
+    if (pwrite_full(active->fd, b->buf, b->len, active->size) < 0) {
+        // 디스크 오류: 이번 배치는 버리고 같은 위치에 다음 배치를 쓴다
+        server_log("(msglog) write failed, %llu records lost: %s",
+                   (unsigned long long)(b->last_seq - b->first_seq + 1), strerror(errno));
+        b->len = 0;
+        b->nidx = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&seg_lock);
+    for (int i = 0; i < b->nidx; i++) idx_add(active, b->idx[i].seq, b->idx[i].off);
+    active->size += b->len;
+    active->last = b->last_seq;
+    active->last_ts = b->last_ts;
+    pthread_mutex_unlock(&seg_lock);
+
+    atomic_fetch_add_explicit(&st_bytes, b->len, memory_order_relaxed);
+    b->len = 0;
+    b->nidx = 0;
+}
+
+static void batch_sync(void) {
+    uint64_t t0 = metrics_now_ns();
+    fdatasync(active->fd);
+    atomic_fetch_add_explicit(&st_sync_ns, metrics_now_ns() - t0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st_syncs, 1, memory_order_relaxed);
+    atomic_store_explicit(&st_last, active->last, memory_order_release);
+}
+
+static void compact_wake(void) {
+    pthread_mutex_lock(&compact_lock);
+    pthread_cond_signal(&compact_cond);
+    pthread_mutex_unlock(&compact_lock);
+}
+
+/**
+ * 활성 세그먼트를 봉인하고 next_seq 부터 새 세그먼트로 넘어간다.
+ */
+static void segment_roll(uint64_t next_seq) {
+    msync(active->idx, (size_t)active->idx_cap * sizeof(IdxEntry), MS_SYNC);
+
+    Segment *s = seg_create(next_seq);
+    if (!s) {
+        server_log("(msglog) cannot create segment %020llu: %s",
+                   (unsigned long long)next_seq, strerror(errno));
+        return;                                 // 지금 세그먼트에 계속 쓴다
+    }
+
+    pthread_mutex_lock(&seg_lock);
+    int ok = seg_list_push(s) == 0;
+    pthread_mutex_unlock(&seg_lock);
+    if (!ok) {
+        seg_destroy(s, 1);
+        return;
+    }
+    active = s;
+    compact_wake();
+}
+
+static void batch_append(MsgBatch *b, const MsgSlot *slot, uint64_t seq) {
+    RecHdr h = {
+        .len = (uint32_t)slot->sender_len + slot->target_len + slot->len,
+        .seq = seq,
+        .ts_ms = slot->ts_ms,
+        .type = slot->type,
+        .sender_len = slot->sender_len,
+        .target_len = slot->target_len,
+    };
+    h.sum = rec_sum(&h, slot->data);
+    size_t rec = sizeof(h) + h.len;
+
+    // 세그먼트가 다 찼으면 지금까지를 확정하고 새 세그먼트로
+    if (active->size + b->len > 0 && active->size + b->len + rec > segment_bytes) {
+        batch_write(b);
+        batch_sync();
+        segment_roll(seq);
+    }
+    if (b->len + rec > sizeof(b->buf)) batch_write(b);
+
+    uint64_t off = active->size + b->len;
+    if ((active->nidx == 0 && b->nidx == 0) || off - b->idx_last_off >= MSGLOG_INDEX_EVERY) {
+        b->idx[b->nidx].seq = seq;
+        b->idx[b->nidx].off = off;
+        b->nidx++;
+        b->idx_last_off = off;
+    }
+    if (b->len == 0) b->first_seq = seq;
+    if (off == 0) active->first_ts = h.ts_ms;
+
+    memcpy(b->buf + b->len, &h, sizeof(h));
+    memcpy(b->buf + b->len + sizeof(h), slot->data, h.len);
+    b->len += rec;
+    b->last_seq = seq;
+    b->last_ts = h.ts_ms;
+}
+
+/**
+ * 링에 쌓인 레코드를 모두 배치로 옮긴다. 반환: 옮긴 개수
+ */
+static int ring_drain(MsgBatch *b) {
+    int count = 0;
+
+    for (;;) {
+        MsgSlot *slot = &ring[SLOT_INDEX(ring_head)];
+        if (slot_turn(ring_head) != ring_head + 1) break;
+
+        batch_append(b, slot, seq_base + ring_head);
+        slot_set_turn(ring_head, ring_head + MSGLOG_RING_SLOTS);
+        ring_head++;
+        count++;
+    }
+    return count;
+}
+
+static void *msglog_writer_main(void *arg) {
+    (void)arg;
+    static MsgBatch batch;
+    batch.idx_last_off = active->nidx ? active->idx[active->nidx - 1].off : 0;
+    int wait_ms = g_config.msglog_commit_ms > 0 ? g_config.msglog_commit_ms : 1;
+    struct timespec idle = { wait_ms / 1000, (long)(wait_ms % 1000) * 1000 * 1000 };
+
+    for (;;) {
+        int stopping = atomic_load(&msglog_stop);
+        int count = ring_drain(&batch);
+        if (count > 0) {
+            // 이번에 모인 레코드 전체를 fdatasync 한 번으로 확정 (group commit)
+            batch_write(&batch);
+            batch_sync();
+            atomic_fetch_add_explicit(&st_records, count, memory_order_relaxed);
+        }
+        if (stopping) break;
+
+        // 기다리는 동안 들어온 레코드가 다음 commit 에 함께 묶인다
+        if (count == 0 || g_config.msglog_commit_ms > 0) nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
+
+/* ----------------------- 정리 스레드 ----------------------- */
+
+/**
+ * 봉인된 세그먼트 s 에서 ts 가 cutoff 이상인 첫 레코드부터 새 세그먼트로 다시 쓴다.
+ * tmp 파일에 쓰고 rename → 목록 교체 → 옛 파일 삭제. 어디서 죽어도 다음 시작 때 정리된다.
+ */
+static Segment *seg_rewrite(Segment *s, int64_t cutoff) {
+    uint64_t off = 0, base = 0;
+    while (off < s->size) {
+        RecHdr h;
+        if (pread_full(s->fd, &h, sizeof(h), off) < 0) return NULL;
+        if (h.ts_ms >= cutoff) {
+            base = h.seq;
+            break;
+        }
+        off += sizeof(h) + h.len;
+    }
+    if (base == 0) return NULL;
+
+    char tmp[256], path[256];
+    seg_path(tmp, sizeof(tmp), base, "tmp");
+    seg_path(path, sizeof(path), base, "log");
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return NULL;
+
+    static char buf[MSGLOG_BATCH_SIZE];
+    uint64_t pos = off, out = 0;
+    int ok = 1;
+    while (ok && pos < s->size) {
+        size_t n = s->size - pos > sizeof(buf) ? sizeof(buf) : (size_t)(s->size - pos);
+        ok = pread_full(s->fd, buf, n, pos) == 0 && pwrite_full(fd, buf, n, out) == 0;
+        pos += n;
+        out += n;
+    }
+    if (ok) ok = fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return NULL;
+    }
+    sync_dir();
+    return seg_load(base, 1);
+}
+
+static void compact_once(void) {
+    int64_t cutoff = retain_ms > 0 ? now_ms() - retain_ms : INT64_MIN;
+
+    pthread_mutex_lock(&seg_lock);
+    for (;;) {
+        if (nsegs < 2) break;                  // 활성 세그먼트는 건드리지 않는다
+        Segment *old = segs[0];
+
+        uint64_t total = 0;
+        for (int i = 0; i < nsegs; i++) total += segs[i]->size;
+
+        Segment *repl = NULL;
+        if ((retain_bytes && total > retain_bytes) || old->last_ts < cutoff) {
+            // 통째로 삭제
+        } else if (old->first_ts < cutoff) {
+            // 일부만 지남: 봉인된 세그먼트는 바뀌지 않으므로 잠금을 풀고 다시 쓴다
+            pthread_mutex_unlock(&seg_lock);
+            repl = seg_rewrite(old, cutoff);
+            pthread_mutex_lock(&seg_lock);
+            if (!repl) break;
+        } else {
+            break;
+        }
+
+        if (repl) segs[0] = repl;
+        else seg_list_remove_first();
+        pthread_mutex_unlock(&seg_lock);
+
+        server_log("(msglog) segment %020llu %s (seq %llu..%llu)",
+                   (unsigned long long)old->base, repl ? "compacted" : "removed",
+                   (unsigned long long)old->base, (unsigned long long)old->last);
+        seg_destroy(old, 1);
+        atomic_fetch_add_explicit(&st_compactions, 1, memory_order_relaxed);
+
+        pthread_mutex_lock(&seg_lock);
+        if (repl) break;
+    }
+    pthread_mutex_unlock(&seg_lock);
+}
+
+static void *msglog_compact_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&compact_lock);
+    while (!atomic_load(&msglog_stop)) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += MSGLOG_COMPACT_SEC;
+        pthread_cond_timedwait(&compact_cond, &compact_lock, &until);
+        if (atomic_load(&msglog_stop)) break;
+
+        pthread_mutex_unlock(&compact_lock);
+        compact_once();
+        pthread_mutex_lock(&compact_lock);
+    }
+    pthread_mutex_unlock(&compact_lock);
+    return NULL;
+}
+
+/* ----------------------- 시작 / 종료 ----------------------- */
+
+/**
+ * 세그먼트 복구 후 writer/정리 스레드 시작. --msglog-segment-mb=0 이면 아무것도 안 한다.
+ */
+int msglog_start(void) {
+    if (running || g_config.msglog_segment_mb == 0) return 0;
+
+    segment_bytes = (uint64_t)g_config.msglog_segment_mb * 1024 * 1024;
+    retain_bytes = (uint64_t)g_config.msglog_retain_mb * 1024 * 1024;
+    retain_ms = (int64_t)g_config.msglog_retain_hours * 3600 * 1000;
+
+    mkdir("./server", 0755);
+    mkdir(MSGLOG_DIR, 0755);
+    if (segs_recover() < 0) {
+        perror("msglog " MSGLOG_DIR);
+        return -1;
+    }
+
+    uint64_t last = nsegs > 0 ? segs[nsegs - 1]->last : 0;
+    if (nsegs > 0 && segs[nsegs - 1]->size < segment_bytes) {
+        active = segs[nsegs - 1];
+    } else {
+        Segment *s = seg_create(last + 1);
+        if (!s || seg_list_push(s) < 0) {
+            perror("msglog segment");
+            return -1;
+        }
+        active = s;
+    }
+    seq_base = last + 1;
+    atomic_store(&st_last, last);
+
+    if (pthread_create(&writer_tid, NULL, msglog_writer_main, NULL) != 0) return -1;
+    if (pthread_create(&compact_tid, NULL, msglog_compact_main, NULL) != 0) {
+        atomic_store(&msglog_stop, 1);
+        pthread_join(writer_tid, NULL);
+        return -1;
+    }
+    running = 1;
+
+    server_log("(msglog) %d segments, last seq %llu", nsegs, (unsigned long long)last);
+    return 0;
+}
+
+/**
+ * 링에 남은 레코드를 모두 기록하고 종료 (cleanup() 에서 호출)
+ */
+void msglog_shutdown(void) {
+    if (!running) return;
+    running = 0;                                // 이후 append 는 버림
+
+    atomic_store(&msglog_stop, 1);
+    pthread_join(writer_tid, NULL);
+    compact_wake();
+    pthread_join(compact_tid, NULL);
+
+    pthread_mutex_lock(&seg_lock);
+    msync(active->idx, (size_t)active->idx_cap * sizeof(IdxEntry), MS_SYNC);
+    for (int i = 0; i < nsegs; i++) seg_destroy(segs[i], 0);
+    nsegs = 0;
+    active = NULL;
+    pthread_mutex_unlock(&seg_lock);
+}
+
+/* ----------------------- 조회 ----------------------- */
+
+uint64_t msglog_last_seq(void) {
+    return atomic_load_explicit(&st_last, memory_order_acquire);
+}
+
+/**
+ * seq 가 들어 있는 위치 근처 (그 이전 마지막 인덱스 항목)
+ */
+static uint64_t idx_lookup(const Segment *s, uint64_t seq) {
+    uint32_t lo = 0, hi = s->nidx;              // idx[lo..hi) 중 seq 이하인 마지막 항목
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->idx[mid].seq <= seq) lo = mid;
+        else hi = mid;
+    }
+    return s->nidx > 0 && s->idx[lo].seq <= seq ? s->idx[lo].off : 0;
+}
+
+int msglog_read_after(uint64_t after, int max, msglog_fn fn, void *arg) {
+    static char buf[MSGLOG_BATCH_SIZE];        // seg_lock 으로 보호
+    int count = 0;
+
+    pthread_mutex_lock(&seg_lock);
+
+    // base <= after + 1 인 마지막 세그먼트 (after 가 지워진 범위면 남은 것 중 처음부터)
+    int lo = 0, hi = nsegs;
+    while (hi - lo > 1) {
+        int mid = lo + (hi - lo) / 2;
+        if (segs[mid]->base <= after + 1) lo = mid;
+        else hi = mid;
+    }
+
+    for (int i = lo; i < nsegs && count < max; i++) {
+        Segment *s = segs[i];
+        uint64_t off = idx_lookup(s, after + 1);
+        uint64_t end = s->size;
+        size_t have = 0, at = 0;
+
+        while (count < max) {
+            // 버퍼에 레코드 하나가 통째로 없으면 남은 부분을 앞으로 당기고 더 읽는다
+            RecHdr h;
+            if (have - at < sizeof(h) ||
+                (memcpy(&h, buf + at, sizeof(h)), have - at < sizeof(h) + h.len)) {
+                if (off >= end) break;
+                memmove(buf, buf + at, have - at);
+                have -= at;
+                at = 0;
+                size_t n = end - off > sizeof(buf) - have ? sizeof(buf) - have : (size_t)(end - off);
+                if (pread_full(s->fd, buf + have, n, off) < 0) break;
+                have += n;
+                off += n;
+                continue;
+            }
+
+            const char *p = buf + at + sizeof(h);
+            at += sizeof(h) + h.len;
+            if (h.seq <= after) continue;
+
+            char sender[MAX_NAME], target[MAX_NAME];
+            memcpy(sender, p, h.sender_len);
+            sender[h.sender_len] = '\0';
+            memcpy(target, p + h.sender_len, h.target_len);
+            target[h.target_len] = '\0';
+
+            MsglogRecord r = {
+                .seq = h.seq,
+                .ts_ms = h.ts_ms,
+                .type = h.type,
+                .sender = sender,
+                .target = target,
+                .body = p + h.sender_len + h.target_len,
+                .len = h.len - h.sender_len - h.target_len,
+            };
+            fn(&r, arg);
+            count++;
+        }
+    }
+
+    pthread_mutex_unlock(&seg_lock);
+    return count;
+}
+
+void msglog_stats(MsglogStats *out) {
+    memset(out, 0, sizeof(*out));
+    out->last_seq = atomic_load(&st_last);
+    out->records = atomic_load(&st_records);
+    out->bytes = atomic_load(&st_bytes);
+    out->syncs = atomic_load(&st_syncs);
+    out->sync_ns = atomic_load(&st_sync_ns);
+    out->compactions = atomic_load(&st_compactions);
+
+    pthread_mutex_lock(&seg_lock);
+    out->segments = nsegs;
+    for (int i = 0; i < nsegs; i++) out->disk_bytes += segs[i]->size;
+    pthread_mutex_unlock(&seg_lock);
+}
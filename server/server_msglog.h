@@ -0,0 +1,54 @@
+#ifndef SERVER_MSGLOG_H
+#define SERVER_MSGLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "protocol.h"
+
+/*
+ * 영구 메시지 로그 (채팅 / DM)
+ *  - MSGLOG_DIR 의 세그먼트 파일에 레코드를 이어 쓰기만 한다. 레코드마다 1 부터 늘어나는 seq.
+ *  - msglog_append() 는 링 슬롯 하나에 복사하고 끝난다. (락/시스템 콜 없음)
+ *    writer 스레드가 모인 레코드를 write() 한 번, fdatasync() 한 번으로 확정한다. (group commit)
+ *  - 세그먼트마다 mmap 한 희소 인덱스(seq → 파일 위치, 몇 KB 마다 1개)가 있어서
+ *    "seq X 이후" 조회는 이진 탐색 + 짧은 순차 읽기로 끝난다.
+ *  - 세그먼트가 --msglog-segment-mb 를 넘으면 새 세그먼트로 넘어가고,
+ *    정리 스레드가 보존 크기/기간을 넘은 오래된 세그먼트를 지우거나 다시 써서 줄인다.
+ */
+
+#define MSGLOG_DIR "./server/server_msglog/"
+
+typedef struct {
+    uint64_t    seq;
+    int64_t     ts_ms;          // 기록 시각 (epoch ms)
+    int         type;
+    const char *sender;
+    const char *target;
+    const char *body;
+    size_t      len;
+} MsglogRecord;
+
+typedef void (*msglog_fn)(const MsglogRecord *r, void *arg);
+
+typedef struct {
+    uint64_t last_seq;          // 디스크에 확정된 마지막 seq
+    uint64_t records;           // 기록한 레코드 (이번 실행)
+    uint64_t bytes;
+    uint64_t syncs;             // fdatasync 횟수 (= commit 묶음 수)
+    uint64_t sync_ns;           // fdatasync 에 쓴 시간 합
+    uint64_t segments;
+    uint64_t disk_bytes;        // 모든 세그먼트 크기 합
+    uint64_t compactions;       // 정리로 지우거나 다시 쓴 세그먼트
+} MsglogStats;
+
+int      msglog_start(void);                // 복구 + writer/정리 스레드 시작 (reactor 시작 전)
+void     msglog_shutdown(void);             // 링에 남은 레코드까지 기록하고 종료
+uint64_t msglog_append(const Message *m);   // 붙인 seq (로그 끔 / 링 가득 참이면 0)
+uint64_t msglog_last_seq(void);
+
+// seq > after 인 레코드를 오래된 것부터 max 개까지. 반환: 읽은 개수
+int      msglog_read_after(uint64_t after, int max, msglog_fn fn, void *arg);
+
+void     msglog_stats(MsglogStats *out);
+
+#endif
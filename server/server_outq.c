@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "server_outq.h"
+#include "server_conn.h"
+#include "server_config.h"
+#include "server_event.h"
+#include "server_user_list.h"
+#include "server_metrics.h"
+#include "server_spool.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 연결별 출력 큐
+ *  - 소켓은 non-blocking. 보낼 데이터는 SharedFrame 참조로 큐에 넣고,
+ *    이벤트 루프 한 바퀴(tick)가 끝날 때 outq_flush_pending() 에서 연결마다
+ *    쌓인 프레임을 sendmsg(iovec) 한 번으로 보낸다.
+ *  - broadcast 는 프레임을 한 번만 만들고 모든 수신자 큐가 같은 버퍼를 참조
+ *    (refcount) → 수신자 수만큼 복사하지 않는다.
+ *  - short write 는 OutEntry.off 로 이어서 보내므로 스트림이 깨지지 않는다.
+ *    다 못 보냈으면 EV_WRITE 를 켜고 쓰기 가능 이벤트 때 이어서 보낸다.
+ *  - 큐가 high watermark 를 넘으면 g_config.slow_policy 적용
+ *    (채팅 broadcast 처럼 OUTQ_DROPPABLE 인 메시지만 버림)
+ *  - 버릴 수 없는 메시지만으로 high 의 OUTQ_HARD_FACTOR 배를 넘으면 정책과 관계없이 연결 종료
+ *  - 묶어 보내기는 tick 단위로 여기서 하므로 커널의 Nagle 지연은 필요 없다 → TCP_NODELAY.
+ *    한 번에 다 못 담는 큐는 MSG_MORE 로 이어 보내고, 파일 다운로드 동안은 TCP_CORK 로
+ *    MSS 보다 작은 조각이 따로 나가지 않게 한다.
+ */
+
+#define OUTQ_HARD_FACTOR 4
+#define OUTQ_MAX_IOV     64     // sendmsg 한 번에 묶는 프레임 수
+
+/* ----------------------- SharedFrame ----------------------- */
+
+SharedFrame *sframe_new(size_t len) {
+    SharedFrame *f = malloc(sizeof(SharedFrame) + len);
+    if (!f) return NULL;
+    f->refcnt = 1;
+    f->len = len;
+    return f;
+}
+
+SharedFrame *sframe_copy(const void *buf, size_t len) {
+    SharedFrame *f = sframe_new(len);
+    if (f) memcpy(f->data, buf, len);
+    return f;
+}
+
+void sframe_unref(SharedFrame *f) {
+    if (f && --f->refcnt == 0) free(f);
+}
+
+/* ----------------------- ring buffer ----------------------- */
+
+static OutEntry *entry_at(OutQueue *q, unsigned i) {
+    return &q->ents[(q->head + i) & (q->cap - 1)];
+}
+
+static int ring_grow(OutQueue *q) {
+    unsigned new_cap = q->cap ? q->cap * 2 : 16;
+    OutEntry *ne = malloc(sizeof(OutEntry) * new_cap);
+    if (!ne) return -1;
+
+    for (unsigned i = 0; i < q->count; i++)
+        ne[i] = *entry_at(q, i);
+
+    free(q->ents);
+    q->ents = ne;
+    q->cap = new_cap;
+    q->head = 0;
+    return 0;
+}
+
+void outq_clear(OutQueue *q) {
+    metric_gauge_add(G_OUTQ_BYTES, -(int64_t)q->bytes);
+    for (unsigned i = 0; i < q->count; i++)
+        sframe_unref(entry_at(q, i)->frame);
+    free(q->ents);
+    memset(q, 0, sizeof(*q));
+}
+
+/**
+ * accept 한 소켓의 TCP 옵션 (g_config.tcp_nodelay)
+ */
+void outq_sock_init(int fd) {
+    int one = 1;
+    if (g_config.tcp_nodelay &&
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+        server_log("TCP_NODELAY 설정 실패 (socket %d, errno=%d)", fd, errno);
+    }
+}
+
+/**
+ * 파일 다운로드 앞뒤로 TCP_CORK 켜고 끄기 (g_config.tcp_cork)
+ * 끌 때 커널에 남아 있던 마지막 조각이 바로 나간다.
+ */
+void conn_cork(Conn *c, int on) {
+    if (!g_config.tcp_cork || c->fd < 0 || c->outq.corked == on) return;
+    c->outq.corked = on;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+/* ----------------------- flush 대기 목록 ----------------------- */
+
+static __thread struct Conn **pending = NULL;
+static __thread int pending_count = 0;
+static __thread int pending_cap = 0;
+
+static void mark_pending(Conn *c) {
+    if (c->outq.pending) return;
+
+    if (pending_count == pending_cap) {
+        int new_cap = pending_cap ? pending_cap * 2 : 64;
+        Conn **p = realloc(pending, sizeof(Conn *) * new_cap);
+        if (!p) {
+            conn_flush(c);      // 목록을 못 늘리면 바로 보낸다
+            return;
+        }
+        pending = p;
+        pending_cap = new_cap;
+    }
+    c->outq.pending = 1;
+    pending[pending_count++] = c;
+}
+
+/**
+ * 이번 tick 에 데이터가 쌓인 연결들을 한 번씩 flush (이벤트 루프에서 호출)
+ */
+void outq_flush_pending(void) {
+    // flush 중 연결이 끊겨 다른 연결이 추가될 수도 있으므로 인덱스로 순회
+    for (int i = 0; i < pending_count; i++) {
+        Conn *c = pending[i];
+        if (!c->outq.pending) continue;     // 이미 종료/flush 된 연결
+        c->outq.pending = 0;
+        if (c->fd >= 0) conn_flush(c);
+    }
+    pending_count = 0;
+}
+
+/* ----------------------- 느린 클라이언트 정책 ----------------------- */
+
+void conn_want_write(Conn *c, int on) {
+    if (c->outq.write_armed == on) return;
+    c->outq.write_armed = on;
+    event_mod(c->fd, on ? (EV_READ | EV_WRITE) : EV_READ);
+}
+
+/**
+ * 아직 한 바이트도 안 보낸 DROPPABLE 메시지를 오래된 것부터 버려서 target 이하로 줄임
+ */
+static void coalesce(OutQueue *q, size_t target) {
+    unsigned kept = 0;
+    unsigned n = q->count;
+
+    for (unsigned i = 0; i < n; i++) {
+        OutEntry e = *entry_at(q, i);
+        if (q->bytes > target && (e.flags & OUTQ_DROPPABLE) && e.off == 0) {
+            q->bytes -= e.frame->len;
+            q->dropped++;
+            metric_gauge_add(G_OUTQ_BYTES, -(int64_t)e.frame->len);
+            metric_add(M_OUTQ_DROPPED, 1);
+            sframe_unref(e.frame);
+            continue;
+        }
+        *entry_at(q, kept++) = e;
+    }
+    q->count = kept;
+}
+
+/**
+ * 큐에 넣기 전에 느린 클라이언트 정책 적용
+ * 반환: 1 = 큐에 넣음, 0 = 버림, -1 = 연결 종료됨
+ */
+static int apply_slow_policy(Conn *c, size_t len, int flags) {
+    OutQueue *q = &c->outq;
+
+    if (q->bytes + len > g_config.outq_high_wm) {
+        if (!q->slow) {
+            q->slow = 1;
+            server_log("느린 클라이언트 감지 (socket %d, queued %zu bytes, policy %s)",
+                       c->fd, q->bytes, slow_policy_name(g_config.slow_policy));
+        }
+
+        switch (g_config.slow_policy) {
+            case SLOW_POLICY_DISCONNECT:
+                server_log("느린 클라이언트 연결 종료 (socket %d)", c->fd);
+                disconnect_client(c);
+                return -1;
+            case SLOW_POLICY_COALESCE:
+                coalesce(q, g_config.outq_low_wm);
+                break;
+            case SLOW_POLICY_DROP:
+                break;
+        }
+    }
+
+    if (q->slow && (flags & OUTQ_DROPPABLE) &&
+        (g_config.slow_policy == SLOW_POLICY_DROP ||
+         q->bytes + len > g_config.outq_high_wm)) {
+        q->dropped++;
+        metric_add(M_OUTQ_DROPPED, 1);
+        return 0;
+    }
+
+    if (q->bytes + len > g_config.outq_high_wm * OUTQ_HARD_FACTOR) {
+        server_log("출력 큐 한도 초과로 연결 종료 (socket %d, %zu bytes)", c->fd, q->bytes);
+        disconnect_client(c);
+        return -1;
+    }
+    return 1;
+}
+
+/* ----------------------- 전송 ----------------------- */
+
+/**
+ * 메모리가 없어 프레임을 큐에 넣지 못했을 때.
+ * 버려도 되는 메시지면 정책으로 버린 것처럼 세고, 아니면 메시지가 빠진 채로 계속 보내지 않도록 연결을 끊는다.
+ * 반환: 0 = 버림, -1 = 연결 종료됨 (보내지 않았음을 호출한 쪽이 알 수 있다)
+ */
+int conn_send_nomem(Conn *c, int flags) {
+    c->outq.dropped++;
+    metric_add(M_OUTQ_DROPPED, 1);
+
+    if (flags & OUTQ_DROPPABLE) {
+        server_log("출력 큐 할당 실패로 메시지 버림 (socket %d)", c->fd);
+        return 0;
+    }
+    server_log("출력 큐 할당 실패로 연결 종료 (socket %d)", c->fd);
+    disconnect_client(c);
+    return -1;
+}
+
+/**
+ * 공유 프레임을 연결의 출력 큐에 넣는다 (참조만 추가, 복사 없음)
+ * 실제 전송은 이번 tick 의 flush 단계에서 한다.
+ * 반환: 0 = 성공 또는 정책/메모리 부족으로 버려짐, -1 = 연결 종료됨 (큐에 넣지 못함)
+ */
+int conn_send_frame(Conn *c, SharedFrame *f, int flags) {
+    if (!c || c->fd < 0 || !f) return -1;
+
+    int r = apply_slow_policy(c, f->len, flags);
+    if (r <= 0) return r;
+
+    OutQueue *q = &c->outq;
+    if (q->count == q->cap && ring_grow(q) < 0) return conn_send_nomem(c, flags);
+
+    f->refcnt++;
+    OutEntry *e = entry_at(q, q->count++);
+    e->frame = f;
+    e->off = 0;
+    e->flags = flags;
+    q->bytes += f->len;
+    metric_gauge_add(G_OUTQ_BYTES, (int64_t)f->len);
+
+    mark_pending(c);
+    return 0;
+}
+
+/**
+ * 버퍼를 복사해서 큐에 넣는다 (한 연결에만 보내는 메시지)
+ */
+int conn_send(Conn *c, const void *buf, size_t len, int flags) {
+    if (!c || c->fd < 0) return -1;
+
+    SharedFrame *f = sframe_copy(buf, len);
+    if (!f) return conn_send_nomem(c, flags);
+    int r = conn_send_frame(c, f, flags);
+    sframe_unref(f);
+    return r;
+}
+
+/**
+ * 큐 앞쪽 프레임들을 iovec 으로 묶어 sendmsg 한 번 호출
+ * 반환: 보낸 바이트 수 (send 결과 그대로)
+ */
+static ssize_t send_batch(Conn *c) {
+    OutQueue *q = &c->outq;
+    struct iovec iov[OUTQ_MAX_IOV];
+    int n = 0;
+
+    for (unsigned i = 0; i < q->count && n < OUTQ_MAX_IOV; i++, n++) {
+        OutEntry *e = entry_at(q, i);
+        iov[n].iov_base = e->frame->data + e->off;
+        iov[n].iov_len = e->frame->len - e->off;
+    }
+
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = n;
+
+    // 바로 다음 호출로 이어 보낼 것이 남아 있으면 끝 조각을 붙잡아 둔다
+    int more = (unsigned)n < q->count ? MSG_MORE : 0;
+    metric_add(M_SEND_CALLS, 1);
+    return sendmsg(c->fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL | more);
+}
+
+/**
+ * 보낸 바이트 만큼 큐 앞에서 제거
+ */
+static void consume(OutQueue *q, size_t sent) {
+    q->bytes -= sent;
+    metric_gauge_add(G_OUTQ_BYTES, -(int64_t)sent);
+    metric_add(M_BYTES_OUT, sent);
+    while (sent > 0) {
+        OutEntry *e = entry_at(q, 0);
+        size_t remain = e->frame->len - e->off;
+        if (sent < remain) {
+            e->off += sent;
+            return;
+        }
+        sent -= remain;
+        metric_add(M_FRAMES_OUT, 1);
+        sframe_unref(e->frame);
+        q->head = (q->head + 1) & (q->cap - 1);
+        q->count--;
+    }
+}
+
+/**
+ * 큐에 쌓인 데이터를 블로킹 없이 가능한 만큼 전송
+ * 반환: 0 = 정상 (다 못 보냈으면 EV_WRITE 대기), -1 = 연결 종료됨
+ */
+int conn_flush(Conn *c) {
+    OutQueue *q = &c->outq;
+
+    // 파일 본문이 소켓으로 직접 나가는 중에는 프레임을 끼워 넣지 않는다
+    if (q->hold) return 0;
+
+    while (q->count > 0) {
+        ssize_t n = send_batch(c);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_want_write(c, 1);
+                return 0;
+            }
+            server_log("Fail Send: socket %d (errno=%d)", c->fd, errno);
+            disconnect_client(c);
+            return -1;
+        }
+        consume(q, (size_t)n);
+    }
+
+    // 로그인 때 넣은 보관 귓속말까지 다 나갔으면 보관함에서 지운다
+    if (c->spool_unacked) spool_ack(c);
+
+    if (q->slow && q->bytes <= g_config.outq_low_wm) {
+        q->slow = 0;
+        if (q->dropped)
+            server_log("클라이언트 복구 (socket %d, dropped %lu)", c->fd, q->dropped);
+    }
+    conn_want_write(c, 0);
+    return 0;
+}
+
+/**
+ * 연결을 닫기 직전 남은 데이터를 한 번만 보내 본다 (kick 공지 등). 실패는 무시.
+ */
+void conn_flush_final(Conn *c) {
+    if (c->outq.count > 0 && !c->outq.hold) {
+        ssize_t n = send_batch(c);
+        (void)n;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SERVER_OUTQ_H
+#define SERVER_OUTQ_H
+
+#include <stddef.h>
+
+// conn_send() flags
+#define OUTQ_DROPPABLE  0x01   // 느린 클라이언트 정책으로 버려도 되는 메시지 (채팅 broadcast)
+
+// 한 번 인코딩해서 여러 연결의 출력 큐가 같이 참조하는 불변 버퍼
+typedef struct SharedFrame {
+    int    refcnt;
+    size_t len;
+    unsigned char data[];
+} SharedFrame;
+
+// 출력 큐 원소: 프레임 참조 + 이 연결에서 이미 보낸 위치
+typedef struct {
+    SharedFrame *frame;
+    size_t off;
+    int    flags;
+} OutEntry;
+
+typedef struct {
+    OutEntry *ents;           // ring buffer
+    unsigned  head;
+    unsigned  count;
+    unsigned  cap;            // 2의 거듭제곱
+    size_t    bytes;          // 아직 안 보낸 바이트 합
+    int       slow;           // high watermark 를 넘어 low 까지 내려오기 전
+    int       write_armed;    // EV_WRITE 감시 중
+    int       pending;        // 이번 tick 에 flush 대기 목록에 들어있음
+    int       hold;           // bulk 파일 본문 전송 중: 큐에 쌓아두기만 함
+    int       corked;         // TCP_CORK 켜 둠 (파일 다운로드 중)
+    unsigned long dropped;    // 정책으로 버린 메시지 수
+} OutQueue;
+
+struct Conn;
+
+SharedFrame *sframe_new(size_t len);
+SharedFrame *sframe_copy(const void *buf, size_t len);
+void sframe_unref(SharedFrame *f);
+
+void outq_clear(OutQueue *q);
+void outq_sock_init(int fd);
+
+int  conn_send(struct Conn *c, const void *buf, size_t len, int flags);
+int  conn_send_frame(struct Conn *c, SharedFrame *f, int flags);
+int  conn_send_nomem(struct Conn *c, int flags);
+int  conn_flush(struct Conn *c);
+void conn_want_write(struct Conn *c, int on);
+void conn_cork(struct Conn *c, int on);
+void conn_flush_final(struct Conn *c);
+void outq_flush_pending(void);
+
+#endif
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "server_proto.h"
+#include "server_outq.h"
+#include "server_metrics.h"
+
+extern void server_log(const char *fmt, ...);
+
+/*
+ * 메시지 송수신 (v1 / v2 프레임 공통 처리)
+ *  - 새 클라이언트는 v2 프레임을 쓰고, 예전 클라이언트(v1)는 Message 구조체를
+ *    그대로 보낸다. 연결의 첫 바이트가 FRAME_MAGIC 이면 v2.
+ *  - 받을 때는 소켓에서 읽을 수 있는 만큼 연결의 입력 버퍼(rxbuf)로 읽고,
+ *    그 안에서 완성된 프레임만 하나씩 꺼낸다. 덜 온 프레임은 버퍼에 남겨 두고
+ *    다음 읽기 이벤트를 기다리므로 한 클라이언트가 반쪽 프레임을 보내도 루프가 멈추지 않는다.
+ *  - 보낼 때는 받는 쪽 버전에 맞춰 인코딩한다.
+ */
+
+/**
+ * 소켓에서 읽을 수 있는 만큼 입력 버퍼 빈자리로 한 번 읽는다 (블로킹 없음)
+ * 앞쪽에 이미 꺼낸 자리가 있으면 남은 조각을 버퍼 앞으로 당긴 뒤 읽는다.
+ * 반환: 1 = 읽음, 0 = 지금은 읽을 데이터 없음, -1 = 연결 종료/오류
+ */
+int conn_rx_fill(Conn *c) {
+    if (c->rx_head > 0) {
+        unsigned left = c->rx_tail - c->rx_head;
+        memmove(c->rxbuf, c->rxbuf + c->rx_head, left);
+        c->rx_head = 0;
+        c->rx_tail = left;
+    }
+
+    // 덜 받은 프레임은 항상 FRAME_MAX_LEN 보다 짧으므로 빈자리가 남아 있다
+    for (;;) {
+        ssize_t n = recv(c->fd, c->rxbuf + c->rx_tail, CONN_RX_BUF - c->rx_tail, 0);
+        if (n > 0) {
+            c->rx_tail += (unsigned)n;
+            metric_add(M_BYTES_IN, (uint64_t)n);
+            rate_charge_bytes(c, (size_t)n);
+            return 1;
+        }
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+/**
+ * 입력 버퍼에 남은 바이트를 프레임이 아닌 본문으로 가져간다 (병렬 업로드 구간 본문)
+ * 반환: 복사한 바이트 수
+ */
+size_t conn_rx_take(Conn *c, void *dst, size_t max) {
+    size_t n = conn_rx_buffered(c);
+    if (n > max) n = max;
+    memcpy(dst, c->rxbuf + c->rx_head, n);
+    c->rx_head += (unsigned)n;
+    if (c->rx_head == c->rx_tail) c->rx_head = c->rx_tail = 0;
+    return n;
+}
+
+/**
+ * 입력 버퍼에서 완성된 메시지 하나를 꺼낸다 (소켓은 건드리지 않음)
+ * 연결의 첫 바이트가 들어오면 그것으로 프로토콜 버전을 정한다.
+ * 반환: 1 = 꺼냄, 0 = 바이트가 더 필요함, -1 = 잘못된 프레임
+ */
+int conn_next_message(Conn *c, Message *m) {
+    const unsigned char *p = c->rxbuf + c->rx_head;
+    size_t avail = conn_rx_buffered(c);
+    size_t used;
+
+    if (avail == 0) return 0;
+
+    if (c->proto == PROTO_UNKNOWN) {
+        c->proto = (p[0] == FRAME_MAGIC) ? PROTO_V2 : PROTO_V1;
+        server_log("프로토콜 판별: socket %d → v%d", c->fd, c->proto);
+    }
+
+    if (c->proto == PROTO_V1) {
+        if (avail < sizeof(Message)) return 0;
+        memcpy(m, p, sizeof(Message));
+        // 문자열 필드가 NUL 로 끝나도록 보정
+        m->sender[MAX_NAME - 1] = '\0';
+        m->target[MAX_NAME - 1] = '\0';
+        used = sizeof(Message);
+    } else {
+        FrameHeader h;
+        if (avail < FRAME_HDR_LEN) return 0;
+        if (frame_parse_header(p, &h) < 0) {
+            server_log("잘못된 프레임 헤더 (socket %d)", c->fd);
+            return -1;
+        }
+        if (avail < FRAME_HDR_LEN + h.len) return 0;
+
+        if (frame_decode(&h, p + FRAME_HDR_LEN, m) < 0) {
+            server_log("잘못된 프레임 payload (socket %d, type %d)", c->fd, h.type);
+            return -1;
+        }
+        used = FRAME_HDR_LEN + h.len;
+    }
+
+    c->rx_head += (unsigned)used;
+    if (c->rx_head == c->rx_tail) c->rx_head = c->rx_tail = 0;
+    return 1;
+}
+
+/**
+ * 프레임에 싣는 세션 id: 상위 8bit 는 shard, 하위 24bit 는 shard 안의 슬롯 id
+ */
+uint32_t conn_wire_id(const Conn *c) {
+    return c ? ((uint32_t)c->shard << 24) | (uint32_t)c->id : FRAME_ID_NONE;
+}
+
+uint32_t conn_ref_wire_id(const ConnRef *r) {
+    // 슬롯 id 는 슬랩을 만들 때 정해지고 바뀌지 않으므로 다른 shard 에서 읽어도 된다
+    return r && r->conn ? ((uint32_t)r->shard << 24) | (uint32_t)r->conn->id : FRAME_ID_NONE;
+}
+
+void outmsg_init(OutMessage *om, const Message *m, uint32_t sender_id, uint32_t target_id) {
+    om->msg = m;
+    om->sender_id = sender_id;
+    om->target_id = target_id;
+    om->v2 = NULL;
+    om->v1 = NULL;
+}
+
+/**
+ * 받는 쪽 버전에 맞는 프레임을 (없으면 인코딩해서) 큐에 넣는다
+ */
+int conn_send_outmsg(Conn *c, OutMessage *om, int flags) {
+    if (!c) return -1;
+
+    metric_msg_out(om->msg->type);
+
+    if (c->proto == PROTO_V1) {
+        if (!om->v1) {
+            om->v1 = sframe_new(sizeof(Message));
+            if (!om->v1) return conn_send_nomem(c, flags);
+            message_to_v1(om->msg, (Message *)om->v1->data);
+        }
+        return conn_send_frame(c, om->v1, flags);
+    }
+
+    if (!om->v2) {
+        om->v2 = sframe_new(frame_encoded_len(om->msg));
+        if (!om->v2) return conn_send_nomem(c, flags);
+        frame_encode(om->msg, om->sender_id, om->target_id, om->v2->data);
+    }
+    return conn_send_frame(c, om->v2, flags);
+}
+
+void outmsg_release(OutMessage *om) {
+    sframe_unref(om->v2);
+    sframe_unref(om->v1);
+    om->v2 = om->v1 = NULL;
+}
+
+/**
+ * 서버가 만든 메시지를 한 연결에 전송 (받는 쪽 버전에 맞춰 인코딩)
+ */
+int conn_send_msg(Conn *c, const Message *m, int flags) {
+    OutMessage om;
+    outmsg_init(&om, m, FRAME_ID_NONE, FRAME_ID_NONE);
+    int r = conn_send_outmsg(c, &om, flags);
+    outmsg_release(&om);
+    return r;
+}
+
+int conn_send_msg_fd(int fd, const Message *m, int flags) {
+    return conn_send_msg(conn_by_fd(fd), m, flags);
+}
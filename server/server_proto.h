@@ -0,0 +1,45 @@
+#ifndef SERVER_PROTO_H
+#define SERVER_PROTO_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "protocol.h"
+#include "frame.h"
+#include "server_conn.h"
+
+// 연결별 프로토콜 버전 (첫 바이트로 자동 판별)
+#define PROTO_UNKNOWN 0
+#define PROTO_V1      1   // Message 구조체 그대로 (1072 bytes 고정)
+#define PROTO_V2      2   // 가변 길이 프레임 (frame.h)
+
+// 연결별 입력 버퍼 (non-blocking, 프레임 단위로 꺼냄)
+int    conn_rx_fill(Conn *c);
+int    conn_next_message(Conn *c, Message *m);
+size_t conn_rx_take(Conn *c, void *dst, size_t max);
+
+static inline size_t conn_rx_buffered(const Conn *c) {
+    return c->rx_tail - c->rx_head;
+}
+
+/*
+ * 여러 연결에 보낼 메시지: 버전별 프레임을 처음 필요할 때 한 번만 인코딩하고
+ * 모든 수신자 큐가 같은 SharedFrame 을 참조한다.
+ */
+typedef struct {
+    const Message *msg;
+    uint32_t sender_id;
+    uint32_t target_id;
+    SharedFrame *v2;
+    SharedFrame *v1;
+} OutMessage;
+
+void outmsg_init(OutMessage *om, const Message *m, uint32_t sender_id, uint32_t target_id);
+int  conn_send_outmsg(Conn *c, OutMessage *om, int flags);
+void outmsg_release(OutMessage *om);
+
+int conn_send_msg(Conn *c, const Message *m, int flags);
+int conn_send_msg_fd(int fd, const Message *m, int flags);
+uint32_t conn_wire_id(const Conn *c);
+uint32_t conn_ref_wire_id(const ConnRef *r);
+
+#endif
@@ -0,0 +1,127 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include "server_ratelimit.h"
+#include "server_config.h"
+#include "server_conn.h"
+#include "server_metrics.h"
+
+static pthread_mutex_t accept_lock = PTHREAD_MUTEX_INITIALIZER;
+static TokenBucket accept_bucket;
+static int accept_bucket_ready = 0;
+static atomic_int handshakes = 0;
+
+/**
+ * 지난번 이후 흐른 시간만큼 채운 잔고 (burst 까지)
+ */
+static double bucket_level(TokenBucket *b, double rate, double burst, uint64_t now) {
+    if (now > b->stamp_ns) {
+        b->tokens += (double)(now - b->stamp_ns) * rate / 1e9;
+        if (b->tokens > burst) b->tokens = burst;
+        b->stamp_ns = now;
+    }
+    return b->tokens;
+}
+
+/**
+ * 토큰 1개가 생길 때까지 걸리는 시간 (ms, 이미 있으면 0). rate 가 0 이면 제한 없음.
+ */
+static int bucket_wait_ms(TokenBucket *b, double rate, double burst, uint64_t now) {
+    if (rate <= 0) return 0;
+    double t = bucket_level(b, rate, burst, now);
+    if (t >= 1.0) return 0;
+    return (int)((1.0 - t) * 1000.0 / rate) + 1;
+}
+
+/* ----------------------- 연결별 ----------------------- */
+
+void rate_init(Conn *c) {
+    uint64_t now = metrics_now_ns();
+    c->rate.msgs.tokens = g_config.rate_msg_burst;
+    c->rate.msgs.stamp_ns = now;
+    c->rate.bytes.tokens = (double)g_config.rate_byte_burst;
+    c->rate.bytes.stamp_ns = now;
+}
+
+void rate_charge_msg(Conn *c) {
+    if (g_config.rate_msgs > 0) c->rate.msgs.tokens -= 1.0;
+}
+
+void rate_charge_bytes(Conn *c, size_t n) {
+    if (g_config.rate_bytes > 0) c->rate.bytes.tokens -= (double)n;
+}
+
+int rate_throttle(Conn *c, int recv) {
+    if (g_config.rate_msgs <= 0 && g_config.rate_bytes <= 0) return 0;
+
+    uint64_t now = metrics_now_ns();
+    int wait_msgs = recv ? bucket_wait_ms(&c->rate.msgs, g_config.rate_msgs,
+                                          g_config.rate_msg_burst, now) : 0;
+    int wait_bytes = bucket_wait_ms(&c->rate.bytes, (double)g_config.rate_bytes,
+                                    (double)g_config.rate_byte_burst, now);
+    int wait = wait_msgs > wait_bytes ? wait_msgs : wait_bytes;
+    if (wait == 0) return 0;
+
+    // 다운로드는 매 tick 확인하므로 이미 걸려 있으면 그대로 둔다
+    if (!timer_pending(&c->rate_timer)) {
+        timer_add_ms(&c->rate_timer, (uint64_t)wait);
+        metric_add(wait_msgs >= wait_bytes ? M_RATE_LIMITED_MSGS : M_RATE_LIMITED_BYTES, 1);
+    }
+    return 1;
+}
+
+/**
+ * 파일 본문을 한 번에 보내거나 받을 최대 바이트: 바이트 버킷 잔고까지만 (rate_throttle 다음에 호출)
+ */
+size_t rate_budget(Conn *c, size_t max) {
+    double t = c->rate.bytes.tokens;
+    if (g_config.rate_bytes <= 0 || t >= (double)max) return max;
+    return t < 1.0 ? 1 : (size_t)t;
+}
+
+/* ----------------------- accept ----------------------- */
+
+int admit_accept(void) {
+    if (g_config.accept_rate <= 0) return 0;
+
+    double rate = g_config.accept_rate;
+    int wait;
+
+    pthread_mutex_lock(&accept_lock);
+    uint64_t now = metrics_now_ns();
+    if (!accept_bucket_ready) {
+        accept_bucket.tokens = rate;
+        accept_bucket.stamp_ns = now;
+        accept_bucket_ready = 1;
+    }
+    wait = bucket_wait_ms(&accept_bucket, rate, rate, now);
+    if (wait == 0) accept_bucket.tokens -= 1.0;
+    pthread_mutex_unlock(&accept_lock);
+    return wait;
+}
+
+void admit_accept_refund(void) {
+    if (g_config.accept_rate <= 0) return;
+    pthread_mutex_lock(&accept_lock);
+    accept_bucket.tokens += 1.0;
+    pthread_mutex_unlock(&accept_lock);
+}
+
+int admit_handshake_begin(Conn *c) {
+    int n = atomic_fetch_add(&handshakes, 1);
+    if (g_config.max_handshakes > 0 && n >= g_config.max_handshakes) {
+        atomic_fetch_sub(&handshakes, 1);
+        return 0;
+    }
+    c->handshake = 1;
+    return 1;
+}
+
+void admit_handshake_end(Conn *c) {
+    if (!c->handshake) return;
+    c->handshake = 0;
+    atomic_fetch_sub(&handshakes, 1);
+}
+
+int admit_handshakes(void) {
+    return atomic_load(&handshakes);
+}
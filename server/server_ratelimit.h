@@ -0,0 +1,42 @@
+#ifndef SERVER_RATELIMIT_H
+#define SERVER_RATELIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 속도 제한 / 접속 허용 제어 (token bucket)
+ *  - 연결마다 메시지 버킷(초당 메시지 수)과 바이트 버킷(초당 바이트, 업로드/다운로드 포함).
+ *    쓴 만큼 나중에 빼는 방식이라 잔고가 음수가 될 수 있고, 잔고가 모자라면 그 연결은
+ *    다시 찰 때까지 읽기(와 다운로드)를 멈춘다. 안 읽은 데이터는 소켓에 남아 TCP 가 보내는 쪽을 늦춘다.
+ *  - accept 는 모든 shard 가 같이 쓰는 버킷 하나. 비면 accept 를 멈추고 커널 backlog 에 둔다.
+ *  - 로그인 전 연결(handshake)이 --max-handshakes 개면 새 연결은 받자마자 닫는다.
+ */
+
+typedef struct {
+    double   tokens;
+    uint64_t stamp_ns;          // 마지막으로 채운 시각
+} TokenBucket;
+
+typedef struct {
+    TokenBucket msgs;
+    TokenBucket bytes;
+} RateLimit;
+
+struct Conn;
+
+void rate_init(struct Conn *c);                     // accept 직후: 버킷을 가득 채움
+void rate_charge_msg(struct Conn *c);
+void rate_charge_bytes(struct Conn *c, size_t n);
+
+// 버킷이 비었으면 찰 때까지 c->rate_timer 를 걸고 1 (recv: 메시지 버킷도 확인)
+int  rate_throttle(struct Conn *c, int recv);
+size_t rate_budget(struct Conn *c, size_t max);     // 파일 전송 한 번에 쓸 바이트 (버킷 잔고까지)
+
+int  admit_accept(void);                            // accept 버킷: 0 = 하나 씀, 양수 = 기다릴 ms
+void admit_accept_refund(void);                     // 쓴 토큰으로 accept 하지 못했을 때
+int  admit_handshake_begin(struct Conn *c);         // 0 = 자리 없음
+void admit_handshake_end(struct Conn *c);           // 로그인 성공 또는 연결 종료
+int  admit_handshakes(void);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "server_config.h"
+#include "server_conn.h"
+#include "server_log.h"
+#include "server_room.h"
+
+/*
+ * 잠금
+ *  - room_lock: 이름 ↔ 슬롯 배정과 members 합계. 빈 방은 members == 0 을 잠금 안에서 보고만 정리한다.
+ *  - shards[i] 멤버 배열: shard i 의 reactor 스레드만 읽고 쓴다.
+ * 들어갈 때는 합계를 먼저 올리고 배열에 넣고, 나갈 때는 배열에서 빼고 합계를 내린다.
+ * 그래서 합계가 0 인 방의 배열은 모든 shard 에서 비어 있다.
+ */
+
+Room rooms[MAX_ROOMS];
+static pthread_mutex_t room_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int room_init(void) {
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        pthread_mutex_init(&rooms[i].own_hist.lock, NULL);
+        rooms[i].hist = &rooms[i].own_hist;
+    }
+    strcpy(rooms[ROOM_LOBBY].name, "lobby");
+    rooms[ROOM_LOBBY].hist = &history_lobby;
+    return 0;
+}
+
+static int valid_name(const char *s) {
+    size_t n = strlen(s);
+    if (n == 0 || n >= MAX_NAME) return 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_' && s[i] != '-') return 0;
+    }
+    return 1;
+}
+
+static int room_find(const char *name) {
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (rooms[i].name[0] && strcmp(rooms[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * 새 방 슬롯 (room_lock 을 잡은 채로). 빈 슬롯이 없으면 아무도 없는 방을 정리해서 쓴다.
+ */
+static int room_alloc(const char *name) {
+    int slot = -1;
+    for (int i = ROOM_LOBBY + 1; i < MAX_ROOMS && slot < 0; i++) {
+        if (!rooms[i].name[0]) slot = i;
+    }
+    for (int i = ROOM_LOBBY + 1; i < MAX_ROOMS && slot < 0; i++) {
+        if (atomic_load(&rooms[i].members) == 0) slot = i;
+    }
+    if (slot < 0) return -1;
+
+    Room *r = &rooms[slot];
+    if (r->name[0]) {
+        server_log("빈 채팅방 정리: %s", r->name);
+        history_ring_free(r->hist);
+    }
+
+    r->gen++;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    atomic_store(&r->msgs, 0);
+    atomic_store(&r->recipients, 0);
+
+    // 기록 링을 못 잡으면 기록 없는 방으로 쓴다
+    if (history_ring_init(r->hist, (size_t)g_config.room_history_kb * 1024,
+                          (uint32_t)g_config.history_msgs) < 0) {
+        server_log("채팅방 기록 할당 실패: %s", name);
+    }
+    return slot;
+}
+
+static int local_reserve(RoomMembers *m) {
+    if (m->count < m->cap) return 0;
+
+    int cap = m->cap ? m->cap * 2 : 16;
+    struct Conn **p = realloc(m->conns, sizeof(*p) * cap);
+    if (!p) return -1;
+    m->conns = p;
+    m->cap = cap;
+    return 0;
+}
+
+/**
+ * 이 shard 멤버 배열에 넣는다 (자리는 local_reserve 로 미리 확보)
+ * 기록 seq 는 shard 비트를 켠 뒤에 읽어야, 그 뒤 다른 shard 채팅이 이 shard 로 온다.
+ */
+static void local_add(Conn *c, int room) {
+    RoomMembers *m = room_local(room);
+
+    c->room = room;
+    c->room_idx = m->count;
+    m->conns[m->count++] = c;
+    if (m->count == 1) atomic_fetch_or(&rooms[room].shard_mask, 1ull << shard_id);
+
+    c->hist_seq = history_next_seq(rooms[room].hist);
+}
+
+static void local_remove(Conn *c) {
+    RoomMembers *m = room_local(c->room);
+
+    // 마지막 원소와 자리를 바꿔 제거
+    Conn *last = m->conns[--m->count];
+    m->conns[c->room_idx] = last;
+    last->room_idx = c->room_idx;
+    if (m->count == 0) atomic_fetch_and(&rooms[c->room].shard_mask, ~(1ull << shard_id));
+}
+
+int room_enter(Conn *c, int room) {
+    if (c->room == room) return room;
+    if (local_reserve(room_local(room)) < 0) return -2;
+
+    pthread_mutex_lock(&room_lock);
+    atomic_fetch_add(&rooms[room].members, 1);
+    pthread_mutex_unlock(&room_lock);
+
+    room_leave(c);
+    local_add(c, room);
+    return room;
+}
+
+int room_join(Conn *c, const char *name) {
+    if (!valid_name(name)) return -1;
+    if (c->room >= 0 && strcmp(rooms[c->room].name, name) == 0) return c->room;
+
+    pthread_mutex_lock(&room_lock);
+    int room = room_find(name);
+    if (room < 0) room = room_alloc(name);
+    if (room >= 0 && local_reserve(room_local(room)) < 0) room = -1;
+    if (room >= 0) atomic_fetch_add(&rooms[room].members, 1);
+    pthread_mutex_unlock(&room_lock);
+
+    if (room < 0) return -2;
+
+    room_leave(c);
+    local_add(c, room);
+    return room;
+}
+
+void room_leave(Conn *c) {
+    if (c->room < 0) return;
+
+    local_remove(c);
+
+    pthread_mutex_lock(&room_lock);
+    atomic_fetch_sub(&rooms[c->room].members, 1);
+    pthread_mutex_unlock(&room_lock);
+
+    c->room = -1;
+}
+
+int room_list(RoomStat *out, int max) {
+    int n = 0;
+
+    pthread_mutex_lock(&room_lock);
+    for (int i = 0; i < MAX_ROOMS && n < max; i++) {
+        Room *r = &rooms[i];
+        if (!r->name[0]) continue;
+
+        memcpy(out[n].name, r->name, MAX_NAME);
+        out[n].members = atomic_load(&r->members);
+        out[n].msgs = atomic_load(&r->msgs);
+        out[n].recipients = atomic_load(&r->recipients);
+        n++;
+    }
+    pthread_mutex_unlock(&room_lock);
+    return n;
+}
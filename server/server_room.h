@@ -0,0 +1,66 @@
+#ifndef SERVER_ROOM_H
+#define SERVER_ROOM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "protocol.h"
+#include "server_history.h"
+#include "server_shard.h"
+
+/*
+ * 채팅방
+ *  - 로그인한 연결은 항상 방 하나에 들어가 있다. (처음에는 ROOM_LOBBY)
+ *    채팅은 그 방 멤버에게만 가므로 전달 비용은 전체 접속자가 아니라 방 인원에 비례한다.
+ *  - 멤버 목록은 shard 마다 따로 둔 dense 배열이다. 자기 shard 칸은 그 reactor 스레드만 고치므로 락이 없다.
+ *    shard_mask 는 멤버가 있는 shard 비트맵이라, 다른 shard 에는 멤버가 있는 곳에만 메일을 보낸다.
+ *  - 방마다 채팅 기록 링과 지표가 있다. 빈 방은 자리가 모자랄 때 정리되어 다른 이름으로 다시 쓰인다.
+ *    (gen 으로 그 사이 배달 중이던 메일을 걸러낸다)
+ */
+
+#define MAX_ROOMS   256
+#define ROOM_LOBBY  0
+
+struct Conn;
+
+typedef struct {
+    struct Conn **conns;
+    int           count;
+    int           cap;
+} RoomMembers;
+
+typedef struct {
+    char             name[MAX_NAME];    // 빈 문자열이면 빈 슬롯
+    atomic_uint      gen;               // 슬롯을 새 방으로 쓸 때마다 증가
+    atomic_int       members;           // 모든 shard 합
+    _Atomic uint64_t shard_mask;        // 멤버가 있는 shard (비트 i 는 shard i 만 바꾼다)
+    HistoryRing     *hist;              // 로비는 history_lobby
+    HistoryRing      own_hist;
+    _Atomic uint64_t msgs;              // 방에 보낸 채팅 수
+    _Atomic uint64_t recipients;        // 채팅을 큐에 넣은 수신자 수
+    RoomMembers      shards[MAX_SHARDS];
+} Room;
+
+typedef struct {
+    char     name[MAX_NAME];
+    int      members;
+    uint64_t msgs;
+    uint64_t recipients;
+} RoomStat;
+
+extern Room rooms[MAX_ROOMS];
+
+int  room_init(void);
+
+// c 를 name 방으로 옮긴다. 반환: 방 번호, 이름이 잘못됐으면 -1, 방이 가득 찼으면 -2
+int  room_join(struct Conn *c, const char *name);
+int  room_enter(struct Conn *c, int room);     // 번호로 들어가기 (로그인 시 로비)
+void room_leave(struct Conn *c);               // 끊길 때
+
+// 이 shard 의 멤버 배열 (reactor 스레드만)
+static inline RoomMembers *room_local(int room) {
+    return &rooms[room].shards[shard_id];
+}
+
+int  room_list(RoomStat *out, int max);      // 사용 중인 방 (/rooms, 지표)
+
+#endif
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "server_shard.h"
+#include "server_metrics.h"
+
+/*
+ * shard 간 메일박스
+ *  - shard(reactor 스레드)마다 연결을 따로 갖고 있으므로, 다른 shard 의 사용자에게 보낼
+ *    broadcast / DM / kick 은 그 shard 의 메일박스에 넣는다.
+ *  - 메일박스는 lock-free MPSC 큐 (intrusive, stub 노드 방식). 넣는 쪽은 atomic exchange 한 번.
+ *  - 받는 shard 가 이벤트 대기 중일 수 있으므로 eventfd 로 깨운다.
+ *    wake_pending 으로 "이미 깨웠음" 을 표시해서, 몰려 들어와도 write() 는 한 번만.
+ */
+
+typedef struct {
+    Mail *_Atomic head;         // 생산자가 넣는 쪽
+    Mail         *tail;         // 소비자(받는 shard)만 사용
+    Mail          stub;
+    atomic_int    wake_pending;
+    int           efd;
+} Mailbox;
+
+__thread int shard_id = 0;
+int shard_count = 1;
+
+static Mailbox *mailboxes = NULL;
+
+int shard_init(int count) {
+    shard_count = count;
+    mailboxes = calloc(count, sizeof(Mailbox));
+    if (!mailboxes) return -1;
+
+    for (int i = 0; i < count; i++) {
+        Mailbox *mb = &mailboxes[i];
+        atomic_store(&mb->stub.next, NULL);
+        atomic_store(&mb->head, &mb->stub);
+        mb->tail = &mb->stub;
+        mb->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (mb->efd < 0) {
+            perror("eventfd");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int shard_mailbox_fd(void) {
+    return mailboxes[shard_id].efd;
+}
+
+static void mailbox_push(Mailbox *mb, Mail *m) {
+    atomic_store_explicit(&m->next, NULL, memory_order_relaxed);
+    Mail *prev = atomic_exchange_explicit(&mb->head, m, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, m, memory_order_release);
+}
+
+/**
+ * 하나 꺼내기. 비었거나 넣는 중(연결이 아직 안 끝남)이면 NULL
+ */
+static Mail *mailbox_pop(Mailbox *mb) {
+    Mail *tail = mb->tail;
+    Mail *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &mb->stub) {
+        if (!next) return NULL;
+        mb->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next) {
+        mb->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&mb->head, memory_order_acquire)) return NULL;
+
+    // 마지막 하나: stub 을 뒤에 붙여야 꺼낼 수 있다
+    mailbox_push(mb, &mb->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        mb->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/**
+ * 그 shard 를 이벤트 대기에서 깨운다 (이미 깨웠으면 아무것도 안 함)
+ * atomic 교환과 write() 뿐이라 시그널 핸들러에서도 부를 수 있다.
+ */
+void shard_wake(int shard) {
+    if (!mailboxes) return;
+    Mailbox *mb = &mailboxes[shard];
+
+    if (atomic_exchange(&mb->wake_pending, 1) == 0) {
+        uint64_t one = 1;
+        if (write(mb->efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("eventfd write");
+        }
+    }
+}
+
+/**
+ * 다른 shard 메일박스에 넣고 필요하면 깨운다
+ */
+void shard_post(int shard, Mail *m) {
+    mailbox_push(&mailboxes[shard], m);
+    shard_wake(shard);
+}
+
+/**
+ * 이 shard 메일박스에 아직 처리 못 한 것이 있는지 (넣는 중인 것 포함)
+ */
+int shard_mail_pending(void) {
+    Mailbox *mb = &mailboxes[shard_id];
+    return mb->tail != atomic_load(&mb->head) ||
+           atomic_load(&mb->tail->next) != NULL;
+}
+
+/**
+ * 이 shard 메일박스를 비운다 (이벤트 루프에서 매 tick 호출)
+ */
+void shard_drain(void) {
+    Mailbox *mb = &mailboxes[shard_id];
+
+    // 먼저 깨움 표시를 지워야, 처리하는 동안 들어온 것이 다시 깨운다
+    if (atomic_exchange(&mb->wake_pending, 0)) {
+        uint64_t v;
+        if (read(mb->efd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+            perror("eventfd read");
+        }
+    }
+
+    Mail *m;
+    while ((m = mailbox_pop(mb)) != NULL) {
+        mail_deliver(m);
+        metric_add(M_MAIL_IN, 1);
+        shared_msg_unref(m->msg);
+        free(m);
+    }
+}
+
+SharedMsg *shared_msg_new(const Message *m, int refs) {
+    SharedMsg *s = malloc(sizeof(SharedMsg));
+    if (!s) return NULL;
+    atomic_init(&s->refs, refs);
+    s->hist_seq = 0;
+    memcpy(&s->msg, m, sizeof(Message));
+    return s;
+}
+
+void shared_msg_unref(SharedMsg *s) {
+    if (s && atomic_fetch_sub(&s->refs, 1) == 1) free(s);
+}
+
+Mail *mail_new(int type, SharedMsg *msg) {
+    Mail *m = calloc(1, sizeof(Mail));
+    if (!m) return NULL;
+    m->type = type;
+    m->msg = msg;
+    return m;
+}
+
+/**
+ * mask 에 표시된 shard 들에 tmpl 과 같은 메일 전달 (이 shard 는 제외)
+ * 메시지 본문은 한 번만 복사해서 받는 shard 들이 공유한다.
+ */
+void shard_multicast(uint64_t mask, const Mail *tmpl, const Message *m, uint64_t hist_seq) {
+    if (shard_count < MAX_SHARDS) mask &= (1ull << shard_count) - 1;
+    mask &= ~(1ull << shard_id);
+    if (mask == 0) return;
+
+    SharedMsg *s = shared_msg_new(m, __builtin_popcountll(mask));
+    if (!s) return;
+    s->hist_seq = hist_seq;
+
+    while (mask) {
+        int i = __builtin_ctzll(mask);
+        mask &= mask - 1;
+
+        Mail *mail = mail_new(tmpl->type, s);
+        if (!mail) {
+            shared_msg_unref(s);
+            continue;
+        }
+        mail->target_gen = tmpl->target_gen;
+        mail->room = tmpl->room;
+        mail->sender_id = tmpl->sender_id;
+        mail->flags = tmpl->flags;
+        shard_post(i, mail);
+    }
+}
+
+/**
+ * 다른 모든 shard 에 broadcast 전달
+ */
+void shard_broadcast_remote(const Message *m, uint64_t hist_seq, uint32_t sender_id, int flags) {
+    Mail tmpl = { .type = MAIL_BROADCAST, .sender_id = sender_id, .flags = flags };
+    shard_multicast(~0ull, &tmpl, m, hist_seq);
+}
@@ -0,0 +1,61 @@
+#ifndef SERVER_SHARD_H
+#define SERVER_SHARD_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "protocol.h"
+
+// reactor 스레드(shard) 최대 개수
+#define MAX_SHARDS 64
+
+struct Conn;
+
+// 이 스레드가 맡은 shard 번호 / 전체 shard 수
+extern __thread int shard_id;
+extern int shard_count;
+
+// 여러 shard 가 같이 읽는 메시지 (마지막 shard 가 해제)
+typedef struct SharedMsg {
+    atomic_int refs;
+    uint64_t   hist_seq;        // 채팅 기록 seq (0: 기록 안 됨)
+    Message    msg;
+} SharedMsg;
+
+typedef enum {
+    MAIL_BROADCAST = 1,     // 그 shard 의 로그인한 모든 연결에 전송
+    MAIL_DM,                // target 연결 하나에 전송
+    MAIL_KICK,              // target 연결 강퇴
+    MAIL_ROOM               // 그 shard 의 room 멤버에게 전송
+} MailType;
+
+// 다른 shard 로 보내는 작업 1개
+typedef struct Mail {
+    struct Mail *_Atomic next;
+    int          type;
+    struct Conn *target;        // DM/KICK 대상 (받는 shard 의 연결)
+    unsigned     target_gen;    // 그 사이 슬롯이 재사용됐는지 확인용 (ROOM: 방 gen)
+    int          room;          // MAIL_ROOM 대상 방
+    uint32_t     sender_id;     // v2 프레임 sender_id
+    uint32_t     target_id;
+    int          flags;         // OUTQ_*
+    SharedMsg   *msg;
+} Mail;
+
+int  shard_init(int count);
+int  shard_mailbox_fd(void);
+int  shard_mail_pending(void);
+void shard_drain(void);
+
+SharedMsg *shared_msg_new(const Message *m, int refs);
+void shared_msg_unref(SharedMsg *s);
+
+Mail *mail_new(int type, SharedMsg *msg);
+void  shard_post(int shard, Mail *m);
+void  shard_wake(int shard);
+void  shard_broadcast_remote(const Message *m, uint64_t hist_seq, uint32_t sender_id, int flags);
+void  shard_multicast(uint64_t mask, const Mail *tmpl, const Message *m, uint64_t hist_seq);
+
+// 받는 shard 에서 Mail 처리 (server_chat.c)
+void mail_deliver(Mail *m);
+
+#endif
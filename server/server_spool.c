@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "frame.h"
+#include "server_config.h"
+#include "server_log.h"
+#include "server_metrics.h"
+#include "server_proto.h"
+#include "server_timer.h"
+#include "server_spool.h"
+
+/*
+ * 파일 배치
+ *   <받는 사람 이름 hex>.q : 레코드를 도착 순서대로 이어 쓴 파일 (이름에 어떤 글자가 와도 경로가 안전하도록 hex)
+ * 레코드 = SpoolHdr + 보낸 사람 + 본문. 시작할 때 길이가 안 맞는 꼬리는 쓰다 만 것으로 보고 잘라낸다.
+ * 레코드는 시각 순이므로 보관 기간이 지난 것은 항상 파일 앞쪽에 모여 있다.
+ *
+ * 잠금
+ *  - spool_lock: 인덱스(항목 목록, 개수/크기)만 지킨다. 파일은 잠금 밖에서 다룬다.
+ *  - 사용자 파일을 다루는 쪽은 먼저 그 항목을 잡는다(busy). 같은 사용자를 다루려는 다른 쪽은
+ *    spool_idle 에서 기다리고, 다른 사용자의 보관/전달은 디스크 I/O 를 기다리지 않는다.
+ *  - 보관할 때 항목을 잡은 뒤 접속 여부를 다시 본다. 로그인은 register_user() 뒤에 항목을 잡고
+ *    꺼내 가므로, 둘 중 늦은 쪽이 반드시 상대를 본다. (보관함에 남은 채로 로그인이 끝나는 일이 없다)
+ *
+ * 전달
+ *  - 로그인하면 파일을 읽어 출력 큐에 넣고 항목을 draining 으로 표시한다. 파일은 그대로 둔다.
+ *  - 출력 큐가 다 나가면(spool_ack) 그때 넣은 만큼만 파일 앞에서 지운다.
+ *    그 전에 연결이 끊기면(spool_abort) 표시만 풀고, 다음 로그인 때 다시 전달한다.
+ */
+
+#define SPOOL_BUCKETS   1024                // 2의 거듭제곱
+#define SPOOL_SWEEP_MS  (60 * 1000)         // 보관 기간 정리 주기
+
+typedef struct {
+    uint32_t len;           // 헤더 뒤 바이트 수
+    uint8_t  sender_len;
+    uint8_t  pad[3];
+    int64_t  ts_ms;         // 보관한 시각 (epoch ms)
+} SpoolHdr;
+
+#define SPOOL_REC_MAX (sizeof(SpoolHdr) + MAX_NAME + MAX_BUF)
+
+typedef struct SpoolUser {
+    struct SpoolUser *next;
+    char     name[MAX_NAME];
+    uint32_t count;
+    uint64_t bytes;         // 파일 크기
+    int64_t  oldest_ts;     // 첫 레코드 시각
+    int      busy;          // 한 스레드가 이 사용자 파일을 다루는 중
+    int      draining;      // 로그인한 연결의 출력 큐에 넣었고 아직 다 나가지 않음
+    uint32_t drain_count;   // 그때 넣은 레코드 수 / 바이트 (파일 앞부분)
+    uint64_t drain_bytes;
+} SpoolUser;
+
+static SpoolUser *buckets[SPOOL_BUCKETS];
+static uint64_t st_users, st_msgs, st_bytes;
+static pthread_mutex_t spool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  spool_idle = PTHREAD_COND_INITIALIZER;
+
+static Timer sweep_timer;       // shard 0 전용
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t ttl_cutoff(void) {
+    return g_config.spool_ttl_hours > 0
+         ? now_ms() - (int64_t)g_config.spool_ttl_hours * 3600 * 1000 : INT64_MIN;
+}
+
+static uint32_t name_hash(const char *s) {
+    uint32_t h = 2166136261u;       // FNV-1a 32bit
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void spool_path(char *out, size_t size, const char *name, const char *suffix) {
+    static const char hex[] = "0123456789abcdef";
+    char enc[2 * MAX_NAME + 1];
+    size_t n = 0;
+
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        enc[n++] = hex[*p >> 4];
+        enc[n++] = hex[*p & 15];
+    }
+    enc[n] = '\0';
+    snprintf(out, size, "%s%s.q%s", SPOOL_DIR, enc, suffix);
+}
+
+// 파일 이름 (hex) → 사용자 이름. 잘못된 이름이면 -1
+static int decode_name(const char *file, char *out) {
+    size_t n = strlen(file);
+    if (n < 4 || strcmp(file + n - 2, ".q") != 0) return -1;
+    n -= 2;
+    if (n % 2 || n / 2 >= MAX_NAME) return -1;
+
+    for (size_t i = 0; i < n; i += 2) {
+        int v = 0;
+        for (int k = 0; k < 2; k++) {
+            char ch = file[i + k];
+            int d = ch >= '0' && ch <= '9' ? ch - '0' : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : -1;
+            if (d < 0) return -1;
+            v = v * 16 + d;
+        }
+        if (v == 0) return -1;
+        out[i / 2] = (char)v;
+    }
+    out[n / 2] = '\0';
+    return 0;
+}
+
+static SpoolUser **user_slot(const char *name) {
+    SpoolUser **pp = &buckets[name_hash(name) & (SPOOL_BUCKETS - 1)];
+    while (*pp && strcmp((*pp)->name, name) != 0) pp = &(*pp)->next;
+    return pp;
+}
+
+static void user_remove(SpoolUser **pp) {
+    SpoolUser *u = *pp;
+    *pp = u->next;
+    st_users--;
+    st_msgs -= u->count;
+    st_bytes -= u->bytes;
+    free(u);
+}
+
+/**
+ * 이름의 항목을 잡는다 (spool_lock 을 잡은 채로). 다른 스레드가 잡고 있으면 놓을 때까지 기다린다.
+ * create 면 없을 때 빈 항목을 만든다. 반환: 잡은 항목, 없으면 NULL
+ */
+static SpoolUser *user_acquire(const char *name, int create) {
+    SpoolUser *u;
+    while ((u = *user_slot(name)) != NULL && u->busy) {
+        pthread_cond_wait(&spool_idle, &spool_lock);
+    }
+
+    if (!u) {
+        if (!create || (u = calloc(1, sizeof(SpoolUser))) == NULL) return NULL;
+        snprintf(u->name, sizeof(u->name), "%s", name);
+        SpoolUser **pp = user_slot(name);
+        u->next = *pp;
+        *pp = u;
+        st_users++;
+    }
+    u->busy = 1;
+    return u;
+}
+
+/**
+ * 잡은 항목을 놓는다 (spool_lock 을 잡은 채로). 남은 레코드가 없으면 인덱스에서 지운다.
+ */
+static void user_put_back(SpoolUser *u) {
+    u->busy = 0;
+    if (u->count == 0 && !u->draining) user_remove(user_slot(u->name));
+    pthread_cond_broadcast(&spool_idle);
+}
+
+// 파일 앞의 레코드 n개(off 바이트)가 빠졌음을 인덱스에 반영 (spool_lock 을 잡은 채로)
+static void user_cut(SpoolUser *u, uint32_t n, uint64_t off, int64_t next_ts) {
+    u->count -= n;
+    u->bytes -= off;
+    u->oldest_ts = next_ts;
+    st_msgs -= n;
+    st_bytes -= off;
+}
+
+// rec_len 짜리 레코드를 더 넣으면 개수/크기 한도를 넘는지
+static int is_full(const SpoolUser *u, size_t rec_len) {
+    return u->count >= (uint32_t)g_config.spool_msgs ||
+           u->bytes + rec_len > (uint64_t)g_config.spool_kb * 1024;
+}
+
+/**
+ * 보관 파일 전체 읽기 (호출한 쪽이 free). 실패하면 NULL
+ */
+static unsigned char *read_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    unsigned char *buf = NULL;
+    if (fstat(fd, &st) == 0 && (buf = malloc(st.st_size ? st.st_size : 1)) != NULL) {
+        size_t got = 0;
+        while (got < (size_t)st.st_size) {
+            ssize_t n = read(fd, buf + got, st.st_size - got);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += n;
+        }
+        *len = got;
+    }
+    close(fd);
+    return buf;
+}
+
+/**
+ * buf[off] 의 레코드 길이. 온전한 레코드가 아니면 0
+ */
+static size_t rec_size(const unsigned char *buf, size_t len, size_t off) {
+    if (len - off < sizeof(SpoolHdr)) return 0;
+
+    SpoolHdr h;
+    memcpy(&h, buf + off, sizeof(h));
+    if (h.len == 0 || h.sender_len >= MAX_NAME || h.len < h.sender_len ||
+        h.len - h.sender_len > MAX_BUF || len - off - sizeof(h) < h.len) return 0;
+    return sizeof(h) + h.len;
+}
+
+static int64_t rec_ts(const unsigned char *buf, size_t off) {
+    SpoolHdr h;
+    memcpy(&h, buf + off, sizeof(h));
+    return h.ts_ms;
+}
+
+/**
+ * 보관 파일에서 앞 off 바이트를 잘라낸다 (항목을 잡은 채, spool_lock 밖에서).
+ * 남는 것이 없으면 파일을 지운다. 반환: 0 성공, -1 실패 (파일은 그대로)
+ */
+static int cut_front(const SpoolUser *u, const unsigned char *buf, size_t len, size_t off) {
+    char path[128], tmp[128];
+    spool_path(path, sizeof(path), u->name, "");
+
+    if (off >= len) {
+        if (unlink(path) < 0 && errno != ENOENT) {
+            server_log("보관함 지우기 실패: %s (errno=%d)", u->name, errno);
+            return -1;
+        }
+        return 0;
+    }
+
+    spool_path(tmp, sizeof(tmp), u->name, ".tmp");
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, buf + off, len - off) != (ssize_t)(len - off) ||
+        rename(tmp, path) < 0) {
+        server_log("보관함 정리 실패: %s (errno=%d)", u->name, errno);
+        if (fd >= 0) close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * 보관 기간이 지난 앞쪽 레코드를 버리고 다시 쓴다 (항목을 잡은 채, spool_lock 밖에서).
+ * 다 지났으면 파일을 지운다. 반환: 버린 레코드 수
+ */
+static int drop_expired(SpoolUser *u, int64_t cutoff) {
+    char path[128];
+    spool_path(path, sizeof(path), u->name, "");
+
+    size_t len = 0;
+    unsigned char *buf = read_file(path, &len);
+    if (!buf) return 0;
+
+    size_t off = 0, sz;
+    int dropped = 0;
+    while ((sz = rec_size(buf, len, off)) > 0 && rec_ts(buf, off) < cutoff) {
+        off += sz;
+        dropped++;
+    }
+
+    int all = off == len || dropped == (int)u->count;
+    if ((dropped == 0 && !all) || cut_front(u, buf, len, all ? len : off) < 0) {
+        free(buf);
+        return 0;
+    }
+
+    pthread_mutex_lock(&spool_lock);
+    if (all) user_cut(u, u->count, u->bytes, 0);
+    else user_cut(u, dropped, off, rec_ts(buf, off));
+    pthread_mutex_unlock(&spool_lock);
+
+    free(buf);
+    return dropped;
+}
+
+/**
+ * 시작할 때 보관 파일 하나를 읽어 인덱스에 넣는다 (쓰다 만 꼬리는 잘라냄)
+ */
+static void load_one(const char *file) {
+    char name[MAX_NAME], path[128];
+    if (decode_name(file, name) < 0) return;
+    spool_path(path, sizeof(path), name, "");
+
+    size_t len = 0;
+    unsigned char *buf = read_file(path, &len);
+    if (!buf) return;
+
+    size_t off = 0, sz;
+    uint32_t count = 0;
+    while ((sz = rec_size(buf, len, off)) > 0) {
+        off += sz;
+        count++;
+    }
+    if (off < len) {
+        server_log("보관함 %s: 끝의 %zu 바이트 잘라냄", name, len - off);
+        if (truncate(path, off) < 0) server_log("보관함 %s 자르기 실패 (errno=%d)", name, errno);
+    }
+
+    SpoolUser *u = count ? calloc(1, sizeof(SpoolUser)) : NULL;
+    if (!u) {
+        unlink(path);
+        free(buf);
+        return;
+    }
+    strcpy(u->name, name);
+    u->count = count;
+    u->bytes = off;
+    u->oldest_ts = rec_ts(buf, 0);
+    free(buf);
+
+    SpoolUser **pp = user_slot(name);
+    u->next = *pp;
+    *pp = u;
+    st_users++;
+    st_msgs += count;
+    st_bytes += off;
+}
+
+int spool_start(void) {
+    mkdir("./server", 0755);
+    mkdir(SPOOL_DIR, 0755);
+
+    DIR *d = opendir(SPOOL_DIR);
+    if (!d) {
+        perror("spool dir open failed");
+        return -1;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        size_t n = strlen(de->d_name);
+        if (n > 4 && strcmp(de->d_name + n - 4, ".tmp") == 0) {
+            // 정리하다 멈춘 임시 파일 (원본은 그대로 있다)
+            char path[512];
+            snprintf(path, sizeof(path), "%s%s", SPOOL_DIR, de->d_name);
+            unlink(path);
+            continue;
+        }
+        load_one(de->d_name);
+    }
+    closedir(d);
+
+    if (st_users > 0) {
+        server_log("오프라인 귓속말 보관함 복구: 사용자 %llu명, %llu개",
+                   (unsigned long long)st_users, (unsigned long long)st_msgs);
+    }
+    return 0;
+}
+
+SpoolResult spool_put(const Message *dm, ConnRef *ref) {
+    if (g_config.spool_msgs == 0) return SPOOL_OFF;
+
+    size_t sender_len = strnlen(dm->sender, MAX_NAME - 1);
+    size_t body_len = (size_t)dm->data_len;
+
+    unsigned char rec[SPOOL_REC_MAX];
+    SpoolHdr h;
+    memset(&h, 0, sizeof(h));
+    h.len = (uint32_t)(sender_len + body_len);
+    h.sender_len = (uint8_t)sender_len;
+    h.ts_ms = now_ms();
+    memcpy(rec, &h, sizeof(h));
+    memcpy(rec + sizeof(h), dm->sender, sender_len);
+    memcpy(rec + sizeof(h) + sender_len, dm->data, body_len);
+    size_t rec_len = sizeof(h) + h.len;
+
+    SpoolResult res = SPOOL_STORED;
+
+    pthread_mutex_lock(&spool_lock);
+    SpoolUser *u = user_acquire(dm->target, 1);
+    if (!u) {
+        pthread_mutex_unlock(&spool_lock);
+        return SPOOL_ERROR;
+    }
+
+    // 조회와 보관 사이에 로그인했으면 보관하지 않고 바로 전달하게 한다
+    if (conn_lookup(dm->target, ref)) {
+        user_put_back(u);
+        pthread_mutex_unlock(&spool_lock);
+        return SPOOL_ONLINE;
+    }
+    pthread_mutex_unlock(&spool_lock);
+
+    // 여기부터는 항목을 잡고 있으므로 잠금 없이 이 사용자 파일을 다룬다
+    // 가득 찼으면 보관 기간이 지난 것부터 비워 본다
+    if (is_full(u, rec_len) && !u->draining && u->oldest_ts < ttl_cutoff()) {
+        metric_add(M_SPOOL_EXPIRED, drop_expired(u, ttl_cutoff()));
+    }
+
+    char path[128];
+    int fd = -1;
+    ssize_t n = 0;
+    if (is_full(u, rec_len)) {
+        res = SPOOL_FULL;
+    } else {
+        spool_path(path, sizeof(path), u->name, "");
+        fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        n = fd >= 0 ? write(fd, rec, rec_len) : -1;
+        if (n != (ssize_t)rec_len) {
+            // 반쯤 쓴 레코드가 남지 않게 원래 길이로 되돌린다
+            server_log("귓속말 보관 실패: %s (errno=%d)", u->name, errno);
+            if (fd >= 0 && n > 0 && ftruncate(fd, (off_t)u->bytes) < 0)
+                server_log("보관함 되돌리기 실패: %s (시작할 때 잘라냄)", u->name);
+            if (u->count == 0) unlink(path);
+            res = SPOOL_ERROR;
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    pthread_mutex_lock(&spool_lock);
+    if (res == SPOOL_STORED) {
+        if (u->count == 0) u->oldest_ts = h.ts_ms;
+        u->count++;
+        u->bytes += rec_len;
+        st_msgs++;
+        st_bytes += rec_len;
+    }
+    user_put_back(u);
+    pthread_mutex_unlock(&spool_lock);
+
+    if (res == SPOOL_STORED) metric_add(M_SPOOL_STORED, 1);
+    else if (res == SPOOL_FULL) metric_add(M_SPOOL_FULL, 1);
+    return res;
+}
+
+int spool_drain(Conn *c) {
+    // 인덱스에 없으면 디스크는 보지 않는다 (대부분의 로그인)
+    pthread_mutex_lock(&spool_lock);
+    SpoolUser *u = user_acquire(c->username, 0);
+    if (u && u->draining) {
+        user_put_back(u);       // 다른 연결이 아직 전달 중
+        u = NULL;
+    }
+    pthread_mutex_unlock(&spool_lock);
+    if (!u) return 0;
+
+    char path[128];
+    size_t len = 0;
+    spool_path(path, sizeof(path), c->username, "");
+    unsigned char *buf = read_file(path, &len);
+    int loaded = buf != NULL;
+    if (!loaded) server_log("보관함 읽기 실패: %s (errno=%d)", c->username, errno);
+
+    // 모두 출력 큐에 넣고, 이 tick 끝의 flush 에서 한꺼번에 보낸다
+    int64_t cutoff = ttl_cutoff();
+    int sent = 0, expired = 0;
+    size_t off = 0, sz;
+    while (buf && (sz = rec_size(buf, len, off)) > 0) {
+        SpoolHdr h;
+        memcpy(&h, buf + off, sizeof(h));
+        const unsigned char *p = buf + off + sizeof(h);
+        off += sz;
+
+        if (h.ts_ms < cutoff) {
+            expired++;
+            continue;
+        }
+
+        Message dm;
+        memset(&dm, 0, sizeof(dm));
+        dm.type = MSG_DM;
+        memcpy(dm.sender, p, h.sender_len);
+        strcpy(dm.target, c->username);
+        dm.data_len = (int)(h.len - h.sender_len);
+        memcpy(dm.data, p + h.sender_len, dm.data_len);
+
+        // 보낸 사람은 지금 접속해 있지 않을 수 있으므로 연결 id 없이 보낸다 (이름은 sender 에 있음)
+        OutMessage om;
+        outmsg_init(&om, &dm, FRAME_ID_NONE, conn_wire_id(c));
+        int r = conn_send_outmsg(c, &om, 0);
+        outmsg_release(&om);
+        if (r < 0) break;       // 큐에 못 넣고 끊김: 파일은 그대로 두고 다음 로그인 때 다시
+        sent++;
+    }
+    free(buf);
+
+    // 파일은 출력 큐가 다 나갈 때까지 그대로 둔다 (넣는 중에 끊겼으면 다음 로그인 때 다시)
+    pthread_mutex_lock(&spool_lock);
+    if (loaded && c->fd >= 0) {
+        u->draining = 1;
+        u->drain_count = (uint32_t)(sent + expired);
+        u->drain_bytes = off;
+    }
+    user_put_back(u);
+    pthread_mutex_unlock(&spool_lock);
+    if (!loaded || c->fd < 0) return 0;
+
+    c->spool_unacked = 1;
+    if (sent == 0) spool_ack(c);        // 모두 기간이 지났으면 보낼 것 없이 바로 정리
+
+    metric_add(M_SPOOL_DELIVERED, sent);
+    metric_add(M_SPOOL_EXPIRED, expired);
+    if (sent > 0 || expired > 0) {
+        server_log("%s 보관된 귓속말 전달: %d개 (기간 지남 %d개)", c->username, sent, expired);
+    }
+    return sent;
+}
+
+void spool_ack(Conn *c) {
+    c->spool_unacked = 0;
+
+    pthread_mutex_lock(&spool_lock);
+    SpoolUser *u = user_acquire(c->username, 0);
+    if (u && !u->draining) {
+        user_put_back(u);
+        u = NULL;
+    }
+    pthread_mutex_unlock(&spool_lock);
+    if (!u) return;
+
+    // 보통은 전부 보낸 것이라 파일을 지우면 끝. 뒤에 더 붙었으면 보낸 앞부분만 잘라낸다
+    int all = u->drain_count >= u->count;
+    size_t len = 0;
+    unsigned char *buf = NULL;
+    int ok;
+    if (all) {
+        ok = cut_front(u, NULL, 0, 0) == 0;
+    } else {
+        char path[128];
+        spool_path(path, sizeof(path), u->name, "");
+        buf = read_file(path, &len);
+        ok = buf && u->drain_bytes < len && cut_front(u, buf, len, u->drain_bytes) == 0;
+    }
+
+    pthread_mutex_lock(&spool_lock);
+    u->draining = 0;
+    if (ok && all) user_cut(u, u->count, u->bytes, 0);
+    else if (ok) user_cut(u, u->drain_count, u->drain_bytes, rec_ts(buf, u->drain_bytes));
+    user_put_back(u);
+    pthread_mutex_unlock(&spool_lock);
+    free(buf);
+}
+
+void spool_abort(Conn *c) {
+    if (!c->spool_unacked) return;
+    c->spool_unacked = 0;
+
+    pthread_mutex_lock(&spool_lock);
+    SpoolUser *u = *user_slot(c->username);
+    if (u) u->draining = 0;
+    pthread_mutex_unlock(&spool_lock);
+    server_log("%s 보관된 귓속말을 다 보내기 전에 끊김: 다음 로그인 때 다시 전달", c->username);
+}
+
+static void sweep_timer_fire(Timer *t) {
+    if (g_config.spool_ttl_hours > 0) {
+        int64_t cutoff = ttl_cutoff();
+        int dropped = 0;
+
+        // 대상 이름만 모아 두고, 파일 정리는 항목을 하나씩 잡아서 잠금 밖에서 한다
+        char (*names)[MAX_NAME] = NULL;
+        size_t n = 0, cap = 0;
+
+        pthread_mutex_lock(&spool_lock);
+        for (int b = 0; b < SPOOL_BUCKETS; b++) {
+            for (SpoolUser *u = buckets[b]; u; u = u->next) {
+                if (u->oldest_ts >= cutoff || u->draining) continue;
+                if (n == cap) {
+                    size_t ncap = cap ? cap * 2 : 16;
+                    void *p = realloc(names, ncap * sizeof(*names));
+                    if (!p) break;
+                    names = p;
+                    cap = ncap;
+                }
+                memcpy(names[n++], u->name, MAX_NAME);
+            }
+        }
+        pthread_mutex_unlock(&spool_lock);
+
+        for (size_t i = 0; i < n; i++) {
+            pthread_mutex_lock(&spool_lock);
+            SpoolUser *u = user_acquire(names[i], 0);
+            pthread_mutex_unlock(&spool_lock);
+            if (!u) continue;
+
+            if (!u->draining && u->oldest_ts < cutoff) dropped += drop_expired(u, cutoff);
+
+            pthread_mutex_lock(&spool_lock);
+            user_put_back(u);
+            pthread_mutex_unlock(&spool_lock);
+        }
+        free(names);
+
+        if (dropped > 0) {
+            metric_add(M_SPOOL_EXPIRED, dropped);
+            server_log("보관 기간이 지난 귓속말 %d개 정리", dropped);
+        }
+    }
+    timer_add_ms(t, SPOOL_SWEEP_MS);
+}
+
+void spool_arm_sweep(void) {
+    timer_setup(&sweep_timer, sweep_timer_fire, NULL);
+    timer_add_ms(&sweep_timer, SPOOL_SWEEP_MS);
+}
+
+void spool_stats(SpoolStats *out) {
+    pthread_mutex_lock(&spool_lock);
+    out->users = st_users;
+    out->msgs = st_msgs;
+    out->bytes = st_bytes;
+    pthread_mutex_unlock(&spool_lock);
+}
@@ -0,0 +1,43 @@
+#ifndef SERVER_SPOOL_H
+#define SERVER_SPOOL_H
+
+#include <stdint.h>
+#include "protocol.h"
+#include "server_conn.h"
+
+/*
+ * 오프라인 귓속말 보관함 (store-and-forward)
+ *  - 받는 사람이 접속해 있지 않으면 DM 을 SPOOL_DIR 의 받는 사람별 파일에 이어 쓴다.
+ *  - 메모리 인덱스(이름 → 개수/크기/가장 오래된 시각)만 보고 한도와 보관 여부를 판단하므로
+ *    보관함이 빈 사용자의 로그인은 디스크를 건드리지 않는다.
+ *  - 로그인 직후 register_user() 다음에 한 번에 읽어서 출력 큐에 넣는다.
+ *    (같은 tick 끝의 flush 에서 sendmsg 묶음으로 나간다)
+ *    파일에서는 출력 큐가 다 나간 뒤에 지우고, 그 전에 끊기면 다음 로그인 때 다시 전달한다.
+ *  - 사용자별 개수/크기 한도(--spool-msgs, --spool-kb)와 보관 기간(--spool-ttl-hours)이 있다.
+ */
+
+#define SPOOL_DIR "./server/server_spool/"
+
+typedef enum {
+    SPOOL_STORED = 0,       // 보관함에 넣음
+    SPOOL_ONLINE,           // 그 사이 접속함 (ref 에 위치, 바로 전달할 것)
+    SPOOL_FULL,             // 받는 사람 보관함이 가득 참
+    SPOOL_OFF,              // 보관 기능 꺼짐 (--spool-msgs=0)
+    SPOOL_ERROR             // 디스크 오류
+} SpoolResult;
+
+typedef struct {
+    uint64_t users;         // 보관함이 있는 사용자
+    uint64_t msgs;
+    uint64_t bytes;         // 보관 파일 크기 합
+} SpoolStats;
+
+int         spool_start(void);                          // 보관 파일 읽어서 인덱스 생성 (reactor 시작 전)
+SpoolResult spool_put(const Message *dm, ConnRef *ref); // dm->target 앞으로 보관
+int         spool_drain(Conn *c);                       // 로그인한 c 에게 보관된 DM 전달. 반환: 보낸 개수
+void        spool_ack(Conn *c);                         // c 의 출력 큐가 비었음: 전달한 DM 을 보관함에서 지움
+void        spool_abort(Conn *c);                       // 다 보내기 전에 끊김: 다음 로그인 때 다시 전달
+void        spool_arm_sweep(void);                      // 보관 기간 정리 타이머 (shard 0 에서 한 번)
+void        spool_stats(SpoolStats *out);
+
+#endif
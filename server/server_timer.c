@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "server_timer.h"
+
+/*
+ * 타이머 휠 (Linux 예전 timer wheel 과 같은 방식)
+ *  - 0단계: 앞으로 64 tick 안에 만료되는 타이머를 만료 tick 칸에 둔다.
+ *  - L단계: 64^L ~ 64^(L+1) tick 뒤 타이머를 (expires >> 6L) 칸에 두고,
+ *    아래 단계가 한 바퀴 돌 때마다 한 칸씩 아래로 내려보낸다(cascade).
+ *  → tick 마다 0단계 한 칸만 보면 되고, 대부분 타이머(유휴 연결 등)는
+ *    만료 전에 취소되거나 미뤄지므로 아래 단계까지 내려오지 않는다.
+ */
+
+#define TW_BITS    6
+#define TW_SIZE    (1 << TW_BITS)
+#define TW_MASK    (TW_SIZE - 1)
+#define TW_LEVELS  4
+#define TW_MAX_DELTA ((1ull << (TW_BITS * TW_LEVELS)) - 1)
+
+static __thread Timer   *wheel[TW_LEVELS][TW_SIZE];
+static __thread uint64_t wheel_next;     // 아직 처리하지 않은 다음 tick
+static __thread int      timer_count;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void timer_wheel_init(void) {
+    memset(wheel, 0, sizeof(wheel));
+    wheel_next = now_ms() / TIMER_TICK_MS + 1;
+    timer_count = 0;
+}
+
+void timer_setup(Timer *t, void (*fn)(Timer *t), void *arg) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+int timer_pending(const Timer *t) {
+    return t->pprev != NULL;
+}
+
+uint64_t timer_ticks(void) {
+    return wheel_next - 1;
+}
+
+uint64_t timer_ms_to_ticks(uint64_t ms) {
+    return (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+}
+
+static void slot_push(Timer **slot, Timer *t) {
+    t->next = *slot;
+    if (t->next) t->next->pprev = &t->next;
+    *slot = t;
+    t->pprev = slot;
+}
+
+/**
+ * 만료까지 남은 tick 수로 단계를 고른다
+ */
+static void wheel_insert(Timer *t) {
+    uint64_t expires = t->expires;
+    uint64_t delta = expires - wheel_next;
+    Timer **slot;
+
+    if ((int64_t)delta < 0) {
+        slot = &wheel[0][wheel_next & TW_MASK];         // 이미 지남 → 다음 tick 에 실행
+    } else if (delta < (1ull << TW_BITS)) {
+        slot = &wheel[0][expires & TW_MASK];
+    } else if (delta < (1ull << (2 * TW_BITS))) {
+        slot = &wheel[1][(expires >> TW_BITS) & TW_MASK];
+    } else if (delta < (1ull << (3 * TW_BITS))) {
+        slot = &wheel[2][(expires >> (2 * TW_BITS)) & TW_MASK];
+    } else {
+        // 휠 범위 밖이면 맨 끝 칸에 두고, 내려올 때 다시 넣는다
+        if (delta > TW_MAX_DELTA) expires = wheel_next + TW_MAX_DELTA;
+        slot = &wheel[3][(expires >> (3 * TW_BITS)) & TW_MASK];
+    }
+    slot_push(slot, t);
+}
+
+/**
+ * 만료 tick 에 등록 (이미 등록되어 있으면 옮긴다)
+ */
+void timer_add(Timer *t, uint64_t expires) {
+    if (t->pprev) timer_del(t);
+    t->expires = expires;
+    wheel_insert(t);
+    timer_count++;
+}
+
+void timer_add_ms(Timer *t, uint64_t delay_ms) {
+    uint64_t d = timer_ms_to_ticks(delay_ms);
+    timer_add(t, timer_ticks() + (d ? d : 1));
+}
+
+void timer_del(Timer *t) {
+    if (!t->pprev) return;
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+    timer_count--;
+}
+
+// 윗단계 칸 하나를 비우고 아래 단계로 다시 넣는다. 반환: 칸 번호
+static int cascade(int level, int idx) {
+    Timer *t = wheel[level][idx];
+    wheel[level][idx] = NULL;
+
+    while (t) {
+        Timer *next = t->next;
+        wheel_insert(t);
+        t = next;
+    }
+    return idx;
+}
+
+/**
+ * 현재 시각까지 밀린 tick 을 처리하고 만료된 타이머를 실행
+ * 콜백 안에서 다른 타이머를 등록/취소해도 된다.
+ */
+void timer_run(void) {
+    uint64_t now = now_ms() / TIMER_TICK_MS;
+
+    if (timer_count == 0) {
+        if (now >= wheel_next) wheel_next = now + 1;
+        return;
+    }
+
+    while (wheel_next <= now) {
+        int idx = (int)(wheel_next & TW_MASK);
+
+        if (idx == 0 &&
+            cascade(1, (int)((wheel_next >> TW_BITS) & TW_MASK)) == 0 &&
+            cascade(2, (int)((wheel_next >> (2 * TW_BITS)) & TW_MASK)) == 0) {
+            cascade(3, (int)((wheel_next >> (3 * TW_BITS)) & TW_MASK));
+        }
+        uint64_t tick = wheel_next++;
+
+        // 칸 목록을 떼어 내서 처리 (콜백이 같은 칸의 다른 타이머를 지워도 안전)
+        Timer *work = wheel[0][idx];
+        wheel[0][idx] = NULL;
+        if (work) work->pprev = &work;
+
+        while (work) {
+            Timer *t = work;
+            timer_del(t);
+            if (t->expires > tick) {
+                // 휠 범위보다 멀었던 타이머: 아직 남았으면 다시 넣는다
+                timer_add(t, t->expires);
+                continue;
+            }
+            t->fn(t);
+        }
+    }
+}
+
+/**
+ * 다음 만료 가능 시점까지의 대기 시간(ms)
+ * 0단계에서 가장 가까운 칸, 없으면 0단계가 한 바퀴 도는(cascade) 시점까지 기다린다.
+ */
+int timer_wait_ms(void) {
+    if (timer_count == 0) return -1;
+
+    uint64_t target = wheel_next;
+    while ((target & TW_MASK) != 0 && !wheel[0][target & TW_MASK])
+        target++;
+
+    uint64_t now = now_ms();
+    uint64_t at = target * TIMER_TICK_MS;
+    return at > now ? (int)(at - now) : 0;
+}
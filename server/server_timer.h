@@ -0,0 +1,36 @@
+#ifndef SERVER_TIMER_H
+#define SERVER_TIMER_H
+
+#include <stdint.h>
+
+/*
+ * 계층형 타이머 휠 (reactor 스레드마다 하나, 이벤트 루프가 직접 돌린다)
+ *  - 한 칸(tick) = TIMER_TICK_MS, 단계마다 64칸 × 4단계 → 약 19일까지 바로 담고,
+ *    그보다 먼 타이머는 맨 위 단계에 두었다가 내려올 때 다시 넣는다.
+ *  - 등록/취소 O(1), 스레드 없음. 타이머는 등록한 스레드에서만 만지고 실행된다.
+ */
+
+#define TIMER_TICK_MS 100
+
+typedef struct Timer {
+    struct Timer  *next;
+    struct Timer **pprev;        // NULL 이면 등록 안 됨
+    uint64_t       expires;      // 만료 tick
+    void         (*fn)(struct Timer *t);
+    void          *arg;
+} Timer;
+
+void     timer_wheel_init(void);
+void     timer_setup(Timer *t, void (*fn)(Timer *t), void *arg);
+void     timer_add(Timer *t, uint64_t expires);
+void     timer_add_ms(Timer *t, uint64_t delay_ms);
+void     timer_del(Timer *t);
+int      timer_pending(const Timer *t);
+
+uint64_t timer_ticks(void);           // 마지막으로 돌린 시점의 tick (시계 호출 없음)
+uint64_t timer_ms_to_ticks(uint64_t ms);
+
+int      timer_wait_ms(void);         // event_wait 에 넘길 대기 시간 (-1: 타이머 없음)
+void     timer_run(void);             // 만료된 타이머 실행 (이벤트 루프에서 매 tick)
+
+#endif
@@ -2,30 +2,41 @@
 #include <string.h>
 #include <unistd.h>
 #include "protocol.h"
+#include "server_event.h"
+#include "server_conn.h"
+#include "server_proto.h"
+#include "server_file.h"
+#include "server_auth.h"
+#include "server_room.h"
+#include "server_spool.h"
 
-extern int client_sockets[];
-extern char usernames[][MAX_NAME];   // server_auth.c에서 선언된 username 테이블
 extern void server_log(const char *fmt, ...);
 
-#define MAX_CLIENTS 10
-
-int wb;
 /**
  *  접속자 목록 문자열을 생성 (username 기반)
  *  결과를 buf에 저장
  */
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t len;
+} UserListBuf;
+
+static void append_user(const char *name, const ConnRef *ref, void *arg) {
+    UserListBuf *b = arg;
+    if (b->len + 1 >= b->size) return;
+
+    int n = snprintf(b->buf + b->len, b->size - b->len, "- %s (socket %d)\n", name, ref->fd);
+    if (n < 0) return;
+    b->len += (size_t)n < b->size - b->len ? (size_t)n : b->size - b->len - 1;
+}
+
 void build_user_list(char *buf, size_t bufsize) {
     buf[0] = '\0';  // 초기화
 
-    char temp[128];
-
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0 && usernames[i][0] != '\0') {
-            snprintf(temp, sizeof(temp), "- %s (socket %d)\n",
-                     usernames[i], client_sockets[i]);
-            strncat(buf, temp, bufsize - strlen(buf) - 1);
-        }
-    }
+    // 모든 shard 의 로그인 사용자 (공용 username 인덱스)
+    UserListBuf b = { buf, bufsize, 0 };
+    conn_foreach_user(append_user, &b);
 
     if (strlen(buf) == 0)
         strcpy(buf, "(no users online)\n");
@@ -47,29 +58,28 @@ void send_user_list(int client_fd) {
     snprintf(msg.data, MAX_BUF, "%s", list_buf);
 
 
-    wb = write(client_fd, &msg, sizeof(msg));
-
-    if(wb < 0){
-        perror("write");
-    }
+    conn_send_msg_fd(client_fd, &msg, 0);
     server_log("접속자 목록 전송 (to socket %d)", client_fd);
 }
 
-void disconnect_client(int idx) {
-    if (client_sockets[idx] > 0) {
-        close(client_sockets[idx]);
-        client_sockets[idx] = 0;
-        usernames[idx][0] = '\0';  // 이름 초기화
-        printf("[SERVER] Client %d disconnected\n", idx);
+void disconnect_client(Conn *c) {
+    if (c && c->fd >= 0) {
+        int fd = c->fd;
+        file_transfer_abort(c);    // 진행 중인 업로드/다운로드 정리
+        spool_abort(c);            // 다 못 보낸 보관 귓속말은 보관함에 남긴다 (이름 해제 전에)
+        conn_clear_username(c);    // 다른 shard 에서 더 이상 찾지 못하게 먼저 이름 해제
+        room_leave(c);             // 채팅방 멤버에서 제거
+        auth_on_disconnect(fd);    // root 였으면 해제
+        conn_flush_final(c);       // kick 공지 등 남은 메시지
+        event_del(fd);
+        close(fd);
+        conn_release(c);           // 슬롯 반납 (이름도 초기화됨)
+        printf("[SERVER] Client %d disconnected\n", fd);
     }
 }
 
 int find_client_fd(const char *name) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0 && strcmp(usernames[i], name) == 0) {
-            return client_sockets[i];
-        }
-    }
-    return -1;
+    Conn *c = conn_by_username(name);
+    return c ? c->fd : -1;
 }
 